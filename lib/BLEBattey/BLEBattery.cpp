@@ -1,5 +1,6 @@
 // C++
 #include "BLEBattery.h"
+#include "BridgeStats.h"
 
 bool _BLEClientConnected = false;
 
@@ -8,11 +9,35 @@ BLEBattery& bleBattery = BLEBattery::getInstance();
 void MyServerCallbacks::onConnect(BLEServer *pServer)
 {
     _BLEClientConnected = true;
+    if (bleBattery._eventTask) xTaskNotifyGive(bleBattery._eventTask);
 }
 
 void MyServerCallbacks::onDisconnect(BLEServer *pServer)
 {
     _BLEClientConnected = false;
+    if (bleBattery._eventTask) xTaskNotifyGive(bleBattery._eventTask);
+}
+
+void MyServerCallbacks::onConnect(BLEServer *pServer, esp_ble_gatts_cb_param_t *param)
+{
+    if (bleBattery._serviceCallbacks) bleBattery._serviceCallbacks->onConnect(pServer, param);
+}
+
+void MyServerCallbacks::onDisconnect(BLEServer *pServer, esp_ble_gatts_cb_param_t *param)
+{
+    if (bleBattery._serviceCallbacks) bleBattery._serviceCallbacks->onDisconnect(pServer, param);
+}
+
+void MyServerCallbacks::onMtuChanged(BLEServer *pServer, esp_ble_gatts_cb_param_t *param)
+{
+    if (bleBattery._serviceCallbacks) bleBattery._serviceCallbacks->onMtuChanged(pServer, param);
+}
+
+void BridgeStatsCallbacks::onRead(BLECharacteristic *pCharacteristic)
+{
+    uint8_t stats[BridgeStats::PACKED_SIZE];
+    size_t len = bridgeStats.pack(stats, sizeof(stats));
+    pCharacteristic->setValue(stats, len);
 }
 
 void BLEBattery::begin(String deviceName)
@@ -38,6 +63,18 @@ void BLEBattery::begin(String deviceName)
     pBattery->addCharacteristic(_BatteryLevelCharacteristic);
     pBattery->start();
 
+    // Bridge traffic counters, readable without touching the data stream.
+    // Read only: the value is longer than a notification, clients fetch it
+    // with a long read and get a snapshot packed on the first request.
+    BLEService *pStats = pServer->createService(BRIDGE_STATS_SERVICE_UUID);
+    _BridgeStatsCharacteristic = new BLECharacteristic(
+        BRIDGE_STATS_UUID,
+        BLECharacteristic::PROPERTY_READ
+    );
+    _BridgeStatsCharacteristic->setCallbacks(new BridgeStatsCallbacks());
+    pStats->addCharacteristic(_BridgeStatsCharacteristic);
+    pStats->start();
+
     pServer->getAdvertising()->addServiceUUID(BATTERY_SERVICE_UUID);
     advertise();
 }
@@ -47,10 +84,11 @@ void BLEBattery::advertise()
     if (pServer) pServer->getAdvertising()->start();
 }
 
-void BLEBattery::setBatteryLevel(uint8_t level)
+void BLEBattery::setBatteryLevel(uint8_t level, bool force)
 {
-    if (_BatteryLevelCharacteristic) {
-        _BatteryLevelCharacteristic->setValue(&level, 1);
-        _BatteryLevelCharacteristic->notify();
-    }
+    if (!_BatteryLevelCharacteristic) return;
+    if (level == _batteryLevel && !force) return;
+    _BatteryLevelCharacteristic->setValue(&level, 1);
+    if (_BLEClientConnected) _BatteryLevelCharacteristic->notify();
+    _batteryLevel = level;
 }
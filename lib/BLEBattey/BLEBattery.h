@@ -5,15 +5,27 @@
 #include <BLEUtils.h>
 #include <BLEServer.h> //Library to use BLE as server
 #include <BLE2902.h> 
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 
 #define BATTERY_SERVICE_UUID        BLEUUID((uint16_t)0x180F)
 #define BATTERY_LEVEL_UUID          BLEUUID((uint16_t)0x2A19)
+#define BRIDGE_STATS_SERVICE_UUID   BLEUUID("9f1e0001-5c3a-4d7e-9b2a-1f6c3e8a7d10")
+#define BRIDGE_STATS_UUID           BLEUUID("9f1e0002-5c3a-4d7e-9b2a-1f6c3e8a7d10")
 
 extern bool _BLEClientConnected;
 
 class MyServerCallbacks : public BLEServerCallbacks {
     void onConnect(BLEServer* pServer);
+    void onConnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param);
     void onDisconnect(BLEServer* pServer);
+    void onDisconnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param);
+    void onMtuChanged(BLEServer* pServer, esp_ble_gatts_cb_param_t* param);
+};
+
+// Packs the bridge counters when a client reads them
+class BridgeStatsCallbacks : public BLECharacteristicCallbacks {
+    void onRead(BLECharacteristic* pCharacteristic);
 };
 
 class BLEBattery {
@@ -23,14 +35,26 @@ private:
     BLEBattery(const BLEBattery&) = delete;
 
     BLECharacteristic* _BatteryLevelCharacteristic = nullptr;
+    BLECharacteristic* _BridgeStatsCharacteristic = nullptr;
     BLEDescriptor* _BatteryLevelDescriptor = nullptr;
     BLEServer* pServer = nullptr;
+    TaskHandle_t _eventTask = nullptr;
+    BLEServerCallbacks* _serviceCallbacks = nullptr;
+    int _batteryLevel = -1; // Last notified level, -1 before the first one
+
+    friend class MyServerCallbacks;
 
 public:
     void begin(String deviceName);
     void advertise();
-    void setBatteryLevel(uint8_t level);
+    // Notifies only when the level changed, unless forced (e.g. on connect)
+    void setBatteryLevel(uint8_t level, bool force = false);
     bool isClientConnected() { return _BLEClientConnected; }
+    // Task notified on every connect and disconnect
+    void setEventTask(TaskHandle_t task) { _eventTask = task; }
+    // Other services on the same server, e.g. BLE UART, get the server events too
+    void setServiceCallbacks(BLEServerCallbacks* callbacks) { _serviceCallbacks = callbacks; }
+    BLEServer* server() { return pServer; }
     static BLEBattery& getInstance() {
         static BLEBattery instance;
         return instance;
@@ -0,0 +1,104 @@
+#include "BatteryCurve.h"
+
+namespace {
+
+constexpr double LN2 = 0.69314718055994530942;
+
+// Natural log for positive x: scale into [1, 2), then the atanh series
+constexpr double cln(double x)
+{
+    int k = 0;
+    while (x >= 2) { x /= 2; k++; }
+    while (x < 1) { x *= 2; k--; }
+    double y = (x - 1) / (x + 1);
+    double y2 = y * y;
+    double term = y;
+    double sum = 0;
+    for (int n = 1; n < 60; n += 2)
+    {
+        sum += term / n;
+        term *= y2;
+    }
+    return 2 * sum + k * LN2;
+}
+
+// e^x: split off a power of two, Taylor series for the remainder
+constexpr double cexp(double x)
+{
+    int n = (int)(x / LN2 + (x < 0 ? -0.5 : 0.5));
+    double r = x - n * LN2;
+    double term = 1;
+    double sum = 1;
+    for (int i = 1; i < 30; ++i)
+    {
+        term *= r / i;
+        sum += term;
+    }
+    for (; n > 0; --n) sum *= 2;
+    for (; n < 0; ++n) sum /= 2;
+    return sum;
+}
+
+constexpr double cpow(double base, double exponent)
+{
+    return cexp(exponent * cln(base));
+}
+
+// The fitted curve the firmware has always used, in percent
+constexpr double socPercent(double volts)
+{
+    return 128.7445 + (1.778399 - 128.7445) / cpow(1 + cpow(volts / 3.689705, 116.3086), 0.1018804);
+}
+
+constexpr uint16_t toCenti(double percent)
+{
+    return percent <= 0 ? 0 : percent >= 100 ? 10000 : (uint16_t)(percent * 100 + 0.5);
+}
+
+struct SocTable {
+    uint16_t v[BatteryCurve::POINTS];
+    constexpr SocTable() : v()
+    {
+        for (size_t i = 0; i < BatteryCurve::POINTS; ++i)
+            v[i] = toCenti(socPercent((BatteryCurve::MIN_MV + i * BatteryCurve::STEP_MV) / 1000.0));
+    }
+};
+
+constexpr SocTable SOC_TABLE;
+
+constexpr uint16_t interpolate(uint32_t mv)
+{
+    if (mv <= BatteryCurve::MIN_MV) return SOC_TABLE.v[0];
+    if (mv >= BatteryCurve::MAX_MV) return SOC_TABLE.v[BatteryCurve::POINTS - 1];
+    uint32_t offset = mv - BatteryCurve::MIN_MV;
+    size_t i = offset / BatteryCurve::STEP_MV;
+    int32_t frac = offset % BatteryCurve::STEP_MV;
+    int32_t lo = SOC_TABLE.v[i];
+    int32_t hi = SOC_TABLE.v[i + 1];
+    return (uint16_t)(lo + (hi - lo) * frac / (int32_t)BatteryCurve::STEP_MV);
+}
+
+// Largest gap between the table and the curve, checked at every millivolt
+constexpr uint32_t maxTableError()
+{
+    uint32_t worst = 0;
+    for (uint32_t mv = BatteryCurve::MIN_MV; mv <= BatteryCurve::MAX_MV; ++mv)
+    {
+        int32_t diff = (int32_t)interpolate(mv) - (int32_t)toCenti(socPercent(mv / 1000.0));
+        uint32_t err = diff < 0 ? -diff : diff;
+        if (err > worst) worst = err;
+    }
+    return worst;
+}
+
+static_assert(cln(2.0) - LN2 < 1e-12 && LN2 - cln(2.0) < 1e-12, "constexpr log is inaccurate");
+static_assert(cexp(1.0) - 2.718281828459045 < 1e-12 && 2.718281828459045 - cexp(1.0) < 1e-12, "constexpr exp is inaccurate");
+static_assert(SOC_TABLE.v[40] > 3900 && SOC_TABLE.v[40] < 4000, "curve mismatch at 3.8 V"); // 39.48 %
+static_assert(maxTableError() < 100, "table must stay within 1% of the curve");
+
+} // namespace
+
+uint16_t BatteryCurve::centiPercent(uint32_t cellMv)
+{
+    return interpolate(cellMv);
+}
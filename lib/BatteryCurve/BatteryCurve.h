@@ -0,0 +1,18 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// State of charge of the LiPo cell from its voltage. The fitted discharge
+// curve is evaluated at compile time into a table of 20 mV steps, and
+// readings are interpolated linearly between the two nearest points.
+class BatteryCurve {
+public:
+    static constexpr uint32_t MIN_MV = 3000;
+    static constexpr uint32_t MAX_MV = 4300;
+    static constexpr uint32_t STEP_MV = 20;
+    static constexpr size_t POINTS = (MAX_MV - MIN_MV) / STEP_MV + 1;
+
+    // Hundredths of a percent, 0 to 10000
+    static uint16_t centiPercent(uint32_t cellMv);
+    static uint8_t percent(uint32_t cellMv) { return centiPercent(cellMv) / 100; }
+};
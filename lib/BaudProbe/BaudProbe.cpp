@@ -0,0 +1,100 @@
+#include "BaudProbe.h"
+
+constexpr uint32_t BaudProbe::CANDIDATES[];
+
+void BaudScorer::feed(const uint8_t* data, size_t len)
+{
+    _nmea.feed(data, len, nullptr, nullptr);
+    _rtcm.feed(data, len, nullptr, nullptr);
+    _bytes += len;
+    for (size_t i = 0; i < len; ++i)
+        if ((data[i] >= 0x20 && data[i] < 0x7F) || data[i] == '\r' || data[i] == '\n')
+            _printable++;
+}
+
+void BaudScorer::reset()
+{
+    _nmea.reset();
+    _nmea.resetStats();
+    _rtcm.reset();
+    _rtcm.resetStats();
+    _bytes = 0;
+    _printable = 0;
+}
+
+uint32_t BaudScorer::score() const
+{
+    uint32_t score = frames() * 1000;
+    if (_bytes >= MIN_BYTES && _printable * 100 >= _bytes * PRINTABLE_PERCENT)
+        score += _printable * 100 / _bytes;
+    return score;
+}
+
+uint32_t BaudProbe::run(Stream& in, SetBaud setBaud, void* ctx, uint32_t first, unsigned long budgetMs)
+{
+    uint32_t order[CANDIDATE_COUNT + 1];
+    size_t count = 0;
+    order[count++] = first;
+    for (uint32_t rate : CANDIDATES)
+        if (rate != first)
+            order[count++] = rate;
+
+    uint8_t buffer[64];
+    uint32_t best = 0;
+    bool heard = false;
+    _bestScore = 0;
+    _activityMs = 0;
+    unsigned long start = millis();
+    while (millis() - start < budgetMs)
+    {
+        for (size_t i = 0; i < count && millis() - start < budgetMs; ++i)
+        {
+            setBaud(ctx, order[i]);
+            while (in.available() > 0)
+                in.read(); // Bytes received at the previous rate
+            _scorer.reset();
+
+            // The window opens with the first byte, so waiting for the
+            // receiver costs no candidate, and closes when its burst ends
+            unsigned long window = windowMs(order[i]);
+            unsigned long gap = gapMs(order[i]);
+            unsigned long opened = 0;
+            unsigned long lastByte = 0;
+            while (_scorer.bytes() < HOP_BYTES && millis() - start < budgetMs)
+            {
+                unsigned long now = millis();
+                if (_scorer.bytes() > 0 && (now - opened >= window || now - lastByte >= gap))
+                    break;
+                int avail = in.available();
+                if (avail <= 0)
+                {
+                    delay(1);
+                    continue;
+                }
+                size_t len = in.readBytes(buffer, (size_t)avail < sizeof(buffer) ? (size_t)avail : sizeof(buffer));
+                lastByte = millis();
+                if (_scorer.bytes() == 0)
+                    opened = lastByte;
+                if (!heard)
+                {
+                    heard = true;
+                    _activityMs = lastByte - start;
+                }
+                _scorer.feed(buffer, len);
+                if (_scorer.frames() > 0)
+                {
+                    _bestScore = _scorer.score();
+                    _elapsedMs = millis() - start;
+                    return order[i];
+                }
+            }
+            if (_scorer.score() > _bestScore)
+            {
+                _bestScore = _scorer.score();
+                best = order[i];
+            }
+        }
+    }
+    _elapsedMs = millis() - start;
+    return best;
+}
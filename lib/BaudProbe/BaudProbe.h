@@ -0,0 +1,75 @@
+#pragma once
+#include <Arduino.h>
+#include <Stream.h>
+#include "NmeaFramer.h"
+#include "Rtcm3Framer.h"
+
+// Scores a byte stream by how well it frames as NMEA 0183 or RTCM 3.
+// Checksum-valid sentences and CRC-valid frames dominate the score; the
+// share of mostly printable traffic only breaks ties between rates that
+// produced no valid framing. Pure logic, so recorded streams can be scored
+// on host.
+class BaudScorer {
+public:
+    static constexpr size_t MIN_BYTES = 32;           // Less than this never scores on printable share alone
+    static constexpr unsigned PRINTABLE_PERCENT = 90; // Wrong rates rarely decode to this much text
+
+    void feed(const uint8_t* data, size_t len);
+    void reset();
+
+    uint32_t frames() const { return _nmea.sentences() + _rtcm.frames(); }
+    size_t bytes() const { return _bytes; }
+    uint32_t score() const;
+
+private:
+    NmeaFramer _nmea;
+    Rtcm3Framer _rtcm;
+    size_t _bytes = 0;
+    size_t _printable = 0;
+};
+
+// Finds the rate a receiver talks at by hopping through the candidate rates
+// while it sends. The first rate that yields a valid sentence or frame is
+// locked at once; otherwise the best scoring rate wins when the time budget
+// runs out. A rate's window opens with the first byte heard at it and closes
+// after HOP_BYTES without framing anything, after as long as HOP_BYTES take
+// at that rate, or when the epoch burst ends. Waiting for the receiver
+// therefore costs no candidate. After 'first', rates are tried fastest
+// first, so the windows ahead of any rate add up to about HOP_BYTES at that
+// rate: an epoch burst of 512 bytes or more locks within the burst, under a
+// second after the receiver's first byte even at 9600 baud. Sparser output
+// spreads the hop over several epochs, at least one candidate per epoch.
+// Blocks for up to the budget; run it from a task of its own.
+class BaudProbe {
+public:
+    using SetBaud = void (*)(void* ctx, uint32_t baud);
+
+    static constexpr uint32_t CANDIDATES[] = {921600, 460800, 230400, 115200, 57600, 38400, 9600};
+    static constexpr size_t CANDIDATE_COUNT = sizeof(CANDIDATES) / sizeof(CANDIDATES[0]);
+    static constexpr size_t HOP_BYTES = 256;       // Two sentences of the longest kind, and then some
+    static constexpr unsigned long GAP_MS = 20;    // Silence that ends an epoch burst
+    static constexpr size_t UART_FIFO_BYTES = 120; // Held by the UART before the driver passes them on
+    // An epoch to wait for the receiver, then one candidate per epoch of a
+    // 1 Hz receiver at worst. Only a silent or sparse receiver takes this long.
+    static constexpr unsigned long BUDGET_MS = (CANDIDATE_COUNT + 1) * 1000;
+
+    // Tries 'first' before the other candidates. Returns the chosen rate, or
+    // 0 if nothing usable was heard; the port is left at the last rate tried.
+    uint32_t run(Stream& in, SetBaud setBaud, void* ctx, uint32_t first, unsigned long budgetMs = BUDGET_MS);
+
+    // Listening time for a rate: HOP_BYTES at that rate, plus a tick
+    static constexpr unsigned long windowMs(uint32_t baud) { return HOP_BYTES * 10 * 1000 / baud + 2; }
+    // Silence that ends a burst at a rate, as the driver delivers FIFO loads
+    static constexpr unsigned long gapMs(uint32_t baud) { return GAP_MS + UART_FIFO_BYTES * 10 * 1000 / baud; }
+
+    unsigned long elapsedMs() const { return _elapsedMs; }
+    // When the first byte was heard, from the start of run(); 0 if none was
+    unsigned long activityMs() const { return _activityMs; }
+    uint32_t bestScore() const { return _bestScore; }
+
+private:
+    BaudScorer _scorer;
+    unsigned long _elapsedMs = 0;
+    unsigned long _activityMs = 0;
+    uint32_t _bestScore = 0;
+};
@@ -0,0 +1,51 @@
+#include "BlePacketizer.h"
+
+uint16_t BlePacketizer::payloadSize()
+{
+    uint16_t mtu = _transport.mtu();
+    if (mtu < MIN_MTU) mtu = MIN_MTU;
+    return mtu - ATT_HEADER;
+}
+
+// Opens a new window once the previous connection interval has passed
+bool BlePacketizer::budgetLeft(uint32_t nowUs)
+{
+    if (!_windowOpen || nowUs - _windowStart >= connectionInterval())
+    {
+        _windowOpen = true;
+        _windowStart = nowUs;
+        _sentInWindow = 0;
+    }
+    return _sentInWindow < _perInterval;
+}
+
+size_t BlePacketizer::send(const uint8_t* data, size_t len, uint32_t nowUs)
+{
+    size_t done = 0;
+    size_t payload = payloadSize();
+    while (done < len && _transport.connected() && budgetLeft(nowUs))
+    {
+        size_t chunk = len - done < payload ? len - done : payload;
+        if (!_transport.notify(data + done, chunk))
+        {
+            // The stack is congested: give up the rest of this interval
+            _refused++;
+            _sentInWindow = _perInterval;
+            break;
+        }
+        _sentInWindow++;
+        _packets++;
+        _bytes += chunk;
+        done += chunk;
+    }
+    return done;
+}
+
+uint32_t BlePacketizer::waitUs(uint32_t nowUs) const
+{
+    if (!_windowOpen || _sentInWindow < _perInterval)
+        return 0;
+    uint32_t elapsed = nowUs - _windowStart;
+    uint32_t interval = connectionInterval();
+    return elapsed >= interval ? 0 : interval - elapsed;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Link to one GATT client. The device implementation wraps a notify
+// characteristic; host tests substitute a fake.
+class GattTransport {
+public:
+    virtual ~GattTransport() = default;
+    virtual bool connected() = 0;
+    virtual uint16_t mtu() = 0;
+    // Sends one notification; false if the stack cannot take it now
+    virtual bool notify(const uint8_t* data, size_t len) = 0;
+};
+
+// Splits a byte stream into notifications filled to MTU-3 bytes and paces
+// them to a budget of packets per connection interval, so the controller
+// is never handed more than it can put on air before the next event.
+class BlePacketizer {
+public:
+    static constexpr uint16_t ATT_HEADER = 3;
+    static constexpr uint16_t MIN_MTU = 23;
+    static constexpr uint32_t DEFAULT_INTERVAL_US = 30000;
+    static constexpr uint8_t DEFAULT_PACKETS_PER_INTERVAL = 4;
+
+    explicit BlePacketizer(GattTransport& transport) : _transport(transport) {}
+
+    // May be called from the BLE stack while another task sends
+    void setConnectionInterval(uint32_t us) { _intervalUs.store(us ? us : DEFAULT_INTERVAL_US, std::memory_order_relaxed); }
+    uint32_t connectionInterval() const { return _intervalUs.load(std::memory_order_relaxed); }
+    void setPacketsPerInterval(uint8_t packets) { _perInterval = packets ? packets : 1; }
+    // Starts a fresh budget, e.g. after a (re)connect
+    void reset() { _windowOpen = false; }
+
+    uint16_t payloadSize();
+    // Sends as much of data as the budget allows at nowUs. Returns bytes consumed.
+    size_t send(const uint8_t* data, size_t len, uint32_t nowUs);
+    // Microseconds until the budget allows the next packet, 0 if now
+    uint32_t waitUs(uint32_t nowUs) const;
+
+    uint32_t packets() const { return _packets; }
+    uint32_t bytes() const { return _bytes; }
+    uint32_t refused() const { return _refused; }
+
+private:
+    GattTransport& _transport;
+    std::atomic<uint32_t> _intervalUs{DEFAULT_INTERVAL_US};
+    uint8_t _perInterval = DEFAULT_PACKETS_PER_INTERVAL;
+
+    bool _windowOpen = false;
+    uint32_t _windowStart = 0;
+    uint8_t _sentInWindow = 0;
+
+    uint32_t _packets = 0;
+    uint32_t _bytes = 0;
+    uint32_t _refused = 0;
+
+    bool budgetLeft(uint32_t nowUs);
+};
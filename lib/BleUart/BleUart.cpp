@@ -0,0 +1,102 @@
+#include "BleUart.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+BleUart& bleUart = BleUart::getInstance();
+
+void BleUart::begin(BLEServer* server)
+{
+    _server = server;
+    BLEDevice::setMTU(LOCAL_MTU);
+    BLEDevice::setCustomGapHandler(onGapEvent);
+
+    BLEService *pUart = server->createService(BLE_UART_SERVICE_UUID);
+    _tx = new BLECharacteristic(BLE_UART_TX_UUID, BLECharacteristic::PROPERTY_NOTIFY);
+    _tx->setCallbacks(&_txCallbacks);
+    _cccd = new BLE2902();
+    _cccd->setCallbacks(&_cccdCallbacks);
+    _tx->addDescriptor(_cccd);
+    pUart->addCharacteristic(_tx);
+    _rx = new BLECharacteristic(BLE_UART_RX_UUID,
+                                BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_WRITE_NR);
+    _rx->setCallbacks(&_rxCallbacks);
+    pUart->addCharacteristic(_rx);
+    pUart->start();
+
+    // A 128-bit UUID next to the battery service and the name would overflow
+    // the 31-byte advertising packet, so apps filtering on NUS find it in the
+    // scan response. It is applied at once and kept across restarts.
+    BLEAdvertisementData scanResponse;
+    scanResponse.setCompleteServices(BLE_UART_SERVICE_UUID);
+    server->getAdvertising()->setScanResponseData(scanResponse);
+}
+
+// Blocks while the pacing budget is used up; drops everything without a subscriber
+size_t BleUart::write(const uint8_t *buffer, size_t size)
+{
+    size_t done = 0;
+    while (done < size && connected())
+    {
+        uint32_t wait = _packetizer.waitUs(micros());
+        if (wait > 0)
+        {
+            vTaskDelay(pdMS_TO_TICKS((wait + 999) / 1000));
+            continue;
+        }
+        done += _packetizer.send(buffer + done, size - done, micros());
+    }
+    return done;
+}
+
+// False unless the stack accepted the notification for the subscriber
+bool BleUart::notify(const uint8_t* data, size_t len)
+{
+    if (!_tx || !connected()) return false;
+    _notified.store(false, std::memory_order_relaxed);
+    _tx->setValue(data, len);
+    _tx->notify();
+    return _notified.load(std::memory_order_relaxed);
+}
+
+void BleUart::onConnect(BLEServer* server, esp_ble_gatts_cb_param_t* param)
+{
+    _mtu.store(BlePacketizer::MIN_MTU, std::memory_order_relaxed);
+    _packetizer.setConnectionInterval(param->connect.conn_params.interval * 1250);
+    _packetizer.reset();
+    // Ask for a short interval; the GAP handler picks up what the client grants
+    server->updateConnParams(param->connect.remote_bda, MIN_INTERVAL, MAX_INTERVAL, 0, SUPERVISION_TIMEOUT);
+}
+
+// The descriptor value outlives the connection; the next client subscribes anew
+void BleUart::onDisconnect(BLEServer* server, esp_ble_gatts_cb_param_t* param)
+{
+    _subscribed.store(false, std::memory_order_relaxed);
+    if (_cccd) _cccd->setNotifications(false);
+}
+
+void BleUart::onMtuChanged(BLEServer* server, esp_ble_gatts_cb_param_t* param)
+{
+    _mtu.store(param->mtu.mtu, std::memory_order_relaxed);
+}
+
+void BleUart::onGapEvent(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param)
+{
+    if (event == ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT)
+        bleUart._packetizer.setConnectionInterval(param->update_conn_params.conn_int * 1250);
+}
+
+void BleUart::RxCallbacks::onWrite(BLECharacteristic* characteristic)
+{
+    if (bleUart._onData && characteristic->getLength() > 0)
+        bleUart._onData(characteristic->getData(), characteristic->getLength());
+}
+
+void BleUart::TxCallbacks::onStatus(BLECharacteristic* characteristic, Status status, uint32_t code)
+{
+    bleUart._notified.store(status == SUCCESS_NOTIFY, std::memory_order_relaxed);
+}
+
+void BleUart::CccdCallbacks::onWrite(BLEDescriptor* descriptor)
+{
+    bleUart._subscribed.store(bleUart._cccd->getNotifications(), std::memory_order_relaxed);
+}
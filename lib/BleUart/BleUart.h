@@ -0,0 +1,91 @@
+#pragma once
+#include <Arduino.h>
+#include <Stream.h>
+#include <atomic>
+#include <BLEDevice.h>
+#include <BLEServer.h>
+#include <BLE2902.h>
+#include "BlePacketizer.h"
+
+// Nordic UART Service UUIDs, understood by most GNSS apps on iOS
+#define BLE_UART_SERVICE_UUID BLEUUID("6e400001-b5a3-f393-e0a9-e50e24dcca9e")
+#define BLE_UART_RX_UUID      BLEUUID("6e400002-b5a3-f393-e0a9-e50e24dcca9e")
+#define BLE_UART_TX_UUID      BLEUUID("6e400003-b5a3-f393-e0a9-e50e24dcca9e")
+
+// NUS-style serial port over BLE GATT, for clients that cannot use Classic
+// SPP. Writes are packetized to the negotiated MTU and paced to the
+// connection interval; they block the calling task while pacing, so they
+// belong behind an OutputForwarder just like SerialBT. A client counts once
+// it has subscribed to TX notifications, not as soon as it connects.
+class BleUart : public Stream, public GattTransport, public BLEServerCallbacks {
+public:
+    using DataHandler = void (*)(const uint8_t* buffer, size_t len);
+
+    static constexpr uint16_t LOCAL_MTU = 517;     // Largest ATT MTU, the client picks the final one
+    static constexpr uint16_t MIN_INTERVAL = 12;   // 15 ms, in 1.25 ms units (the iOS minimum)
+    static constexpr uint16_t MAX_INTERVAL = 24;   // 30 ms
+    static constexpr uint16_t SUPERVISION_TIMEOUT = 400; // 4 s, in 10 ms units
+
+    // Adds the service to an existing server; its events must be forwarded here
+    void begin(BLEServer* server);
+    void onData(DataHandler handler) { _onData = handler; }
+    bool hasClient() { return connected(); }
+    BlePacketizer& packetizer() { return _packetizer; }
+
+    // Stream interface, write-only: received data goes to the onData handler
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+
+    // GattTransport
+    bool connected() override { return _subscribed.load(std::memory_order_relaxed); }
+    uint16_t mtu() override { return _mtu.load(std::memory_order_relaxed); }
+    bool notify(const uint8_t* data, size_t len) override;
+
+    // BLEServerCallbacks
+    using BLEServerCallbacks::onConnect;
+    using BLEServerCallbacks::onDisconnect;
+    void onConnect(BLEServer* server, esp_ble_gatts_cb_param_t* param) override;
+    void onDisconnect(BLEServer* server, esp_ble_gatts_cb_param_t* param) override;
+    void onMtuChanged(BLEServer* server, esp_ble_gatts_cb_param_t* param) override;
+
+    static BleUart& getInstance() {
+        static BleUart instance;
+        return instance;
+    }
+
+private:
+    BleUart() = default;
+    BleUart(const BleUart&) = delete;
+
+    class RxCallbacks : public BLECharacteristicCallbacks {
+        void onWrite(BLECharacteristic* characteristic) override;
+    };
+    // The stack reports each notification before notify() returns
+    class TxCallbacks : public BLECharacteristicCallbacks {
+        void onStatus(BLECharacteristic* characteristic, Status status, uint32_t code) override;
+    };
+    class CccdCallbacks : public BLEDescriptorCallbacks {
+        void onWrite(BLEDescriptor* descriptor) override;
+    };
+
+    BLEServer* _server = nullptr;
+    BLECharacteristic* _tx = nullptr;
+    BLECharacteristic* _rx = nullptr;
+    BLE2902* _cccd = nullptr;
+    RxCallbacks _rxCallbacks;
+    TxCallbacks _txCallbacks;
+    CccdCallbacks _cccdCallbacks;
+    DataHandler _onData = nullptr;
+    std::atomic<bool> _subscribed{false};
+    std::atomic<bool> _notified{false};
+    std::atomic<uint16_t> _mtu{BlePacketizer::MIN_MTU};
+    BlePacketizer _packetizer{*this};
+
+    static void onGapEvent(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param);
+};
+
+extern BleUart& bleUart;
@@ -0,0 +1,71 @@
+#include "BridgeRouter.h"
+
+void BridgeRouterBase::begin()
+{
+    _ownerTimer = xTimerCreate("Owner Timeout", pdMS_TO_TICKS(_ownerTimeout), pdFALSE, this, onOwnerTimer);
+}
+
+void BridgeRouterBase::setUplinkMode(UplinkMode mode)
+{
+    if (mode == UplinkMode::Mux)
+    {
+        for (MuxQueue& mux : _mux)
+            if (mux.queue.capacity() == 0)
+                mux.queue.begin(MUX_QUEUE_SIZE);
+    }
+    // Partial frames and magic word matches belong to the old mode. A menu
+    // command runs from inside the mux framer, which must not be reset under
+    // its own feet; the exclusive path resets it when an uplink takes over.
+    for (int input = 0; input < INPUT_COUNT; ++input)
+    {
+        _magicLen[input] = 0;
+        if (_feeding < 0)
+            uplinkFramer((Input)input).reset();
+    }
+    _uplinkMode = mode;
+}
+
+bool BridgeRouterBase::hasPendingUplink() const
+{
+    for (const MuxQueue& mux : _mux)
+        if (mux.queue.available() > 0)
+            return true;
+    return !_corrections.empty() || (_commands && _commands->busy());
+}
+
+// Moves the state on only if nobody else changed it first
+bool BridgeRouterBase::claim(State from, State to)
+{
+    return _state.compare_exchange_strong(from, to, std::memory_order_acq_rel);
+}
+
+void BridgeRouterBase::restartOwnerTimer()
+{
+    if (_ownerTimer)
+        xTimerChangePeriod(_ownerTimer, pdMS_TO_TICKS(_ownerTimeout), 0);
+}
+
+// Highest priority mux queue holding a frame, -1 if all are empty
+int BridgeRouterBase::nextMuxQueue() const
+{
+    int best = -1;
+    for (int i = 0; i < INPUT_COUNT; ++i)
+        if (_mux[i].queue.available() > 0 && (best < 0 || _mux[i].priority > _mux[best].priority))
+            best = i;
+    return best;
+}
+
+// Runs in the timer service task. Activity only refreshes a timestamp, so the
+// timer re-arms itself for the remaining time until the owner is really idle.
+void BridgeRouterBase::onOwnerTimer(TimerHandle_t timer)
+{
+    BridgeRouterBase* self = static_cast<BridgeRouterBase*>(pvTimerGetTimerID(timer));
+    unsigned long idle = millis() - self->_lastActivity.load(std::memory_order_relaxed);
+    if (idle < self->_ownerTimeout)
+    {
+        xTimerChangePeriod(timer, pdMS_TO_TICKS(self->_ownerTimeout - idle) + 1, 0);
+        return;
+    }
+    if (!self->claim(State::SerialForward, State::Idle))
+        self->claim(State::SerialBTForward, State::Idle);
+}
@@ -0,0 +1,555 @@
+#pragma once
+#include <Arduino.h>
+#include <Stream.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/timers.h>
+#include "MenuCLI.h"
+#include "ByteRing.h"
+#include "NmeaFramer.h"
+#include "Rtcm3Framer.h"
+#include "NmeaFilter.h"
+#include "PacketPool.h"
+#include "GnssCommand.h"
+#include "RtcmScheduler.h"
+
+// Serial1 ownership state machine shared by the USB Serial, SPP and BLE
+// uplinks. SPP and BLE own Serial1 together as the wireless side, but each
+// is framed and matched against the magic word on its own.
+// The state is a single atomic: uplinks claim Serial1 with a compare-and-swap
+// from Idle, and a one-shot timer releases an owner that has gone quiet.
+// In mux mode there is no owner: both uplinks are split into RTCM frames and
+// text lines, and whole frames are interleaved onto Serial1 by priority.
+// In either mode, RTCM frames from SerialBT and BLE wait in the correction
+// scheduler whenever Serial1 is short of space.
+//
+// Everything that does not touch a port lives here; BasicBridgeRouter adds
+// the port wiring on top.
+class BridgeRouterBase {
+public:
+    // Downlink outputs, each with its own sentence filter
+    enum Output
+    {
+        SerialOutput,
+        SerialBTOutput,
+        OUTPUT_COUNT
+    };
+
+    enum Input
+    {
+        SerialInput,
+        SerialBTInput,
+        BLEInput,
+        INPUT_COUNT
+    };
+
+    enum class UplinkMode : uint8_t
+    {
+        Exclusive, // One uplink owns Serial1 until it has been quiet for the owner timeout
+        Mux        // Both uplinks share Serial1 at frame boundaries
+    };
+
+    enum class State
+    {
+        Menu,
+        Idle,
+        SerialForward,
+        SerialBTForward
+    };
+
+    void begin();
+
+    void setState(State state) { _state.store(state, std::memory_order_release); }
+    State state() const { return _state.load(std::memory_order_acquire); }
+    void setOwnerTimeout(unsigned long ms) { _ownerTimeout = ms; }
+
+    void setUplinkMode(UplinkMode mode);
+    UplinkMode uplinkMode() const { return _uplinkMode; }
+    // Higher values go first; the top source may use all of the Serial1 queue
+    void setPriority(Input input, uint8_t priority) { _mux[input].priority = priority; }
+    uint8_t priority(Input input) const { return _mux[input].priority; }
+    bool hasPendingUplink() const;
+    size_t muxPending(Input input) const { return _mux[input].queue.available(); }
+    uint32_t muxFrames(Input input) const { return _mux[input].frames; }
+    uint32_t muxDrops(Input input) const { return _mux[input].drops; }
+    Rtcm3Framer& uplinkFramer(Input input)
+    {
+        return input == SerialInput ? _serialFramer : input == SerialBTInput ? _rtcm : _bleRtcm;
+    }
+
+    NmeaFramer& nmea() { return _nmea; }
+    Rtcm3Framer& rtcm() { return _rtcm; }
+    Rtcm3Framer& bleRtcm() { return _bleRtcm; }
+    RtcmScheduler& corrections() { return _corrections; }
+    NmeaFilter& filter(Output output) { return _downlink[output].filter; }
+    // Downlink batches are built in pool packets and handed to the outputs
+    // by reference. Without a pool, or while it is empty, each sentence is
+    // written on its own.
+    void setPacketPool(PacketPool* pool) { _pool = pool; }
+    // Receiver commands are written to Serial1 between uplink frames and
+    // matched against the downlink sentences, which are still forwarded
+    void setCommandQueue(GnssCommandQueue* commands) { _commands = commands; }
+
+protected:
+    // Frames waiting for room on Serial1, each stored with a 16-bit length
+    static constexpr size_t MUX_QUEUE_SIZE = 4096;
+    // Space on Serial1 kept free for the top priority source
+    static constexpr size_t MUX_HEADROOM = Rtcm3Framer::MAX_FRAME;
+    struct MuxQueue {
+        ByteRing queue;
+        uint8_t priority = 0;
+        uint32_t frames = 0;
+        uint32_t drops = 0;
+    };
+
+    std::atomic<State> _state{State::Idle};
+    std::atomic<unsigned long> _lastActivity{0};
+    unsigned long _ownerTimeout = 2000;
+    TimerHandle_t _ownerTimer = nullptr;
+
+    UplinkMode _uplinkMode = UplinkMode::Exclusive;
+    MuxQueue _mux[INPUT_COUNT];
+    int _feeding = -1; // Input whose data is being framed
+    size_t _magicLen[INPUT_COUNT] = {};
+    uint8_t _muxScratch[2 + Rtcm3Framer::MAX_FRAME];
+
+    // Downlink sentences are batched so each output write ends on a sentence boundary
+    struct Downlink {
+        NmeaFilter filter;
+        Packet* batch = nullptr;
+    };
+    NmeaFramer _nmea;
+    Downlink _downlink[OUTPUT_COUNT];
+    PacketPool* _pool = nullptr;
+    GnssCommandQueue* _commands = nullptr;
+
+    // Corrections from SerialBT and BLE reach Serial1 as whole, CRC-checked frames
+    Rtcm3Framer _rtcm;
+    Rtcm3Framer _bleRtcm;
+    Rtcm3Framer _serialFramer; // Mux mode only
+    RtcmScheduler _corrections;
+
+    static constexpr const char* MAGIC_WORD = "menu";
+    static constexpr size_t MAGIC_LEN = 4;
+
+    BridgeRouterBase() = default;
+    BridgeRouterBase(const BridgeRouterBase&) = delete;
+
+    bool claim(State from, State to);
+    void restartOwnerTimer();
+    int nextMuxQueue() const;
+    static void onOwnerTimer(TimerHandle_t timer);
+};
+
+// The routing table: which copies of the traffic are made. A route that is
+// off is not compiled in at all.
+struct BridgeRoutes {
+    static constexpr bool serialDownlink = true;   // Serial1 sentences to Serial
+    static constexpr bool serialBTDownlink = true; // Serial1 sentences to SerialBT
+    static constexpr bool mirrorSerial = true;     // Serial uplink data echoed to the SerialBT console
+    static constexpr bool mirrorSerialBT = true;   // SerialBT and BLE uplink data echoed to the Serial console
+    static constexpr bool frameSerialBT = true;    // Only whole RTCM frames from SerialBT and BLE reach Serial1
+};
+
+// Routes between the ports it is constructed with. The port types and the
+// routing table are template parameters, so every write on the forwarding
+// path is a direct call into the concrete output stage instead of a virtual
+// Stream call, and the per-uplink wiring below is fixed at compile time.
+// Host builds can instantiate it with mock ports; a port needs
+// write(const uint8_t*, size_t), availableForWrite(), flush() and
+// println(const char*).
+template <class SerialPort, class Serial1Port, class SerialBTPort, class Menu = MenuCLI, class Routes = BridgeRoutes>
+class BasicBridgeRouter : public BridgeRouterBase {
+public:
+    BasicBridgeRouter(SerialPort& serialOut, Serial1Port& serial1Out, SerialBTPort& serialBTOut, Menu& menu)
+        : _serialOut(serialOut), _serial1Out(serial1Out), _serialBTOut(serialBTOut), _menu(menu),
+          _serialUplink{serialOut, serialBTOut, State::SerialForward, State::SerialBTForward,
+                        "ERROR: Serial does not own Serial1.", false, nullptr, SerialInput},
+          _serialBTUplink{serialBTOut, serialOut, State::SerialBTForward, State::SerialForward,
+                          "ERROR: SerialBT does not own Serial1.", true, &_rtcm, SerialBTInput},
+          _bleUplink{serialBTOut, serialOut, State::SerialBTForward, State::SerialForward,
+                     "ERROR: BLE does not own Serial1.", true, &_bleRtcm, BLEInput} {}
+
+    // Data received on each port
+    void onSerial1Data(const uint8_t *buffer, size_t len);
+    void onSerialData(const uint8_t *buffer, size_t len) { onUplinkData(_serialUplink, buffer, len); }
+    void onSerialBTData(const uint8_t *buffer, size_t len) { onUplinkData(_serialBTUplink, buffer, len); }
+    void onBLEData(const uint8_t *buffer, size_t len) { onUplinkData(_bleUplink, buffer, len); }
+
+    // Retries frames held back while Serial1 was short of space, and sends
+    // receiver commands that are due
+    void poll()
+    {
+        pumpMux();
+        pumpCommands();
+    }
+
+private:
+    // Per-uplink wiring: the console it talks to and the console it mirrors
+    // to, if Mirror; with Framed, only whole frames from framer reach Serial1
+    template <class Console, class Peer, bool Mirror, bool Framed>
+    struct Uplink {
+        static constexpr bool MIRROR = Mirror;
+        static constexpr bool FRAMED = Framed;
+        Console& console;
+        Peer& peer;
+        State owning;
+        State other;
+        const char* ownerError;
+        bool flushBeforeMenu;
+        Rtcm3Framer* framer;
+        Input input;
+    };
+    using SerialUplink = Uplink<SerialPort, SerialBTPort, Routes::mirrorSerial, false>;
+    using SerialBTUplink = Uplink<SerialBTPort, SerialPort, Routes::mirrorSerialBT, Routes::frameSerialBT>;
+
+    SerialPort& _serialOut;
+    Serial1Port& _serial1Out;
+    SerialBTPort& _serialBTOut;
+    Menu& _menu;
+
+    SerialUplink _serialUplink;
+    SerialBTUplink _serialBTUplink;
+    SerialBTUplink _bleUplink;
+
+    // Calls f with the uplink of input; each branch is compiled separately
+    template <class F>
+    void withUplink(int input, F f)
+    {
+        if (input == SerialInput)
+            f(_serialUplink);
+        else if (input == SerialBTInput)
+            f(_serialBTUplink);
+        else
+            f(_bleUplink);
+    }
+
+    template <class U>
+    void onUplinkData(U& src, const uint8_t *buffer, size_t len);
+    template <class U>
+    bool enterMenu(U& src);
+    template <class U>
+    void submit(U& src, const uint8_t* frame, size_t len);
+    void submitCorrection(const uint8_t* frame, size_t len);
+    static void onMuxFrame(void* ctx, const uint8_t* frame, size_t len, uint16_t type);
+    static void onMuxLine(void* ctx, const uint8_t* line, size_t len);
+    bool fits(Input input, size_t len);
+    void pumpMux();
+    void pumpCommands();
+    static void onSentence(void* ctx, const uint8_t* sentence, size_t len);
+    static void onUplinkFrame(void* ctx, const uint8_t* frame, size_t len, uint16_t type);
+    void flushDownlink(Output output);
+    template <class Port>
+    void sendDownlink(Port& port, Output output, const uint8_t* sentence, size_t len);
+};
+
+// Forward complete, checksum-valid Serial1 sentences to Serial and SerialBT
+template <class SerialPort, class Serial1Port, class SerialBTPort, class Menu, class Routes>
+void BasicBridgeRouter<SerialPort, Serial1Port, SerialBTPort, Menu, Routes>::onSerial1Data(const uint8_t *buffer, size_t len)
+{
+    _nmea.feed(buffer, len, onSentence, this);
+    if constexpr (Routes::serialDownlink)
+        flushDownlink(SerialOutput);
+    if constexpr (Routes::serialBTDownlink)
+        flushDownlink(SerialBTOutput);
+    pumpCommands();
+}
+
+template <class SerialPort, class Serial1Port, class SerialBTPort, class Menu, class Routes>
+void BasicBridgeRouter<SerialPort, Serial1Port, SerialBTPort, Menu, Routes>::onSentence(void* ctx, const uint8_t* sentence, size_t len)
+{
+    BasicBridgeRouter* self = static_cast<BasicBridgeRouter*>(ctx);
+    unsigned long now = millis();
+    if (self->_commands)
+        self->_commands->onSentence(sentence, len, now);
+    if constexpr (Routes::serialDownlink)
+        if (self->_downlink[SerialOutput].filter.accept(sentence, len, now))
+            self->sendDownlink(self->_serialOut, SerialOutput, sentence, len);
+    if constexpr (Routes::serialBTDownlink)
+        if (self->_downlink[SerialBTOutput].filter.accept(sentence, len, now))
+            self->sendDownlink(self->_serialBTOut, SerialBTOutput, sentence, len);
+}
+
+template <class SerialPort, class Serial1Port, class SerialBTPort, class Menu, class Routes>
+template <class Port>
+void BasicBridgeRouter<SerialPort, Serial1Port, SerialBTPort, Menu, Routes>::sendDownlink(Port& port, Output output, const uint8_t* sentence, size_t len)
+{
+    Downlink& downlink = _downlink[output];
+    if (downlink.batch && downlink.batch->room() < len)
+        flushDownlink(output);
+    if (!downlink.batch && _pool)
+        downlink.batch = _pool->acquire();
+    if (downlink.batch && downlink.batch->room() >= len)
+    {
+        memcpy(downlink.batch->data + downlink.batch->len, sentence, len);
+        downlink.batch->len += len;
+        return;
+    }
+    // Pool empty or sentence larger than a packet
+    flushDownlink(output);
+    port.write(sentence, len);
+}
+
+template <class SerialPort, class Serial1Port, class SerialBTPort, class Menu, class Routes>
+void BasicBridgeRouter<SerialPort, Serial1Port, SerialBTPort, Menu, Routes>::flushDownlink(Output output)
+{
+    Packet* batch = _downlink[output].batch;
+    if (!batch) return;
+    if (batch->len > 0)
+    {
+        if (output == SerialOutput)
+            sendPacket(_serialOut, batch);
+        else
+            sendPacket(_serialBTOut, batch);
+    }
+    batch->release();
+    _downlink[output].batch = nullptr;
+}
+
+template <class SerialPort, class Serial1Port, class SerialBTPort, class Menu, class Routes>
+void BasicBridgeRouter<SerialPort, Serial1Port, SerialBTPort, Menu, Routes>::onUplinkFrame(void* ctx, const uint8_t* frame, size_t len, uint16_t type)
+{
+    static_cast<BasicBridgeRouter*>(ctx)->submitCorrection(frame, len);
+}
+
+template <class SerialPort, class Serial1Port, class SerialBTPort, class Menu, class Routes>
+template <class U>
+void BasicBridgeRouter<SerialPort, Serial1Port, SerialBTPort, Menu, Routes>::onUplinkData(U& src, const uint8_t *buffer, size_t len)
+{
+    if (_uplinkMode == UplinkMode::Mux)
+    {
+        _feeding = src.input;
+        uplinkFramer(src.input).feed(buffer, len, onMuxFrame, this, onMuxLine);
+        _feeding = -1;
+        pumpMux();
+        return;
+    }
+
+    _lastActivity.store(millis(), std::memory_order_relaxed);
+    State currentState = state();
+
+    if (currentState == State::Idle)
+    {
+        size_t& magicLen = _magicLen[src.input];
+        size_t processed = 0;
+        while (magicLen < MAGIC_LEN && processed < len)
+        {
+            char c = buffer[processed++];
+            if (c != MAGIC_WORD[magicLen++])
+            {
+                magicLen = 0;
+                if (claim(State::Idle, src.owning))
+                {
+                    if constexpr (U::FRAMED)
+                        src.framer->reset();
+                    restartOwnerTimer();
+                }
+                // Forward all data in whatever state won
+                onUplinkData(src, buffer, len);
+                return;
+            }
+            if (magicLen == MAGIC_LEN)
+            {
+                magicLen = 0;
+                if (!enterMenu(src))
+                {
+                    // The other uplink took Serial1 first, so the word is data
+                    onUplinkData(src, buffer, len);
+                    return;
+                }
+                if (processed < len)
+                {
+                    onUplinkData(src, buffer + processed, len - processed);
+                }
+                return;
+            }
+        }
+        // Not enough data yet to decide, wait for more
+        return;
+    }
+
+    if (currentState == src.owning)
+    {
+        if constexpr (U::MIRROR)
+            src.peer.write(buffer, len);
+        if constexpr (U::FRAMED)
+            src.framer->feed(buffer, len, onUplinkFrame, this);
+        else
+            _serial1Out.write(buffer, len);
+    }
+    else if (currentState == State::Menu)
+    {
+        _menu.write(buffer, len);
+    }
+    else if (currentState == src.other)
+    {
+        if constexpr (U::MIRROR)
+            src.peer.write(buffer, len);
+        src.console.println(src.ownerError);
+    }
+}
+
+template <class SerialPort, class Serial1Port, class SerialBTPort, class Menu, class Routes>
+template <class U>
+bool BasicBridgeRouter<SerialPort, Serial1Port, SerialBTPort, Menu, Routes>::enterMenu(U& src)
+{
+    if (!claim(State::Idle, State::Menu))
+        return false;
+    src.console.println("\n[Menu mode entered]");
+    if (src.flushBeforeMenu)
+    {
+        src.console.flush();
+        delay(10); // Give client time to process
+    }
+    _menu.begin();
+    return true;
+}
+
+// Corrections keep flowing in mux mode, even while the menu is open
+template <class SerialPort, class Serial1Port, class SerialBTPort, class Menu, class Routes>
+void BasicBridgeRouter<SerialPort, Serial1Port, SerialBTPort, Menu, Routes>::onMuxFrame(void* ctx, const uint8_t* frame, size_t len, uint16_t type)
+{
+    BasicBridgeRouter* self = static_cast<BasicBridgeRouter*>(ctx);
+    if (self->_feeding != SerialInput && self->_corrections.enabled())
+    {
+        if constexpr (Routes::mirrorSerialBT)
+            self->_serialBTUplink.peer.write(frame, len);
+        self->submitCorrection(frame, len);
+        return;
+    }
+    self->withUplink(self->_feeding, [&](auto& src) { self->submit(src, frame, len); });
+}
+
+// Text lines are commands for the receiver, or for the menu while it is open.
+// A line holding only the magic word opens the menu.
+template <class SerialPort, class Serial1Port, class SerialBTPort, class Menu, class Routes>
+void BasicBridgeRouter<SerialPort, Serial1Port, SerialBTPort, Menu, Routes>::onMuxLine(void* ctx, const uint8_t* line, size_t len)
+{
+    BasicBridgeRouter* self = static_cast<BasicBridgeRouter*>(ctx);
+    if (self->state() == State::Menu)
+    {
+        self->_menu.write(line, len);
+        return;
+    }
+    size_t textLen = len;
+    while (textLen > 0 && (line[textLen - 1] == '\r' || line[textLen - 1] == '\n'))
+        textLen--;
+    bool magic = textLen == MAGIC_LEN && memcmp(line, MAGIC_WORD, MAGIC_LEN) == 0;
+    self->withUplink(self->_feeding, [&](auto& src) {
+        if (!magic || !self->enterMenu(src))
+            self->submit(src, line, len);
+    });
+}
+
+// Frames go straight to Serial1 unless they would overtake queued frames of
+// the same or a higher priority source, or eat into the reserved headroom
+template <class SerialPort, class Serial1Port, class SerialBTPort, class Menu, class Routes>
+template <class U>
+void BasicBridgeRouter<SerialPort, Serial1Port, SerialBTPort, Menu, Routes>::submit(U& src, const uint8_t* frame, size_t len)
+{
+    if constexpr (U::MIRROR)
+        src.peer.write(frame, len);
+    MuxQueue& mux = _mux[src.input];
+    bool queuedAhead = false;
+    for (const MuxQueue& other : _mux)
+        if (other.queue.available() > 0 && other.priority >= mux.priority)
+            queuedAhead = true;
+    if (!_corrections.empty() && _mux[SerialBTInput].priority >= mux.priority)
+        queuedAhead = true;
+    if (!queuedAhead && fits(src.input, len))
+    {
+        _serial1Out.write(frame, len);
+        mux.frames++;
+        return;
+    }
+    const uint8_t header[2] = {(uint8_t)(len & 0xFF), (uint8_t)(len >> 8)};
+    if (mux.queue.freeSpace() < sizeof(header) + len)
+    {
+        mux.drops++;
+        return;
+    }
+    mux.queue.writeAll(header, sizeof(header));
+    mux.queue.writeAll(frame, len);
+}
+
+template <class SerialPort, class Serial1Port, class SerialBTPort, class Menu, class Routes>
+bool BasicBridgeRouter<SerialPort, Serial1Port, SerialBTPort, Menu, Routes>::fits(Input input, size_t len)
+{
+    int room = _serial1Out.availableForWrite();
+    size_t reserve = 0;
+    for (int other = 0; other < INPUT_COUNT; ++other)
+        if (_mux[other].priority > _mux[input].priority)
+            reserve = MUX_HEADROOM;
+    return room >= 0 && (size_t)room >= len + reserve;
+}
+
+// Sends queued frames, highest priority first. When the frame at the head
+// does not fit yet, lower priority sources wait behind it. Scheduled
+// corrections compete with the SerialBT priority and go after its queued
+// lines; in exclusive mode they only go out while SerialBT or BLE owns Serial1.
+template <class SerialPort, class Serial1Port, class SerialBTPort, class Menu, class Routes>
+void BasicBridgeRouter<SerialPort, Serial1Port, SerialBTPort, Menu, Routes>::pumpMux()
+{
+    if (_uplinkMode == UplinkMode::Exclusive && !_corrections.empty() && state() != State::SerialBTForward)
+        _corrections.clear();
+    for (;;)
+    {
+        int best = nextMuxQueue();
+        if (!_corrections.empty() && (best < 0 || _mux[SerialBTInput].priority > _mux[best].priority))
+        {
+            size_t len;
+            const uint8_t* frame = _corrections.front(len);
+            if (!fits(SerialBTInput, len + _corrections.reserve()))
+                return;
+            _serial1Out.write(frame, len);
+            _corrections.pop();
+            continue;
+        }
+        if (best < 0)
+            return;
+
+        MuxQueue& mux = _mux[best];
+        uint8_t header[2];
+        mux.queue.peek(header, sizeof(header));
+        size_t len = header[0] | (header[1] << 8);
+        if (!fits((Input)best, len))
+            return;
+        mux.queue.read(_muxScratch, sizeof(header) + len);
+        _serial1Out.write(_muxScratch + sizeof(header), len);
+        mux.frames++;
+    }
+}
+
+// Commands only go out at a frame boundary: in mux mode every uplink write
+// is a whole frame, otherwise no uplink may be streaming raw bytes
+template <class SerialPort, class Serial1Port, class SerialBTPort, class Menu, class Routes>
+void BasicBridgeRouter<SerialPort, Serial1Port, SerialBTPort, Menu, Routes>::pumpCommands()
+{
+    if (!_commands)
+        return;
+    State current = state();
+    if (_uplinkMode == UplinkMode::Exclusive && current != State::Menu && current != State::Idle)
+        return;
+    unsigned long now = millis();
+    const GnssCommandQueue::Command* command = _commands->ready(now);
+    if (!command)
+        return;
+    int room = _serial1Out.availableForWrite();
+    if (room < 0 || (size_t)room < command->len)
+        return;
+    _serial1Out.write((const uint8_t*)command->sentence, command->len);
+    _commands->sentSentence(now);
+}
+
+// Without the scheduler, frames go out in arrival order as before
+template <class SerialPort, class Serial1Port, class SerialBTPort, class Menu, class Routes>
+void BasicBridgeRouter<SerialPort, Serial1Port, SerialBTPort, Menu, Routes>::submitCorrection(const uint8_t* frame, size_t len)
+{
+    if (!_corrections.enabled())
+    {
+        _serial1Out.write(frame, len);
+        return;
+    }
+    _corrections.push(frame, len);
+    pumpMux();
+}
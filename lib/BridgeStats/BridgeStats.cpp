@@ -0,0 +1,62 @@
+#include "BridgeStats.h"
+
+BridgeStats& bridgeStats = BridgeStats::getInstance();
+
+void LinkCounters::reset()
+{
+    bytes.store(0, std::memory_order_relaxed);
+    chunks.store(0, std::memory_order_relaxed);
+    drops.store(0, std::memory_order_relaxed);
+    truncated.store(0, std::memory_order_relaxed);
+    maxDepth.store(0, std::memory_order_relaxed);
+    stalls.store(0, std::memory_order_relaxed);
+    stallUs.store(0, std::memory_order_relaxed);
+}
+
+size_t BridgeStats::pack(uint8_t* out, size_t size) const
+{
+    if (size < PACKED_SIZE) return 0;
+    size_t pos = 0;
+    for (const LinkCounters& link : _links)
+    {
+        const uint32_t fields[FIELD_COUNT] = {
+            link.bytes.load(std::memory_order_relaxed),
+            link.chunks.load(std::memory_order_relaxed),
+            link.drops.load(std::memory_order_relaxed),
+            link.truncated.load(std::memory_order_relaxed),
+            link.maxDepth.load(std::memory_order_relaxed),
+            link.stalls.load(std::memory_order_relaxed),
+            link.stallUs.load(std::memory_order_relaxed),
+        };
+        for (uint32_t v : fields)
+        {
+            out[pos++] = v & 0xFF;
+            out[pos++] = (v >> 8) & 0xFF;
+            out[pos++] = (v >> 16) & 0xFF;
+            out[pos++] = (v >> 24) & 0xFF;
+        }
+    }
+    return pos;
+}
+
+void BridgeStats::reset()
+{
+    for (LinkCounters& link : _links)
+        link.reset();
+}
+
+const char* BridgeStats::name(Link link)
+{
+    switch (link)
+    {
+    case SerialRx: return "Serial RX";
+    case Serial1Rx: return "Serial1 RX";
+    case SerialBTRx: return "SerialBT RX";
+    case SerialTx: return "Serial TX";
+    case Serial1Tx: return "Serial1 TX";
+    case SerialBTTx: return "SerialBT TX";
+    case BLERx: return "BLE RX";
+    case BLETx: return "BLE TX";
+    default: return "?";
+    }
+}
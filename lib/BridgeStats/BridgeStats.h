@@ -0,0 +1,80 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Traffic counters for one direction of one port. Updated on the hot path
+// with relaxed atomics; readers only ever see a best-effort snapshot.
+struct LinkCounters {
+    static constexpr uint32_t STALL_THRESHOLD_US = 5000; // Writes slower than this count as stalls
+
+    std::atomic<uint32_t> bytes{0};
+    std::atomic<uint32_t> chunks{0};
+    std::atomic<uint32_t> drops{0};     // Bytes lost to full queues
+    std::atomic<uint32_t> truncated{0}; // Reads that filled the whole read buffer
+    std::atomic<uint32_t> maxDepth{0};  // Deepest queue level seen
+    std::atomic<uint32_t> stalls{0};    // Writes that blocked longer than STALL_THRESHOLD_US
+    std::atomic<uint32_t> stallUs{0};   // Total time spent in blocked writes
+
+    void chunk(size_t len)
+    {
+        bytes.fetch_add(len, std::memory_order_relaxed);
+        chunks.fetch_add(1, std::memory_order_relaxed);
+    }
+    void drop(size_t len) { drops.fetch_add(len, std::memory_order_relaxed); }
+    void truncate() { truncated.fetch_add(1, std::memory_order_relaxed); }
+    void depth(size_t level)
+    {
+        uint32_t seen = maxDepth.load(std::memory_order_relaxed);
+        while (level > seen && !maxDepth.compare_exchange_weak(seen, level, std::memory_order_relaxed)) {}
+    }
+    void write(uint32_t us)
+    {
+        if (us < STALL_THRESHOLD_US) return;
+        stalls.fetch_add(1, std::memory_order_relaxed);
+        stallUs.fetch_add(us, std::memory_order_relaxed);
+    }
+    void reset();
+};
+
+class BridgeStats {
+public:
+    enum Link
+    {
+        SerialRx,
+        Serial1Rx,
+        SerialBTRx,
+        SerialTx,
+        Serial1Tx,
+        SerialBTTx,
+        BLERx,
+        BLETx,
+        LINK_COUNT
+    };
+
+    static constexpr size_t FIELD_COUNT = 7;
+    static constexpr size_t PACKED_SIZE = LINK_COUNT * FIELD_COUNT * sizeof(uint32_t);
+
+    LinkCounters& operator[](Link link) { return _links[link]; }
+    const LinkCounters& operator[](Link link) const { return _links[link]; }
+
+    // Little-endian uint32 fields per link, in Link order:
+    // bytes, chunks, drops, truncated, maxDepth, stalls, stallUs
+    size_t pack(uint8_t* out, size_t size) const;
+    void reset();
+
+    static const char* name(Link link);
+
+    static BridgeStats& getInstance() {
+        static BridgeStats instance;
+        return instance;
+    }
+
+private:
+    BridgeStats() = default;
+    BridgeStats(const BridgeStats&) = delete;
+
+    LinkCounters _links[LINK_COUNT];
+};
+
+extern BridgeStats& bridgeStats;
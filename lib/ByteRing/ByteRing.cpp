@@ -0,0 +1,120 @@
+#include "ByteRing.h"
+#include <esp_heap_caps.h>
+
+bool ByteRing::begin(size_t capacity, bool preferPsram)
+{
+    end();
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+
+    if (preferPsram)
+        _buffer = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!_buffer)
+        _buffer = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_8BIT);
+    if (!_buffer) return false;
+
+    _mask = size - 1;
+    _head.store(0, std::memory_order_relaxed);
+    _tail.store(0, std::memory_order_relaxed);
+    resetStats();
+    return true;
+}
+
+void ByteRing::end()
+{
+    if (_buffer) heap_caps_free(_buffer);
+    _buffer = nullptr;
+    _mask = 0;
+}
+
+size_t ByteRing::write(const uint8_t* data, size_t len)
+{
+    if (!_buffer) {
+        _overflow.fetch_add(len, std::memory_order_relaxed);
+        return 0;
+    }
+    size_t head = _head.load(std::memory_order_relaxed);
+    size_t tail = _tail.load(std::memory_order_acquire);
+    size_t space = capacity() - (head - tail);
+    size_t n = len < space ? len : space;
+    if (n < len)
+        _overflow.fetch_add(len - n, std::memory_order_relaxed);
+    if (n == 0) return 0;
+
+    copyIn(head, data, n);
+    _head.store(head + n, std::memory_order_release);
+
+    size_t used = head + n - tail;
+    if (used > _highWater.load(std::memory_order_relaxed))
+        _highWater.store(used, std::memory_order_relaxed);
+    return n;
+}
+
+bool ByteRing::writeAll(const uint8_t* data, size_t len)
+{
+    if (len > freeSpace()) {
+        _overflow.fetch_add(len, std::memory_order_relaxed);
+        return false;
+    }
+    return write(data, len) == len;
+}
+
+size_t ByteRing::freeSpace() const
+{
+    if (!_buffer) return 0;
+    return capacity() - (_head.load(std::memory_order_relaxed) - _tail.load(std::memory_order_acquire));
+}
+
+size_t ByteRing::read(uint8_t* data, size_t len)
+{
+    size_t n = peek(data, len);
+    if (n) _tail.store(_tail.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    return n;
+}
+
+size_t ByteRing::peek(uint8_t* data, size_t len) const
+{
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    size_t avail = _head.load(std::memory_order_acquire) - tail;
+    size_t n = len < avail ? len : avail;
+    if (n) copyOut(tail, data, n);
+    return n;
+}
+
+size_t ByteRing::skip(size_t len)
+{
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    size_t avail = _head.load(std::memory_order_acquire) - tail;
+    size_t n = len < avail ? len : avail;
+    if (n) _tail.store(tail + n, std::memory_order_release);
+    return n;
+}
+
+size_t ByteRing::available() const
+{
+    return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_relaxed);
+}
+
+void ByteRing::resetStats()
+{
+    _overflow.store(0, std::memory_order_relaxed);
+    _highWater.store(0, std::memory_order_relaxed);
+}
+
+void ByteRing::copyIn(size_t pos, const uint8_t* data, size_t len)
+{
+    size_t offset = pos & _mask;
+    size_t first = capacity() - offset;
+    if (first > len) first = len;
+    memcpy(_buffer + offset, data, first);
+    if (len > first) memcpy(_buffer, data + first, len - first);
+}
+
+void ByteRing::copyOut(size_t pos, uint8_t* data, size_t len) const
+{
+    size_t offset = pos & _mask;
+    size_t first = capacity() - offset;
+    if (first > len) first = len;
+    memcpy(data, _buffer + offset, first);
+    if (len > first) memcpy(data + first, _buffer, len - first);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Lock-free single-producer/single-consumer byte ring.
+// Exactly one context may call the producer methods and exactly one other
+// context the consumer methods; neither side ever blocks or takes a lock.
+class ByteRing {
+public:
+    ByteRing() = default;
+    ~ByteRing() { end(); }
+    ByteRing(const ByteRing&) = delete;
+    ByteRing& operator=(const ByteRing&) = delete;
+
+    // Allocates the storage. Capacity is rounded up to a power of two.
+    // Returns false if no memory could be allocated.
+    bool begin(size_t capacity, bool preferPsram = true);
+    void end();
+
+    // Producer side
+    size_t write(const uint8_t* data, size_t len);    // Writes what fits, counts the rest as overflow
+    bool writeAll(const uint8_t* data, size_t len);   // Writes everything or nothing
+    size_t freeSpace() const;
+
+    // Consumer side
+    size_t read(uint8_t* data, size_t len);
+    size_t peek(uint8_t* data, size_t len) const;
+    size_t skip(size_t len);
+    size_t available() const;
+
+    size_t capacity() const { return _buffer ? _mask + 1 : 0; }
+    // Running byte offsets, used to match bytes to their receive timestamps
+    size_t totalWritten() const { return _head.load(std::memory_order_acquire); }
+    size_t totalRead() const { return _tail.load(std::memory_order_acquire); }
+
+    // Statistics
+    uint32_t overflowBytes() const { return _overflow.load(std::memory_order_relaxed); }
+    size_t highWater() const { return _highWater.load(std::memory_order_relaxed); }
+    void resetStats();
+
+private:
+    uint8_t* _buffer = nullptr;
+    size_t _mask = 0;
+    std::atomic<size_t> _head{0}; // Total bytes written, owned by the producer
+    std::atomic<size_t> _tail{0}; // Total bytes read, owned by the consumer
+    std::atomic<uint32_t> _overflow{0};
+    std::atomic<size_t> _highWater{0};
+
+    void copyIn(size_t pos, const uint8_t* data, size_t len);
+    void copyOut(size_t pos, uint8_t* data, size_t len) const;
+};
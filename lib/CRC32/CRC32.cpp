@@ -0,0 +1,88 @@
+#include "CRC32.h"
+#include <esp_rom_crc.h>
+
+namespace {
+
+// Slice-by-8 tables for the reflected CRC-32 polynomial 0xEDB88320,
+// generated at compile time. Table 0 is the classic byte-wise table.
+struct Crc32Tables {
+    uint32_t t[8][256];
+    constexpr Crc32Tables() : t()
+    {
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t crc = i;
+            for (int j = 0; j < 8; ++j)
+                crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+            t[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i)
+            for (int k = 1; k < 8; ++k)
+                t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+    }
+};
+
+constexpr Crc32Tables CRC32_TABLES;
+
+constexpr uint32_t crc32Bytewise(uint32_t crc, const char* data, size_t len)
+{
+    for (size_t i = 0; i < len; ++i)
+        crc = (crc >> 8) ^ CRC32_TABLES.t[0][(crc ^ (uint8_t)data[i]) & 0xFF];
+    return crc;
+}
+
+// The runtime loop, also evaluated at compile time below so the eight-byte
+// step itself is checked and not just the tables
+template <class Byte>
+constexpr uint32_t crc32Slice8(uint32_t crc, const Byte* data, size_t len)
+{
+    const auto& t = CRC32_TABLES.t;
+
+    // Eight bytes per step, then byte-wise for the tail
+    while (len >= 8) {
+        uint32_t one = crc ^ ((uint32_t)(uint8_t)data[0] | (uint32_t)(uint8_t)data[1] << 8 |
+                              (uint32_t)(uint8_t)data[2] << 16 | (uint32_t)(uint8_t)data[3] << 24);
+        uint32_t two = (uint32_t)(uint8_t)data[4] | (uint32_t)(uint8_t)data[5] << 8 |
+                       (uint32_t)(uint8_t)data[6] << 16 | (uint32_t)(uint8_t)data[7] << 24;
+        crc = t[7][one & 0xFF] ^ t[6][(one >> 8) & 0xFF] ^ t[5][(one >> 16) & 0xFF] ^ t[4][one >> 24] ^
+              t[3][two & 0xFF] ^ t[2][(two >> 8) & 0xFF] ^ t[1][(two >> 16) & 0xFF] ^ t[0][two >> 24];
+        data += 8;
+        len -= 8;
+    }
+    while (len--) {
+        crc = (crc >> 8) ^ t[0][(crc ^ (uint8_t)*data++) & 0xFF];
+    }
+    return crc;
+}
+
+// Standard check values, so a bad table or step never makes it into a build
+static_assert(CRC32_TABLES.t[0][1] == 0x77073096, "CRC32 table mismatch");
+static_assert(CRC32_TABLES.t[0][255] == 0x2D02EF8D, "CRC32 table mismatch");
+static_assert(~crc32Bytewise(0xFFFFFFFF, "123456789", 9) == 0xCBF43926, "CRC32 check value mismatch");
+static_assert(~crc32Slice8(0xFFFFFFFF, "123456789", 9) == 0xCBF43926, "CRC32 slice-by-8 check value mismatch");
+static_assert(~crc32Slice8(0xFFFFFFFF, "The quick brown fox jumps over the lazy dog", 43) == 0x414FA339,
+              "CRC32 slice-by-8 mismatch over several steps");
+
+} // namespace
+
+// CRC32 (polynomial 0xEDB88320), bit-compatible with the original bitwise loop
+uint32_t CRC32::calculate(const uint8_t* data, size_t len) {
+    return ~update(0xFFFFFFFF, data, len);
+}
+
+uint32_t CRC32::update(uint32_t crc, const uint8_t* data, size_t len) {
+#ifdef CRC32_ROM
+    return updateRom(crc, data, len);
+#else
+    return updateTables(crc, data, len);
+#endif
+}
+
+uint32_t CRC32::updateTables(uint32_t crc, const uint8_t* data, size_t len) {
+    return crc32Slice8(crc, data, len);
+}
+
+// The ROM routine inverts on entry and exit itself
+uint32_t CRC32::updateRom(uint32_t crc, const uint8_t* data, size_t len) {
+    return ~esp_rom_crc32_le(~crc, data, len);
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Table-driven slice-by-8 CRC32. Define CRC32_ROM to use the ESP32 ROM
+// crc32_le routine instead of the tables.
+class CRC32 {
+public:
+    static uint32_t calculate(const uint8_t* data, size_t len);
+    // Raw register update for incremental use: start with 0xFFFFFFFF, invert at the end
+    static uint32_t update(uint32_t crc, const uint8_t* data, size_t len);
+    // The two implementations behind update(), both always built so they
+    // can be checked against each other
+    static uint32_t updateTables(uint32_t crc, const uint8_t* data, size_t len);
+    static uint32_t updateRom(uint32_t crc, const uint8_t* data, size_t len);
+};
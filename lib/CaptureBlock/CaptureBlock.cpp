@@ -0,0 +1,122 @@
+#include "CaptureBlock.h"
+#include <string.h>
+#include "CRC32.h"
+
+static void putLe(uint8_t* out, uint64_t value, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; ++i)
+        out[i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint64_t getLe(const uint8_t* in, size_t bytes)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i)
+        value |= (uint64_t)in[i] << (8 * i);
+    return value;
+}
+
+void CaptureBlock::start(uint32_t seq, uint64_t baseUs)
+{
+    _seq = seq;
+    _baseUs = baseUs;
+    _lastUs = baseUs;
+    _used = HEADER_LEN;
+    _records = 0;
+}
+
+size_t CaptureBlock::putVarint(size_t pos, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        _data[pos++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    _data[pos++] = (uint8_t)value;
+    return pos;
+}
+
+bool CaptureBlock::append(uint64_t us, uint8_t source, const uint8_t* data, size_t len)
+{
+    uint64_t delta = us > _lastUs ? us - _lastUs : 0;
+    if (delta > UINT32_MAX || _records == UINT16_MAX || _used + MAX_RECORD_HEADER + len > SIZE)
+        return false;
+    size_t pos = putVarint(_used, (uint32_t)delta);
+    _data[pos++] = source;
+    pos = putVarint(pos, (uint32_t)len);
+    memcpy(_data + pos, data, len);
+    _used = pos + len;
+    _records++;
+    _lastUs = us > _lastUs ? us : _lastUs;
+    return true;
+}
+
+const uint8_t* CaptureBlock::finish()
+{
+    // The unused tail is zeroed so stale records never look valid
+    memset(_data + _used, 0, SIZE - _used);
+    putLe(_data, MAGIC, 4);
+    putLe(_data + 4, _seq, 4);
+    putLe(_data + 8, _baseUs, 8);
+    putLe(_data + 16, _used - HEADER_LEN, 2);
+    putLe(_data + 18, _records, 2);
+    putLe(_data + 20, CRC32::calculate(_data + HEADER_LEN, _used - HEADER_LEN), 4);
+    return _data;
+}
+
+bool CaptureReader::open(const uint8_t* block)
+{
+    _body = nullptr;
+    size_t used = (size_t)getLe(block + 16, 2);
+    if (getLe(block, 4) != CaptureBlock::MAGIC || used > CaptureBlock::SIZE - CaptureBlock::HEADER_LEN ||
+        CRC32::calculate(block + CaptureBlock::HEADER_LEN, used) != (uint32_t)getLe(block + 20, 4))
+        return false;
+    _body = block + CaptureBlock::HEADER_LEN;
+    _used = used;
+    _pos = 0;
+    _read = 0;
+    _seq = (uint32_t)getLe(block + 4, 4);
+    _us = getLe(block + 8, 8);
+    _records = (uint16_t)getLe(block + 18, 2);
+    return true;
+}
+
+bool CaptureReader::getVarint(uint32_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 35 && _pos < _used; shift += 7)
+    {
+        uint8_t byte = _body[_pos++];
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (byte < 0x80)
+            return true;
+    }
+    return false;
+}
+
+bool CaptureReader::next(CaptureRecord& record)
+{
+    uint32_t delta, len;
+    if (!_body || _read == _records || !getVarint(delta) || _pos >= _used)
+        return false;
+    record.source = _body[_pos++];
+    if (!getVarint(len) || len > _used - _pos)
+        return false;
+    _us += delta;
+    record.us = _us;
+    record.data = _body + _pos;
+    record.len = len;
+    _pos += len;
+    _read++;
+    return true;
+}
+
+void CaptureResume::add(const uint8_t* header)
+{
+    if (getLe(header, 4) != CaptureBlock::MAGIC)
+        return;
+    uint32_t seq = (uint32_t)getLe(header + 4, 4);
+    if (!_found || (int32_t)(seq - _newest) > 0)
+        _newest = seq;
+    _found = true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// One fixed-size block of the capture file. Records never straddle blocks,
+// so every block decodes on its own once the ring has wrapped.
+//
+// Header, little-endian: magic u32, seq u32, baseUs u64, used u16,
+// records u16, crc32 u32 (over the record bytes). Each record is
+// varint deltaUs (to the previous record, the first to baseUs),
+// source u8, varint len, then len payload bytes.
+class CaptureBlock {
+public:
+    static constexpr size_t SIZE = 2048;
+    static constexpr size_t HEADER_LEN = 24;
+    static constexpr size_t MAX_RECORD_HEADER = 5 + 1 + 3;
+    static constexpr uint32_t MAGIC = 0x31504143; // "CAP1"
+
+    // Starts an empty block whose deltas count from baseUs
+    void start(uint32_t seq, uint64_t baseUs);
+    // False if the record does not fit; the block is left unchanged
+    bool append(uint64_t us, uint8_t source, const uint8_t* data, size_t len);
+    // Fills in the header; the block is then ready to be written out
+    const uint8_t* finish();
+
+    bool empty() const { return _records == 0; }
+    uint32_t seq() const { return _seq; }
+    uint64_t baseUs() const { return _baseUs; }
+
+private:
+    uint8_t _data[SIZE] = {};
+    size_t _used = HEADER_LEN;
+    uint16_t _records = 0;
+    uint32_t _seq = 0;
+    uint64_t _baseUs = 0;
+    uint64_t _lastUs = 0;
+
+    size_t putVarint(size_t pos, uint32_t value);
+};
+
+struct CaptureRecord {
+    uint64_t us;
+    uint8_t source; // LatencyTrace port
+    const uint8_t* data;
+    size_t len;
+};
+
+// Walks the records of a finished block, e.g. one read back from the file
+class CaptureReader {
+public:
+    // False for an empty or damaged block: bad magic, length or CRC
+    bool open(const uint8_t* block);
+    // Next record, pointing into the block; false at the end or on a
+    // record that runs past the used bytes
+    bool next(CaptureRecord& record);
+
+    uint32_t seq() const { return _seq; }
+    uint16_t records() const { return _records; }
+
+private:
+    const uint8_t* _body = nullptr;
+    size_t _used = 0;
+    size_t _pos = 0;
+    uint16_t _records = 0;
+    uint16_t _read = 0;
+    uint32_t _seq = 0;
+    uint64_t _us = 0;
+
+    bool getVarint(uint32_t& value);
+};
+
+// Where a capture continues in a file it finds: one past the newest block.
+// Seqs compare with wrap-around; the blocks of one ring are never further
+// apart than the ring is long.
+class CaptureResume {
+public:
+    // The first HEADER_LEN bytes of a block; anything without the magic is skipped
+    void add(const uint8_t* header);
+    uint32_t nextSeq() const { return _found ? _newest + 1 : 0; }
+
+private:
+    bool _found = false;
+    uint32_t _newest = 0;
+};
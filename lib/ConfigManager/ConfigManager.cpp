@@ -1,16 +0,0 @@
-#include "ConfigManager.h"
-
-// Simple CRC32 implementation (polynomial 0xEDB88320)
-uint32_t CRC32::calculate(const uint8_t* data, size_t len) {
-    uint32_t crc = 0xFFFFFFFF;
-    for (size_t i = 0; i < len; ++i) {
-        crc ^= data[i];
-        for (int j = 0; j < 8; ++j) {
-            if (crc & 1)
-                crc = (crc >> 1) ^ 0xEDB88320;
-            else
-                crc = crc >> 1;
-        }
-    }
-    return ~crc;
-}
\ No newline at end of file
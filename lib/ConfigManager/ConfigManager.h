@@ -2,65 +2,169 @@
 #include <Arduino.h>
 #include <EEPROM.h>
 #include <stdint.h>
+#include "CRC32.h"
 
-class CRC32 {
-public:
-    static uint32_t calculate(const uint8_t* data, size_t len);
-};
-
+// Stores one config struct at eepromStart as a header carrying the struct
+// size, the struct, and a CRC32 over both. On ESP32 the EEPROM region is a
+// single NVS blob that every commit rewrites whole, so the region is only as
+// large as the struct and a commit delay batches menu edits into one commit.
+// New fields must only be appended: a copy stored with a different size is
+// loaded over the defaults up to the shorter of the two sizes.
 template<typename T>
 class ConfigManager {
 public:
+    // Copies the fields a legacy copy holds into config, which has the defaults
+    using Migrate = void (*)(const uint8_t* legacy, T& config);
+
     explicit ConfigManager(int eepromStart = 0)
         : _eepromStart(eepromStart), _structPtr(nullptr) {}
 
+    // Firmware before the header stored legacyLen bytes followed by their
+    // CRC32 at eepromStart. Such a copy is migrated field by field on begin().
+    void setLegacy(size_t legacyLen, Migrate migrate) {
+        _legacyLen = legacyLen;
+        _migrate = migrate;
+    }
+
     // Returns true if loaded from EEPROM (CRC OK), false if defaults used
     bool begin(T* structPtr) {
         _structPtr = structPtr;
-        uint8_t buf[totalLen];
-
-        EEPROM.begin(totalLen);
-        readFromEEPROM(buf);
+        size_t legacyTotal = _migrate ? _legacyLen + sizeof(uint32_t) : 0;
+        EEPROM.begin(_eepromStart + (totalLen > legacyTotal ? totalLen : legacyTotal));
 
-        uint32_t storedCrc;
-        memcpy(&storedCrc, buf + dataLen, sizeof(uint32_t));
-        uint32_t calcCrc = CRC32::calculate(buf, dataLen);
-        if (storedCrc == calcCrc) {
-            memcpy(structPtr, buf, dataLen);
+        uint8_t header[HEADER_LEN];
+        readBytes(_eepromStart, header, HEADER_LEN);
+        uint32_t magic;
+        uint16_t len;
+        memcpy(&magic, header, sizeof(magic));
+        memcpy(&len, header + 4, sizeof(len));
+        if (magic == MAGIC && len == dataLen) {
+            // Verify before copying so the defaults survive a miss
+            T stored;
+            readBytes(_eepromStart + HEADER_LEN, reinterpret_cast<uint8_t*>(&stored), dataLen);
+            uint32_t storedCrc;
+            readBytes(_eepromStart + HEADER_LEN + dataLen, reinterpret_cast<uint8_t*>(&storedCrc), sizeof(storedCrc));
+            if (storedCrc == crc(header, reinterpret_cast<const uint8_t*>(&stored))) {
+                memcpy(structPtr, &stored, dataLen);
+                return true;
+            }
+        } else if (magic == MAGIC) {
+            // Written by firmware with fewer (or more) fields
+            if (loadResized(header, len, *structPtr)) {
+                write(structPtr);
+                return true;
+            }
+        } else if (migrateLegacy(*structPtr)) {
+            write(structPtr);
             return true;
-        } else {
-            save(structPtr); // Save default if CRC mismatch
-            return false;
         }
+        write(structPtr); // Save default if nothing valid is stored
+        return false;
     }
 
+    // Persists the struct. With a commit delay set, saves of the managed struct
+    // are batched and committed by poll() once no save happened for that long.
     void save(const T* structPtr = nullptr) {
         if (!structPtr) structPtr = _structPtr;
         if (!structPtr) return;
 
-        uint8_t buf[totalLen];
-        memcpy(buf, structPtr, dataLen);
-        uint32_t crc = CRC32::calculate(buf, dataLen);
-        memcpy(buf + dataLen, &crc, sizeof(uint32_t));
+        if (_commitDelayMs == 0 || structPtr != _structPtr) {
+            write(structPtr);
+            _dirty = false;
+            return;
+        }
+        _dirty = true;
+        _dirtySince = millis();
+    }
+
+    void setCommitDelay(unsigned long ms) { _commitDelayMs = ms; }
+    bool pending() const { return _dirty; }
 
-        EEPROM.begin(totalLen);
-        writeToEEPROM(buf);
+    // Commits a deferred save once the idle delay has passed
+    void poll() {
+        if (_dirty && millis() - _dirtySince >= _commitDelayMs) flush();
+    }
+
+    // Commits a deferred save immediately
+    void flush() {
+        if (!_dirty || !_structPtr) return;
+        write(_structPtr);
+        _dirty = false;
     }
 
 private:
+    static constexpr uint32_t MAGIC = 0x32474643; // "CFG2"
+    static constexpr size_t HEADER_LEN = 8;       // Magic, struct size, reserved
+    static constexpr size_t MAX_LEGACY_LEN = 256;
+    static constexpr size_t dataLen = sizeof(T);
+    static constexpr size_t totalLen = HEADER_LEN + dataLen + sizeof(uint32_t);
+    static_assert(dataLen <= 0xFFFF, "Config struct too large");
+
     int _eepromStart;
     T* _structPtr;
-    static constexpr size_t dataLen = sizeof(T);
-    static constexpr size_t totalLen = dataLen + sizeof(uint32_t);
+    size_t _legacyLen = 0;
+    Migrate _migrate = nullptr;
+    bool _dirty = false;
+    unsigned long _dirtySince = 0;
+    unsigned long _commitDelayMs = 0;
 
-    void readFromEEPROM(uint8_t* buf) const {
-        for (size_t i = 0; i < totalLen; ++i)
-            buf[i] = EEPROM.read(_eepromStart + i);
+    static uint32_t crc(const uint8_t* header, const uint8_t* data) {
+        return ~CRC32::update(CRC32::update(0xFFFFFFFF, header, HEADER_LEN), data, dataLen);
     }
 
-    void writeToEEPROM(const uint8_t* buf) const {
-        for (size_t i = 0; i < totalLen; ++i)
-            EEPROM.write(_eepromStart + i, buf[i]);
+    // EEPROM only marks bytes that differ, and commit() skips a clean region,
+    // so saving unchanged settings costs no flash write
+    void write(const T* structPtr) {
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(structPtr);
+        uint8_t header[HEADER_LEN] = {};
+        uint32_t magic = MAGIC;
+        uint16_t len = dataLen;
+        memcpy(header, &magic, sizeof(magic));
+        memcpy(header + 4, &len, sizeof(len));
+        uint32_t sum = crc(header, data);
+        writeBytes(_eepromStart, header, HEADER_LEN);
+        writeBytes(_eepromStart + HEADER_LEN, data, dataLen);
+        writeBytes(_eepromStart + HEADER_LEN + dataLen, reinterpret_cast<const uint8_t*>(&sum), sizeof(sum));
         EEPROM.commit();
     }
-};
\ No newline at end of file
+
+    // A copy of another size: checked over its own length, then the fields
+    // both layouts share are copied over the defaults
+    bool loadResized(const uint8_t* header, size_t len, T& config) const {
+        if (_eepromStart + HEADER_LEN + len + sizeof(uint32_t) > EEPROM.length())
+            return false; // A larger copy was cut short when the region shrank
+        uint32_t sum = CRC32::update(0xFFFFFFFF, header, HEADER_LEN);
+        uint8_t chunk[32];
+        for (size_t done = 0; done < len; done += sizeof(chunk)) {
+            size_t n = len - done < sizeof(chunk) ? len - done : sizeof(chunk);
+            readBytes(_eepromStart + HEADER_LEN + done, chunk, n);
+            sum = CRC32::update(sum, chunk, n);
+        }
+        uint32_t storedCrc;
+        readBytes(_eepromStart + HEADER_LEN + len, reinterpret_cast<uint8_t*>(&storedCrc), sizeof(storedCrc));
+        if (storedCrc != ~sum) return false;
+        readBytes(_eepromStart + HEADER_LEN, reinterpret_cast<uint8_t*>(&config), len < dataLen ? len : dataLen);
+        return true;
+    }
+
+    bool migrateLegacy(T& config) const {
+        if (!_migrate || _legacyLen > MAX_LEGACY_LEN) return false;
+        uint8_t legacy[MAX_LEGACY_LEN];
+        uint32_t storedCrc;
+        readBytes(_eepromStart, legacy, _legacyLen);
+        readBytes(_eepromStart + _legacyLen, reinterpret_cast<uint8_t*>(&storedCrc), sizeof(storedCrc));
+        if (storedCrc != CRC32::calculate(legacy, _legacyLen)) return false;
+        _migrate(legacy, config);
+        return true;
+    }
+
+    void readBytes(int addr, uint8_t* buf, size_t len) const {
+        for (size_t i = 0; i < len; ++i)
+            buf[i] = EEPROM.read(addr + i);
+    }
+
+    void writeBytes(int addr, const uint8_t* buf, size_t len) const {
+        for (size_t i = 0; i < len; ++i)
+            EEPROM.write(addr + i, buf[i]);
+    }
+};
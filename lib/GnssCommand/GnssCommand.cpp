@@ -0,0 +1,270 @@
+#include "GnssCommand.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Field n of a sentence, counting the name as field 0; stops at the checksum
+static const char* field(const uint8_t* sentence, size_t len, int n, size_t& fieldLen)
+{
+    const char* p = (const char*)sentence + 1;
+    const char* end = (const char*)sentence + len;
+    const char* star = (const char*)memchr(p, '*', end - p);
+    if (star)
+        end = star;
+    for (; n > 0; --n)
+    {
+        const char* comma = (const char*)memchr(p, ',', end - p);
+        if (!comma)
+        {
+            fieldLen = 0;
+            return nullptr;
+        }
+        p = comma + 1;
+    }
+    const char* comma = (const char*)memchr(p, ',', end - p);
+    fieldLen = (comma ? comma : end) - p;
+    return p;
+}
+
+static bool fieldEquals(const char* f, size_t len, const char* s)
+{
+    return f && strlen(s) == len && memcmp(f, s, len) == 0;
+}
+
+static long fieldToInt(const char* f, size_t len)
+{
+    char buf[12];
+    if (!f || len == 0 || len >= sizeof(buf))
+        return -1;
+    memcpy(buf, f, len);
+    buf[len] = '\0';
+    char* end;
+    long value = strtol(buf, &end, 10);
+    return *end == '\0' ? value : -1;
+}
+
+// Command number of a $PAIR<nnn> name, -1 for anything else
+static long pairId(const char* name)
+{
+    if (strncmp(name, "PAIR", 4) != 0 || name[4] == '\0')
+        return -1;
+    return fieldToInt(name + 4, strlen(name + 4));
+}
+
+bool GnssCommandQueue::push(const char* text, size_t len, uint32_t nowMs)
+{
+    while (len > 0 && (*text == ' ' || *text == '$'))
+    {
+        text++;
+        len--;
+    }
+    while (len > 0 && (text[len - 1] == ' ' || text[len - 1] == '\r' || text[len - 1] == '\n'))
+        len--;
+    const char* star = (const char*)memchr(text, '*', len);
+    if (star)
+        len = star - text;
+
+    size_t nameLen = 0;
+    while (nameLen < len && text[nameLen] != ',')
+        nameLen++;
+    if (nameLen == 0 || nameLen >= MAX_NAME || len + 6 > MAX_SENTENCE)
+        return false;
+    for (size_t i = 0; i < len; ++i)
+        if (text[i] < 0x20 || text[i] > 0x7E || text[i] == '$' || text[i] == '*' ||
+            (i < nameLen && !isalnum((unsigned char)text[i])))
+            return false;
+
+    if (size() == MAX_COMMANDS)
+    {
+        if (_first == _next)
+            return false;
+        _first++; // Forget the oldest finished command
+    }
+
+    Command& command = _commands[_end % MAX_COMMANDS];
+    static const char hex[] = "0123456789ABCDEF";
+    uint8_t sum = NmeaFramer::checksum(text, len);
+    command.sentence[0] = '$';
+    memcpy(command.sentence + 1, text, len);
+    char* tail = command.sentence + 1 + len;
+    tail[0] = '*';
+    tail[1] = hex[sum >> 4];
+    tail[2] = hex[sum & 0x0F];
+    tail[3] = '\r';
+    tail[4] = '\n';
+    tail[5] = '\0';
+    command.len = len + 6;
+    memcpy(command.name, text, nameLen);
+    command.name[nameLen] = '\0';
+    command.reply[0] = '\0';
+    command.status = Status::Queued;
+    command.tries = 0;
+    command.code = -1;
+    command.queuedAt = nowMs;
+    command.sentAt = 0;
+    command.doneAt = 0;
+    if (_next == _end)
+        _resendAt = nowMs;
+    _end++;
+    return true;
+}
+
+void GnssCommandQueue::clear()
+{
+    if (busy() && current().tries > 0)
+        _end = _next + 1;
+    else
+        _end = _next;
+}
+
+const GnssCommandQueue::Command* GnssCommandQueue::ready(uint32_t nowMs)
+{
+    while (busy())
+    {
+        Command& command = current();
+        if (command.status == Status::Sent)
+        {
+            if (nowMs - command.sentAt < _timeoutMs)
+                return nullptr;
+            if (command.tries <= _retries)
+            {
+                retry(nowMs, 0);
+                continue;
+            }
+            finish(Status::Timeout, -1, nowMs);
+            continue;
+        }
+        return (int32_t)(nowMs - _resendAt) >= 0 ? &command : nullptr;
+    }
+    return nullptr;
+}
+
+void GnssCommandQueue::sentSentence(uint32_t nowMs)
+{
+    Command& command = current();
+    command.status = Status::Sent;
+    command.sentAt = nowMs;
+    if (command.tries++ > 0)
+        _retried++;
+    _sent++;
+}
+
+bool GnssCommandQueue::onSentence(const uint8_t* sentence, size_t len, uint32_t nowMs)
+{
+    size_t nameLen;
+    const char* name = field(sentence, len, 0, nameLen);
+    if (!name || nameLen == 0 || nameLen >= MAX_NAME)
+        return false;
+    bool waiting = busy() && current().status == Status::Sent;
+
+    if (fieldEquals(name, nameLen, "PAIR001"))
+    {
+        if (!waiting)
+            return false;
+        size_t idLen, resultLen;
+        const char* id = field(sentence, len, 1, idLen);
+        const char* result = field(sentence, len, 2, resultLen);
+        long pair = pairId(current().name);
+        if (pair < 0 || fieldToInt(id, idLen) != pair)
+            return false;
+        long code = fieldToInt(result, resultLen);
+        if (code == 0)
+        {
+            _lastAcked = _next;
+            finish(Status::Ok, 0, nowMs);
+        }
+        else if (code == 1)
+            current().sentAt = nowMs; // Still processing, restart the timeout
+        else if (code == 5 && current().tries <= _retries)
+            retry(nowMs, BUSY_BACKOFF_MS);
+        else
+            finish(Status::Failed, code, nowMs);
+        return true;
+    }
+
+    if (waiting && fieldEquals(name, nameLen, current().name))
+    {
+        Command& command = current();
+        setReply(command, sentence, len);
+        if (pairId(command.name) >= 0)
+            return true; // The acknowledgement finishes it
+        size_t statusLen, codeLen;
+        const char* status = field(sentence, len, 1, statusLen);
+        const char* code = field(sentence, len, 2, codeLen);
+        if (fieldEquals(status, statusLen, "ERROR"))
+            finish(Status::Failed, fieldToInt(code, codeLen), nowMs);
+        else
+            finish(Status::Ok, -1, nowMs);
+        return true;
+    }
+
+    if (_lastAcked >= 0 && (uint32_t)_lastAcked >= _first)
+    {
+        Command& command = _commands[_lastAcked % MAX_COMMANDS];
+        if (command.reply[0] == '\0' && fieldEquals(name, nameLen, command.name))
+        {
+            _lastAcked = -1;
+            setReply(command, sentence, len);
+            notify(command);
+            return true;
+        }
+    }
+    return false;
+}
+
+void GnssCommandQueue::finish(Status status, int16_t code, uint32_t nowMs)
+{
+    Command& command = current();
+    command.status = status;
+    command.code = code;
+    command.doneAt = nowMs;
+    if (status != Status::Ok)
+        _failed++;
+    _next++;
+    _resendAt = nowMs;
+    notify(command);
+}
+
+void GnssCommandQueue::retry(uint32_t nowMs, uint32_t delayMs)
+{
+    current().status = Status::Queued;
+    _resendAt = nowMs + delayMs;
+}
+
+// Kept without the checksum
+void GnssCommandQueue::setReply(Command& command, const uint8_t* sentence, size_t len)
+{
+    size_t n = 0;
+    while (n < len && n < MAX_REPLY - 1 && sentence[n] != '*' && sentence[n] != '\r')
+    {
+        command.reply[n] = sentence[n];
+        n++;
+    }
+    command.reply[n] = '\0';
+}
+
+void GnssCommandQueue::notify(const Command& command)
+{
+    if (_handler)
+        _handler(_ctx, command);
+}
+
+void GnssCommandQueue::resetStats()
+{
+    _sent = 0;
+    _retried = 0;
+    _failed = 0;
+}
+
+const char* GnssCommandQueue::statusName(Status status)
+{
+    switch (status)
+    {
+    case Status::Queued: return "queued";
+    case Status::Sent: return "sent";
+    case Status::Ok: return "ok";
+    case Status::Failed: return "failed";
+    case Status::Timeout: return "timeout";
+    default: return "?";
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "NmeaFramer.h"
+
+// Queue of receiver configuration commands, sent one at a time and matched
+// against the replies in the Serial1 sentence stream. Commands are stored
+// as complete sentences with their checksum; the owner writes ready() to
+// Serial1 whenever it may, reports sentSentence(), and feeds every
+// downlink sentence to onSentence(). Replies are recognised as
+//   $PAIR001,<id>,<result>     for $PAIR<id> commands (0 ok, 1 processing, 5 busy)
+//   $<NAME>,OK... / ERROR,<n>  for $PQTM... and other named commands
+// A PAIR query also answers with its own $PAIR<id> sentence after the
+// acknowledgement; that is attached to the finished command as its reply.
+// Unanswered or busy commands are resent up to the retry limit.
+// Not thread safe: one task does all of the above.
+class GnssCommandQueue {
+public:
+    static constexpr size_t MAX_COMMANDS = 32;
+    static constexpr size_t MAX_SENTENCE = NmeaFramer::MAX_SENTENCE;
+    static constexpr size_t MAX_NAME = 16;
+    static constexpr size_t MAX_REPLY = 96;
+
+    enum class Status : uint8_t
+    {
+        Queued,
+        Sent,
+        Ok,
+        Failed,
+        Timeout
+    };
+
+    struct Command {
+        char sentence[MAX_SENTENCE];
+        uint8_t len;
+        char name[MAX_NAME]; // Sentence name without '$', e.g. PAIR050
+        char reply[MAX_REPLY];
+        Status status;
+        uint8_t tries;
+        int16_t code; // PAIR result or PQTM error code, -1 if none
+        uint32_t queuedAt;
+        uint32_t sentAt;
+        uint32_t doneAt;
+    };
+
+    // Called when a command finishes and again if a reply arrives later
+    using Handler = void (*)(void* ctx, const Command& command);
+    void setHandler(Handler handler, void* ctx)
+    {
+        _handler = handler;
+        _ctx = ctx;
+    }
+
+    void setTimeout(uint32_t ms) { _timeoutMs = ms; }
+    uint32_t timeout() const { return _timeoutMs; }
+    void setRetries(uint8_t retries) { _retries = retries; }
+    uint8_t retries() const { return _retries; }
+
+    // Queues "PAIR050,1000" or "$PAIR050,1000*hh"; the checksum is always
+    // recomputed. False if the text is not a sentence body or the queue is full.
+    bool push(const char* text, size_t len, uint32_t nowMs);
+    // Drops everything not yet sent; a command already sent still finishes
+    void clear();
+
+    // Command to write now, nullptr if one is awaiting its reply or none is due
+    const Command* ready(uint32_t nowMs);
+    void sentSentence(uint32_t nowMs);
+    // Every sentence from the receiver; true if it answered a command
+    bool onSentence(const uint8_t* sentence, size_t len, uint32_t nowMs);
+
+    // True while commands are queued or awaiting replies
+    bool busy() const { return _next != _end; }
+    size_t pending() const { return _end - _next; }
+
+    // Finished and pending commands, oldest first
+    size_t size() const { return _end - _first; }
+    const Command& at(size_t i) const { return _commands[(_first + i) % MAX_COMMANDS]; }
+
+    uint32_t sent() const { return _sent; }
+    uint32_t retried() const { return _retried; }
+    uint32_t failed() const { return _failed; }
+    void resetStats();
+
+    static const char* statusName(Status status);
+
+private:
+    static constexpr uint32_t BUSY_BACKOFF_MS = 100;
+
+    Command _commands[MAX_COMMANDS];
+    // Monotonic indexes: [_first, _next) finished, [_next, _end) pending
+    uint32_t _first = 0;
+    uint32_t _next = 0;
+    uint32_t _end = 0;
+    uint32_t _resendAt = 0;
+    // Last PAIR command acknowledged, for the reply that follows the ack
+    int32_t _lastAcked = -1;
+
+    uint32_t _timeoutMs = 1000;
+    uint8_t _retries = 2;
+    Handler _handler = nullptr;
+    void* _ctx = nullptr;
+
+    uint32_t _sent = 0;
+    uint32_t _retried = 0;
+    uint32_t _failed = 0;
+
+    Command& current() { return _commands[_next % MAX_COMMANDS]; }
+    void finish(Status status, int16_t code, uint32_t nowMs);
+    void retry(uint32_t nowMs, uint32_t delayMs);
+    void setReply(Command& command, const uint8_t* sentence, size_t len);
+    void notify(const Command& command);
+};
@@ -0,0 +1,176 @@
+#include "LatencyTrace.h"
+#include <esp_timer.h>
+
+LatencyTrace& latencyTrace = LatencyTrace::getInstance();
+
+static_assert((LatencyTrace::RING_SIZE & (LatencyTrace::RING_SIZE - 1)) == 0, "RING_SIZE must be a power of two");
+static_assert(LatencyTrace::Histogram::BUCKETS >= 8 + 4 * 22, "Histogram must reach 2^24 us");
+
+// Offsets are running totals, so compare them by distance to survive wrap-around
+static bool reached(size_t offset, size_t limit)
+{
+    return (ptrdiff_t)(offset - limit) <= 0;
+}
+
+uint32_t LatencyTrace::now()
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+size_t LatencyTrace::Histogram::bucketOf(uint32_t us)
+{
+    if (us < 8) return us;
+    int e = 31 - __builtin_clz(us);
+    size_t bucket = (e - 1) * 4 + ((us >> (e - 2)) & 3);
+    return bucket < BUCKETS ? bucket : BUCKETS - 1;
+}
+
+uint32_t LatencyTrace::Histogram::upperBound(size_t bucket)
+{
+    if (bucket < 8) return bucket;
+    int e = bucket / 4 + 1;
+    return ((4 + bucket % 4) << (e - 2)) + (1u << (e - 2)) - 1;
+}
+
+void LatencyTrace::Histogram::add(uint32_t us)
+{
+    buckets[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    uint32_t seen = max.load(std::memory_order_relaxed);
+    while (us > seen && !max.compare_exchange_weak(seen, us, std::memory_order_relaxed)) {}
+}
+
+uint32_t LatencyTrace::Histogram::percentile(unsigned pct) const
+{
+    uint32_t total = count.load(std::memory_order_relaxed);
+    if (total == 0) return 0;
+    uint32_t target = ((uint64_t)total * pct + 99) / 100;
+    uint32_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i)
+    {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= target)
+        {
+            uint32_t bound = upperBound(i);
+            uint32_t top = max.load(std::memory_order_relaxed);
+            return bound < top ? bound : top;
+        }
+    }
+    return max.load(std::memory_order_relaxed);
+}
+
+void LatencyTrace::Histogram::reset()
+{
+    for (std::atomic<uint32_t>& bucket : buckets)
+        bucket.store(0, std::memory_order_relaxed);
+    count.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+}
+
+bool LatencyTrace::StampQueue::push(const Stamp& stamp)
+{
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= STAMP_DEPTH) return false;
+    items[h % STAMP_DEPTH] = stamp;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+const LatencyTrace::Stamp* LatencyTrace::StampQueue::front() const
+{
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) return nullptr;
+    return &items[t % STAMP_DEPTH];
+}
+
+void LatencyTrace::received(Port port, size_t end, size_t len)
+{
+    if (!enabled() || len == 0) return;
+    uint32_t us = now();
+    record(us, Receive, port, len);
+    // A full queue only loses this sample; the next stamp covers the bytes
+    _inStamps[port].push({end, us, port});
+}
+
+void LatencyTrace::beginRoute(Port port, size_t start)
+{
+    // Stamps whose bytes were all routed earlier are done
+    StampQueue& stamps = _inStamps[port];
+    const Stamp* stamp;
+    while ((stamp = stamps.front()) && reached(stamp->end, start))
+        stamps.pop();
+    // The oldest byte of the chunk sets the origin of everything it produces
+    _routeValid = stamp && enabled();
+    if (_routeValid)
+    {
+        _routeSource = port;
+        _routeUs = stamp->us;
+    }
+}
+
+void LatencyTrace::enqueued(Port output, size_t end, size_t len)
+{
+    if (!enabled()) return;
+    record(now(), Enqueue, output, len);
+    if (_routeValid)
+        _outStamps[output].push({end, _routeUs, _routeSource});
+}
+
+void LatencyTrace::written(Port output, size_t end, size_t len)
+{
+    bool active = enabled();
+    uint32_t us = active ? now() : 0;
+    if (active) record(us, Output, output, len);
+    // Drained even while disabled so no stale stamp survives a restart
+    StampQueue& stamps = _outStamps[output];
+    const Stamp* stamp;
+    while ((stamp = stamps.front()) && reached(stamp->end, end))
+    {
+        if (active) _paths[stamp->source][output].add(us - stamp->us);
+        stamps.pop();
+    }
+}
+
+size_t LatencyTrace::snapshot(Record* out, size_t max) const
+{
+    uint32_t next = _next.load(std::memory_order_acquire);
+    size_t count = next < RING_SIZE ? next : RING_SIZE;
+    if (count > max) count = max;
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t slot = (next - count + i) & (RING_SIZE - 1);
+        uint32_t meta = _ringMeta[slot].load(std::memory_order_relaxed);
+        out[i].us = _ringUs[slot].load(std::memory_order_relaxed);
+        out[i].point = meta & 0xFF;
+        out[i].port = (meta >> 8) & 0xFF;
+        out[i].len = meta >> 16;
+    }
+    return count;
+}
+
+void LatencyTrace::reset()
+{
+    _next.store(0, std::memory_order_release);
+    for (auto& row : _paths)
+        for (Histogram& histogram : row)
+            histogram.reset();
+}
+
+const char* LatencyTrace::name(Port port)
+{
+    switch (port)
+    {
+    case SerialPort: return "Serial";
+    case Serial1Port: return "Serial1";
+    case SerialBTPort: return "SerialBT";
+    case BLEPort: return "BLE";
+    default: return "?";
+    }
+}
+
+void LatencyTrace::record(uint32_t us, Point point, Port port, size_t len)
+{
+    size_t slot = _next.fetch_add(1, std::memory_order_relaxed) & (RING_SIZE - 1);
+    _ringUs[slot].store(us, std::memory_order_relaxed);
+    _ringMeta[slot].store(point | (port << 8) | ((len > 0xFFFF ? 0xFFFF : len) << 16), std::memory_order_release);
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// End-to-end latency tracing for the bridge. Bytes are stamped when the
+// receive callback puts them into a receive ring, followed through the router
+// into an output queue, and measured again once the output task has handed
+// them to the target stream. Every tracepoint is appended to a fixed-size
+// trace ring and completed transfers feed a latency histogram per path.
+//
+// Timestamps come from esp_timer (microseconds): the CPU cycle counters of
+// the two cores are not synchronized, and a transfer usually crosses cores.
+class LatencyTrace {
+public:
+    enum Port : uint8_t
+    {
+        SerialPort,
+        Serial1Port,
+        SerialBTPort,
+        BLEPort,
+        PORT_COUNT
+    };
+
+    enum Point : uint8_t
+    {
+        Receive,
+        Enqueue,
+        Output
+    };
+
+    // Trace ring entry, dumped as 8 little-endian bytes: us, point, port, len
+    struct Record {
+        uint32_t us;
+        uint8_t point;
+        uint8_t port;
+        uint16_t len;
+    };
+
+    // Log-linear buckets: exact below 8 us, then four buckets per octave
+    struct Histogram {
+        static constexpr size_t BUCKETS = 96;
+
+        std::atomic<uint32_t> buckets[BUCKETS] = {};
+        std::atomic<uint32_t> count{0};
+        std::atomic<uint32_t> max{0};
+
+        void add(uint32_t us);
+        uint32_t percentile(unsigned pct) const; // Upper bound of the bucket holding it
+        void reset();
+
+        static size_t bucketOf(uint32_t us);
+        static uint32_t upperBound(size_t bucket);
+    };
+
+    static constexpr size_t RING_SIZE = 256; // Power of two
+    static constexpr size_t STAMP_DEPTH = 32;
+
+    static uint32_t now();
+
+    void setEnabled(bool enabled) { _enabled.store(enabled, std::memory_order_relaxed); }
+    bool enabled() const { return _enabled.load(std::memory_order_relaxed); }
+
+    // Receive context: len bytes ending at ring offset end have just arrived
+    void received(Port port, size_t end, size_t len);
+    // Router: the chunk starting at ring offset start is routed until endRoute()
+    void beginRoute(Port port, size_t start);
+    void endRoute() { _routeValid = false; }
+    // Router: len bytes ending at queue offset end were queued for output
+    void enqueued(Port output, size_t end, size_t len);
+    // Output task: everything up to queue offset end has been written out
+    void written(Port output, size_t end, size_t len);
+
+    const Histogram& histogram(Port source, Port output) const { return _paths[source][output]; }
+    // Copies the trace ring, oldest record first
+    size_t snapshot(Record* out, size_t max) const;
+    void reset();
+
+    static const char* name(Port port);
+
+    static LatencyTrace& getInstance() {
+        static LatencyTrace instance;
+        return instance;
+    }
+
+private:
+    struct Stamp {
+        size_t end;
+        uint32_t us;
+        uint8_t source;
+    };
+
+    // Single-producer/single-consumer queue of byte offset stamps
+    struct StampQueue {
+        Stamp items[STAMP_DEPTH] = {};
+        std::atomic<uint32_t> head{0};
+        std::atomic<uint32_t> tail{0};
+
+        bool push(const Stamp& stamp);
+        const Stamp* front() const;
+        void pop() { tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+    };
+
+    LatencyTrace() = default;
+    LatencyTrace(const LatencyTrace&) = delete;
+
+    std::atomic<bool> _enabled{false};
+
+    // Records are two words so concurrent tracepoints never need a lock;
+    // a reader racing a writer may see one torn record
+    std::atomic<uint32_t> _next{0};
+    std::atomic<uint32_t> _ringUs[RING_SIZE] = {};
+    std::atomic<uint32_t> _ringMeta[RING_SIZE] = {};
+
+    StampQueue _inStamps[PORT_COUNT];
+    StampQueue _outStamps[PORT_COUNT];
+    Histogram _paths[PORT_COUNT][PORT_COUNT];
+
+    // Owned by the router task
+    bool _routeValid = false;
+    uint8_t _routeSource = 0;
+    uint32_t _routeUs = 0;
+
+    void record(uint32_t us, Point point, Port port, size_t len);
+};
+
+extern LatencyTrace& latencyTrace;
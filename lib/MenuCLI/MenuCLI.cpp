@@ -3,9 +3,6 @@
 #include <freertos/task.h>
 #include <Arduino.h>
 
-#define MENUCLI_OUTPUT_BUFFER_SIZE 256
-#define MENUCLI_DEFAULT_BUFFER_TIMEOUT_MS 30 // <-- Add this line
-
 MenuCLI::MenuCLI() : _multiOutput() {}
 
 void MenuCLI::attachOutput(Stream* out) {
@@ -16,6 +13,7 @@ void MenuCLI::begin()
 {
     _lineLen = 0;
     _lineBuffer[0] = '\0';
+    _lineOverflow = false;
 
     printHelp();
     printPrompt();
@@ -26,6 +24,45 @@ void MenuCLI::registerCommand(const String &cmd, const String &help, CommandHand
     _commands[cmd] = {help, handler};
 }
 
+void MenuCLI::setCommandTable(const Command *table, size_t count)
+{
+    _table = table;
+    _tableSize = count;
+}
+
+// Longest command name that matches the line up to a word boundary,
+// found by binary search over the sorted table for each boundary
+const MenuCLI::Command *MenuCLI::findCommand(const char *cmdline, size_t len) const
+{
+    for (size_t prefix = len; prefix > 0; --prefix) {
+        if (prefix < len && !isspace(cmdline[prefix]))
+            continue;
+        size_t lo = 0, hi = _tableSize;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            int c = compare(cmdline, _table[mid].name, prefix);
+            if (c == 0)
+                return &_table[mid];
+            if (c < 0)
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+    }
+    return nullptr;
+}
+
+bool MenuCLI::dispatchTable(const char *cmdline, size_t len)
+{
+    const Command *cmd = findCommand(cmdline, len);
+    if (!cmd)
+        return false;
+    size_t start = strlen(cmd->name);
+    while (start < len && isspace(cmdline[start])) start++;
+    cmd->handler(Args{cmdline + start, len - start}, outputStream());
+    return true;
+}
+
 void MenuCLI::handleInputChar(char c)
 {
     if (c == '\r')
@@ -33,9 +70,17 @@ void MenuCLI::handleInputChar(char c)
     if (c == '\n')
     {
         bufferOutput("\n");
-        processLine();
+        if (_lineOverflow) {
+            char msg[64];
+            snprintf(msg, sizeof(msg), "ERROR: Line longer than %u characters, ignored.\n", (unsigned)(LINE_BUFFER_SIZE - 1));
+            bufferOutput(msg);
+            printPrompt();
+        } else {
+            processLine();
+        }
         _lineLen = 0;
         _lineBuffer[0] = '\0';
+        _lineOverflow = false;
         return;
     }
     if (c == 8 || c == 127)
@@ -57,6 +102,10 @@ void MenuCLI::handleInputChar(char c)
             if (_echoEnabled)
                 bufferOutputChar(c);
         }
+        else
+        {
+            _lineOverflow = true;
+        }
     }
 }
 
@@ -77,6 +126,11 @@ void MenuCLI::processLine()
 
     const char* cmdline = _lineBuffer + start;
 
+    if (dispatchTable(cmdline, end - start)) {
+        printPrompt();
+        return;
+    }
+
     String matchedCmd;
     String matchedArgs;
     auto matchedIt = _commands.end();
@@ -104,6 +158,7 @@ void MenuCLI::processLine()
         }
         if (strncmp(cmdline, "exit", 4) == 0 && (cmdline[4] == '\0' || isspace(cmdline[4]))) {
             bufferOutput("\nExiting menu, returning to idle mode.\n");
+            _multiOutput.flush();
             if (_onExit) _onExit();
             // Do NOT print prompt after exit
             return;
@@ -125,6 +180,14 @@ void MenuCLI::printPrompt()
 void MenuCLI::printHelp()
 {
     bufferOutput("Available commands:\n");
+    for (size_t i = 0; i < _tableSize; ++i)
+    {
+        bufferOutput("  ");
+        bufferOutput(_table[i].name);
+        bufferOutput(": ");
+        bufferOutput(_table[i].help);
+        bufferOutput("\n");
+    }
     for (const auto &kv : _commands)
     {
         bufferOutput("  " + kv.first + ": " + kv.second.help + "\n");
@@ -151,19 +214,19 @@ int MenuCLI::peek()
 
 void MenuCLI::flush()
 {
-    // No-op
+    _multiOutput.flush();
 }
 
 void MenuCLI::bufferOutput(const String &s) {
-    for (auto out : _multiOutput.outputs()) {
-        out->print(s);
-    }
+    _multiOutput.write((const uint8_t *)s.c_str(), s.length());
+}
+
+void MenuCLI::bufferOutput(const char *s) {
+    _multiOutput.write((const uint8_t *)s, strlen(s));
 }
 
 void MenuCLI::bufferOutputChar(char c) {
-    for (auto out : _multiOutput.outputs()) {
-        out->write(c);
-    }
+    _multiOutput.write((uint8_t)c);
 }
 
 size_t MenuCLI::write(uint8_t c) {
@@ -180,18 +243,90 @@ size_t MenuCLI::write(const uint8_t *buffer, size_t size) {
     return n;
 }
 
+// Args implementation
+long MenuCLI::Args::toInt() const {
+    char buf[16];
+    copyTo(buf, sizeof(buf));
+    return atol(buf);
+}
+
+MenuCLI::Args MenuCLI::Args::nextWord() {
+    size_t i = 0;
+    while (i < len && !isspace(data[i])) i++;
+    Args word{data, i};
+    while (i < len && isspace(data[i])) i++;
+    data += i;
+    len -= i;
+    return word;
+}
+
+size_t MenuCLI::Args::copyTo(char *buf, size_t size) const {
+    if (size == 0) return 0;
+    size_t n = len < size - 1 ? len : size - 1;
+    memcpy(buf, data, n);
+    buf[n] = '\0';
+    return n;
+}
+
 // MultiOutputStream implementation
 size_t MenuCLI::MultiOutputStream::write(uint8_t c) {
-    size_t total = 0;
-    for (auto out : _outputs) {
-        total += out->write(c);
-    }
-    return total;
+    return write(&c, 1);
 }
+
 size_t MenuCLI::MultiOutputStream::write(const uint8_t *buffer, size_t size) {
-    size_t total = 0;
-    for (auto out : _outputs) {
-        total += out->write(buffer, size);
+    for (auto &sink : _sinks) {
+        append(sink, buffer, size);
+    }
+    return size;
+}
+
+void MenuCLI::MultiOutputStream::flush() {
+    for (auto &sink : _sinks) {
+        flushSink(sink);
+    }
+}
+
+bool MenuCLI::MultiOutputStream::pending() const {
+    for (const auto &sink : _sinks) {
+        if (sink.len > 0) return true;
+    }
+    return false;
+}
+
+void MenuCLI::MultiOutputStream::poll() {
+    unsigned long now = millis();
+    for (auto &sink : _sinks) {
+        if (sink.len > 0 && now - sink.since >= _timeoutMs)
+            flushSink(sink);
     }
-    return total;
-}
\ No newline at end of file
+}
+
+void MenuCLI::MultiOutputStream::append(Sink &sink, const uint8_t *buffer, size_t size) {
+    bool newline = false;
+    for (size_t i = 0; i < size; ++i) {
+        if (sink.len == sizeof(sink.buffer)) {
+            flushSink(sink);
+            if (sink.len == sizeof(sink.buffer)) {
+                // Sink is congested; drop rather than block the caller
+                _dropped += size - i;
+                return;
+            }
+        }
+        if (sink.len == 0) sink.since = millis();
+        sink.buffer[sink.len++] = buffer[i];
+        newline |= buffer[i] == '\n';
+    }
+    if (newline) flushSink(sink);
+}
+
+void MenuCLI::MultiOutputStream::flushSink(Sink &sink) {
+    if (sink.len == 0) return;
+    int room = sink.out->availableForWrite();
+    if (room <= 0) return;
+    size_t n = (size_t)room < sink.len ? (size_t)room : sink.len;
+    n = sink.out->write(sink.buffer, n);
+    if (n == 0) return;
+    sink.len -= n;
+    memmove(sink.buffer, sink.buffer + n, sink.len);
+    sink.since = millis();
+}
@@ -5,14 +5,57 @@
 #include <vector>
 #include <Stream.h>
 
-class MenuCLI : public Stream {
+#ifndef MENUCLI_OUTPUT_BUFFER_SIZE
+#define MENUCLI_OUTPUT_BUFFER_SIZE 256
+#endif
+// Longest input line plus terminator; fits a ';' batch of receiver commands
+#ifndef MENUCLI_LINE_BUFFER_SIZE
+#define MENUCLI_LINE_BUFFER_SIZE 512
+#endif
+#ifndef MENUCLI_DEFAULT_BUFFER_TIMEOUT_MS
+#define MENUCLI_DEFAULT_BUFFER_TIMEOUT_MS 30
+#endif
+
+class MenuCLI final : public Stream {
 public:
     using CommandHandler = std::function<void(const String& args, Stream& output)>;
 
+    // Argument slice pointing into the line buffer; valid during the handler call
+    struct Args {
+        const char* data;
+        size_t len;
+
+        bool empty() const { return len == 0; }
+        bool equals(const char* s) const { return strlen(s) == len && strncmp(data, s, len) == 0; }
+        long toInt() const;
+        Args nextWord();
+        size_t copyTo(char* buf, size_t size) const;
+    };
+
+    // Static command table entry. Tables are kept in flash and must be sorted by name.
+    using TableHandler = void (*)(Args args, Stream& output);
+    struct Command {
+        const char* name;
+        const char* help;
+        TableHandler handler;
+    };
+
+    // A longer line is rejected as a whole when it ends, never run truncated
+    static constexpr size_t LINE_BUFFER_SIZE = MENUCLI_LINE_BUFFER_SIZE;
+
     MenuCLI();
 
     void begin();
     void registerCommand(const String& cmd, const String& help, CommandHandler handler);
+    void setCommandTable(const Command* table, size_t count);
+    template <size_t N>
+    void setCommandTable(const Command (&table)[N]) { setCommandTable(table, N); }
+
+    static constexpr bool isSorted(const Command* table, size_t count) {
+        for (size_t i = 1; i < count; ++i)
+            if (compare(table[i - 1].name, table[i].name, SIZE_MAX) >= 0) return false;
+        return true;
+    }
 
     // Stream interface
     int available() override;
@@ -25,15 +68,24 @@ public:
     void setEcho(bool enabled) { _echoEnabled = enabled; }
     bool isEchoEnabled() const { return _echoEnabled; }
 
+    // Outputs are buffered per sink and flushed on newline, when full or after
+    // the buffer timeout. Sinks must report availableForWrite(); a sink that has
+    // no room is skipped instead of blocking, and overflowing bytes are dropped.
     void attachOutput(Stream* out);
+    void setBufferTimeout(unsigned long ms) { _multiOutput.setTimeout(ms); }
+    bool hasPendingOutput() const { return _multiOutput.pending(); }
+    void poll() { _multiOutput.poll(); }
+    uint32_t droppedOutput() const { return _multiOutput.dropped(); }
+    // For reports that complete after their command has returned
+    Stream& output() { return _multiOutput; }
 
     using OnExitCallback = std::function<void()>;
     void setOnExit(OnExitCallback cb) { _onExit = cb; }
 
 private:
-    static constexpr size_t LINE_BUFFER_SIZE = 128;
     char _lineBuffer[LINE_BUFFER_SIZE] = {0};
     size_t _lineLen = 0;
+    bool _lineOverflow = false;
     bool _echoEnabled = true;
 
     struct CommandInfo {
@@ -41,22 +93,51 @@ private:
         CommandHandler handler;
     };
     std::map<String, CommandInfo> _commands;
+    const Command* _table = nullptr;
+    size_t _tableSize = 0;
 
-    // Proxy stream that writes to all outputs
+    // strcmp of a (up to aLen characters) against the terminated string b
+    static constexpr int compare(const char* a, const char* b, size_t aLen) {
+        size_t i = 0;
+        for (; i < aLen && a[i] != '\0'; ++i) {
+            if (b[i] == '\0' || a[i] != b[i])
+                return (unsigned char)a[i] < (unsigned char)b[i] ? -1 : 1;
+        }
+        return b[i] == '\0' ? 0 : -1;
+    }
+    const Command* findCommand(const char* cmdline, size_t len) const;
+    bool dispatchTable(const char* cmdline, size_t len);
+
+    // Proxy stream that buffers and writes to all outputs
     class MultiOutputStream : public Stream {
     public:
         MultiOutputStream() = default;
         int available() override { return 0; }
         int read() override { return -1; }
         int peek() override { return -1; }
-        void flush() override {}
+        void flush() override;
         size_t write(uint8_t c) override;
         size_t write(const uint8_t *buffer, size_t size) override;
-        void addOutput(Stream* out) { _outputs.push_back(out); }
-        void clearOutputs() { _outputs.clear(); }
-        std::vector<Stream*>& outputs() { return _outputs; }
+        using Print::write;
+        void addOutput(Stream* out) { _sinks.push_back(Sink{out}); }
+        void clearOutputs() { _sinks.clear(); }
+        void setTimeout(unsigned long ms) { _timeoutMs = ms; }
+        bool pending() const;
+        void poll();
+        uint32_t dropped() const { return _dropped; }
     private:
-        std::vector<Stream*> _outputs;
+        struct Sink {
+            Stream* out = nullptr;
+            uint8_t buffer[MENUCLI_OUTPUT_BUFFER_SIZE] = {};
+            size_t len = 0;
+            unsigned long since = 0; // When the oldest buffered byte was written
+        };
+        std::vector<Sink> _sinks;
+        unsigned long _timeoutMs = MENUCLI_DEFAULT_BUFFER_TIMEOUT_MS;
+        uint32_t _dropped = 0;
+
+        void append(Sink& sink, const uint8_t *buffer, size_t size);
+        void flushSink(Sink& sink);
     } _multiOutput;
 
     MultiOutputStream& outputStream() { return _multiOutput; }
@@ -67,6 +148,7 @@ private:
     void printHelp();
 
     void bufferOutput(const String& s);
+    void bufferOutput(const char* s);
     void bufferOutputChar(char c);
 
     OnExitCallback _onExit = nullptr;
@@ -0,0 +1,128 @@
+#include "NmeaFilter.h"
+#include <string.h>
+
+bool NmeaFilter::validKey(const char* key)
+{
+    size_t len = strlen(key);
+    if (len != 3 && len != 5) return false;
+    for (size_t i = 0; i < len; ++i)
+        if (!((key[i] >= 'A' && key[i] <= 'Z') || (key[i] >= '0' && key[i] <= '9'))) return false;
+    return true;
+}
+
+bool NmeaFilter::setRule(Table& table, const char* key, Action action, uint8_t rateHz)
+{
+    if (!validKey(key)) return false;
+    Rule* free = nullptr;
+    for (Rule& rule : table.rules)
+    {
+        if (strcmp(rule.key, key) == 0)
+        {
+            free = &rule;
+            break;
+        }
+        if (!free && rule.key[0] == '\0') free = &rule;
+    }
+    if (!free) return false;
+    strncpy(free->key, key, KEY_LEN - 1);
+    free->key[KEY_LEN - 1] = '\0';
+    free->action = action;
+    free->rateHz = action == Decimate ? rateHz : 0;
+    return true;
+}
+
+bool NmeaFilter::removeRule(Table& table, const char* key)
+{
+    for (Rule& rule : table.rules)
+    {
+        if (rule.key[0] != '\0' && strcmp(rule.key, key) == 0)
+        {
+            memset(&rule, 0, sizeof(rule));
+            return true;
+        }
+    }
+    return false;
+}
+
+void NmeaFilter::clear(Table& table)
+{
+    table = Table();
+}
+
+void NmeaFilter::load(const Table& table)
+{
+    memset(_index, 0, sizeof(_index));
+    memset(_scheduled, 0, sizeof(_scheduled));
+    _defaultAction = table.defaultAction;
+    for (size_t i = 0; i < MAX_RULES; ++i)
+    {
+        _rules[i] = table.rules[i];
+        _rules[i].key[KEY_LEN - 1] = '\0';
+        if (!validKey(_rules[i].key)) continue;
+
+        _keys[i] = packKey(_rules[i].key, strlen(_rules[i].key));
+        size_t slot = slotOf(_keys[i]);
+        while (_index[slot]) slot = (slot + 1) & (INDEX_SIZE - 1);
+        _index[slot] = (uint8_t)(i + 1);
+    }
+}
+
+bool NmeaFilter::accept(const uint8_t* sentence, size_t len, unsigned long nowMs)
+{
+    // "$TTSSS," - a talker/type rule wins over a type-only rule
+    int rule = -1;
+    if (len >= 7)
+    {
+        const char* address = (const char*)sentence + 1;
+        rule = find(packKey(address, 5));
+        if (rule < 0) rule = find(packKey(address + 2, 3));
+    }
+
+    uint8_t action = rule < 0 ? _defaultAction : _rules[rule].action;
+    bool pass = action == Pass;
+    if (action == Decimate && _rules[rule].rateHz > 0)
+    {
+        // Pass on a fixed schedule with a little slack for epoch jitter,
+        // so a 1 Hz rule on a 10 Hz source neither slips nor doubles up
+        unsigned long interval = 1000 / _rules[rule].rateHz;
+        long early = (long)(_nextPass[rule] - nowMs);
+        if (!_scheduled[rule] || early <= (long)(interval / 20))
+        {
+            if (!_scheduled[rule] || early < -(long)interval)
+                _nextPass[rule] = nowMs;
+            _nextPass[rule] += interval;
+            _scheduled[rule] = true;
+            pass = true;
+        }
+    }
+
+    if (pass) _passed++;
+    else _dropped++;
+    return pass;
+}
+
+void NmeaFilter::resetStats()
+{
+    _passed = 0;
+    _dropped = 0;
+}
+
+uint32_t NmeaFilter::packKey(const char* key, size_t len)
+{
+    uint32_t packed = len == 5 ? LONG_KEY : 0;
+    for (size_t i = 0; i < len; ++i)
+        packed |= (uint32_t)((key[i] - 0x20) & 0x3F) << (6 * i);
+    return packed;
+}
+
+int NmeaFilter::find(uint32_t key) const
+{
+    size_t slot = slotOf(key);
+    while (_index[slot])
+    {
+        int rule = _index[slot] - 1;
+        if (_keys[rule] == key) return rule;
+        slot = (slot + 1) & (INDEX_SIZE - 1);
+    }
+    return -1;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Per-output NMEA sentence filter. Rules match either a sentence type for
+// any talker ("GSV") or one talker/type pair ("GPGSV") and pass, drop or
+// decimate the sentence to a maximum rate. Lookup is a single probe into a
+// small hash index built when the rule table is loaded.
+class NmeaFilter {
+public:
+    static constexpr size_t MAX_RULES = 8;
+    static constexpr size_t KEY_LEN = 6; // Up to 5 characters plus terminator
+
+    enum Action : uint8_t
+    {
+        Pass = 0,
+        Drop = 1,
+        Decimate = 2
+    };
+
+    struct Rule {
+        char key[KEY_LEN];
+        uint8_t action;
+        uint8_t rateHz;
+    };
+
+    // Persistent form, stored as is in Config
+    struct Table {
+        Rule rules[MAX_RULES] = {};
+        uint8_t defaultAction = Pass;
+    };
+
+    static bool setRule(Table& table, const char* key, Action action, uint8_t rateHz = 0);
+    static bool removeRule(Table& table, const char* key);
+    static void clear(Table& table);
+    static bool validKey(const char* key);
+
+    void load(const Table& table);
+    bool accept(const uint8_t* sentence, size_t len, unsigned long nowMs);
+
+    uint32_t passed() const { return _passed; }
+    uint32_t dropped() const { return _dropped; }
+    void resetStats();
+
+private:
+    static constexpr size_t INDEX_SIZE = 32; // Power of two, well above MAX_RULES
+    static constexpr uint32_t LONG_KEY = 0x80000000u;
+
+    Rule _rules[MAX_RULES] = {};
+    uint32_t _keys[MAX_RULES] = {};
+    unsigned long _nextPass[MAX_RULES] = {};
+    bool _scheduled[MAX_RULES] = {};
+    uint8_t _index[INDEX_SIZE] = {}; // Rule number + 1, 0 when empty
+    uint8_t _defaultAction = Pass;
+
+    uint32_t _passed = 0;
+    uint32_t _dropped = 0;
+
+    static uint32_t packKey(const char* key, size_t len);
+    static size_t slotOf(uint32_t key) { return (key * 2654435761u) >> 27; }
+    int find(uint32_t key) const;
+};
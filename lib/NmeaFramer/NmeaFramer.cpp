@@ -0,0 +1,115 @@
+#include "NmeaFramer.h"
+
+void NmeaFramer::feed(const uint8_t* data, size_t len, SentenceHandler handler, void* ctx)
+{
+    for (size_t i = 0; i < len; ++i)
+    {
+        uint8_t c = data[i];
+
+        // A '$' always starts a new sentence, even in the middle of a broken one
+        if (c == '$')
+        {
+            if (_state != State::Idle) discard();
+            start();
+            continue;
+        }
+        if (_state == State::Idle)
+        {
+            _junkBytes++;
+            continue;
+        }
+        if (_len >= MAX_SENTENCE)
+        {
+            discard();
+            continue;
+        }
+        _buffer[_len++] = c;
+
+        switch (_state)
+        {
+        case State::Body:
+            if (c == '*')
+                _state = State::Checksum1;
+            else if (c < 0x20 || c > 0x7E)
+                discard();
+            else
+                _calc ^= c;
+            break;
+        case State::Checksum1:
+        {
+            int v = hexValue(c);
+            if (v < 0) { discard(); break; }
+            _expected = (uint8_t)(v << 4);
+            _state = State::Checksum2;
+            break;
+        }
+        case State::Checksum2:
+        {
+            int v = hexValue(c);
+            if (v < 0) { discard(); break; }
+            _expected |= (uint8_t)v;
+            _state = State::CR;
+            break;
+        }
+        case State::CR:
+            if (c == '\r') _state = State::LF;
+            else discard();
+            break;
+        case State::LF:
+            if (c != '\n' || _expected != _calc)
+            {
+                discard();
+                break;
+            }
+            _sentences++;
+            if (handler) handler(ctx, _buffer, _len);
+            _state = State::Idle;
+            break;
+        case State::Idle:
+            break;
+        }
+    }
+}
+
+void NmeaFramer::reset()
+{
+    _state = State::Idle;
+    _len = 0;
+}
+
+void NmeaFramer::resetStats()
+{
+    _sentences = 0;
+    _corrupt = 0;
+    _junkBytes = 0;
+}
+
+uint8_t NmeaFramer::checksum(const char* body, size_t len)
+{
+    uint8_t sum = 0;
+    for (size_t i = 0; i < len; ++i) sum ^= (uint8_t)body[i];
+    return sum;
+}
+
+int NmeaFramer::hexValue(uint8_t c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+void NmeaFramer::start()
+{
+    _state = State::Body;
+    _buffer[0] = '$';
+    _len = 1;
+    _calc = 0;
+}
+
+void NmeaFramer::discard()
+{
+    _corrupt++;
+    _state = State::Idle;
+    _len = 0;
+}
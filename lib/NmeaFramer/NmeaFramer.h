@@ -0,0 +1,49 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Incremental, allocation-free NMEA 0183 sentence framer.
+// Bytes are fed in arbitrary chunks; every complete "$...*hh\r\n" sentence
+// with a valid checksum is handed to the callback in one piece.
+class NmeaFramer {
+public:
+    static constexpr size_t MAX_SENTENCE = 128; // Spec limit is 82, proprietary sentences run longer
+
+    using SentenceHandler = void (*)(void* ctx, const uint8_t* sentence, size_t len);
+
+    void feed(const uint8_t* data, size_t len, SentenceHandler handler, void* ctx);
+    void reset();
+
+    uint32_t sentences() const { return _sentences; }
+    uint32_t corrupt() const { return _corrupt; }
+    uint32_t junkBytes() const { return _junkBytes; }
+    void resetStats();
+
+    // XOR of all characters between '$' and '*' (exclusive)
+    static uint8_t checksum(const char* body, size_t len);
+    static int hexValue(uint8_t c);
+
+private:
+    enum class State : uint8_t
+    {
+        Idle,
+        Body,
+        Checksum1,
+        Checksum2,
+        CR,
+        LF
+    };
+
+    State _state = State::Idle;
+    uint8_t _buffer[MAX_SENTENCE];
+    size_t _len = 0;
+    uint8_t _calc = 0;
+    uint8_t _expected = 0;
+
+    uint32_t _sentences = 0;
+    uint32_t _corrupt = 0;
+    uint32_t _junkBytes = 0;
+
+    void start();
+    void discard();
+};
@@ -0,0 +1,449 @@
+#include "OutputForwarder.h"
+#include <ctype.h>
+#include <new>
+
+OutputForwarder::OutputForwarder(Stream& target, const char* name)
+    : _target(target), _name(name) {}
+
+bool OutputForwarder::begin(size_t queueSize, BaseType_t core, UBaseType_t priority)
+{
+    if (!_queue.begin(queueSize)) return false;
+    _latestMutex = xSemaphoreCreateMutex();
+    if (!_latestMutex) return false;
+    return xTaskCreatePinnedToCore(taskEntry, _name, 3072, this, priority, &_task, core) == pdPASS;
+}
+
+void OutputForwarder::setCoalescing(size_t thresholdBytes, uint32_t flushMs)
+{
+    if (thresholdBytes > MAX_COALESCE_BYTES) thresholdBytes = MAX_COALESCE_BYTES;
+    _threshold = thresholdBytes;
+    _flushMs = flushMs;
+    wake();
+}
+
+void OutputForwarder::setBackpressure(const Backpressure& backpressure)
+{
+    _backpressure = backpressure;
+    if (_backpressure.policy > KeepLatest) _backpressure.policy = DropNewest;
+    if (_backpressure.highPercent > 100) _backpressure.highPercent = 100;
+    if (_backpressure.lowPercent > _backpressure.highPercent) _backpressure.lowPercent = _backpressure.highPercent;
+    if (_backpressure.policy == KeepLatest && !_latest)
+    {
+        _latest = new (std::nothrow) LatestSlot[LATEST_SLOTS];
+        if (!_latest) _backpressure.policy = DropNewest;
+    }
+}
+
+const char* OutputForwarder::policyName(uint8_t policy)
+{
+    switch (policy)
+    {
+    case Block: return "block";
+    case DropNewest: return "newest";
+    case DropOldest: return "oldest";
+    case KeepLatest: return "latest";
+    default: return "?";
+    }
+}
+
+void OutputForwarder::flush()
+{
+    _flushRequested.store(true, std::memory_order_relaxed);
+    wake();
+}
+
+size_t OutputForwarder::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+// Writers that check first, like the mux, wait instead of meeting the policy
+int OutputForwarder::availableForWrite()
+{
+    updateCongestion();
+    size_t level = pending();
+    return !_congested && level < _queue.capacity() ? (int)(_queue.capacity() - level) : 0;
+}
+
+void OutputForwarder::updateCongestion()
+{
+    size_t level = pending();
+    if (level > highMark())
+        _congested = true;
+    else if (level <= lowMark())
+    {
+        _congested = false;
+        _blockExpired = false;
+    }
+}
+
+size_t OutputForwarder::write(const uint8_t *buffer, size_t size)
+{
+    updateCongestion();
+    switch (_backpressure.policy)
+    {
+    case Block:
+        if ((_congested || _queue.freeSpace() < size) && (_blockExpired || !waitForRoom(size)))
+        {
+            _blockExpired = true;
+            return drop(buffer, size);
+        }
+        break;
+    case DropNewest:
+        if (_congested) return drop(buffer, size);
+        break;
+    case KeepLatest:
+        // Sentences keep going to the slots until the task has written them
+        if (_congested || _latestCount.load(std::memory_order_relaxed) > 0)
+            return keepLatest(buffer, size);
+        break;
+    default:
+        break;
+    }
+    return enqueue(buffer, size);
+}
+
+size_t OutputForwarder::writePacket(Packet* packet)
+{
+    size_t size = packet->len;
+    updateCongestion();
+    // Held back sentences must go out first, and they go through write()
+    bool copy = _congested || _latestCount.load(std::memory_order_relaxed) > 0 || pending() + size > _queue.capacity();
+    if (copy)
+        return write(packet->data, size);
+    size_t before = pending();
+    packet->retain();
+    if (!_packetQueue.push(packet, _queue.totalWritten()))
+    {
+        packet->release(); // The caller still holds a reference
+        return write(packet->data, size);
+    }
+    _packetBytes.fetch_add(size, std::memory_order_release);
+    _packetIn += size;
+    queued(before, size);
+    return size;
+}
+
+size_t OutputForwarder::enqueue(const uint8_t* buffer, size_t size)
+{
+    size_t before = pending();
+    if (!_queue.writeAll(buffer, size))
+        return drop(buffer, size);
+    queued(before, size);
+    return size;
+}
+
+// Producer side bookkeeping once size bytes have been queued
+void OutputForwarder::queued(size_t before, size_t size)
+{
+    if (_counters) _counters->depth(before + size);
+    if (_tracePort >= 0) latencyTrace.enqueued((LatencyTrace::Port)_tracePort, _queue.totalWritten() + _packetIn, size);
+    // Only wake the task when it has something new to decide on
+    if (before == 0 || (before < _threshold && before + size >= _threshold))
+        wake();
+    if (_backpressure.policy == DropOldest && before + size > highMark())
+    {
+        _trimRequested.store(true, std::memory_order_relaxed);
+        wake();
+    }
+}
+
+// Counts a discarded write, as frames when a delimiter is set
+size_t OutputForwarder::drop(const uint8_t* buffer, size_t size)
+{
+    uint32_t frames = 0;
+    if (_delimiter >= 0)
+        for (size_t i = 0; i < size; ++i)
+            if (buffer[i] == (uint8_t)_delimiter) frames++;
+    _droppedFrames.fetch_add(frames ? frames : 1, std::memory_order_relaxed);
+    if (_counters) _counters->drop(size);
+    return 0;
+}
+
+// Waits for the queue to drain below the low watermark and fit size bytes
+bool OutputForwarder::waitForRoom(size_t size)
+{
+    unsigned long start = millis();
+    while (pending() > lowMark() || _queue.freeSpace() < size)
+    {
+        if (millis() - start >= BLOCK_TIMEOUT_MS) return false;
+        wake();
+        vTaskDelay(1);
+    }
+    _congested = false;
+    return true;
+}
+
+// Key of a complete "$...*hh\r\n" sentence: its address, plus the part
+// for types sent as several sentences per epoch. GSV and TXT number their
+// parts in field 2, GSA (NMEA 4.10) names its system in field 18.
+static bool sentenceKey(const uint8_t* sentence, size_t len, char (&key)[OutputForwarder::LATEST_KEY_LEN])
+{
+    if (len < 8 || (sentence[0] != '$' && sentence[0] != '!') || sentence[len - 1] != '\n')
+        return false;
+    size_t end = len - 1;
+    if (sentence[end - 1] == '\r') end--;
+    if (sentence[end - 3] != '*' || !isxdigit(sentence[end - 2]) || !isxdigit(sentence[end - 1]))
+        return false;
+    end -= 3;
+
+    const char* body = (const char*)sentence + 1;
+    size_t bodyLen = end - 1;
+    size_t addressLen = 0;
+    while (addressLen < bodyLen && body[addressLen] != ',') addressLen++;
+    if (addressLen == 0 || addressLen > 8)
+        return false;
+    memcpy(key, body, addressLen);
+    size_t keyLen = addressLen;
+
+    int partField = -1;
+    if (addressLen == 5 && (memcmp(body + 2, "GSV", 3) == 0 || memcmp(body + 2, "TXT", 3) == 0))
+        partField = 2;
+    else if (addressLen == 5 && memcmp(body + 2, "GSA", 3) == 0)
+        partField = 18;
+    if (partField > 0)
+    {
+        size_t pos = addressLen;
+        for (int field = 0; field < partField && pos < bodyLen; ++pos)
+            if (body[pos] == ',') field++;
+        key[keyLen++] = ',';
+        for (size_t n = 0; n < 3 && pos < bodyLen && body[pos] != ','; ++n)
+            key[keyLen++] = body[pos++];
+    }
+    key[keyLen] = '\0';
+    return true;
+}
+
+// Splits a write into lines. Complete NMEA sentences are held back, the
+// newest per key; runs of anything else (menu replies, mirrored uplink
+// data, RTCM) are queued as usual and only dropped if they do not fit.
+size_t OutputForwarder::keepLatest(const uint8_t* buffer, size_t size)
+{
+    size_t passStart = 0;
+    size_t start = 0;
+    while (start < size)
+    {
+        const uint8_t* newline = (const uint8_t*)memchr(buffer + start, '\n', size - start);
+        size_t end = newline ? newline - buffer + 1 : size;
+        char key[LATEST_KEY_LEN];
+        if (end - start <= LATEST_SLOT_BYTES && sentenceKey(buffer + start, end - start, key))
+        {
+            if (start > passStart)
+                enqueue(buffer + passStart, start - passStart);
+            stashLatest(key, buffer + start, end - start);
+            passStart = end;
+        }
+        start = end;
+    }
+    if (size > passStart)
+        enqueue(buffer + passStart, size - passStart);
+    wake();
+    return size;
+}
+
+void OutputForwarder::stashLatest(const char* key, const uint8_t* sentence, size_t len)
+{
+    xSemaphoreTake(_latestMutex, portMAX_DELAY);
+    size_t count = _latestCount.load(std::memory_order_relaxed);
+    LatestSlot* slot = nullptr;
+    for (size_t i = 0; i < count && !slot; ++i)
+        if (strcmp(_latest[i].key, key) == 0) slot = &_latest[i];
+    if (slot)
+        drop(slot->data, slot->len); // Superseded by the newer sentence
+    else if (count < LATEST_SLOTS)
+        slot = &_latest[count];
+    if (slot)
+    {
+        strcpy(slot->key, key);
+        memcpy(slot->data, sentence, len);
+        slot->len = len;
+        slot->seq = _latestSeq++;
+        if (slot == &_latest[count])
+            _latestCount.store(count + 1, std::memory_order_release);
+    }
+    xSemaphoreGive(_latestMutex);
+    if (!slot)
+        drop(sentence, len);
+}
+
+// Task side: once everything queued is out, writes the held sentences in
+// arrival order, as many as fit in one write. False if none were held.
+bool OutputForwarder::flushLatest()
+{
+    if (_latestCount.load(std::memory_order_acquire) == 0) return false;
+    size_t len = 0;
+    xSemaphoreTake(_latestMutex, portMAX_DELAY);
+    for (size_t count = _latestCount.load(std::memory_order_relaxed); count > 0; --count)
+    {
+        size_t oldest = 0;
+        for (size_t i = 1; i < count; ++i)
+            if ((int32_t)(_latest[i].seq - _latest[oldest].seq) < 0) oldest = i;
+        LatestSlot& slot = _latest[oldest];
+        if (len + slot.len > sizeof(_staging)) break;
+        memcpy(_staging + len, slot.data, slot.len);
+        len += slot.len;
+        slot = _latest[count - 1];
+        _latestCount.store(count - 1, std::memory_order_release);
+    }
+    xSemaphoreGive(_latestMutex);
+    writeTarget(_staging, len);
+    return true;
+}
+
+// Consumer side of DropOldest: discards whole frames from the head of the
+// queue until it is back at the low watermark
+void OutputForwarder::trimOldest()
+{
+    while (pending() > lowMark())
+    {
+        const PacketQueue::Entry* entry = _packetQueue.front();
+        if (entry && entry->position == _queue.totalRead())
+        {
+            size_t len = entry->packet->len;
+            popPacket();
+            _droppedFrames.fetch_add(1, std::memory_order_relaxed);
+            if (_counters) _counters->drop(len);
+            continue;
+        }
+        size_t limit = sizeof(_staging);
+        if (entry && entry->position - _queue.totalRead() < limit)
+            limit = entry->position - _queue.totalRead();
+        size_t len = _queue.peek(_staging, limit);
+        size_t cut = len;
+        if (_delimiter >= 0)
+        {
+            for (size_t i = 0; i < len; ++i)
+            {
+                if (_staging[i] == (uint8_t)_delimiter)
+                {
+                    cut = i + 1;
+                    break;
+                }
+            }
+        }
+        _queue.skip(cut);
+        _droppedFrames.fetch_add(1, std::memory_order_relaxed);
+        if (_counters) _counters->drop(cut);
+    }
+}
+
+// Consumer side: the packet at the head of the packet queue is done
+void OutputForwarder::popPacket()
+{
+    Packet* packet = _packetQueue.front()->packet;
+    _packetQueue.pop();
+    _packetOut += packet->len;
+    _packetBytes.fetch_sub(packet->len, std::memory_order_release);
+    packet->release();
+}
+
+// Consumer side: the packet due next in stream order, nullptr if byte data
+// comes first
+Packet* OutputForwarder::headPacket() const
+{
+    const PacketQueue::Entry* entry = _packetQueue.front();
+    return entry && entry->position == _queue.totalRead() ? entry->packet : nullptr;
+}
+
+// Fills the staging buffer with the byte data due before the next packet.
+// When it fills up, the cut falls after the last delimiter so frames stay
+// intact. Returns the staged length.
+size_t OutputForwarder::gather()
+{
+    size_t len = 0;
+    while (len < sizeof(_staging))
+    {
+        const PacketQueue::Entry* entry = _packetQueue.front();
+        if (entry && entry->position == _queue.totalRead()) break;
+        size_t limit = sizeof(_staging) - len;
+        if (entry && entry->position - _queue.totalRead() < limit)
+            limit = entry->position - _queue.totalRead();
+        size_t got = _queue.peek(_staging + len, limit);
+        if (got == 0) break;
+        size_t cut = got;
+        if (_delimiter >= 0 && len + got == sizeof(_staging))
+        {
+            while (cut > 0 && _staging[len + cut - 1] != (uint8_t)_delimiter) cut--;
+            // A frame longer than the staging buffer goes out as is
+            if (cut == 0 && len == 0) cut = got;
+        }
+        _queue.skip(cut);
+        len += cut;
+        if (cut < got) break;
+    }
+    return len;
+}
+
+void OutputForwarder::resetStats()
+{
+    _queue.resetStats();
+    _packets.store(0, std::memory_order_relaxed);
+    _bytesWritten.store(0, std::memory_order_relaxed);
+    _droppedFrames.store(0, std::memory_order_relaxed);
+}
+
+void OutputForwarder::wake()
+{
+    if (_task) xTaskNotifyGive(_task);
+}
+
+void OutputForwarder::taskEntry(void* pvParameters)
+{
+    static_cast<OutputForwarder*>(pvParameters)->run();
+}
+
+void OutputForwarder::writeTarget(const uint8_t* data, size_t len)
+{
+    unsigned long start = micros();
+    _target.write(data, len);
+    if (_counters)
+    {
+        _counters->chunk(len);
+        _counters->write(micros() - start);
+    }
+    _packets.fetch_add(1, std::memory_order_relaxed);
+    _bytesWritten.fetch_add(len, std::memory_order_relaxed);
+}
+
+void OutputForwarder::run()
+{
+    unsigned long pendingSince = millis();
+    for (;;)
+    {
+        if (_trimRequested.exchange(false, std::memory_order_relaxed))
+            trimOldest();
+        size_t avail = pending();
+        if (avail == 0)
+        {
+            if (flushLatest()) continue;
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            pendingSince = millis();
+            continue;
+        }
+
+        // Hold back small amounts of data until the threshold or deadline
+        unsigned long age = millis() - pendingSince;
+        if (avail < _threshold && age < _flushMs && !_flushRequested.load(std::memory_order_relaxed))
+        {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(_flushMs - age) + 1);
+            continue;
+        }
+        _flushRequested.store(false, std::memory_order_relaxed);
+
+        // Packets go out straight from the pool buffer, bytes through staging
+        size_t len;
+        if (Packet* packet = headPacket())
+        {
+            len = packet->len;
+            writeTarget(packet->data, len);
+            popPacket();
+        }
+        else
+        {
+            len = gather();
+            writeTarget(_staging, len);
+        }
+        if (_tracePort >= 0) latencyTrace.written((LatencyTrace::Port)_tracePort, _queue.totalRead() + _packetOut, len);
+        pendingSince = millis();
+    }
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include <Arduino.h>
+#include <Stream.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include "ByteRing.h"
+#include "BridgeStats.h"
+#include "LatencyTrace.h"
+#include "PacketPool.h"
+
+// Queued output stage for one port. Writes are enqueued without blocking and
+// a dedicated task drains them into the target stream, coalescing small
+// writes until either the byte threshold or the flush deadline is reached.
+// Each write is queued whole or dropped whole, so frames are never split.
+// All writes must come from a single task (the ring is single-producer).
+// Once the queue rises above the high watermark the backpressure policy
+// decides what gives way, until it has drained below the low watermark.
+// Shared packets are queued by reference next to the byte queue, in order
+// with plain writes, and count against the same watermarks.
+// availableForWrite() only reports room the policy lets through untouched.
+class OutputForwarder final : public Stream {
+public:
+    static constexpr size_t MAX_COALESCE_BYTES = 1024;
+    // Longest a Block write stalls the writer. Once it expires, writes are
+    // dropped without waiting until the queue is back at the low watermark.
+    static constexpr uint32_t BLOCK_TIMEOUT_MS = 20;
+    static constexpr size_t LATEST_SLOTS = 16;
+    static constexpr size_t LATEST_SLOT_BYTES = 128;
+    static constexpr size_t LATEST_KEY_LEN = 14; // Address, ',' and part number
+
+    enum Policy : uint8_t
+    {
+        Block = 0,      // Stall the writer
+        DropNewest = 1, // Discard new writes
+        DropOldest = 2, // Discard the oldest queued frames
+        KeepLatest = 3  // Hold back only the newest NMEA sentence of each type and part
+    };
+
+    // Persistent form, stored as is in Config
+    struct Backpressure {
+        uint8_t policy = DropNewest;
+        uint8_t highPercent = 75;
+        uint8_t lowPercent = 50;
+    };
+
+    OutputForwarder(Stream& target, const char* name);
+
+    bool begin(size_t queueSize, BaseType_t core, UBaseType_t priority = 4);
+    void setCoalescing(size_t thresholdBytes, uint32_t flushMs);
+    // Cut coalesced writes after the last delimiter so frames stay intact
+    void setDelimiter(int delimiter) { _delimiter = delimiter; }
+    size_t coalesceBytes() const { return _threshold; }
+    uint32_t flushMs() const { return _flushMs; }
+    const char* name() const { return _name; }
+    void setCounters(LinkCounters* counters) { _counters = counters; }
+    void setTracePort(LatencyTrace::Port port) { _tracePort = port; }
+    void setBackpressure(const Backpressure& backpressure);
+    const Backpressure& backpressure() const { return _backpressure; }
+    static const char* policyName(uint8_t policy);
+
+    // Stream interface
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void flush() override;
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    int availableForWrite() override;
+    // Queues the packet without copying it. Falls back to a copying write
+    // while congested, so the backpressure policy still applies.
+    size_t writePacket(Packet* packet);
+    using Print::write;
+    // Bytes and packets not yet handed to the target, held sentences aside
+    size_t pending() const { return _queue.available() + _packetBytes.load(std::memory_order_acquire); }
+
+    // Statistics
+    const ByteRing& queue() const { return _queue; }
+    uint32_t packets() const { return _packets.load(std::memory_order_relaxed); }
+    uint32_t bytesWritten() const { return _bytesWritten.load(std::memory_order_relaxed); }
+    uint32_t droppedFrames() const { return _droppedFrames.load(std::memory_order_relaxed); }
+    void resetStats();
+
+private:
+    Stream& _target;
+    const char* _name;
+    ByteRing _queue;
+    TaskHandle_t _task = nullptr;
+    volatile size_t _threshold = 0;
+    volatile uint32_t _flushMs = 0;
+    int _delimiter = -1;
+    LinkCounters* _counters = nullptr;
+    int _tracePort = -1;
+    std::atomic<bool> _flushRequested{false};
+    std::atomic<uint32_t> _packets{0};
+    std::atomic<uint32_t> _bytesWritten{0};
+    std::atomic<uint32_t> _droppedFrames{0};
+    uint8_t _staging[MAX_COALESCE_BYTES];
+
+    // Packets queued by reference. Stream offsets cover bytes and packets:
+    // _packetIn is producer side, _packetOut consumer side.
+    PacketQueue _packetQueue;
+    std::atomic<size_t> _packetBytes{0};
+    size_t _packetIn = 0;
+    size_t _packetOut = 0;
+
+    // Backpressure, producer side except for the trim request and the held
+    // sentences, which the task writes out once the queue has drained
+    struct LatestSlot {
+        char key[LATEST_KEY_LEN];
+        uint16_t len;
+        uint32_t seq;
+        uint8_t data[LATEST_SLOT_BYTES];
+    };
+    Backpressure _backpressure;
+    bool _congested = false;
+    bool _blockExpired = false;
+    std::atomic<bool> _trimRequested{false};
+    SemaphoreHandle_t _latestMutex = nullptr;
+    LatestSlot* _latest = nullptr;
+    std::atomic<size_t> _latestCount{0};
+    uint32_t _latestSeq = 0;
+
+    static void taskEntry(void* pvParameters);
+    void run();
+    void wake();
+    size_t highMark() const { return _queue.capacity() * _backpressure.highPercent / 100; }
+    size_t lowMark() const { return _queue.capacity() * _backpressure.lowPercent / 100; }
+    void updateCongestion();
+    size_t enqueue(const uint8_t* buffer, size_t size);
+    void queued(size_t before, size_t size);
+    Packet* headPacket() const;
+    size_t gather();
+    void popPacket();
+    size_t drop(const uint8_t* buffer, size_t size);
+    bool waitForRoom(size_t size);
+    size_t keepLatest(const uint8_t* buffer, size_t size);
+    void stashLatest(const char* key, const uint8_t* sentence, size_t len);
+    bool flushLatest();
+    void writeTarget(const uint8_t* data, size_t len);
+    void trimOldest();
+};
@@ -0,0 +1,123 @@
+#include "PacketPool.h"
+#include <esp_heap_caps.h>
+#include <new>
+
+static_assert((PacketQueue::SIZE & (PacketQueue::SIZE - 1)) == 0, "PacketQueue::SIZE must be a power of two");
+
+void Packet::release()
+{
+    if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        _pool->recycle(this);
+}
+
+bool PacketPool::begin(size_t count, size_t packetSize, bool preferPsram)
+{
+    end();
+    if (count == 0 || count > MAX_PACKETS || packetSize == 0 || packetSize > 0xFFFF) return false;
+
+    // Only the payload may live in PSRAM; the bookkeeping is hit on every packet
+    if (preferPsram)
+        _storage = (uint8_t*)heap_caps_malloc(count * packetSize, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!_storage)
+        _storage = (uint8_t*)heap_caps_malloc(count * packetSize, MALLOC_CAP_8BIT);
+    _packets = new (std::nothrow) Packet[count];
+    _next = new (std::nothrow) std::atomic<uint16_t>[count];
+    if (!_storage || !_packets || !_next)
+    {
+        end();
+        return false;
+    }
+
+    _count = count;
+    _packetSize = packetSize;
+    for (size_t i = 0; i < count; ++i)
+    {
+        Packet& packet = _packets[i];
+        packet.data = _storage + i * packetSize;
+        packet.len = 0;
+        packet.capacity = packetSize;
+        packet._index = i;
+        packet._pool = this;
+        _next[i].store(i + 1 < count ? i + 1 : NIL, std::memory_order_relaxed);
+    }
+    _available.store(count, std::memory_order_relaxed);
+    _lowWater.store(count, std::memory_order_relaxed);
+    _exhausted.store(0, std::memory_order_relaxed);
+    _head.store(0, std::memory_order_release);
+    return true;
+}
+
+// Only valid once every packet is back in the pool
+void PacketPool::end()
+{
+    if (_storage) heap_caps_free(_storage);
+    delete[] _packets;
+    delete[] _next;
+    _storage = nullptr;
+    _packets = nullptr;
+    _next = nullptr;
+    _count = 0;
+    _head.store(NIL, std::memory_order_relaxed);
+    _available.store(0, std::memory_order_relaxed);
+}
+
+Packet* PacketPool::acquire()
+{
+    uint32_t head = _head.load(std::memory_order_acquire);
+    for (;;)
+    {
+        uint16_t index = head & 0xFFFF;
+        if (index == NIL)
+        {
+            _exhausted.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        // A stale next is harmless: the tag makes the exchange fail
+        uint32_t next = _next[index].load(std::memory_order_relaxed);
+        uint32_t tagged = ((head & 0xFFFF0000u) + 0x10000u) | next;
+        if (_head.compare_exchange_weak(head, tagged, std::memory_order_acquire, std::memory_order_acquire))
+        {
+            Packet* packet = &_packets[index];
+            packet->len = 0;
+            packet->_refs.store(1, std::memory_order_relaxed);
+            size_t available = _available.fetch_sub(1, std::memory_order_relaxed) - 1;
+            size_t low = _lowWater.load(std::memory_order_relaxed);
+            while (available < low && !_lowWater.compare_exchange_weak(low, available, std::memory_order_relaxed)) {}
+            return packet;
+        }
+    }
+}
+
+void PacketPool::recycle(Packet* packet)
+{
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    uint32_t tagged;
+    do
+    {
+        _next[packet->_index].store(head & 0xFFFF, std::memory_order_relaxed);
+        tagged = ((head & 0xFFFF0000u) + 0x10000u) | packet->_index;
+    } while (!_head.compare_exchange_weak(head, tagged, std::memory_order_release, std::memory_order_relaxed));
+    _available.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PacketPool::resetStats()
+{
+    _lowWater.store(available(), std::memory_order_relaxed);
+    _exhausted.store(0, std::memory_order_relaxed);
+}
+
+bool PacketQueue::push(Packet* packet, size_t position)
+{
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    if (head - _tail.load(std::memory_order_acquire) >= SIZE) return false;
+    _entries[head & (SIZE - 1)] = {packet, position};
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+const PacketQueue::Entry* PacketQueue::front() const
+{
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail == _head.load(std::memory_order_acquire)) return nullptr;
+    return &_entries[tail & (SIZE - 1)];
+}
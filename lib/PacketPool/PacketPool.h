@@ -0,0 +1,114 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+class PacketPool;
+
+// Fixed-capacity buffer from a PacketPool. Whoever holds a reference may
+// read it; only the holder of the first reference fills it, before sharing.
+struct Packet {
+    uint8_t* data;
+    uint16_t len;
+    uint16_t capacity;
+
+    // Each sink that queues the packet takes its own reference
+    void retain() { _refs.fetch_add(1, std::memory_order_relaxed); }
+    // Returns the packet to its pool when the last reference is gone
+    void release();
+    size_t room() const { return capacity - len; }
+
+private:
+    friend class PacketPool;
+    std::atomic<uint16_t> _refs{0};
+    uint16_t _index = 0;
+    PacketPool* _pool = nullptr;
+};
+
+// Slab of equally sized packets, allocated once by begin(). acquire() and
+// release() never allocate or lock: free packets sit on a Treiber stack
+// whose head carries a tag against ABA, so any task may take or return
+// packets concurrently. An empty pool is counted, never waited for.
+class PacketPool {
+public:
+    static constexpr size_t MAX_PACKETS = 0xFFFE;
+
+    PacketPool() = default;
+    ~PacketPool() { end(); }
+    PacketPool(const PacketPool&) = delete;
+    PacketPool& operator=(const PacketPool&) = delete;
+
+    bool begin(size_t count, size_t packetSize, bool preferPsram = true);
+    void end();
+
+    // A packet with one reference and no data, or nullptr if none is free
+    Packet* acquire();
+
+    size_t count() const { return _count; }
+    size_t packetSize() const { return _packetSize; }
+    size_t available() const { return _available.load(std::memory_order_relaxed); }
+    size_t lowWater() const { return _lowWater.load(std::memory_order_relaxed); }
+    uint32_t exhausted() const { return _exhausted.load(std::memory_order_relaxed); }
+    void resetStats();
+
+private:
+    friend struct Packet;
+    static constexpr uint16_t NIL = 0xFFFF;
+
+    Packet* _packets = nullptr;
+    uint8_t* _storage = nullptr;
+    std::atomic<uint16_t>* _next = nullptr;
+    size_t _count = 0;
+    size_t _packetSize = 0;
+
+    // Low half: index of the top free packet, high half: change tag
+    std::atomic<uint32_t> _head{NIL};
+    std::atomic<size_t> _available{0};
+    std::atomic<size_t> _lowWater{0};
+    std::atomic<uint32_t> _exhausted{0};
+
+    void recycle(Packet* packet);
+};
+
+// Single-producer/single-consumer FIFO of packet references. Each entry also
+// carries a position the consumer uses to order it against other data.
+class PacketQueue {
+public:
+    static constexpr size_t SIZE = 32; // Power of two
+
+    struct Entry {
+        Packet* packet;
+        size_t position;
+    };
+
+    bool push(Packet* packet, size_t position);
+    const Entry* front() const;
+    void pop() { _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+    size_t size() const { return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire); }
+
+private:
+    Entry _entries[SIZE] = {};
+    std::atomic<uint32_t> _head{0};
+    std::atomic<uint32_t> _tail{0};
+};
+
+// Hands a packet to a sink: by reference if the sink queues packets,
+// otherwise as a plain write. The caller keeps its own reference.
+template <class Sink>
+auto sendPacket(Sink& sink, Packet* packet, int) -> decltype(sink.writePacket(packet), size_t())
+{
+    return sink.writePacket(packet);
+}
+
+template <class Sink>
+size_t sendPacket(Sink& sink, Packet* packet, long)
+{
+    return sink.write(packet->data, packet->len);
+}
+
+template <class Sink>
+size_t sendPacket(Sink& sink, Packet* packet)
+{
+    return sendPacket(sink, packet, 0);
+}
@@ -0,0 +1,127 @@
+#include "PowerGovernor.h"
+
+// Smoothing by a quarter of the difference, in integers
+static uint32_t smooth(uint32_t average, uint32_t sample)
+{
+    return average == 0 ? sample : average + ((int32_t)(sample - average) / 4);
+}
+
+void PowerGovernor::onTraffic(uint32_t nowMs, size_t bytes)
+{
+    if (!_seen || nowMs - _lastTraffic >= BURST_GAP_MS)
+    {
+        if (_burstValid)
+        {
+            // Jitter follows the largest recent deviation of an on-time
+            // epoch and decays slowly
+            uint32_t interval = nowMs - _burstStart;
+            uint32_t deviation = interval > _period ? interval - _period : _period - interval;
+            if (_period > 0 && deviation < _period / 4)
+                _jitter = deviation >= _jitter ? deviation : _jitter - (_jitter - deviation + 3) / 4;
+            // A single missed epoch leaves the period alone; a second long
+            // interval in a row means the rate really dropped
+            bool missed = _period > 0 && interval > _period + _period / 2 && !_missed;
+            _missed = missed;
+            if (!missed)
+                _period = smooth(_period, interval);
+            _length = smooth(_length, _lastTraffic - _burstStart);
+        }
+        _burstStart = nowMs;
+        _burstValid = _seen;
+    }
+    if (!_seen)
+        _windowStart = nowMs;
+    _seen = true;
+    _lastTraffic = nowMs;
+
+    _windowBytes += bytes;
+    uint32_t elapsed = nowMs - _windowStart;
+    if (elapsed >= RATE_WINDOW_MS)
+    {
+        _rate = (_rate + (uint32_t)((uint64_t)_windowBytes * 1000 / elapsed)) / 2;
+        _windowStart = nowMs;
+        _windowBytes = 0;
+    }
+}
+
+// Time until the next burst is due, 0 if it is due now or not predictable.
+// The guard widens with the jitter, which can land a burst early.
+uint32_t PowerGovernor::nextBurstIn(uint32_t nowMs) const
+{
+    if (_period == 0 || !_seen)
+        return 0;
+    uint32_t guard = GUARD_MS + 2 * _jitter;
+    if (guard > _period / 4)
+        guard = _period / 4;
+    uint32_t since = nowMs - _burstStart;
+    return since + guard < _period ? _period - guard - since : 0;
+}
+
+PowerGovernor::Mode PowerGovernor::decide(uint32_t nowMs) const
+{
+    if (_policy == Off || !_seen)
+        return _policy == Off ? Burst : Idle;
+    uint32_t quiet = nowMs - _lastTraffic;
+    if (quiet < BURST_GAP_MS || _rate > DENSE_RATE)
+        return Burst;
+    if (quiet >= IDLE_MS)
+        return Idle;
+    // Regular epochs: be at full clock when the next one starts
+    if (_period > 0 && nextBurstIn(nowMs) == 0 && quiet < _period + BURST_GAP_MS)
+        return Burst;
+    return Between;
+}
+
+PowerGovernor::Mode PowerGovernor::update(uint32_t nowMs)
+{
+    if (_updated)
+        _timeIn[_mode] += nowMs - _lastUpdate;
+    _updated = true;
+    _lastUpdate = nowMs;
+    _mode = decide(nowMs);
+    return _mode;
+}
+
+uint32_t PowerGovernor::nextCheckMs(uint32_t nowMs) const
+{
+    if (_policy == Off || !_seen)
+        return 0;
+    uint32_t quiet = nowMs - _lastTraffic;
+    if (quiet < BURST_GAP_MS)
+        return BURST_GAP_MS - quiet;
+    if (quiet >= IDLE_MS)
+        return 0;
+    uint32_t check = IDLE_MS - quiet;
+    uint32_t burst = nextBurstIn(nowMs);
+    if (burst > 0 && burst < check)
+        check = burst;
+    // A predicted burst that did not come ends the full clock after one gap
+    if (_mode == Burst && _period > 0 && quiet < _period + BURST_GAP_MS && _period + BURST_GAP_MS - quiet < check)
+        check = _period + BURST_GAP_MS - quiet;
+    return check;
+}
+
+unsigned PowerGovernor::dutyPercent(Mode mode) const
+{
+    uint64_t total = 0;
+    for (uint64_t time : _timeIn)
+        total += time;
+    return total ? (unsigned)(_timeIn[mode] * 100 / total) : 0;
+}
+
+void PowerGovernor::resetStats()
+{
+    for (uint64_t& time : _timeIn)
+        time = 0;
+}
+
+const char* PowerGovernor::name(Mode mode)
+{
+    switch (mode)
+    {
+    case Burst: return "burst";
+    case Between: return "between";
+    case Idle: return "idle";
+    default: return "?";
+    }
+}
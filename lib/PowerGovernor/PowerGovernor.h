@@ -0,0 +1,79 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Picks the CPU clock from the shape of the forwarded traffic. GNSS data
+// arrives in bursts of a few milliseconds once per epoch; between bursts
+// the clock drops, and it goes back up when traffic resumes or shortly
+// before the next burst is expected. Dense streams keep the full clock.
+// Pure logic driven by millisecond timestamps, so recorded traffic
+// timelines can be replayed through it on host; the caller applies mhz().
+class PowerGovernor {
+public:
+    enum Policy : uint8_t
+    {
+        Off,  // Always the full clock
+        Auto
+    };
+
+    enum Mode : uint8_t
+    {
+        Burst,   // Traffic flowing, full clock
+        Between, // Gap between bursts, low clock
+        Idle,    // No traffic for IDLE_MS, low clock
+        MODE_COUNT
+    };
+
+    static constexpr uint32_t FULL_MHZ = 240;
+    static constexpr uint32_t LOW_MHZ = 80;        // Lowest clock that keeps the APB, and the UART baud rates, at 80 MHz
+    static constexpr uint32_t BURST_GAP_MS = 10;   // Silence that ends a burst
+    static constexpr uint32_t GUARD_MS = 3;        // Clock goes up this long before an expected burst, plus twice the jitter
+    static constexpr uint32_t IDLE_MS = 3000;
+    static constexpr uint32_t RATE_WINDOW_MS = 1000;
+    static constexpr uint32_t DENSE_RATE = 16384;  // Bytes/s above which gaps are too short to use
+
+    void setPolicy(Policy policy) { _policy = policy; }
+    Policy policy() const { return _policy; }
+
+    // Router task: bytes arrived at nowMs
+    void onTraffic(uint32_t nowMs, size_t bytes);
+    // Re-evaluates the mode at nowMs and accounts the time spent in the old one
+    Mode update(uint32_t nowMs);
+    // Milliseconds after nowMs when update() may decide differently, 0 if never
+    uint32_t nextCheckMs(uint32_t nowMs) const;
+
+    Mode mode() const { return _mode; }
+    uint32_t mhz() const { return _mode == Burst ? FULL_MHZ : LOW_MHZ; }
+    uint32_t byteRate() const { return _rate; }
+    uint32_t burstPeriodMs() const { return _period; }
+    uint32_t burstLengthMs() const { return _length; }
+    uint32_t burstJitterMs() const { return _jitter; }
+    // Share of the time since the last reset spent in mode, in percent
+    unsigned dutyPercent(Mode mode) const;
+    void resetStats();
+
+    static const char* name(Mode mode);
+
+private:
+    Policy _policy = Auto;
+    Mode _mode = Burst;
+    bool _seen = false;
+    uint32_t _lastTraffic = 0;
+    uint32_t _burstStart = 0;
+    bool _burstValid = false;
+    uint32_t _period = 0; // Smoothed burst start to burst start
+    uint32_t _length = 0; // Smoothed burst duration
+    uint32_t _jitter = 0; // Smoothed deviation of the burst start from the period
+    bool _missed = false; // Last interval was skipped as a missed epoch
+
+    uint32_t _windowStart = 0;
+    uint32_t _windowBytes = 0;
+    uint32_t _rate = 0;
+
+    uint32_t _lastUpdate = 0;
+    bool _updated = false;
+    uint64_t _timeIn[MODE_COUNT] = {};
+
+    Mode decide(uint32_t nowMs) const;
+    uint32_t nextBurstIn(uint32_t nowMs) const;
+};
@@ -0,0 +1,161 @@
+#include "Rtcm3Framer.h"
+#include <string.h>
+
+namespace {
+
+// CRC-24Q (polynomial 0x1864CFB), generated at compile time
+struct Crc24qTable {
+    uint32_t v[256];
+    constexpr Crc24qTable() : v()
+    {
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t crc = i << 16;
+            for (int j = 0; j < 8; ++j)
+            {
+                crc <<= 1;
+                if (crc & 0x1000000) crc ^= 0x1864CFB;
+            }
+            v[i] = crc & 0xFFFFFF;
+        }
+    }
+};
+
+constexpr Crc24qTable CRC24Q_TABLE;
+
+} // namespace
+
+uint32_t Rtcm3Framer::crc24q(const uint8_t* data, size_t len)
+{
+    uint32_t crc = 0;
+    for (size_t i = 0; i < len; ++i)
+        crc = ((crc << 8) & 0xFFFFFF) ^ CRC24Q_TABLE.v[((crc >> 16) ^ data[i]) & 0xFF];
+    return crc;
+}
+
+void Rtcm3Framer::feed(const uint8_t* data, size_t len, FrameHandler handler, void* ctx, TextHandler textHandler)
+{
+    _textHandler = textHandler;
+    _ctx = ctx;
+    for (size_t i = 0; i < len; ++i)
+    {
+        if (_len == 0 && data[i] != PREAMBLE)
+        {
+            if (_textHandler)
+                text(data[i]);
+            else
+                _junkBytes++;
+            continue;
+        }
+        _buffer[_len++] = data[i];
+        while (process(handler, ctx)) {}
+    }
+    _textHandler = nullptr;
+}
+
+void Rtcm3Framer::reset()
+{
+    _len = 0;
+    _lineLen = 0;
+    _lineJunk = false;
+}
+
+// Validates what is buffered so far. Returns true if the buffer changed and
+// has to be checked again (after a resync or when bytes follow a frame).
+bool Rtcm3Framer::process(FrameHandler handler, void* ctx)
+{
+    if (_len < HEADER_LEN) return false;
+    if (_buffer[1] & 0xFC)
+    {
+        resync(1);
+        return _len > 0;
+    }
+
+    size_t payloadLen = ((size_t)(_buffer[1] & 0x03) << 8) | _buffer[2];
+    size_t frameLen = HEADER_LEN + payloadLen + CRC_LEN;
+    if (_len < frameLen) return false;
+
+    const uint8_t* trailer = _buffer + frameLen - CRC_LEN;
+    uint32_t received = ((uint32_t)trailer[0] << 16) | ((uint32_t)trailer[1] << 8) | trailer[2];
+    if (crc24q(_buffer, frameLen - CRC_LEN) != received)
+    {
+        _crcErrors++;
+        resync(1);
+        return _len > 0;
+    }
+
+    uint16_t type = payloadLen >= 2 ? messageType(_buffer) : 0;
+    _frames++;
+    countType(type);
+    if (handler) handler(ctx, _buffer, frameLen, type);
+
+    _len -= frameLen;
+    if (_len == 0) return false;
+    memmove(_buffer, _buffer + frameLen, _len);
+    resync(0);
+    return _len > 0;
+}
+
+// Drops everything before the first preamble at or after 'from'. In text
+// mode the skipped bytes after the false preamble go on as text.
+void Rtcm3Framer::resync(size_t from)
+{
+    size_t i = from;
+    while (i < _len && _buffer[i] != PREAMBLE) i++;
+    if (_textHandler)
+    {
+        _junkBytes += from;
+        for (size_t k = from; k < i; ++k)
+            text(_buffer[k]);
+    }
+    else
+    {
+        _junkBytes += i;
+    }
+    _len -= i;
+    if (_len) memmove(_buffer, _buffer + i, _len);
+}
+
+// Lines with binary content are line noise, not commands, and are dropped
+void Rtcm3Framer::text(uint8_t c)
+{
+    _line[_lineLen++] = c;
+    if ((c < 0x20 && c != '\r' && c != '\n' && c != '\t') || c >= 0x7F)
+        _lineJunk = true;
+    if (c != '\n' && _lineLen < MAX_LINE)
+        return;
+    if (_lineJunk)
+    {
+        _junkBytes += _lineLen;
+    }
+    else
+    {
+        _lines++;
+        _textHandler(_ctx, _line, _lineLen);
+    }
+    _lineLen = 0;
+    _lineJunk = false;
+}
+
+void Rtcm3Framer::countType(uint16_t type)
+{
+    for (size_t i = 0; i < _typeCount; ++i)
+    {
+        if (_types[i].type == type)
+        {
+            _types[i].count++;
+            return;
+        }
+    }
+    if (_typeCount < MAX_TYPES)
+        _types[_typeCount++] = {type, 1};
+}
+
+void Rtcm3Framer::resetStats()
+{
+    _frames = 0;
+    _crcErrors = 0;
+    _junkBytes = 0;
+    _lines = 0;
+    _typeCount = 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Incremental RTCM 3 framer: 0xD3 preamble, 6 reserved bits, 10-bit length,
+// payload and a CRC-24Q trailer. Only whole frames with a valid CRC are
+// handed to the callback; anything else is skipped until the next preamble.
+// With a text handler, bytes outside frames are collected into ASCII lines
+// instead, so one framer can split a mixed stream of RTCM and NMEA commands.
+class Rtcm3Framer {
+public:
+    static constexpr uint8_t PREAMBLE = 0xD3;
+    static constexpr size_t HEADER_LEN = 3;
+    static constexpr size_t CRC_LEN = 3;
+    static constexpr size_t MAX_PAYLOAD = 1023;
+    static constexpr size_t MAX_FRAME = HEADER_LEN + MAX_PAYLOAD + CRC_LEN;
+    static constexpr size_t MAX_TYPES = 32;
+    static constexpr size_t MAX_LINE = 256; // Longer lines are passed on in pieces
+
+    using FrameHandler = void (*)(void* ctx, const uint8_t* frame, size_t len, uint16_t type);
+    using TextHandler = void (*)(void* ctx, const uint8_t* line, size_t len);
+
+    struct TypeCount {
+        uint16_t type;
+        uint32_t count;
+    };
+
+    void feed(const uint8_t* data, size_t len, FrameHandler handler, void* ctx, TextHandler textHandler = nullptr);
+    void reset();
+
+    uint32_t frames() const { return _frames; }
+    uint32_t crcErrors() const { return _crcErrors; }
+    uint32_t junkBytes() const { return _junkBytes; }
+    uint32_t lines() const { return _lines; }
+    // Per message type counters, in order of first appearance
+    size_t typeCount() const { return _typeCount; }
+    const TypeCount& typeAt(size_t i) const { return _types[i]; }
+    void resetStats();
+
+    static uint32_t crc24q(const uint8_t* data, size_t len);
+    static uint16_t messageType(const uint8_t* frame) { return (uint16_t)((frame[3] << 4) | (frame[4] >> 4)); }
+
+private:
+    uint8_t _buffer[MAX_FRAME];
+    size_t _len = 0;
+
+    uint8_t _line[MAX_LINE];
+    size_t _lineLen = 0;
+    bool _lineJunk = false;
+    TextHandler _textHandler = nullptr; // Only valid during feed()
+    void* _ctx = nullptr;
+
+    uint32_t _frames = 0;
+    uint32_t _crcErrors = 0;
+    uint32_t _junkBytes = 0;
+    uint32_t _lines = 0;
+    TypeCount _types[MAX_TYPES];
+    size_t _typeCount = 0;
+
+    bool process(FrameHandler handler, void* ctx);
+    void resync(size_t from);
+    void text(uint8_t c);
+    void countType(uint16_t type);
+};
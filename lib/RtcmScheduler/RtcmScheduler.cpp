@@ -0,0 +1,246 @@
+#include "RtcmScheduler.h"
+#include <string.h>
+
+// Big-endian bit field of an RTCM payload
+static uint32_t bits(const uint8_t* data, size_t pos, size_t count)
+{
+    uint32_t value = 0;
+    for (size_t i = pos; i < pos + count; ++i)
+        value = (value << 1) | ((data[i / 8] >> (7 - i % 8)) & 1);
+    return value;
+}
+
+RtcmScheduler::Class RtcmScheduler::classify(uint16_t type)
+{
+    if (constellation(type) >= 0)
+        return Observation;
+    switch (type)
+    {
+    case 1005:
+    case 1006:
+    case 1007:
+    case 1008:
+    case 1032:
+    case 1033:
+        return Station;
+    case 1230:
+        return Bias;
+    default:
+        return Other;
+    }
+}
+
+int RtcmScheduler::constellation(uint16_t type)
+{
+    if (type >= 1001 && type <= 1004)
+        return 0;
+    if (type >= 1009 && type <= 1012)
+        return 1;
+    // MSM1-7 in blocks of ten from 1071 (GPS) to 1131 (NavIC)
+    if (type >= 1071 && type <= 1137 && (type - 1071) % 10 < 7)
+        return (type - 1071) / 10;
+    return -1;
+}
+
+const char* RtcmScheduler::className(Class cls)
+{
+    switch (cls)
+    {
+    case Observation: return "observation";
+    case Station: return "station";
+    case Bias: return "bias";
+    case Other: return "other";
+    default: return "?";
+    }
+}
+
+// Send order: lower first. Newest epoch group, station and bias, other,
+// older groups newest first; arrival order within each. The newest group is
+// the latest one seen, so leftovers of older groups stay behind station and
+// bias messages once it has gone out.
+static uint64_t sendKey(uint8_t cls, uint32_t epoch, size_t index, uint32_t newest)
+{
+    uint64_t rank;
+    uint32_t age = 0;
+    if (cls == RtcmScheduler::Observation)
+    {
+        age = newest - epoch;
+        rank = age == 0 ? 0 : 3;
+    }
+    else
+        rank = cls == RtcmScheduler::Other ? 2 : 1;
+    return (rank << 48) | ((uint64_t)age << 16) | index;
+}
+
+bool RtcmScheduler::push(const uint8_t* frame, size_t len)
+{
+    if (len < Rtcm3Framer::HEADER_LEN + 2 + Rtcm3Framer::CRC_LEN || len > Rtcm3Framer::MAX_FRAME)
+        return false;
+    const uint8_t* payload = frame + Rtcm3Framer::HEADER_LEN;
+    size_t payloadLen = len - Rtcm3Framer::HEADER_LEN - Rtcm3Framer::CRC_LEN;
+
+    Entry entry = {};
+    entry.len = len;
+    entry.type = Rtcm3Framer::messageType(frame);
+    entry.cls = classify(entry.type);
+    entry.constellation = constellation(entry.type);
+    entry.station = payloadLen >= 3 ? bits(payload, 12, 12) : 0;
+
+    if (entry.cls == Observation)
+    {
+        // Epoch time from after the station id up to the multiple message
+        // bit: 30 bits, 27 for legacy GLONASS. GLONASS MSM puts the day of
+        // week above its 27 bit time of day, which is all that is compared.
+        size_t mmbBit = entry.type >= 1009 && entry.type <= 1012 ? 51 : 54;
+        bool timed = payloadLen * 8 > mmbBit;
+        bool more = timed && bits(payload, mmbBit, 1);
+        uint32_t time = timed ? bits(payload, 24, mmbBit - 24) : 0;
+        if (entry.constellation == 1)
+            time &= 0x7FFFFFF;
+        Track& track = _tracks[entry.constellation];
+        if (!track.seen || (timed ? time != track.time : track.closed))
+        {
+            // The next group starts with the second epoch of any constellation
+            if (track.seen && track.group == _epoch)
+                _epoch++;
+            track.seen = true;
+            track.time = time;
+            track.group = _epoch;
+        }
+        track.closed = !more;
+        entry.epoch = track.group;
+        for (size_t i = _count; i-- > 0;)
+        {
+            const Entry& queued = _entries[i];
+            if (queued.cls == Observation && queued.constellation == entry.constellation &&
+                (int32_t)(queued.epoch - entry.epoch) < 0)
+            {
+                if (TypeStats* s = stats(queued.type)) s->superseded++;
+                remove(i);
+            }
+        }
+    }
+    else if (entry.cls != Other)
+    {
+        for (size_t i = _count; i-- > 0;)
+        {
+            const Entry& queued = _entries[i];
+            if (queued.type == entry.type && queued.station == entry.station)
+            {
+                if (TypeStats* s = stats(queued.type)) s->duplicates++;
+                remove(i);
+            }
+        }
+    }
+
+    while (_count == MAX_FRAMES || BUFFER_SIZE - _used < len)
+    {
+        int victim = pick(true);
+        if (victim < 0 || sendKey(entry.cls, entry.epoch, _count, _epoch) >
+                              sendKey(_entries[victim].cls, _entries[victim].epoch, victim, _epoch))
+        {
+            if (TypeStats* s = stats(entry.type)) s->overflows++;
+            return false;
+        }
+        if (TypeStats* s = stats(_entries[victim].type)) s->overflows++;
+        remove(victim);
+    }
+
+    if (BUFFER_SIZE - _end < len)
+        compact();
+    entry.offset = _end;
+    memcpy(_buffer + _end, frame, len);
+    _end += len;
+    _used += len;
+    _entries[_count++] = entry;
+    _front = -1;
+    return true;
+}
+
+// First (or last) entry in send order, -1 if empty
+int RtcmScheduler::pick(bool last) const
+{
+    int best = -1;
+    uint64_t bestKey = 0;
+    for (size_t i = 0; i < _count; ++i)
+    {
+        uint64_t key = sendKey(_entries[i].cls, _entries[i].epoch, i, _epoch);
+        if (best < 0 || (last ? key > bestKey : key < bestKey))
+        {
+            best = i;
+            bestKey = key;
+        }
+    }
+    return best;
+}
+
+const uint8_t* RtcmScheduler::front(size_t& len)
+{
+    if (_front < 0)
+        _front = pick(false);
+    if (_front < 0)
+        return nullptr;
+    len = _entries[_front].len;
+    return _buffer + _entries[_front].offset;
+}
+
+void RtcmScheduler::pop()
+{
+    if (_front < 0)
+        _front = pick(false);
+    if (_front < 0)
+        return;
+    if (TypeStats* s = stats(_entries[_front].type)) s->sent++;
+    remove(_front);
+}
+
+void RtcmScheduler::clear()
+{
+    _cleared += _count;
+    _count = 0;
+    _end = 0;
+    _used = 0;
+    _front = -1;
+}
+
+void RtcmScheduler::remove(size_t index)
+{
+    _used -= _entries[index].len;
+    memmove(&_entries[index], &_entries[index + 1], (_count - index - 1) * sizeof(Entry));
+    _count--;
+    if (_count == 0)
+        _end = 0;
+    _front = -1;
+}
+
+// Frames stay in arrival order, so each one only moves down
+void RtcmScheduler::compact()
+{
+    size_t end = 0;
+    for (size_t i = 0; i < _count; ++i)
+    {
+        Entry& entry = _entries[i];
+        if (entry.offset != end)
+            memmove(_buffer + end, _buffer + entry.offset, entry.len);
+        entry.offset = end;
+        end += entry.len;
+    }
+    _end = end;
+}
+
+RtcmScheduler::TypeStats* RtcmScheduler::stats(uint16_t type)
+{
+    for (size_t i = 0; i < _typeCount; ++i)
+        if (_types[i].type == type)
+            return &_types[i];
+    if (_typeCount == MAX_TYPES)
+        return nullptr;
+    _types[_typeCount] = {type, 0, 0, 0, 0};
+    return &_types[_typeCount++];
+}
+
+void RtcmScheduler::resetStats()
+{
+    _cleared = 0;
+    _typeCount = 0;
+}
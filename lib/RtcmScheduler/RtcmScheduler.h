@@ -0,0 +1,116 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "Rtcm3Framer.h"
+
+// Holds RTCM 3 correction frames that do not fit on Serial1 yet and picks
+// what goes next, so a backlog costs the receiver old data instead of
+// correction age:
+//  - Observations (MSM, legacy 1001-1004/1009-1012) belong to the epoch
+//    named by the epoch time in their header, tracked per constellation.
+//    A new time drops the queued observations of the same constellation.
+//    The multiple message bit only ends an epoch for frames too short to
+//    carry the time. Epochs of all constellations that arrive together
+//    form one group for the send order.
+//  - Station coordinates, antenna descriptors and GLONASS biases replace a
+//    queued copy from the same station.
+//  - The newest epoch group goes first, then station and bias messages,
+//    then everything else, then whatever is left of older groups.
+// When the buffer runs out, frames are evicted from the end of that order.
+// Frames are whole and CRC-checked (Rtcm3Framer output); drops are counted
+// per message type. Not thread safe.
+class RtcmScheduler {
+public:
+    static constexpr size_t BUFFER_SIZE = 6144;
+    static constexpr size_t MAX_FRAMES = 48;
+    static constexpr size_t MAX_TYPES = Rtcm3Framer::MAX_TYPES;
+    static constexpr size_t CONSTELLATIONS = 7;
+
+    enum Class : uint8_t
+    {
+        Observation,
+        Station, // 1005-1008, 1032, 1033
+        Bias,    // 1230
+        Other,
+        CLASS_COUNT
+    };
+
+    struct TypeStats {
+        uint16_t type;
+        uint32_t sent;
+        uint32_t superseded;
+        uint32_t duplicates;
+        uint32_t overflows;
+    };
+
+    void setEnabled(bool enabled) { _enabled = enabled; }
+    bool enabled() const { return _enabled; }
+    // Serial1 queue space kept free. Frames beyond it wait here, where a
+    // newer epoch can still replace them, instead of in the output queue.
+    void setReserve(size_t bytes) { _reserve = bytes; }
+    size_t reserve() const { return _reserve; }
+
+    // Copies a frame in; false if it had to be dropped
+    bool push(const uint8_t* frame, size_t len);
+    // Next frame to send, nullptr if none. Valid until the next push or pop.
+    const uint8_t* front(size_t& len);
+    void pop();
+    // Drops everything queued, e.g. when the uplink loses Serial1
+    void clear();
+
+    bool empty() const { return _count == 0; }
+    size_t frames() const { return _count; }
+    size_t bytes() const { return _used; }
+    uint32_t cleared() const { return _cleared; }
+
+    // Per message type counters, in order of first appearance
+    size_t typeCount() const { return _typeCount; }
+    const TypeStats& typeAt(size_t i) const { return _types[i]; }
+    void resetStats();
+
+    static Class classify(uint16_t type);
+    // 0 GPS, 1 GLONASS, 2 Galileo, 3 SBAS, 4 QZSS, 5 BeiDou, 6 NavIC; -1 if not an observation
+    static int constellation(uint16_t type);
+    static const char* className(Class cls);
+
+private:
+    struct Entry {
+        uint16_t offset;
+        uint16_t len;
+        uint16_t type;
+        uint16_t station;
+        uint8_t cls;
+        int8_t constellation;
+        uint32_t epoch; // Observations only: epoch group, counting up
+    };
+
+    // Latest epoch seen per constellation
+    struct Track {
+        bool seen;
+        bool closed; // The last frame had the multiple message bit clear
+        uint32_t time;
+        uint32_t group;
+    };
+
+    bool _enabled = true;
+    size_t _reserve = 0;
+
+    // Frames stored back to back in arrival order; entries in the same order
+    uint8_t _buffer[BUFFER_SIZE];
+    size_t _end = 0;
+    size_t _used = 0;
+    Entry _entries[MAX_FRAMES];
+    size_t _count = 0;
+    int _front = -1;
+
+    Track _tracks[CONSTELLATIONS] = {};
+    uint32_t _epoch = 0;
+    uint32_t _cleared = 0;
+    TypeStats _types[MAX_TYPES];
+    size_t _typeCount = 0;
+
+    int pick(bool last) const;
+    void remove(size_t index);
+    void compact();
+    TypeStats* stats(uint16_t type);
+};
@@ -0,0 +1,48 @@
+#pragma once
+#include <Arduino.h>
+#include <Stream.h>
+#include "PacketPool.h"
+
+// Write-only stream that copies everything to two streams, so two links
+// (e.g. SPP and BLE) can be served as one port. With concrete stream types
+// the copies are direct calls rather than virtual ones.
+template <class First = Stream, class Second = First>
+class StreamTee final : public Stream {
+public:
+    StreamTee(First& first, Second& second) : _first(first), _second(second) {}
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void flush() override
+    {
+        _first.flush();
+        _second.flush();
+    }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    // Succeeds if either side took the data; each side counts its own drops
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        size_t first = _first.write(buffer, size);
+        size_t second = _second.write(buffer, size);
+        return first > second ? first : second;
+    }
+    // Both sides share the packet, each takes its own reference if it queues it
+    size_t writePacket(Packet* packet)
+    {
+        size_t first = sendPacket(_first, packet);
+        size_t second = sendPacket(_second, packet);
+        return first > second ? first : second;
+    }
+    int availableForWrite() override
+    {
+        int first = _first.availableForWrite();
+        int second = _second.availableForWrite();
+        return first < second ? first : second;
+    }
+    using Print::write;
+
+private:
+    First& _first;
+    Second& _second;
+};
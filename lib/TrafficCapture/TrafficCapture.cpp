@@ -0,0 +1,269 @@
+#include "TrafficCapture.h"
+#include <esp_timer.h>
+
+TrafficCapture& trafficCapture = TrafficCapture::getInstance();
+
+static_assert(TrafficCapture::MAX_PAYLOAD + CaptureBlock::MAX_RECORD_HEADER <= CaptureBlock::SIZE - CaptureBlock::HEADER_LEN,
+              "A record must always fit an empty block");
+static_assert(TrafficCapture::MIN_KB * 1024 % CaptureBlock::SIZE == 0, "File sizes must be whole blocks");
+
+static void putLe(uint8_t* out, uint64_t value, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; ++i)
+        out[i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint64_t getLe(const uint8_t* in, size_t bytes)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i)
+        value |= (uint64_t)in[i] << (8 * i);
+    return value;
+}
+
+void TrafficCapture::record(uint8_t source, const uint8_t* data, size_t len)
+{
+    if (!active() || len == 0)
+        return;
+    if (len > MAX_PAYLOAD)
+    {
+        _truncated.fetch_add(1, std::memory_order_relaxed);
+        len = MAX_PAYLOAD;
+    }
+    // Staged in one write so the capture task never sees half a record
+    static uint8_t staged[STAGED_HEADER_LEN + MAX_PAYLOAD];
+    putLe(staged, (uint64_t)esp_timer_get_time(), 8);
+    staged[8] = source;
+    putLe(staged + 9, len, 2);
+    memcpy(staged + STAGED_HEADER_LEN, data, len);
+    if (!_staging.writeAll(staged, STAGED_HEADER_LEN + len))
+    {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    _records.fetch_add(1, std::memory_order_relaxed);
+    _bytes.fetch_add(len, std::memory_order_relaxed);
+    if (_staging.available() > STAGING_SIZE / 2)
+        xTaskNotifyGive(_task);
+}
+
+bool TrafficCapture::start(uint16_t sizeKb)
+{
+    if (sizeKb < MIN_KB || sizeKb > MAX_KB)
+        return false;
+    if (!_task)
+    {
+        if (!_readLock)
+        {
+            _readLock = xSemaphoreCreateMutex();
+            _readDone = xSemaphoreCreateBinary();
+        }
+        if (!_readLock || !_readDone || !_staging.begin(STAGING_SIZE))
+            return false;
+        if (xTaskCreatePinnedToCore(taskEntry, "Capture Task", 4096, this, 1, &_task, 1) != pdPASS)
+        {
+            _task = nullptr;
+            return false;
+        }
+    }
+    _active.store(false, std::memory_order_relaxed);
+    // Whole blocks only
+    _sizeKb.store(sizeKb - sizeKb % (CaptureBlock::SIZE / 1024), std::memory_order_relaxed);
+    _command.store(Start, std::memory_order_release);
+    xTaskNotifyGive(_task);
+    return true;
+}
+
+void TrafficCapture::stop()
+{
+    if (!_task)
+        return;
+    _active.store(false, std::memory_order_relaxed);
+    _command.store(Stop, std::memory_order_release);
+    xTaskNotifyGive(_task);
+}
+
+// A second handle on the file while the task holds it open for writing would
+// see stale metadata, so the task reads through its own handle
+bool TrafficCapture::readBlock(size_t index, uint8_t* out)
+{
+    if (index >= blockCount())
+        return false;
+    if (!_task)
+        return readFile(index, out);
+    xSemaphoreTake(_readLock, portMAX_DELAY);
+    _readIndex = index;
+    _readOut = out;
+    _readPending.store(true, std::memory_order_release);
+    xTaskNotifyGive(_task);
+    xSemaphoreTake(_readDone, portMAX_DELAY);
+    bool ok = _readOk;
+    xSemaphoreGive(_readLock);
+    return ok;
+}
+
+bool TrafficCapture::readFile(size_t index, uint8_t* out)
+{
+    File file = LittleFS.open(PATH, "r");
+    if (!file)
+        return false;
+    bool ok = file.seek(index * CaptureBlock::SIZE) && file.read(out, CaptureBlock::SIZE) == CaptureBlock::SIZE;
+    file.close();
+    return ok;
+}
+
+// Capture task; writeBlock() seeks before every write, so reading through
+// the write handle is safe
+void TrafficCapture::serveRead()
+{
+    if (!_readPending.load(std::memory_order_acquire))
+        return;
+    if (_file)
+        _readOk = _file.seek(_readIndex * CaptureBlock::SIZE) &&
+                  _file.read(_readOut, CaptureBlock::SIZE) == CaptureBlock::SIZE;
+    else
+        _readOk = readFile(_readIndex, _readOut);
+    _readPending.store(false, std::memory_order_relaxed);
+    xSemaphoreGive(_readDone);
+}
+
+void TrafficCapture::resetStats()
+{
+    _records.store(0, std::memory_order_relaxed);
+    _bytes.store(0, std::memory_order_relaxed);
+    _blocksWritten.store(0, std::memory_order_relaxed);
+    _dropped.store(0, std::memory_order_relaxed);
+    _truncated.store(0, std::memory_order_relaxed);
+    _writeErrors.store(0, std::memory_order_relaxed);
+}
+
+// Preallocates the file once, then finds the newest block to continue after
+bool TrafficCapture::open()
+{
+    if (_file)
+        _file.close();
+    if (!LittleFS.begin(true))
+        return false;
+    size_t size = blockCount() * CaptureBlock::SIZE;
+    File existing = LittleFS.open(PATH, "r");
+    bool reuse = existing && existing.size() == size;
+    if (existing)
+        existing.close();
+
+    static uint8_t block[CaptureBlock::SIZE];
+    if (!reuse)
+    {
+        LittleFS.remove(PATH);
+        File file = LittleFS.open(PATH, "w");
+        if (!file)
+            return false;
+        memset(block, 0, sizeof(block));
+        for (size_t pos = 0; pos < size; pos += CaptureBlock::SIZE)
+        {
+            if (file.write(block, sizeof(block)) != sizeof(block))
+            {
+                file.close();
+                return false;
+            }
+        }
+        file.close();
+    }
+
+    _file = LittleFS.open(PATH, "r+");
+    if (!_file)
+        return false;
+    _fileBlocks = blockCount();
+    CaptureResume resume;
+    for (size_t i = 0; reuse && i < _fileBlocks; ++i)
+    {
+        if (!_file.seek(i * CaptureBlock::SIZE) || _file.read(block, CaptureBlock::HEADER_LEN) != CaptureBlock::HEADER_LEN)
+            break;
+        resume.add(block);
+    }
+    _nextSeq = resume.nextSeq();
+    return true;
+}
+
+void TrafficCapture::drain()
+{
+    static uint8_t payload[MAX_PAYLOAD];
+    uint8_t header[STAGED_HEADER_LEN];
+    while (_staging.available() >= STAGED_HEADER_LEN)
+    {
+        _staging.read(header, sizeof(header));
+        uint64_t us = getLe(header, 8);
+        size_t len = (size_t)getLe(header + 9, 2);
+        _staging.read(payload, len);
+        if (_block.empty())
+        {
+            _block.start(_nextSeq, us);
+            _blockSince = millis();
+        }
+        if (!_block.append(us, header[8], payload, len))
+        {
+            writeBlock();
+            _block.start(_nextSeq, us);
+            _blockSince = millis();
+            _block.append(us, header[8], payload, len);
+        }
+    }
+}
+
+void TrafficCapture::writeBlock()
+{
+    if (_block.empty() || !_file)
+        return;
+    const uint8_t* data = _block.finish();
+    size_t index = _block.seq() % _fileBlocks;
+    if (_file.seek(index * CaptureBlock::SIZE) && _file.write(data, CaptureBlock::SIZE) == CaptureBlock::SIZE)
+    {
+        _file.flush();
+        _blocksWritten.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        _writeErrors.fetch_add(1, std::memory_order_relaxed);
+    }
+    _nextSeq++;
+    _block.start(_nextSeq, 0);
+}
+
+void TrafficCapture::taskEntry(void* param)
+{
+    static_cast<TrafficCapture*>(param)->run();
+}
+
+void TrafficCapture::run()
+{
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, active() ? pdMS_TO_TICKS(POLL_MS) : portMAX_DELAY);
+        serveRead();
+        uint32_t command = _command.load(std::memory_order_acquire);
+        if (command == Start)
+        {
+            // What the previous run staged, or held in RAM, belongs in its file
+            drain();
+            writeBlock();
+            _block.start(0, 0);
+            bool ok = open();
+            // A newer command wins over the one just carried out
+            uint32_t expected = Start;
+            if (_command.compare_exchange_strong(expected, None))
+                _active.store(ok, std::memory_order_relaxed);
+            continue;
+        }
+        drain();
+        if (command == Stop)
+        {
+            writeBlock();
+            if (_file)
+                _file.close();
+            uint32_t expected = Stop;
+            _command.compare_exchange_strong(expected, None);
+            continue;
+        }
+        if (!_block.empty() && millis() - _blockSince >= FLUSH_MS)
+            writeBlock();
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include "ByteRing.h"
+#include "CaptureBlock.h"
+
+// Records every chunk handed to the router into a preallocated ring of
+// blocks in a LittleFS file. The router task only copies the chunk into a
+// RAM staging ring and never waits; a low-priority task packs the staged
+// records into blocks and writes them to flash. When staging is full the
+// record is dropped and counted, forwarding always goes first. The capture
+// task is the only one that opens the file, reads included.
+class TrafficCapture {
+public:
+    static constexpr const char* PATH = "/capture.bin";
+    static constexpr size_t STAGING_SIZE = 16384;
+    static constexpr size_t MAX_PAYLOAD = 512;      // Longer chunks are cut and counted as truncated
+    static constexpr uint32_t POLL_MS = 50;
+    static constexpr uint32_t FLUSH_MS = 1000;      // A partly filled block goes to flash after this
+    static constexpr uint16_t MIN_KB = 16;
+    static constexpr uint16_t MAX_KB = 1024;
+
+    // Router task: source is the LatencyTrace port the chunk came from
+    void record(uint8_t source, const uint8_t* data, size_t len);
+
+    // Capture into a file of sizeKb, continuing after the newest block in it.
+    // Preparing the file takes a while, so the capture task does it and
+    // recording begins once active() turns true.
+    bool start(uint16_t sizeKb);
+    void stop();
+    bool active() const { return _active.load(std::memory_order_relaxed); }
+    bool starting() const { return _command.load(std::memory_order_relaxed) == Start; }
+
+    uint16_t sizeKb() const { return _sizeKb.load(std::memory_order_relaxed); }
+    size_t blockCount() const { return (size_t)sizeKb() * 1024 / CaptureBlock::SIZE; }
+    // Reads block index of the capture file; false if it cannot be read.
+    // Blocks until the capture task has served the read.
+    bool readBlock(size_t index, uint8_t* out);
+
+    uint32_t records() const { return _records.load(std::memory_order_relaxed); }
+    uint32_t bytes() const { return _bytes.load(std::memory_order_relaxed); }
+    uint32_t blocksWritten() const { return _blocksWritten.load(std::memory_order_relaxed); }
+    uint32_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+    uint32_t truncated() const { return _truncated.load(std::memory_order_relaxed); }
+    uint32_t writeErrors() const { return _writeErrors.load(std::memory_order_relaxed); }
+    void resetStats();
+
+    static TrafficCapture& getInstance() {
+        static TrafficCapture instance;
+        return instance;
+    }
+
+private:
+    // Staged record header: us u64, source u8, len u16
+    static constexpr size_t STAGED_HEADER_LEN = 11;
+
+    TrafficCapture() = default;
+    TrafficCapture(const TrafficCapture&) = delete;
+
+    enum Command : uint32_t
+    {
+        None,
+        Start,
+        Stop
+    };
+
+    std::atomic<bool> _active{false};
+    std::atomic<uint32_t> _command{None};
+    std::atomic<uint16_t> _sizeKb{0};
+    ByteRing _staging;
+    TaskHandle_t _task = nullptr;
+
+    // Owned by the capture task
+    CaptureBlock _block;
+    File _file;
+    size_t _fileBlocks = 0; // Blocks in the open file; a start may already have changed sizeKb
+    uint32_t _nextSeq = 0;
+    unsigned long _blockSince = 0;
+
+    // One read at a time, handed to the capture task
+    SemaphoreHandle_t _readLock = nullptr;
+    SemaphoreHandle_t _readDone = nullptr;
+    std::atomic<bool> _readPending{false};
+    size_t _readIndex = 0;
+    uint8_t* _readOut = nullptr;
+    bool _readOk = false;
+
+    std::atomic<uint32_t> _records{0};
+    std::atomic<uint32_t> _bytes{0};
+    std::atomic<uint32_t> _blocksWritten{0};
+    std::atomic<uint32_t> _dropped{0};
+    std::atomic<uint32_t> _truncated{0};
+    std::atomic<uint32_t> _writeErrors{0};
+
+    bool open();
+    bool readFile(size_t index, uint8_t* out);
+    void serveRead();
+    void drain();
+    void writeBlock();
+    static void taskEntry(void* param);
+    void run();
+};
+
+extern TrafficCapture& trafficCapture;
@@ -2,58 +2,94 @@
 #include "BLEBattery.h"
 #include <Arduino.h>
 #include <freertos/FreeRTOS.h>
-#include "BLEBattery.h" // Ensure BLEBattery is declared before use
+#include <freertos/task.h>
+#include "BatteryCurve.h"
+
+#define BATTERY_ADC_PIN 35
+#define BATTERY_OVERSAMPLE 16    // ADC readings averaged per sample
+#define BATTERY_FILTER_SHIFT 2   // Each sample moves the filtered voltage by 1/4 of the difference
+#define BATTERY_HYSTERESIS 25    // Hundredths of a percent past a level boundary before it changes
+#define BATTERY_SAMPLE_MS 5000
+
+static int32_t filteredMv16 = 0; // Filtered cell voltage in 1/16 mV
+
+// Oversampled and low-pass filtered cell voltage. A reseed drops the history,
+// e.g. when the last sample is too old to smooth against.
+static uint32_t cellMillivolts(bool reseed)
+{
+    uint32_t sum = 0;
+    for (int i = 0; i < BATTERY_OVERSAMPLE; ++i)
+        sum += analogReadMilliVolts(BATTERY_ADC_PIN);
+    int32_t mv16 = (int32_t)(sum * 2 * 16 / BATTERY_OVERSAMPLE); // The divider halves the cell voltage
+    if (reseed || filteredMv16 == 0)
+        filteredMv16 = mv16;
+    else
+        filteredMv16 += (mv16 - filteredMv16) / (1 << BATTERY_FILTER_SHIFT);
+    return filteredMv16 / 16;
+}
 
 uint8_t batteryPercentage()
 {
-    float vBat = analogReadMilliVolts(35);
-    vBat *= 2;    // we divided by 2, so multiply back
-    vBat /= 1000; // convert to volts!
-    float pBat = 128.7445 + (1.778399 - 128.7445) / pow(1 + pow(vBat / 3.689705, 116.3086), 0.1018804);
-    if (pBat < 0) pBat = 0;
-    else if (pBat > 100) pBat = 100;
-    return (uint8_t)pBat;
+    return BatteryCurve::percent(cellMillivolts(false));
+}
+
+// Moves the reported level only once the reading is clearly past its band,
+// so a voltage sitting on a boundary does not notify back and forth
+static uint8_t updateLevel(uint8_t level, bool reseed)
+{
+    uint16_t centi = BatteryCurve::centiPercent(cellMillivolts(reseed));
+    if (reseed || centi + BATTERY_HYSTERESIS < level * 100 || centi >= (level + 1) * 100 + BATTERY_HYSTERESIS)
+        return centi / 100;
+    return level;
 }
 
 static void batteryTask(void *pvParameters)
 {
-    static bool oldBleConnectionStatus = false;
+    bool connected = false;
+    uint8_t level = updateLevel(0, true);
+    bleBattery.setBatteryLevel(level);
     for (;;)
     {
         bool currentBleConnectionStatus = bleBattery.isClientConnected();
 
         // Handle BLE connection events
-        if (!oldBleConnectionStatus && currentBleConnectionStatus)
+        if (!connected && currentBleConnectionStatus)
         {
             Serial.println("Bluetooth client connected.");
-            bleBattery.setBatteryLevel(batteryPercentage());
+            level = updateLevel(level, true);
+            bleBattery.setBatteryLevel(level, true);
         }
-        else if (oldBleConnectionStatus && !currentBleConnectionStatus)
+        else if (connected && !currentBleConnectionStatus)
         {
             Serial.println("Bluetooth client disconnected.");
             delay(1000);
             bleBattery.advertise();
         }
-        oldBleConnectionStatus = currentBleConnectionStatus;
-
-        // Periodically update battery level
-        uint8_t battery_level = batteryPercentage();
-        bleBattery.setBatteryLevel(battery_level);
+        else if (currentBleConnectionStatus)
+        {
+            // Notifies only if the level moved
+            level = updateLevel(level, false);
+            bleBattery.setBatteryLevel(level);
+        }
+        connected = currentBleConnectionStatus;
 
-        delay(5000); // Delay for 5 seconds
+        // Sample on a period only while a client listens; otherwise sleep until one connects
+        ulTaskNotifyTake(pdTRUE, connected ? pdMS_TO_TICKS(BATTERY_SAMPLE_MS) : portMAX_DELAY);
     }
 }
 
 void startBLEBatteryTask(const char* device_name)
 {
     bleBattery.begin(device_name);
+    TaskHandle_t task = nullptr;
     xTaskCreatePinnedToCore(
         batteryTask,
         "Battery Task",
         4096,
         NULL,
         1,
-        NULL,
+        &task,
         1
     );
-}
\ No newline at end of file
+    bleBattery.setEventTask(task);
+}
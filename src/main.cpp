@@ -7,10 +7,24 @@
 
 #include <BluetoothSerial.h>
 #include "BLEBatteryTask.h"
+#include "BLEBattery.h"
 #include "MenuCLI.h"
 #include "ConfigManager.h"
+#include "ByteRing.h"
+#include "OutputForwarder.h"
+#include "PacketPool.h"
+#include "BridgeRouter.h"
+#include "BridgeStats.h"
+#include "LatencyTrace.h"
+#include "BaudProbe.h"
+#include "BleUart.h"
+#include "StreamTee.h"
+#include "TrafficCapture.h"
+#include "PowerGovernor.h"
+#include "GnssCommand.h"
 #include <freertos/FreeRTOS.h>
-#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <atomic>
 
 // Check if Bluetooth is available
 #if !defined(CONFIG_BT_ENABLED) || !defined(CONFIG_BLUEDROID_ENABLED)
@@ -24,21 +38,23 @@
 
 #define BUFFER_SIZE 256
 #define LED_PIN 13
+#define RX_RING_MIN_SIZE 1024
+#define RX_RING_BUFFER_MS 125 // Receive rings hold this much traffic at line rate
+#define TX_QUEUE_SIZE 8192
+#define PACKET_SIZE 512 // One downlink batch
+#define PACKET_COUNT 48 // Covers the batches all downlink queues can hold below their high watermarks
+#define CONFIG_COMMIT_DELAY_MS 5000 // Batch menu edits into one flash commit
+#define CONFIG_POLL_MS 250
+#define MENU_POLL_MS 10
+#define UPLINK_POLL_MS 5 // Retry interval for mux frames waiting for room on Serial1
 
-enum class SerialState
-{
-  Menu,
-  Idle,
-  SerialForward,
-  SerialBTForward
-};
-
-SerialState serialState = SerialState::Idle;
-unsigned long lastActivity = 0;
-const unsigned long ownerTimeout = 2000; // 2 seconds
-
-SemaphoreHandle_t stateMutex;
+// Routing is compiled against the concrete output stages, so no forwarded
+// chunk goes through a virtual Stream call
+using BTDownlink = StreamTee<OutputForwarder>;
+using BridgeRouter = BasicBridgeRouter<OutputForwarder, OutputForwarder, BTDownlink>;
 
+// Stored as is by ConfigManager: new fields go at the end only, so an older
+// copy loads its settings and leaves the new fields at their defaults
 struct Config
 {
   char bt_name[32] = "LC29HEA-BT";
@@ -46,213 +62,725 @@ struct Config
   uint32_t serial1_baud = 460800;
   uint32_t serial1_rx = 7;
   uint32_t serial1_tx = 8;
+  uint32_t bt_coalesce_bytes = 512;
+  uint32_t bt_flush_ms = 20;
+  NmeaFilter::Table serial_filter;
+  NmeaFilter::Table bt_filter;
+  uint8_t uplink_mode = (uint8_t)BridgeRouter::UplinkMode::Exclusive;
+  uint8_t serial_priority = 0;
+  uint8_t bt_priority = 1; // Corrections go ahead of typed commands
+  OutputForwarder::Backpressure serial_backpressure;
+  OutputForwarder::Backpressure bt_backpressure = {OutputForwarder::KeepLatest, 75, 50}; // Fewer but fresh sentences on a slow link
+  uint8_t serial1_autobaud = 1;
+  uint16_t capture_kb = 0; // Traffic capture file size, 0 when capture is off
+  uint8_t power_policy = PowerGovernor::Auto;
+  uint16_t gnss_timeout_ms = 1000; // Receiver command reply timeout
+  uint8_t gnss_retries = 2;
+  uint8_t rtcm_schedule = 1;
+  uint16_t rtcm_window = 2048; // Serial1 queue bytes corrections may fill; the rest waits in the scheduler
 };
 
+// Config as the first firmware stored it, without a header
+struct LegacyConfig
+{
+  char bt_name[32];
+  uint32_t serial_baud;
+  uint32_t serial1_baud;
+  uint32_t serial1_rx;
+  uint32_t serial1_tx;
+};
+static_assert(sizeof(LegacyConfig) == 48, "LegacyConfig must match the stored layout");
+
 Config config;
 ConfigManager<Config> configManager(0);
 
+// Carries the settings of a legacy copy over; everything newer keeps its default
+void migrateConfig(const uint8_t *data, Config &cfg)
+{
+  LegacyConfig legacy;
+  memcpy(&legacy, data, sizeof(legacy));
+  memcpy(cfg.bt_name, legacy.bt_name, sizeof(cfg.bt_name));
+  cfg.bt_name[sizeof(cfg.bt_name) - 1] = '\0';
+  cfg.serial_baud = legacy.serial_baud;
+  cfg.serial1_baud = legacy.serial1_baud;
+  cfg.serial1_rx = legacy.serial1_rx;
+  cfg.serial1_tx = legacy.serial1_tx;
+}
+
 BluetoothSerial SerialBT;
 
+// Each output is drained by its own task; BT runs on core 0 next to Bluedroid
+OutputForwarder serialOut(Serial, "Serial Out");
+OutputForwarder serial1Out(Serial1, "Serial1 Out");
+OutputForwarder serialBTOut(SerialBT, "SerialBT Out");
+OutputForwarder bleOut(bleUart, "BLE Out");
+
+// BLE UART clients share the SerialBT role: same downlink, same uplink input
+BTDownlink btDownlink(serialBTOut, bleOut);
+
+// Downlink batches, shared by reference between the outputs that queue them
+PacketPool packetPool;
+
 MenuCLI menuCLI;
-const char *magicWord = "menu";
+BridgeRouter router(serialOut, serial1Out, btDownlink, menuCLI);
+
+// Receive callbacks only enqueue into these rings; routerTask drains them
+ByteRing serialRx;
+ByteRing serial1Rx;
+ByteRing serialBTRx;
+ByteRing bleRx;
+TaskHandle_t routerTaskHandle = nullptr;
+
+// Fed and applied by routerTask only
+PowerGovernor powerGovernor;
+
+// Serial1 baudrate probe. It runs in a task of its own and owns Serial1
+// meanwhile; routerTask routes nothing until it has taken the result back.
+enum class ProbeState : uint8_t
+{
+  Idle,
+  Running,
+  Done
+};
+std::atomic<ProbeState> probeState{ProbeState::Idle};
+BaudProbe baudProbe;
+uint32_t probedBaud = 0;
+Stream *probeReport = nullptr;
+
+// Receiver configuration commands from the menu, sent and matched by the router
+GnssCommandQueue gnssCommands;
+
+size_t rxRingSize(uint32_t baud)
+{
+  size_t size = (size_t)baud / 10 * RX_RING_BUFFER_MS / 1000;
+  return size < RX_RING_MIN_SIZE ? RX_RING_MIN_SIZE : size;
+}
+
+void notifyRouter()
+{
+  if (routerTaskHandle)
+    xTaskNotifyGive(routerTaskHandle);
+}
 
-void setState(SerialState state)
+// Receive path shared by all callbacks: enqueue, count and stamp
+void receive(ByteRing &ring, LinkCounters &counters, LatencyTrace::Port port, const uint8_t *buffer, size_t len)
 {
-  if (stateMutex)
-    xSemaphoreTake(stateMutex, portMAX_DELAY);
-  serialState = state;
-  if (stateMutex)
-    xSemaphoreGive(stateMutex);
+  counters.chunk(len);
+  size_t written = ring.write(buffer, len);
+  if (written < len)
+    counters.drop(len - written);
+  counters.depth(ring.available());
+  latencyTrace.received(port, ring.totalWritten(), written);
 }
 
-void checkOwnerTimeout()
+void onSerialBTReceive(const uint8_t *buffer, size_t len)
 {
-  if (stateMutex)
-    xSemaphoreTake(stateMutex, portMAX_DELAY);
-  SerialState currentState = serialState;
-  unsigned long last = lastActivity;
-  if (stateMutex)
-    xSemaphoreGive(stateMutex);
-
-  if ((currentState == SerialState::SerialBTForward || currentState == SerialState::SerialForward) && millis() - last > ownerTimeout)
+  receive(serialBTRx, bridgeStats[BridgeStats::SerialBTRx], LatencyTrace::SerialBTPort, buffer, len);
+  notifyRouter();
+}
+
+void onBleUartReceive(const uint8_t *buffer, size_t len)
+{
+  receive(bleRx, bridgeStats[BridgeStats::BLERx], LatencyTrace::BLEPort, buffer, len);
+  notifyRouter();
+}
+
+void onSerial1Receive()
+{
+  static uint8_t buffer[BUFFER_SIZE] = {0};
+  digitalWrite(LED_PIN, HIGH); // Turn LED on
+  while (Serial1.available())
   {
-    setState(SerialState::Idle);
+    size_t len = Serial1.read(buffer, BUFFER_SIZE);
+    if (len == BUFFER_SIZE)
+    {
+      bridgeStats[BridgeStats::Serial1Rx].truncate();
+    }
+    if (len > 0)
+    {
+      receive(serial1Rx, bridgeStats[BridgeStats::Serial1Rx], LatencyTrace::Serial1Port, buffer, len);
+    }
   }
+  digitalWrite(LED_PIN, LOW); // Turn LED off after processing
+  notifyRouter();
 }
 
-// Forward Serial1 data to Serial and SerialBT
-void onSerial1Data(const uint8_t *buffer, size_t len)
+static void probeTask(void *pvParameters)
 {
-  Serial.write(buffer, len);
-  SerialBT.write(buffer, len);
+  probedBaud = baudProbe.run(Serial1, [](void *ctx, uint32_t rate)
+                             { Serial1.updateBaudRate(rate); }, nullptr, config.serial1_baud);
+  Serial1.updateBaudRate(probedBaud ? probedBaud : config.serial1_baud);
+  probeState.store(ProbeState::Done);
+  notifyRouter();
+  vTaskDelete(NULL);
 }
 
-void onSerialData(const uint8_t *buffer, size_t len)
+// Listens for the receiver at the candidate rates; routerTask reports to
+// out and persists the rate once it is done. False if already probing.
+bool startSerial1Probe(Stream &out)
 {
-  if (stateMutex)
-    xSemaphoreTake(stateMutex, portMAX_DELAY);
-  lastActivity = millis();
-  SerialState currentState = serialState;
-  if (stateMutex)
-    xSemaphoreGive(stateMutex);
+  ProbeState idle = ProbeState::Idle;
+  if (!probeState.compare_exchange_strong(idle, ProbeState::Running))
+    return false;
+  probeReport = &out;
+  // Take Serial1 away from the receive callback while probing
+  Serial1.onReceive(NULL);
+  if (xTaskCreatePinnedToCore(probeTask, "Baud Probe", 3072, NULL, 2, NULL, 1) != pdPASS)
+  {
+    Serial1.onReceive(onSerial1Receive, false);
+    probeState.store(ProbeState::Idle);
+    return false;
+  }
+  return true;
+}
 
-  static char firstLineBuf[4] = {0};
-  static size_t firstLineLen = 0;
+// routerTask side: nothing fills or drains serial1Rx now, so it can be
+// sized for the new rate before the receive callback comes back
+void finishSerial1Probe()
+{
+  uint32_t baud = probedBaud ? probedBaud : config.serial1_baud;
+  serial1Rx.begin(rxRingSize(baud));
+  Serial1.onReceive(onSerial1Receive, false);
+  probeState.store(ProbeState::Idle);
 
-  switch (currentState)
+  Stream &out = *probeReport;
+  if (probedBaud == 0)
+  {
+    out.printf("Serial1 auto-baud: no receiver heard in %lu ms, keeping %u baud\n", baudProbe.elapsedMs(), (unsigned)baud);
+    return;
+  }
+  out.printf("Serial1 auto-baud: locked at %u baud in %lu ms, %lu ms after the first byte\n", (unsigned)baud,
+             baudProbe.elapsedMs(), baudProbe.elapsedMs() - baudProbe.activityMs());
+  if (baud != config.serial1_baud)
   {
-  case SerialState::Idle:
+    config.serial1_baud = baud;
+    configManager.save();
+  }
+}
+
+// Sets the CPU clock the governor asks for; a no-op while it stays the same
+void updatePower()
+{
+  powerGovernor.update(millis());
+  uint32_t mhz = powerGovernor.mhz();
+  if (getCpuFrequencyMhz() != mhz)
+    setCpuFrequencyMhz(mhz);
+}
+
+// Moves one chunk from a receive ring into the router
+bool routeChunk(ByteRing &ring, LatencyTrace::Port port, void (BridgeRouter::*handler)(const uint8_t *, size_t))
+{
+  static uint8_t buffer[BUFFER_SIZE];
+  size_t start = ring.totalRead();
+  size_t len = ring.read(buffer, sizeof(buffer));
+  if (len == 0)
+    return false;
+  // Full clock before the chunk is routed
+  powerGovernor.onTraffic(millis(), len);
+  updatePower();
+  latencyTrace.beginRoute(port, start);
+  trafficCapture.record(port, buffer, len);
+  (router.*handler)(buffer, len);
+  latencyTrace.endRoute();
+  return true;
+}
+
+static void routerTask(void *pvParameters)
+{
+  for (;;)
   {
-    size_t processed = 0;
-    while (firstLineLen < 4 && processed < len)
+    if (probeState.load() != ProbeState::Idle)
     {
-      char c = buffer[processed++];
-      firstLineBuf[firstLineLen++] = c;
-      if (c != magicWord[firstLineLen - 1])
+      if (probeState.load() == ProbeState::Running)
       {
-        setState(SerialState::SerialForward);
-        firstLineLen = 0;
-        // Forward all data in SerialForward state
-        onSerialData(buffer, len);
-        return;
-      }
-      if (firstLineLen == 4)
-      {
-        Serial.println("\n[Menu mode entered]");
-        menuCLI.begin();
-        setState(SerialState::Menu);
-        firstLineLen = 0;
-        if (processed < len)
-        {
-          onSerialData(buffer + processed, len - processed);
-        }
-        return;
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        continue;
       }
+      finishSerial1Probe();
     }
-    // Not enough data yet to decide, wait for more
-    return;
+
+    // Menu output and config edits are flushed from here once their timeouts expire
+    TickType_t wait = portMAX_DELAY;
+    if (router.hasPendingUplink())
+      wait = pdMS_TO_TICKS(UPLINK_POLL_MS);
+    else if (menuCLI.hasPendingOutput())
+      wait = pdMS_TO_TICKS(MENU_POLL_MS);
+    else if (configManager.pending())
+      wait = pdMS_TO_TICKS(CONFIG_POLL_MS);
+    uint32_t powerCheck = powerGovernor.nextCheckMs(millis());
+    if (powerCheck && pdMS_TO_TICKS(powerCheck) + 1 < wait)
+      wait = pdMS_TO_TICKS(powerCheck) + 1;
+    ulTaskNotifyTake(pdTRUE, wait);
+    menuCLI.poll();
+    configManager.poll();
+    router.poll();
+    bool pending = true;
+    while (pending)
+    {
+      pending = routeChunk(serial1Rx, LatencyTrace::Serial1Port, &BridgeRouter::onSerial1Data);
+      pending |= routeChunk(serialRx, LatencyTrace::SerialPort, &BridgeRouter::onSerialData);
+      pending |= routeChunk(serialBTRx, LatencyTrace::SerialBTPort, &BridgeRouter::onSerialBTData);
+      pending |= routeChunk(bleRx, LatencyTrace::BLEPort, &BridgeRouter::onBLEData);
+    }
+    updatePower();
   }
-  case SerialState::SerialForward:
+}
+
+void printRingStats(Stream &out, const char *name, const ByteRing &ring)
+{
+  out.printf("%-12s size %u, high-water %u, overflow %u bytes\n",
+             name, (unsigned)ring.capacity(), (unsigned)ring.highWater(), (unsigned)ring.overflowBytes());
+}
+
+void printForwarderStats(Stream &out, OutputForwarder &fwd)
+{
+  printRingStats(out, fwd.name(), fwd.queue());
+  uint32_t packets = fwd.packets();
+  out.printf("%-12s %u writes, %u bytes, avg %u bytes/write, %u frames dropped\n", "", (unsigned)packets,
+             (unsigned)fwd.bytesWritten(), (unsigned)(packets ? fwd.bytesWritten() / packets : 0),
+             (unsigned)fwd.droppedFrames());
+}
+
+void printBackpressure(Stream &out, const char *name, OutputForwarder &fwd, const LinkCounters &counters)
+{
+  const OutputForwarder::Backpressure &bp = fwd.backpressure();
+  out.printf("%-6s %-6s high %u%%, low %u%%, dropped %u frames, %u bytes\n", name, OutputForwarder::policyName(bp.policy),
+             (unsigned)bp.highPercent, (unsigned)bp.lowPercent, (unsigned)fwd.droppedFrames(),
+             (unsigned)counters.drops.load());
+}
+
+NmeaFilter::Table *filterTable(MenuCLI::Args output, BridgeRouter::Output &index)
+{
+  if (output.equals("serial"))
   {
-    SerialBT.write(buffer, len);
-    Serial1.write(buffer, len);
-    break;
+    index = BridgeRouter::SerialOutput;
+    return &config.serial_filter;
   }
-  case SerialState::Menu:
+  if (output.equals("bt"))
   {
-    menuCLI.write(buffer, len);
-    while (Serial.available())
-    {
-      menuCLI.write((uint8_t)Serial.read());
-    }
-    break;
+    index = BridgeRouter::SerialBTOutput;
+    return &config.bt_filter;
   }
-  case SerialState::SerialBTForward:
+  return nullptr;
+}
+
+void printFilter(Stream &out, const char *name, const NmeaFilter::Table &table, NmeaFilter &filter)
+{
+  out.printf("%s: default %s, passed %u, dropped %u\n", name, table.defaultAction == NmeaFilter::Drop ? "drop" : "pass",
+             (unsigned)filter.passed(), (unsigned)filter.dropped());
+  for (const NmeaFilter::Rule &rule : table.rules)
   {
-    SerialBT.write(buffer, len);
-    Serial.println("ERROR: Serial does not own Serial1.");
-    break;
+    if (rule.key[0] == '\0')
+      continue;
+    if (rule.action == NmeaFilter::Decimate)
+      out.printf("  %-5s %u Hz\n", rule.key, (unsigned)rule.rateHz);
+    else
+      out.printf("  %-5s %s\n", rule.key, rule.action == NmeaFilter::Drop ? "drop" : "pass");
   }
+}
+
+void printUplink(Stream &out)
+{
+  out.printf("Uplink mode: %s\n", router.uplinkMode() == BridgeRouter::UplinkMode::Mux ? "mux" : "exclusive");
+  const char *names[BridgeRouter::INPUT_COUNT] = {"serial", "bt", "ble"};
+  for (int i = 0; i < BridgeRouter::INPUT_COUNT; ++i)
+  {
+    BridgeRouter::Input input = (BridgeRouter::Input)i;
+    out.printf("  %-6s priority %u, %u frames, %u lines, %u dropped, %u bytes queued\n", names[i],
+               (unsigned)router.priority(input), (unsigned)router.muxFrames(input),
+               (unsigned)router.uplinkFramer(input).lines(), (unsigned)router.muxDrops(input),
+               (unsigned)router.muxPending(input));
   }
 }
 
-void onSerialBTData(const uint8_t *buffer, size_t len)
+void printGnssCommand(Stream &out, const GnssCommandQueue::Command &command)
 {
-  if (stateMutex)
-    xSemaphoreTake(stateMutex, portMAX_DELAY);
-  lastActivity = millis();
-  SerialState currentState = serialState;
-  if (stateMutex)
-    xSemaphoreGive(stateMutex);
+  out.printf("gnss %s: %s", command.name, GnssCommandQueue::statusName(command.status));
+  if (command.status == GnssCommandQueue::Status::Failed && command.code >= 0)
+    out.printf(" (%d)", command.code);
+  if (command.tries > 1)
+    out.printf(", %u tries", (unsigned)command.tries);
+  if (command.doneAt)
+    out.printf(", %u ms", (unsigned)(command.doneAt - command.sentAt));
+  if (command.reply[0])
+    out.printf(", %s", command.reply);
+  out.println();
+}
 
-  static char firstLineBuf[4] = {0};
-  static size_t firstLineLen = 0;
+// Results arrive after the gnss command returned; outside the menu the
+// outputs carry NMEA, so they are only kept for the next "gnss"
+void onGnssResult(void *ctx, const GnssCommandQueue::Command &command)
+{
+  if (router.state() == BridgeRouter::State::Menu)
+    printGnssCommand(menuCLI.output(), command);
+}
 
-  switch (currentState)
-  {
-  case SerialState::Idle:
+// One capture file block per dump, small enough for the menu output queue
+void dumpCaptureBlock(Stream &out, size_t index)
+{
+  static uint8_t block[CaptureBlock::SIZE];
+  if (!trafficCapture.readBlock(index, block))
   {
-    size_t processed = 0;
-    while (firstLineLen < 4 && processed < len)
-    {
-      char c = buffer[processed++];
-      firstLineBuf[firstLineLen++] = c;
-      if (c != magicWord[firstLineLen - 1])
-      {
-        setState(SerialState::SerialBTForward);
-        firstLineLen = 0;
-        // Forward all data in SerialBTForward state
-        onSerialBTData(buffer, len);
-        return;
-      }
-      if (firstLineLen == 4)
-      {
-        SerialBT.println("\n[Menu mode entered]");
-        delay(10); // Give client time to process
-        menuCLI.begin();
-        setState(SerialState::Menu);
-        firstLineLen = 0;
-        if (processed < len)
-        {
-          onSerialBTData(buffer + processed, len - processed);
-        }
-        return;
-      }
-    }
-    // Not enough data yet to decide, wait for more
+    out.println("Cannot read capture block.");
     return;
   }
-  case SerialState::SerialBTForward:
+  out.printf("CAPTURE 1 %u %u\n", (unsigned)index, (unsigned)trafficCapture.blockCount());
+  for (size_t i = 0; i < sizeof(block); i += 64)
   {
-    Serial.write(buffer, len);
-    Serial1.write(buffer, len);
-    break;
+    out.print("B ");
+    for (size_t j = i; j < i + 64; ++j)
+      out.printf("%02x", block[j]);
+    out.println();
   }
-  case SerialState::Menu:
+  out.println("CAPTURE END");
+}
+
+// Hex-framed binary dump for tools/trace_decode.py. "R" lines carry trace
+// records, "H" lines the non-empty buckets of one path histogram.
+void dumpTrace(Stream &out)
+{
+  static LatencyTrace::Record records[LatencyTrace::RING_SIZE];
+  size_t count = latencyTrace.snapshot(records, LatencyTrace::RING_SIZE);
+  out.printf("TRACE 1 %u\n", (unsigned)count);
+  for (size_t i = 0; i < count; ++i)
   {
-    menuCLI.write(buffer, len);
-    while (SerialBT.available())
-    {
-      menuCLI.write((uint8_t)SerialBT.read());
-    }
-    break;
+    const LatencyTrace::Record &r = records[i];
+    if (i % 16 == 0)
+      out.print("R ");
+    out.printf("%02x%02x%02x%02x%02x%02x%02x%02x", (unsigned)(r.us & 0xFF), (unsigned)((r.us >> 8) & 0xFF),
+               (unsigned)((r.us >> 16) & 0xFF), (unsigned)(r.us >> 24), (unsigned)r.point, (unsigned)r.port,
+               (unsigned)(r.len & 0xFF), (unsigned)(r.len >> 8));
+    if (i % 16 == 15 || i + 1 == count)
+      out.println();
   }
-  case SerialState::SerialForward:
+  for (int src = 0; src < LatencyTrace::PORT_COUNT; ++src)
   {
-    Serial.write(buffer, len);
-    SerialBT.println("ERROR: SerialBT does not own Serial1.");
-    break;
-  }
+    for (int dst = 0; dst < LatencyTrace::PORT_COUNT; ++dst)
+    {
+      const LatencyTrace::Histogram &h = latencyTrace.histogram((LatencyTrace::Port)src, (LatencyTrace::Port)dst);
+      if (h.count.load() == 0)
+        continue;
+      out.printf("H %02x%02x%08x%08x", src, dst, (unsigned)h.count.load(), (unsigned)h.max.load());
+      for (size_t b = 0; b < LatencyTrace::Histogram::BUCKETS; ++b)
+      {
+        uint32_t n = h.buckets[b].load();
+        if (n)
+          out.printf("%02x%08x", (unsigned)b, (unsigned)n);
+      }
+      out.println();
+    }
   }
+  out.println("TRACE END");
 }
 
-void registerMenuCommands(MenuCLI *cli)
-{
-  cli->registerCommand("get baud serial1", "Show Serial1 baudrate", [](const String &args, Stream &out)
-                       {
-        out.print("Serial1 baudrate: ");
-        out.println(config.serial1_baud); });
+// Sorted by name; the table lives in flash and dispatch allocates nothing
+static constexpr MenuCLI::Command menuCommands[] = {
+    {"autobaud", "Serial1 baudrate detection. Usage: autobaud [on|off|run]", [](MenuCLI::Args args, Stream &out)
+     {
+        if (args.equals("run")) {
+            if (startSerial1Probe(out))
+                out.println("Serial1 auto-baud: probing, routing paused");
+            else
+                out.println("Serial1 auto-baud: already probing");
+            return;
+        }
+        if (args.equals("on") || args.equals("off")) {
+            config.serial1_autobaud = args.equals("on");
+            configManager.save();
+        } else if (!args.empty()) {
+            out.println("Usage: autobaud [on|off|run]");
+            return;
+        }
+        out.printf("Serial1 auto-baud at boot: %s\n", config.serial1_autobaud ? "on" : "off"); }},
 
-  cli->registerCommand("set baud serial1", "Set Serial1 baudrate. Usage: set baud serial1 <baudrate>", [](const String &args, Stream &out)
-                       {
-        long baud = args.toInt();
-        if (baud <= 0) {
-            out.println("Invalid baudrate. Usage: set baud serial1 <baudrate>");
+    {"backpressure", "Output overflow policy. Usage: backpressure [<serial|bt> <block|newest|oldest|latest> [<high%> <low%>]]", [](MenuCLI::Args args, Stream &out)
+     {
+        MenuCLI::Args output = args.nextWord();
+        if (!output.empty()) {
+            MenuCLI::Args policy = args.nextWord();
+            MenuCLI::Args highArg = args.nextWord();
+            MenuCLI::Args lowArg = args.nextWord();
+            bool serial = output.equals("serial");
+            OutputForwarder::Backpressure bp = serial ? config.serial_backpressure : config.bt_backpressure;
+            bool ok = serial || output.equals("bt");
+            if (policy.equals("block")) bp.policy = OutputForwarder::Block;
+            else if (policy.equals("newest")) bp.policy = OutputForwarder::DropNewest;
+            else if (policy.equals("oldest")) bp.policy = OutputForwarder::DropOldest;
+            else if (policy.equals("latest")) bp.policy = OutputForwarder::KeepLatest;
+            else ok = false;
+            if (!highArg.empty()) {
+                long high = highArg.toInt();
+                long low = lowArg.empty() ? -1 : lowArg.toInt();
+                ok = ok && high > 0 && high <= 100 && low >= 0 && low <= high;
+                bp.highPercent = high;
+                bp.lowPercent = low;
+            }
+            if (!ok) {
+                out.println("Invalid policy. Usage: backpressure <serial|bt> <block|newest|oldest|latest> [<high%> <low%>]");
+                return;
+            }
+            if (serial) {
+                serialOut.setBackpressure(bp);
+            } else {
+                // BLE clients share the bt downlink and its policy
+                serialBTOut.setBackpressure(bp);
+                bleOut.setBackpressure(bp);
+            }
+            (serial ? config.serial_backpressure : config.bt_backpressure) = bp;
+            configManager.save();
+        }
+        printBackpressure(out, "serial", serialOut, bridgeStats[BridgeStats::SerialTx]);
+        printBackpressure(out, "bt", serialBTOut, bridgeStats[BridgeStats::SerialBTTx]);
+        printBackpressure(out, "ble", bleOut, bridgeStats[BridgeStats::BLETx]); }},
+
+    {"buffers", "Show receive/transmit queue usage. Usage: buffers [reset]", [](MenuCLI::Args args, Stream &out)
+     {
+        if (args.equals("reset")) {
+            serialRx.resetStats();
+            serial1Rx.resetStats();
+            serialBTRx.resetStats();
+            bleRx.resetStats();
+            serialOut.resetStats();
+            serial1Out.resetStats();
+            serialBTOut.resetStats();
+            bleOut.resetStats();
+            packetPool.resetStats();
+            out.println("Buffer statistics reset.");
             return;
         }
-        config.serial1_baud = baud;
-        Serial1.updateBaudRate(baud);
-        out.print("Serial1 baudrate set to: ");
-        out.println(baud);
-        configManager.save(); });
+        printRingStats(out, "Serial", serialRx);
+        printRingStats(out, "Serial1", serial1Rx);
+        printRingStats(out, "SerialBT", serialBTRx);
+        printRingStats(out, "BLE", bleRx);
+        printForwarderStats(out, serialOut);
+        printForwarderStats(out, serial1Out);
+        printForwarderStats(out, serialBTOut);
+        printForwarderStats(out, bleOut);
+        out.printf("Packet pool: %u/%u free, low %u, exhausted %u\n", (unsigned)packetPool.available(),
+                   (unsigned)packetPool.count(), (unsigned)packetPool.lowWater(), (unsigned)packetPool.exhausted()); }},
+
+    {"capture", "Traffic capture to flash. Usage: capture [start [kb]|stop|reset|dump <block>]", [](MenuCLI::Args args, Stream &out)
+     {
+        MenuCLI::Args word = args.nextWord();
+        if (word.equals("start")) {
+            long kb = args.empty() ? (config.capture_kb ? config.capture_kb : 256) : args.toInt();
+            if (!trafficCapture.start(kb < 0 || kb > 0xFFFF ? 0 : (uint16_t)kb)) {
+                out.printf("Invalid size or no memory. Size: %u-%u KB\n", TrafficCapture::MIN_KB, TrafficCapture::MAX_KB);
+                return;
+            }
+            config.capture_kb = trafficCapture.sizeKb();
+            configManager.save();
+        } else if (word.equals("stop")) {
+            trafficCapture.stop();
+            config.capture_kb = 0;
+            configManager.save();
+        } else if (word.equals("reset")) {
+            trafficCapture.resetStats();
+        } else if (word.equals("dump") && !args.empty()) {
+            dumpCaptureBlock(out, args.toInt());
+            return;
+        } else if (!word.empty()) {
+            out.println("Usage: capture [start [kb]|stop|reset|dump <block>]");
+            return;
+        }
+        out.printf("Capture %s, %u KB in %u blocks\n",
+                   trafficCapture.active() ? "on" : trafficCapture.starting() ? "starting" : "off",
+                   (unsigned)trafficCapture.sizeKb(), (unsigned)trafficCapture.blockCount());
+        out.printf("Records: %u (%u bytes), blocks written: %u\n", (unsigned)trafficCapture.records(),
+                   (unsigned)trafficCapture.bytes(), (unsigned)trafficCapture.blocksWritten());
+        out.printf("Dropped: %u, truncated: %u, write errors: %u\n", (unsigned)trafficCapture.dropped(),
+                   (unsigned)trafficCapture.truncated(), (unsigned)trafficCapture.writeErrors()); }},
+
+    {"echo off", "Disable echo mode", [](MenuCLI::Args args, Stream &out)
+     {
+        menuCLI.setEcho(false);
+        out.println("Echo mode disabled."); }},
+
+    {"echo on", "Enable echo mode", [](MenuCLI::Args args, Stream &out)
+     {
+        menuCLI.setEcho(true);
+        out.println("Echo mode enabled."); }},
+
+    {"filter", "NMEA output filters. Usage: filter [<serial|bt> <TYPE|TTTYPE> <pass|drop|hz> | <serial|bt> default <pass|drop> | <serial|bt> remove <TYPE> | <serial|bt> clear]", [](MenuCLI::Args args, Stream &out)
+     {
+        MenuCLI::Args output = args.nextWord();
+        if (output.empty()) {
+            printFilter(out, "serial", config.serial_filter, router.filter(BridgeRouter::SerialOutput));
+            printFilter(out, "bt", config.bt_filter, router.filter(BridgeRouter::SerialBTOutput));
+            return;
+        }
+        BridgeRouter::Output index;
+        NmeaFilter::Table *table = filterTable(output, index);
+        MenuCLI::Args key = args.nextWord();
+        MenuCLI::Args value = args.nextWord();
+        char type[NmeaFilter::KEY_LEN + 1];
+        (key.equals("remove") ? value : key).copyTo(type, sizeof(type));
+        for (char *c = type; *c; ++c) *c = toupper(*c);
+        bool ok = table != nullptr;
+        if (ok && key.equals("clear")) {
+            NmeaFilter::clear(*table);
+        } else if (ok && key.equals("default") && (value.equals("pass") || value.equals("drop"))) {
+            table->defaultAction = value.equals("pass") ? NmeaFilter::Pass : NmeaFilter::Drop;
+        } else if (ok && key.equals("remove")) {
+            ok = NmeaFilter::removeRule(*table, type);
+        } else if (ok && value.equals("pass")) {
+            ok = NmeaFilter::setRule(*table, type, NmeaFilter::Pass);
+        } else if (ok && value.equals("drop")) {
+            ok = NmeaFilter::setRule(*table, type, NmeaFilter::Drop);
+        } else if (ok && value.toInt() > 0 && value.toInt() <= 50) {
+            ok = NmeaFilter::setRule(*table, type, NmeaFilter::Decimate, (uint8_t)value.toInt());
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            out.println("Invalid filter. Usage: filter <serial|bt> <TYPE|TTTYPE> <pass|drop|1-50 Hz>");
+            return;
+        }
+        router.filter(index).load(*table);
+        printFilter(out, index == BridgeRouter::SerialOutput ? "serial" : "bt", *table, router.filter(index));
+        configManager.save(); }},
 
-  cli->registerCommand("get baud serial", "Show Serial baudrate", [](const String &args, Stream &out)
-                       {
+    {"get baud serial", "Show Serial baudrate", [](MenuCLI::Args args, Stream &out)
+     {
         out.print("Serial baudrate: ");
-        out.println(Serial.baudRate()); });
+        out.println(Serial.baudRate()); }},
+
+    {"get baud serial1", "Show Serial1 baudrate", [](MenuCLI::Args args, Stream &out)
+     {
+        out.print("Serial1 baudrate: ");
+        out.println(config.serial1_baud); }},
+
+    {"get bt_name", "Show Bluetooth device name", [](MenuCLI::Args args, Stream &out)
+     {
+        out.print("Bluetooth device name: ");
+        out.println(config.bt_name); }},
+
+    {"get coalesce bt", "Show SerialBT write coalescing", [](MenuCLI::Args args, Stream &out)
+     {
+        out.print("SerialBT coalescing: ");
+        out.print(config.bt_coalesce_bytes);
+        out.print(" bytes, ");
+        out.print(config.bt_flush_ms);
+        out.println(" ms"); }},
+
+    {"gnss", "Receiver commands, replies matched from the NMEA stream. Usage: gnss [clear|reset|timeout <ms> <retries>|<PAIR.../PQTM...>[;<command>...]]", [](MenuCLI::Args args, Stream &out)
+     {
+        MenuCLI::Args rest = args;
+        MenuCLI::Args word = rest.nextWord();
+        if (word.equals("clear")) {
+            gnssCommands.clear();
+        } else if (word.equals("reset")) {
+            gnssCommands.resetStats();
+        } else if (word.equals("timeout")) {
+            long ms = rest.nextWord().toInt();
+            long retries = rest.toInt();
+            if (ms < 50 || ms > 60000 || retries < 0 || retries > 9) {
+                out.println("Invalid value. Usage: gnss timeout <50-60000 ms> <0-9 retries>");
+                return;
+            }
+            config.gnss_timeout_ms = ms;
+            config.gnss_retries = retries;
+            gnssCommands.setTimeout(ms);
+            gnssCommands.setRetries(retries);
+            configManager.save();
+        } else if (!args.empty()) {
+            // Queued at once; the router sends them back to back as replies come in
+            while (!args.empty()) {
+                const char *sep = (const char *)memchr(args.data, ';', args.len);
+                size_t len = sep ? sep - args.data : args.len;
+                if (len > 0 && !gnssCommands.push(args.data, len, millis()))
+                    out.printf("Not queued (invalid or queue full): %.*s\n", (int)len, args.data);
+                args.data += sep ? len + 1 : len;
+                args.len -= sep ? len + 1 : len;
+            }
+            out.printf("%u commands pending.\n", (unsigned)gnssCommands.pending());
+            return;
+        }
+        out.printf("Pending %u, sent %u, retried %u, failed %u; timeout %u ms, %u retries\n",
+                   (unsigned)gnssCommands.pending(), (unsigned)gnssCommands.sent(), (unsigned)gnssCommands.retried(),
+                   (unsigned)gnssCommands.failed(), (unsigned)gnssCommands.timeout(), (unsigned)gnssCommands.retries());
+        for (size_t i = 0; i < gnssCommands.size(); ++i)
+            printGnssCommand(out, gnssCommands.at(i)); }},
+
+    {"nmea", "Show Serial1 NMEA framing statistics. Usage: nmea [reset]", [](MenuCLI::Args args, Stream &out)
+     {
+        NmeaFramer &nmea = router.nmea();
+        if (args.equals("reset")) {
+            nmea.resetStats();
+            out.println("NMEA statistics reset.");
+            return;
+        }
+        out.printf("NMEA sentences %u, corrupt %u, junk bytes %u\n",
+                   (unsigned)nmea.sentences(), (unsigned)nmea.corrupt(), (unsigned)nmea.junkBytes()); }},
+
+    {"power", "CPU clock governor. Usage: power [auto|off|reset]", [](MenuCLI::Args args, Stream &out)
+     {
+        if (args.equals("auto") || args.equals("off")) {
+            config.power_policy = args.equals("auto") ? PowerGovernor::Auto : PowerGovernor::Off;
+            powerGovernor.setPolicy((PowerGovernor::Policy)config.power_policy);
+            configManager.save();
+        } else if (args.equals("reset")) {
+            powerGovernor.resetStats();
+        } else if (!args.empty()) {
+            out.println("Usage: power [auto|off|reset]");
+            return;
+        }
+        out.printf("Governor %s, mode %s, CPU %u MHz\n", powerGovernor.policy() == PowerGovernor::Auto ? "auto" : "off",
+                   PowerGovernor::name(powerGovernor.mode()), (unsigned)getCpuFrequencyMhz());
+        out.printf("Duty: burst %u%%, between %u%%, idle %u%%\n", powerGovernor.dutyPercent(PowerGovernor::Burst),
+                   powerGovernor.dutyPercent(PowerGovernor::Between), powerGovernor.dutyPercent(PowerGovernor::Idle));
+        out.printf("Traffic: %u bytes/s, burst every %u ms (jitter %u ms), lasting %u ms\n", (unsigned)powerGovernor.byteRate(),
+                   (unsigned)powerGovernor.burstPeriodMs(), (unsigned)powerGovernor.burstJitterMs(), (unsigned)powerGovernor.burstLengthMs()); }},
 
-  cli->registerCommand("set baud serial", "Set Serial baudrate. Usage: set baud serial <baudrate>", [](const String &args, Stream &out)
-                       {
+    {"rtcm", "SerialBT and BLE RTCM3 framing and correction scheduling. Usage: rtcm [reset|schedule <on|off>|window <bytes>]", [](MenuCLI::Args args, Stream &out)
+     {
+        Rtcm3Framer &rtcm = router.rtcm();
+        RtcmScheduler &corrections = router.corrections();
+        MenuCLI::Args word = args.nextWord();
+        if (word.equals("reset")) {
+            rtcm.resetStats();
+            router.bleRtcm().resetStats();
+            corrections.resetStats();
+            out.println("RTCM statistics reset.");
+            return;
+        } else if (word.equals("schedule") && (args.equals("on") || args.equals("off"))) {
+            config.rtcm_schedule = args.equals("on");
+            corrections.setEnabled(config.rtcm_schedule);
+            configManager.save();
+        } else if (word.equals("window")) {
+            long bytes = args.toInt();
+            if (bytes < (long)Rtcm3Framer::MAX_FRAME || bytes > TX_QUEUE_SIZE) {
+                out.printf("Invalid value. Window: %u-%u bytes\n", (unsigned)Rtcm3Framer::MAX_FRAME, (unsigned)TX_QUEUE_SIZE);
+                return;
+            }
+            config.rtcm_window = bytes;
+            corrections.setReserve(TX_QUEUE_SIZE - bytes);
+            configManager.save();
+        } else if (!word.empty()) {
+            out.println("Usage: rtcm [reset|schedule <on|off>|window <bytes>]");
+            return;
+        }
+        out.printf("RTCM frames %u, CRC errors %u, junk bytes %u\n",
+                   (unsigned)rtcm.frames(), (unsigned)rtcm.crcErrors(), (unsigned)rtcm.junkBytes());
+        Rtcm3Framer &bleRtcm = router.bleRtcm();
+        out.printf("BLE RTCM frames %u, CRC errors %u, junk bytes %u\n",
+                   (unsigned)bleRtcm.frames(), (unsigned)bleRtcm.crcErrors(), (unsigned)bleRtcm.junkBytes());
+        for (size_t i = 0; i < rtcm.typeCount(); ++i) {
+            const Rtcm3Framer::TypeCount &t = rtcm.typeAt(i);
+            out.printf("  %4u: %u\n", (unsigned)t.type, (unsigned)t.count);
+        }
+        out.printf("Scheduler %s, window %u bytes, %u frames (%u bytes) waiting, %u cleared\n",
+                   corrections.enabled() ? "on" : "off", (unsigned)config.rtcm_window, (unsigned)corrections.frames(),
+                   (unsigned)corrections.bytes(), (unsigned)corrections.cleared());
+        for (size_t i = 0; i < corrections.typeCount(); ++i) {
+            const RtcmScheduler::TypeStats &t = corrections.typeAt(i);
+            out.printf("  %4u %-11s sent %u, superseded %u, duplicate %u, overflow %u\n", (unsigned)t.type,
+                       RtcmScheduler::className(RtcmScheduler::classify(t.type)), (unsigned)t.sent,
+                       (unsigned)t.superseded, (unsigned)t.duplicates, (unsigned)t.overflows);
+        } }},
+
+    {"set baud serial", "Set Serial baudrate. Usage: set baud serial <baudrate>", [](MenuCLI::Args args, Stream &out)
+     {
         long baud = args.toInt();
         if (baud <= 0) {
             out.println("Invalid baudrate. Usage: set baud serial <baudrate>");
@@ -262,42 +790,141 @@ void registerMenuCommands(MenuCLI *cli)
         Serial.updateBaudRate(baud);
         out.print("Serial baudrate set to: ");
         out.println(baud);
-        configManager.save(); });
+        configManager.save(); }},
 
-  cli->registerCommand("get bt_name", "Show Bluetooth device name", [](const String &args, Stream &out)
-                       {
-        out.print("Bluetooth device name: ");
-        out.println(config.bt_name); });
+    {"set baud serial1", "Set Serial1 baudrate. Usage: set baud serial1 <baudrate>", [](MenuCLI::Args args, Stream &out)
+     {
+        long baud = args.toInt();
+        if (baud <= 0) {
+            out.println("Invalid baudrate. Usage: set baud serial1 <baudrate>");
+            return;
+        }
+        config.serial1_baud = baud;
+        Serial1.updateBaudRate(baud);
+        out.print("Serial1 baudrate set to: ");
+        out.println(baud);
+        configManager.save(); }},
 
-  cli->registerCommand("set bt_name", "Set Bluetooth device name. Usage: set bt_name <name>", [](const String &args, Stream &out)
-                       {
-        String name = args;
-        name.trim();
-        if (name.length() == 0 || name.length() >= sizeof(config.bt_name)) {
+    {"set bt_name", "Set Bluetooth device name. Usage: set bt_name <name>", [](MenuCLI::Args args, Stream &out)
+     {
+        if (args.empty() || args.len >= sizeof(config.bt_name)) {
             out.println("Invalid name. Usage: set bt_name <name>");
             return;
         }
-        name.toCharArray(config.bt_name, sizeof(config.bt_name));
+        args.copyTo(config.bt_name, sizeof(config.bt_name));
         out.print("Bluetooth device name set to: ");
         out.println(config.bt_name);
         configManager.save();
+        configManager.flush();
         out.println("Restarting ESP32 to apply new name...");
+        out.flush();
         delay(100); // Allow message to be sent
-        ESP.restart(); });
+        ESP.restart(); }},
 
-  cli->registerCommand("echo on", "Enable echo mode", [](const String &args, Stream &out)
-                       {
-        menuCLI.setEcho(true);
-        out.println("Echo mode enabled."); });
+    {"set coalesce bt", "Set SerialBT write coalescing. Usage: set coalesce bt <bytes> <ms>", [](MenuCLI::Args args, Stream &out)
+     {
+        long bytes = args.nextWord().toInt();
+        MenuCLI::Args msArg = args.nextWord();
+        long ms = msArg.empty() ? -1 : msArg.toInt();
+        if (bytes < 0 || bytes > (long)OutputForwarder::MAX_COALESCE_BYTES || ms < 0) {
+            out.println("Invalid value. Usage: set coalesce bt <bytes> <ms>");
+            return;
+        }
+        config.bt_coalesce_bytes = bytes;
+        config.bt_flush_ms = ms;
+        serialBTOut.setCoalescing(bytes, ms);
+        bleOut.setCoalescing(bytes, ms);
+        out.print("SerialBT coalescing set to: ");
+        out.print(bytes);
+        out.print(" bytes, ");
+        out.print(ms);
+        out.println(" ms");
+        configManager.save(); }},
 
-  cli->registerCommand("echo off", "Disable echo mode", [](const String &args, Stream &out)
-                       {
-        menuCLI.setEcho(false);
-        out.println("Echo mode disabled."); });
+    {"stats", "Show bridge traffic counters. Usage: stats [reset]", [](MenuCLI::Args args, Stream &out)
+     {
+        if (args.equals("reset")) {
+            bridgeStats.reset();
+            out.println("Traffic statistics reset.");
+            return;
+        }
+        out.println("Link         bytes      chunks   drops  trunc  maxq  stalls stall_ms");
+        for (int i = 0; i < BridgeStats::LINK_COUNT; ++i) {
+            const LinkCounters &c = bridgeStats[(BridgeStats::Link)i];
+            out.printf("%-11s %10u %8u %7u %6u %5u %6u %8u\n", BridgeStats::name((BridgeStats::Link)i),
+                       (unsigned)c.bytes.load(), (unsigned)c.chunks.load(), (unsigned)c.drops.load(),
+                       (unsigned)c.truncated.load(), (unsigned)c.maxDepth.load(), (unsigned)c.stalls.load(),
+                       (unsigned)(c.stallUs.load() / 1000));
+        } }},
+
+    {"trace", "Latency tracing. Usage: trace [on|off|reset|dump]", [](MenuCLI::Args args, Stream &out)
+     {
+        if (args.equals("on") || args.equals("off")) {
+            latencyTrace.setEnabled(args.equals("on"));
+        } else if (args.equals("reset")) {
+            latencyTrace.reset();
+        } else if (args.equals("dump")) {
+            dumpTrace(out);
+            return;
+        } else if (!args.empty()) {
+            out.println("Usage: trace [on|off|reset|dump]");
+            return;
+        }
+        out.printf("Tracing %s\n", latencyTrace.enabled() ? "on" : "off");
+        for (int src = 0; src < LatencyTrace::PORT_COUNT; ++src) {
+            for (int dst = 0; dst < LatencyTrace::PORT_COUNT; ++dst) {
+                const LatencyTrace::Histogram &h = latencyTrace.histogram((LatencyTrace::Port)src, (LatencyTrace::Port)dst);
+                if (h.count.load() == 0)
+                    continue;
+                out.printf("%-8s -> %-8s %8u  p50 %6u us  p99 %6u us  max %6u us\n",
+                           LatencyTrace::name((LatencyTrace::Port)src), LatencyTrace::name((LatencyTrace::Port)dst),
+                           (unsigned)h.count.load(), (unsigned)h.percentile(50), (unsigned)h.percentile(99),
+                           (unsigned)h.max.load());
+            }
+        } }},
+
+    {"uplink", "Serial1 uplink sharing. Usage: uplink [exclusive|mux | priority <serial|bt> <0-9>]", [](MenuCLI::Args args, Stream &out)
+     {
+        MenuCLI::Args word = args.nextWord();
+        if (word.equals("exclusive") || word.equals("mux")) {
+            BridgeRouter::UplinkMode mode = word.equals("mux") ? BridgeRouter::UplinkMode::Mux : BridgeRouter::UplinkMode::Exclusive;
+            config.uplink_mode = (uint8_t)mode;
+            router.setUplinkMode(mode);
+            configManager.save();
+        } else if (word.equals("priority")) {
+            MenuCLI::Args input = args.nextWord();
+            MenuCLI::Args value = args.nextWord();
+            long priority = value.empty() ? -1 : value.toInt();
+            if ((!input.equals("serial") && !input.equals("bt")) || priority < 0 || priority > 9) {
+                out.println("Invalid priority. Usage: uplink priority <serial|bt> <0-9>");
+                return;
+            }
+            if (input.equals("serial")) {
+                config.serial_priority = priority;
+                router.setPriority(BridgeRouter::SerialInput, priority);
+            } else {
+                config.bt_priority = priority; // SPP and BLE
+                router.setPriority(BridgeRouter::SerialBTInput, priority);
+                router.setPriority(BridgeRouter::BLEInput, priority);
+            }
+            configManager.save();
+        } else if (!word.empty()) {
+            out.println("Usage: uplink [exclusive|mux | priority <serial|bt> <0-9>]");
+            return;
+        }
+        printUplink(out); }},
+};
+
+static_assert(MenuCLI::isSorted(menuCommands, sizeof(menuCommands) / sizeof(menuCommands[0])), "menuCommands must be sorted by name");
+
+void registerMenuCommands(MenuCLI *cli)
+{
+  cli->setCommandTable(menuCommands);
 }
 
 void setup()
 {
+  configManager.setLegacy(sizeof(LegacyConfig), migrateConfig);
   bool loaded = configManager.begin(&config);
   if (loaded)
   {
@@ -311,47 +938,94 @@ void setup()
       Serial.println("Config CRC mismatch or uninitialized, using defaults.");
     }
 
-    menuCLI.attachOutput(&Serial);
-    menuCLI.attachOutput(&SerialBT);
+    serialOut.begin(TX_QUEUE_SIZE, 1);
+    serial1Out.begin(TX_QUEUE_SIZE, 1);
+    serialBTOut.begin(TX_QUEUE_SIZE, 0);
+    bleOut.begin(TX_QUEUE_SIZE, 0);
+    serialOut.setCounters(&bridgeStats[BridgeStats::SerialTx]);
+    serial1Out.setCounters(&bridgeStats[BridgeStats::Serial1Tx]);
+    serialBTOut.setCounters(&bridgeStats[BridgeStats::SerialBTTx]);
+    bleOut.setCounters(&bridgeStats[BridgeStats::BLETx]);
+    serialOut.setTracePort(LatencyTrace::SerialPort);
+    serial1Out.setTracePort(LatencyTrace::Serial1Port);
+    serialBTOut.setTracePort(LatencyTrace::SerialBTPort);
+    bleOut.setTracePort(LatencyTrace::BLEPort);
+    serialBTOut.setCoalescing(config.bt_coalesce_bytes, config.bt_flush_ms);
+    bleOut.setCoalescing(config.bt_coalesce_bytes, config.bt_flush_ms);
+    serialOut.setBackpressure(config.serial_backpressure);
+    serialBTOut.setBackpressure(config.bt_backpressure);
+    bleOut.setBackpressure(config.bt_backpressure);
+    serialOut.setDelimiter('\n');
+    serialBTOut.setDelimiter('\n');
+    bleOut.setDelimiter('\n');
+    router.filter(BridgeRouter::SerialOutput).load(config.serial_filter);
+    router.filter(BridgeRouter::SerialBTOutput).load(config.bt_filter);
+    router.setPriority(BridgeRouter::SerialInput, config.serial_priority);
+    router.setPriority(BridgeRouter::SerialBTInput, config.bt_priority);
+    router.setPriority(BridgeRouter::BLEInput, config.bt_priority);
+    router.setUplinkMode((BridgeRouter::UplinkMode)config.uplink_mode);
+    powerGovernor.setPolicy((PowerGovernor::Policy)config.power_policy);
+    gnssCommands.setTimeout(config.gnss_timeout_ms);
+    gnssCommands.setRetries(config.gnss_retries);
+    gnssCommands.setHandler(onGnssResult, nullptr);
+    router.corrections().setEnabled(config.rtcm_schedule);
+    router.corrections().setReserve(TX_QUEUE_SIZE - config.rtcm_window);
+
+    menuCLI.attachOutput(&serialOut);
+    menuCLI.attachOutput(&serialBTOut);
+    menuCLI.attachOutput(&bleOut);
+    configManager.setCommitDelay(CONFIG_COMMIT_DELAY_MS);
     menuCLI.setOnExit([]()
-                      { setState(SerialState::Idle); });
+                      {
+        configManager.flush();
+        router.setState(BridgeRouter::State::Idle); });
 
     pinMode(LED_PIN, OUTPUT);
     digitalWrite(LED_PIN, LOW);
 
     // Start BLE battery task
     startBLEBatteryTask(config.bt_name);
+    bleBattery.setServiceCallbacks(&bleUart);
+    bleUart.onData(onBleUartReceive);
+    bleUart.begin(bleBattery.server());
 
     registerMenuCommands(&menuCLI);
 
-    stateMutex = xSemaphoreCreateMutex();
+    if (packetPool.begin(PACKET_COUNT, PACKET_SIZE))
+      router.setPacketPool(&packetPool);
+    router.setCommandQueue(&gnssCommands);
+    router.begin();
+
+    serialRx.begin(rxRingSize(config.serial_baud));
+    serial1Rx.begin(rxRingSize(config.serial1_baud));
+    serialBTRx.begin(rxRingSize(config.serial1_baud));
+    bleRx.begin(rxRingSize(config.serial1_baud));
+    xTaskCreatePinnedToCore(routerTask, "Router Task", 4096, NULL, 3, &routerTaskHandle, 1);
+    if (config.capture_kb)
+      trafficCapture.start(config.capture_kb);
 
-    // Inline lambdas for buffer handling
+    // Receive callbacks only drain the UART into the rings
     Serial.onReceive([]()
                      {
         static uint8_t buffer[BUFFER_SIZE] = {0};
+        digitalWrite(LED_PIN, HIGH); // Turn LED on
         while (Serial.available()) {
-            digitalWrite(LED_PIN, HIGH); // Turn LED on
-            size_t len = Serial.readBytes(buffer, BUFFER_SIZE);
-            if (len > 0) {
-                onSerialData(buffer, len); // updated here
+            size_t len = Serial.read(buffer, BUFFER_SIZE);
+            if (len == BUFFER_SIZE) {
+                bridgeStats[BridgeStats::SerialRx].truncate();
             }
-            digitalWrite(LED_PIN, LOW); // Turn LED off after processing
-        } }, false);
-
-    Serial1.onReceive([]()
-                      {
-        static uint8_t buffer[BUFFER_SIZE] = {0};
-        while (Serial1.available()) {
-            digitalWrite(LED_PIN, HIGH); // Turn LED on
-            size_t len = Serial1.readBytes(buffer, BUFFER_SIZE);
             if (len > 0) {
-                onSerial1Data(buffer, len);
+                receive(serialRx, bridgeStats[BridgeStats::SerialRx], LatencyTrace::SerialPort, buffer, len);
             }
-            digitalWrite(LED_PIN, LOW); // Turn LED off after processing
-        } }, false);
+        }
+        digitalWrite(LED_PIN, LOW); // Turn LED off after processing
+        notifyRouter(); }, false);
+
+    Serial1.onReceive(onSerial1Receive, false);
+    if (config.serial1_autobaud)
+      startSerial1Probe(serialOut);
 
-    SerialBT.onData(onSerialBTData);
+    SerialBT.onData(onSerialBTReceive);
 
     SerialBT.begin(config.bt_name);
     Serial.printf("The device with name \"%s\" is started.\nNow you can pair it with Bluetooth!\n", config.bt_name);
@@ -360,5 +1034,6 @@ void setup()
 
 void loop()
 {
-  checkOwnerTimeout();
+  // Everything runs in its own task; owner timeouts come from a timer
+  vTaskDelete(NULL);
 }
\ No newline at end of file
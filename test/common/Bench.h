@@ -0,0 +1,54 @@
+#pragma once
+// Timing helpers for the host benchmarks
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace bench {
+
+inline uint64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Per-call latency samples, reported as percentiles
+class Latency {
+public:
+    void reserve(size_t n) { _samples.reserve(n); }
+    void add(uint64_t ns)
+    {
+        _samples.push_back(ns);
+        _sorted = false;
+    }
+    size_t count() const { return _samples.size(); }
+    uint64_t percentile(double p)
+    {
+        if (_samples.empty()) return 0;
+        if (!_sorted)
+        {
+            std::sort(_samples.begin(), _samples.end());
+            _sorted = true;
+        }
+        size_t i = (size_t)(p / 100.0 * (_samples.size() - 1) + 0.5);
+        return _samples[i];
+    }
+    // "p50 1.2 us, p99 3.4 us, max 20.1 us"
+    const char* summary()
+    {
+        snprintf(_text, sizeof(_text), "p50 %.2f us, p90 %.2f us, p99 %.2f us, max %.2f us", percentile(50) / 1e3,
+                 percentile(90) / 1e3, percentile(99) / 1e3, percentile(100) / 1e3);
+        return _text;
+    }
+
+private:
+    std::vector<uint64_t> _samples;
+    bool _sorted = false;
+    char _text[128];
+};
+
+inline double megabytesPerSecond(uint64_t bytes, uint64_t ns) { return ns ? bytes * 1e3 / ns : 0; }
+
+} // namespace bench
@@ -0,0 +1,134 @@
+#pragma once
+// Synthetic receiver and correction traffic for the host tests
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "NmeaFramer.h"
+#include "Rtcm3Framer.h"
+
+namespace gnss {
+
+// "$<body>*hh\r\n"
+inline std::string sentence(const std::string& body)
+{
+    char tail[6];
+    snprintf(tail, sizeof(tail), "*%02X\r\n", NmeaFramer::checksum(body.data(), body.size()));
+    return "$" + body + tail;
+}
+
+// One fix epoch as an LC29H-class receiver prints it: GGA, RMC, one GSA per
+// constellation, GSV groups of four satellites per part, VTG and GLL
+inline std::string epoch(unsigned index, unsigned constellations = 4, unsigned satellitesEach = 10)
+{
+    static const char* talkers[] = {"GP", "GL", "GA", "GB", "GQ"};
+    char body[128];
+    unsigned hh = index / 36000 % 24, mm = index / 600 % 60, ss = index / 10 % 60, cs = index % 10 * 10;
+    std::string out;
+    snprintf(body, sizeof(body), "GNGGA,%02u%02u%02u.%02u,5231.1234%u,N,01323.4567%u,E,4,%02u,0.6,35.%u,M,39.8,M,1.0,0000",
+             hh, mm, ss, cs, index % 10, index % 7, constellations * satellitesEach % 100, index % 10);
+    out += sentence(body);
+    snprintf(body, sizeof(body), "GNRMC,%02u%02u%02u.%02u,A,5231.1234%u,N,01323.4567%u,E,0.01,%u.0,161026,,,R,V",
+             hh, mm, ss, cs, index % 10, index % 7, index % 360);
+    out += sentence(body);
+    for (unsigned c = 0; c < constellations; ++c)
+    {
+        snprintf(body, sizeof(body), "GNGSA,A,3,%02u,%02u,%02u,%02u,%02u,%02u,,,,,,,1.1,0.6,0.9,%u", 1 + c, 5 + c, 9 + c,
+                 13 + c, 17 + c, 21 + c, c + 1);
+        out += sentence(body);
+        unsigned parts = (satellitesEach + 3) / 4;
+        for (unsigned part = 1; part <= parts; ++part)
+        {
+            int n = snprintf(body, sizeof(body), "%sGSV,%u,%u,%02u", talkers[c % 5], parts, part, satellitesEach);
+            for (unsigned s = (part - 1) * 4; s < part * 4 && s < satellitesEach; ++s)
+                n += snprintf(body + n, sizeof(body) - n, ",%02u,%02u,%03u,%02u", s + 1, (s * 7 + index) % 90,
+                              (s * 37) % 360, 20 + (s + index) % 30);
+            snprintf(body + n, sizeof(body) - n, ",1");
+            out += sentence(body);
+        }
+    }
+    snprintf(body, sizeof(body), "GNVTG,%u.0,T,,M,0.01,N,0.02,K,R", index % 360);
+    out += sentence(body);
+    snprintf(body, sizeof(body), "GNGLL,5231.1234%u,N,01323.4567%u,E,%02u%02u%02u.%02u,A,R", index % 10, index % 7, hh,
+             mm, ss, cs);
+    out += sentence(body);
+    return out;
+}
+
+// Whole epochs back to back, at least bytes long
+inline std::string nmeaStream(size_t bytes, unsigned constellations = 4)
+{
+    std::string out;
+    for (unsigned i = 0; out.size() < bytes; ++i)
+        out += epoch(i, constellations);
+    return out;
+}
+
+// Writes value into count bits of a big-endian bit field
+inline void setBits(uint8_t* data, size_t pos, size_t count, uint32_t value)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint8_t mask = 0x80 >> ((pos + i) % 8);
+        if ((value >> (count - 1 - i)) & 1)
+            data[(pos + i) / 8] |= mask;
+        else
+            data[(pos + i) / 8] &= ~mask;
+    }
+}
+
+// A CRC-valid RTCM 3 frame. Observations carry the station id, epoch time
+// and multiple message bit where RtcmScheduler looks for them.
+inline std::vector<uint8_t> rtcmFrame(uint16_t type, size_t payloadLen, uint16_t station = 0, bool more = false,
+                                      uint8_t fill = 0, uint32_t epochTime = 0)
+{
+    if (payloadLen < 8) payloadLen = 8;
+    std::vector<uint8_t> frame(Rtcm3Framer::HEADER_LEN + payloadLen + Rtcm3Framer::CRC_LEN);
+    frame[0] = Rtcm3Framer::PREAMBLE;
+    frame[1] = (payloadLen >> 8) & 0x03;
+    frame[2] = payloadLen & 0xFF;
+    uint8_t* payload = frame.data() + Rtcm3Framer::HEADER_LEN;
+    for (size_t i = 0; i < payloadLen; ++i)
+        payload[i] = (uint8_t)(fill + i * 31);
+    // Type (12 bits), station (12 bits)
+    payload[0] = type >> 4;
+    payload[1] = (uint8_t)((type & 0x0F) << 4) | ((station >> 8) & 0x0F);
+    payload[2] = station & 0xFF;
+    // Epoch time from bit 24, then the multiple message bit: bit 54 for MSM,
+    // 51 for legacy GLONASS observations
+    size_t mmb = type >= 1009 && type <= 1012 ? 51 : 54;
+    if ((type >= 1001 && type <= 1012) || (type >= 1071 && type <= 1137))
+    {
+        setBits(payload, 24, mmb - 24, epochTime);
+        setBits(payload, mmb, 1, more);
+    }
+    uint32_t crc = Rtcm3Framer::crc24q(frame.data(), Rtcm3Framer::HEADER_LEN + payloadLen);
+    uint8_t* tail = payload + payloadLen;
+    tail[0] = crc >> 16;
+    tail[1] = crc >> 8;
+    tail[2] = crc;
+    return frame;
+}
+
+// One second of base station corrections: an MSM7 epoch for four
+// constellations, then station coordinates and GLONASS biases. The epoch
+// time counts seconds by fill.
+inline std::vector<uint8_t> rtcmEpoch(uint8_t fill = 0)
+{
+    static const uint16_t msm7[] = {1077, 1087, 1097, 1127};
+    std::vector<uint8_t> out;
+    for (size_t i = 0; i < 4; ++i)
+    {
+        std::vector<uint8_t> frame = rtcmFrame(msm7[i], 420 + 40 * i, 0, i < 3, fill + i, fill * 1000u);
+        out.insert(out.end(), frame.begin(), frame.end());
+    }
+    for (uint16_t type : {1005, 1230})
+    {
+        std::vector<uint8_t> frame = rtcmFrame(type, type == 1005 ? 19 : 12, 0, false, fill);
+        out.insert(out.end(), frame.begin(), frame.end());
+    }
+    return out;
+}
+
+} // namespace gnss
@@ -0,0 +1,10 @@
+#pragma once
+// Host stand-ins for the parts of the Arduino-ESP32 core the libraries use,
+// so lib/ builds and runs under PlatformIO's native platform. Header only:
+// the native env only needs this directory on the include path.
+#include "esp32-hal.h"
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+#include "Esp.h"
+#include "HardwareSerial.h"
@@ -0,0 +1,66 @@
+#pragma once
+#include <functional>
+#include <mutex>
+#include <string>
+#include "Arduino.h"
+
+#define CONFIG_BT_ENABLED 1
+#define CONFIG_BLUEDROID_ENABLED 1
+#define CONFIG_BT_SPP_ENABLED 1
+
+typedef std::function<void(const uint8_t* buffer, size_t size)> BluetoothSerialDataCb;
+
+// SPP stand-in: inject() delivers data through the onData callback as the
+// Bluedroid task would, tx() holds what was written
+class BluetoothSerial : public Stream {
+public:
+    bool begin(String localName = String(), bool isMaster = false)
+    {
+        _name = localName;
+        return true;
+    }
+    void end() {}
+    void onData(BluetoothSerialDataCb callback) { _onData = callback; }
+    bool hasClient() { return connected; }
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tx.append((const char*)buffer, size);
+        return size;
+    }
+    using Print::write;
+    int availableForWrite() override { return txRoom; }
+
+    // Test side
+    void inject(const uint8_t* data, size_t len)
+    {
+        if (_onData) _onData(data, len);
+    }
+    void inject(const char* text) { inject((const uint8_t*)text, strlen(text)); }
+    std::string tx()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _tx;
+    }
+    std::string takeTx()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::string out;
+        out.swap(_tx);
+        return out;
+    }
+
+    bool connected = true;
+    int txRoom = 990;
+
+private:
+    std::mutex _mutex;
+    std::string _tx;
+    String _name;
+    BluetoothSerialDataCb _onData;
+};
@@ -0,0 +1,83 @@
+#pragma once
+#include <string.h>
+#include <vector>
+#include "Arduino.h"
+
+// In-memory EEPROM with the arduino-esp32 semantics that matter for flash
+// wear: the whole region is one NVS blob, begin() resizes it keeping the
+// contents, and commit() rewrites all of it, but only when a byte changed.
+class EEPROMClass {
+public:
+    bool begin(size_t size)
+    {
+        if (size == 0) return false;
+        _flash.resize(size, 0xFF);
+        _data = _flash;
+        _dirty = false;
+        _begins++;
+        return true;
+    }
+    void end() { _data.clear(); }
+    uint8_t read(int address) { return (size_t)address < _data.size() ? _data[address] : 0; }
+    void write(int address, uint8_t value)
+    {
+        if ((size_t)address >= _data.size() || _data[address] == value) return;
+        _data[address] = value;
+        _dirty = true;
+    }
+    bool commit()
+    {
+        if (!_dirty) return true;
+        _flash = _data;
+        _dirty = false;
+        _commits++;
+        _bytesWritten += _flash.size();
+        return true;
+    }
+    size_t length() { return _data.size(); }
+    template <class T>
+    T& get(int address, T& t)
+    {
+        for (size_t i = 0; i < sizeof(T); ++i) ((uint8_t*)&t)[i] = read(address + i);
+        return t;
+    }
+    template <class T>
+    const T& put(int address, const T& t)
+    {
+        for (size_t i = 0; i < sizeof(T); ++i) write(address + i, ((const uint8_t*)&t)[i]);
+        return t;
+    }
+
+    // Test side: what survives a reboot, and how often it was rewritten
+    std::vector<uint8_t>& flash() { return _flash; }
+    void reboot()
+    {
+        _data.clear();
+        _dirty = false;
+    }
+    void erase()
+    {
+        _flash.clear();
+        _data.clear();
+        resetCounters();
+    }
+    void resetCounters()
+    {
+        _commits = 0;
+        _begins = 0;
+        _bytesWritten = 0;
+    }
+    uint32_t commits() const { return _commits; }
+    uint32_t begins() const { return _begins; }
+    size_t bytesWritten() const { return _bytesWritten; }
+
+private:
+    std::vector<uint8_t> _flash;
+    std::vector<uint8_t> _data;
+    bool _dirty = false;
+    uint32_t _commits = 0;
+    uint32_t _begins = 0;
+    size_t _bytesWritten = 0;
+};
+
+inline EEPROMClass EEPROM;
@@ -0,0 +1,13 @@
+#pragma once
+#include <stdint.h>
+#include "esp32-hal.h"
+
+struct EspClass {
+    void restart() {}
+    uint32_t getFreeHeap() { return 256 * 1024; }
+    uint32_t getMinFreeHeap() { return 192 * 1024; }
+    uint32_t getCpuFreqMHz() { return 240; }
+    uint32_t getCycleCount() { return (uint32_t)(shim::nowUs() * 240); }
+};
+
+inline EspClass ESP;
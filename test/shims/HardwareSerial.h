@@ -0,0 +1,108 @@
+#pragma once
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include "esp32-hal.h"
+#include "Stream.h"
+
+#define SERIAL_8N1 0x800001c
+
+// UART stand-in. Tests inject received bytes with inject(), which also runs
+// the onReceive callback, and read back what was written from tx().
+// txRoom limits availableForWrite() to model a slow or full link.
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1)
+    {
+        _baud = baud;
+        _begun = true;
+    }
+    void end() { _begun = false; }
+    void updateBaudRate(unsigned long baud) { _baud = baud; }
+    uint32_t baudRate() { return _baud; }
+    bool setRxBufferSize(size_t size)
+    {
+        _rxBufferSize = size;
+        return true;
+    }
+    size_t rxBufferSize() const { return _rxBufferSize; }
+    void onReceive(std::function<void()> callback, bool onlyOnTimeout = false) { _onReceive = callback; }
+    operator bool() const { return _begun; }
+
+    int available() override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _rx.size();
+    }
+    int read() override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_rx.empty()) return -1;
+        int c = _rx.front();
+        _rx.pop_front();
+        return c;
+    }
+    int peek() override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _rx.empty() ? -1 : _rx.front();
+    }
+    size_t read(uint8_t* buffer, size_t size)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        size_t n = 0;
+        while (n < size && !_rx.empty())
+        {
+            buffer[n++] = _rx.front();
+            _rx.pop_front();
+        }
+        return n;
+    }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tx.append((const char*)buffer, size);
+        return size;
+    }
+    using Print::write;
+    int availableForWrite() override { return txRoom; }
+
+    // Test side
+    void inject(const uint8_t* data, size_t len)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _rx.insert(_rx.end(), data, data + len);
+        }
+        if (_onReceive) _onReceive();
+    }
+    void inject(const char* text) { inject((const uint8_t*)text, strlen(text)); }
+    std::string tx()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _tx;
+    }
+    std::string takeTx()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::string out;
+        out.swap(_tx);
+        return out;
+    }
+
+    int txRoom = 128;
+
+private:
+    std::mutex _mutex;
+    std::deque<uint8_t> _rx;
+    std::string _tx;
+    std::function<void()> _onReceive;
+    unsigned long _baud = 0;
+    size_t _rxBufferSize = 256;
+    bool _begun = false;
+};
+
+inline HardwareSerial Serial;
+inline HardwareSerial Serial1;
@@ -0,0 +1,81 @@
+#pragma once
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp32-hal.h"
+#include "WString.h"
+
+class Print {
+public:
+    virtual ~Print() = default;
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size)
+    {
+        size_t n = 0;
+        while (size--)
+        {
+            if (!write(*buffer++)) break;
+            n++;
+        }
+        return n;
+    }
+    size_t write(const char* s) { return s ? write((const uint8_t*)s, strlen(s)) : 0; }
+    size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() {}
+
+    size_t print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+    size_t print(const char* s) { return write(s); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char v, int base = DEC) { return printNumber(v, base); }
+    size_t print(int v, int base = DEC) { return printSigned(v, base); }
+    size_t print(unsigned v, int base = DEC) { return printNumber(v, base); }
+    size_t print(long v, int base = DEC) { return printSigned(v, base); }
+    size_t print(unsigned long v, int base = DEC) { return printNumber(v, base); }
+    size_t print(long long v, int base = DEC) { return printSigned(v, base); }
+    size_t print(unsigned long long v, int base = DEC) { return printNumber(v, base); }
+    size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+
+    size_t println() { return write("\r\n"); }
+    template <class T>
+    size_t println(const T& v) { return print(v) + println(); }
+    template <class T>
+    size_t println(const T& v, int format) { return print(v, format) + println(); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        char small[128];
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(small, sizeof(small), format, args);
+        va_end(args);
+        if (n < 0) return 0;
+        if ((size_t)n < sizeof(small)) return write((const uint8_t*)small, n);
+        std::string big(n + 1, '\0');
+        va_start(args, format);
+        vsnprintf(&big[0], big.size(), format, args);
+        va_end(args);
+        return write((const uint8_t*)big.data(), n);
+    }
+
+private:
+    size_t printNumber(unsigned long long v, int base)
+    {
+        if (base < 2) base = DEC;
+        char buf[65];
+        char* p = buf + sizeof(buf);
+        do
+        {
+            int digit = v % base;
+            *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+            v /= base;
+        } while (v);
+        return write((const uint8_t*)p, buf + sizeof(buf) - p);
+    }
+    size_t printSigned(long long v, int base)
+    {
+        if (v < 0 && base == DEC) return print('-') + printNumber(0ULL - (unsigned long long)v, base);
+        return printNumber((unsigned long long)v, base);
+    }
+};
@@ -0,0 +1,33 @@
+#pragma once
+#include "esp32-hal.h"
+#include "Print.h"
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long ms) { _timeout = ms; }
+    size_t readBytes(uint8_t* buffer, size_t length)
+    {
+        size_t n = 0;
+        unsigned long start = millis();
+        while (n < length)
+        {
+            int c = read();
+            if (c < 0)
+            {
+                if (millis() - start >= _timeout) break;
+                yield();
+                continue;
+            }
+            buffer[n++] = (uint8_t)c;
+        }
+        return n;
+    }
+    size_t readBytes(char* buffer, size_t length) { return readBytes((uint8_t*)buffer, length); }
+
+protected:
+    unsigned long _timeout = 1000;
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <ctype.h>
+#include <stdlib.h>
+#include <string>
+
+// std::string backed Arduino String, enough for the menu
+class String {
+public:
+    String() = default;
+    String(const char* s) : _s(s ? s : "") {}
+    String(const std::string& s) : _s(s) {}
+    String(char c) : _s(1, c) {}
+    explicit String(int v) : _s(std::to_string(v)) {}
+    explicit String(unsigned v) : _s(std::to_string(v)) {}
+    explicit String(long v) : _s(std::to_string(v)) {}
+    explicit String(unsigned long v) : _s(std::to_string(v)) {}
+
+    size_t length() const { return _s.size(); }
+    const char* c_str() const { return _s.c_str(); }
+    long toInt() const { return atol(_s.c_str()); }
+    void trim()
+    {
+        size_t a = 0, b = _s.size();
+        while (a < b && isspace((unsigned char)_s[a])) a++;
+        while (b > a && isspace((unsigned char)_s[b - 1])) b--;
+        _s = _s.substr(a, b - a);
+    }
+    void toUpperCase()
+    {
+        for (char& c : _s) c = toupper((unsigned char)c);
+    }
+    void toCharArray(char* buf, size_t size) const
+    {
+        if (size == 0) return;
+        size_t n = _s.copy(buf, size - 1);
+        buf[n] = '\0';
+    }
+    bool equals(const char* s) const { return _s == s; }
+    bool startsWith(const char* s) const { return _s.rfind(s, 0) == 0; }
+    String substring(size_t from) const { return from < _s.size() ? String(_s.substr(from)) : String(); }
+    String substring(size_t from, size_t to) const { return from < to && from < _s.size() ? String(_s.substr(from, to - from)) : String(); }
+    int indexOf(char c) const
+    {
+        size_t p = _s.find(c);
+        return p == std::string::npos ? -1 : (int)p;
+    }
+
+    String& operator+=(const String& o)
+    {
+        _s += o._s;
+        return *this;
+    }
+    String& operator+=(const char* s)
+    {
+        _s += s;
+        return *this;
+    }
+    String& operator+=(char c)
+    {
+        _s += c;
+        return *this;
+    }
+    String operator+(const String& o) const { return String(_s + o._s); }
+    String operator+(const char* s) const { return String(_s + s); }
+    bool operator==(const String& o) const { return _s == o._s; }
+    bool operator==(const char* s) const { return _s == s; }
+    bool operator!=(const String& o) const { return _s != o._s; }
+    bool operator<(const String& o) const { return _s < o._s; }
+    char operator[](size_t i) const { return _s[i]; }
+
+private:
+    std::string _s;
+};
+
+inline String operator+(const char* a, const String& b) { return String(a) + b; }
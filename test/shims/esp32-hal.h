@@ -0,0 +1,74 @@
+#pragma once
+// Clock, CPU frequency and pin functions of the core. millis() and micros()
+// follow the host clock; advanceMillis() lets a test skip time ahead.
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+
+#define IRAM_ATTR
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+namespace shim {
+// Time since start, plus whatever a test skipped ahead with advanceMillis()
+inline std::atomic<int64_t>& clockOffsetUs()
+{
+    static std::atomic<int64_t> offset{0};
+    return offset;
+}
+
+inline int64_t nowUs()
+{
+    static const auto start = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() + clockOffsetUs().load();
+}
+
+inline void advanceMillis(uint32_t ms) { clockOffsetUs() += (int64_t)ms * 1000; }
+
+inline std::atomic<uint32_t>& cpuMhz()
+{
+    static std::atomic<uint32_t> mhz{240};
+    return mhz;
+}
+} // namespace shim
+
+inline unsigned long millis() { return (unsigned long)(shim::nowUs() / 1000); }
+inline unsigned long micros() { return (unsigned long)shim::nowUs(); }
+inline void delay(unsigned long ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+inline void delayMicroseconds(unsigned int us) { std::this_thread::sleep_for(std::chrono::microseconds(us)); }
+inline void yield() { std::this_thread::yield(); }
+
+inline bool setCpuFrequencyMhz(uint32_t mhz)
+{
+    shim::cpuMhz() = mhz;
+    return true;
+}
+inline uint32_t getCpuFrequencyMhz() { return shim::cpuMhz(); }
+
+inline void pinMode(int, int) {}
+inline void digitalWrite(int, int) {}
+inline int digitalRead(int) { return LOW; }
+inline uint32_t analogReadMilliVolts(int) { return 0; }
+
+inline bool isPrintable(int c) { return isprint(c); }
+
@@ -0,0 +1,12 @@
+#pragma once
+#include <stddef.h>
+#include <stdlib.h>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+// No PSRAM on the host: SPIRAM requests fail so the fallback path runs
+inline void* heap_caps_malloc(size_t size, uint32_t caps) { return (caps & MALLOC_CAP_SPIRAM) ? nullptr : malloc(size); }
+inline void heap_caps_free(void* ptr) { free(ptr); }
+inline size_t heap_caps_get_free_size(uint32_t) { return 256 * 1024; }
@@ -0,0 +1,16 @@
+#pragma once
+#include <stdint.h>
+
+// Bitwise reflected CRC-32 with the ROM's calling convention: the seed and
+// result are the finished (inverted) values, so chained calls pass the last result
+inline uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--)
+    {
+        crc ^= *buf++;
+        for (int bit = 0; bit < 8; ++bit)
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+    }
+    return ~crc;
+}
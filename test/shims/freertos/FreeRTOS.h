@@ -0,0 +1,50 @@
+#pragma once
+// FreeRTOS on std::thread: tasks are threads, notifications a counter under
+// a condition variable, and software timers run in one service thread like
+// the timer daemon task. Ticks are milliseconds of the shim clock.
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <thread>
+#include "../esp32-hal.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFu)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define configMAX_PRIORITIES 25
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+namespace shim {
+struct Task {
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint32_t notifications = 0;
+};
+
+inline thread_local Task* currentTask = nullptr;
+
+inline Task* selfTask()
+{
+    // Threads the shim did not start (the test's main) get a handle on first use
+    if (!currentTask) currentTask = new Task();
+    return currentTask;
+}
+
+// Thrown by vTaskDelete(nullptr) to unwind the calling task's thread
+struct TaskDeleted {};
+} // namespace shim
+
+typedef shim::Task* TaskHandle_t;
+
+inline TickType_t xTaskGetTickCount() { return (TickType_t)millis(); }
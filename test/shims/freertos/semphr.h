@@ -0,0 +1,26 @@
+#pragma once
+#include "FreeRTOS.h"
+
+namespace shim {
+struct Semaphore {
+    std::timed_mutex mutex;
+};
+} // namespace shim
+typedef shim::Semaphore* SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new shim::Semaphore(); }
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        semaphore->mutex.lock();
+        return pdTRUE;
+    }
+    return semaphore->mutex.try_lock_for(std::chrono::milliseconds(ticks)) ? pdTRUE : pdFALSE;
+}
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    semaphore->mutex.unlock();
+    return pdTRUE;
+}
+inline void vSemaphoreDelete(SemaphoreHandle_t semaphore) { delete semaphore; }
@@ -0,0 +1,70 @@
+#pragma once
+#include "FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void*);
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t entry, const char* name, uint32_t stackDepth, void* parameters,
+                                          UBaseType_t priority, TaskHandle_t* handle, BaseType_t core)
+{
+    shim::Task* task = new shim::Task();
+    if (handle) *handle = task;
+    std::thread([=] {
+        shim::currentTask = task;
+        try
+        {
+            entry(parameters);
+        }
+        catch (const shim::TaskDeleted&)
+        {
+        }
+    }).detach();
+    return pdPASS;
+}
+
+inline BaseType_t xTaskCreate(TaskFunction_t entry, const char* name, uint32_t stackDepth, void* parameters,
+                              UBaseType_t priority, TaskHandle_t* handle)
+{
+    return xTaskCreatePinnedToCore(entry, name, stackDepth, parameters, priority, handle, tskNO_AFFINITY);
+}
+
+// Only a task deleting itself is supported
+inline void vTaskDelete(TaskHandle_t task)
+{
+    if (!task || task == shim::currentTask) throw shim::TaskDeleted();
+}
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() { return shim::selfTask(); }
+
+inline void vTaskDelay(TickType_t ticks) { std::this_thread::sleep_for(std::chrono::milliseconds(ticks)); }
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    {
+        std::lock_guard<std::mutex> lock(task->mutex);
+        task->notifications++;
+    }
+    task->cv.notify_one();
+    return pdPASS;
+}
+
+inline void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* woken)
+{
+    xTaskNotifyGive(task);
+    if (woken) *woken = pdFALSE;
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks)
+{
+    shim::Task* self = shim::selfTask();
+    std::unique_lock<std::mutex> lock(self->mutex);
+    auto pending = [self] { return self->notifications > 0; };
+    if (ticks == portMAX_DELAY)
+        self->cv.wait(lock, pending);
+    else
+        self->cv.wait_for(lock, std::chrono::milliseconds(ticks), pending);
+    uint32_t value = self->notifications;
+    if (value) self->notifications = clearOnExit ? 0 : value - 1;
+    return value;
+}
+
+#define portYIELD_FROM_ISR(woken) (void)(woken)
@@ -0,0 +1,123 @@
+#pragma once
+#include "FreeRTOS.h"
+
+namespace shim {
+struct Timer;
+}
+typedef shim::Timer* TimerHandle_t;
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t);
+
+namespace shim {
+struct Timer {
+    TickType_t period;
+    bool autoReload;
+    void* id;
+    TimerCallbackFunction_t callback;
+    bool active = false;
+    uint32_t expiry = 0;
+};
+
+// The timer daemon: fires expired timers in order, one at a time
+class TimerService {
+public:
+    static TimerService& instance()
+    {
+        static TimerService* service = new TimerService();
+        return *service;
+    }
+
+    void start(Timer* timer, TickType_t period)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        timer->period = period;
+        timer->expiry = millis() + period;
+        timer->active = true;
+        _timers.remove(timer);
+        _timers.push_back(timer);
+    }
+    void stop(Timer* timer)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        timer->active = false;
+        _timers.remove(timer);
+    }
+    void remove(Timer* timer) { stop(timer); }
+    bool active(Timer* timer)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return timer->active;
+    }
+
+private:
+    std::mutex _mutex;
+    std::list<Timer*> _timers;
+
+    TimerService()
+    {
+        std::thread([this] { run(); }).detach();
+    }
+
+    void run()
+    {
+        for (;;)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            for (;;)
+            {
+                Timer* due = nullptr;
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    uint32_t now = millis();
+                    for (Timer* timer : _timers)
+                        if ((int32_t)(now - timer->expiry) >= 0)
+                        {
+                            due = timer;
+                            break;
+                        }
+                    if (!due) break;
+                    if (due->autoReload)
+                        due->expiry += due->period;
+                    else
+                    {
+                        due->active = false;
+                        _timers.remove(due);
+                    }
+                }
+                due->callback(due);
+            }
+        }
+    }
+};
+} // namespace shim
+
+inline TimerHandle_t xTimerCreate(const char* name, TickType_t period, UBaseType_t autoReload, void* id,
+                                  TimerCallbackFunction_t callback)
+{
+    return new shim::Timer{period, autoReload != pdFALSE, id, callback};
+}
+
+inline BaseType_t xTimerStart(TimerHandle_t timer, TickType_t)
+{
+    shim::TimerService::instance().start(timer, timer->period);
+    return pdPASS;
+}
+inline BaseType_t xTimerReset(TimerHandle_t timer, TickType_t wait) { return xTimerStart(timer, wait); }
+inline BaseType_t xTimerStop(TimerHandle_t timer, TickType_t)
+{
+    shim::TimerService::instance().stop(timer);
+    return pdPASS;
+}
+// Starts a dormant timer as well, as in FreeRTOS
+inline BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t)
+{
+    shim::TimerService::instance().start(timer, period);
+    return pdPASS;
+}
+inline BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t)
+{
+    shim::TimerService::instance().remove(timer);
+    delete timer;
+    return pdPASS;
+}
+inline BaseType_t xTimerIsTimerActive(TimerHandle_t timer) { return shim::TimerService::instance().active(timer); }
+inline void* pvTimerGetTimerID(TimerHandle_t timer) { return timer->id; }
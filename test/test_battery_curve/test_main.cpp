@@ -0,0 +1,56 @@
+// The compile-time state of charge table against the runtime pow() curve it
+// replaced, at every millivolt the ADC can report for the cell.
+#include <unity.h>
+#include <math.h>
+#include "BatteryCurve.h"
+
+// batteryPercentage() as it was, before the table
+static float oldPercent(uint32_t cellMv)
+{
+    float vBat = cellMv / 1000.0f;
+    float pBat = 128.7445 + (1.778399 - 128.7445) / pow(1 + pow(vBat / 3.689705, 116.3086), 0.1018804);
+    if (pBat < 0) pBat = 0;
+    else if (pBat > 100) pBat = 100;
+    return pBat;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_within_one_percent_of_the_pow_curve(void)
+{
+    double worst = 0;
+    uint32_t worstMv = 0;
+    for (uint32_t mv = 2500; mv <= 4500; ++mv)
+    {
+        double diff = fabs(BatteryCurve::centiPercent(mv) / 100.0 - oldPercent(mv));
+        if (diff > worst)
+        {
+            worst = diff;
+            worstMv = mv;
+        }
+        // Reported levels are whole percents, truncated as before
+        int levelDiff = (int)BatteryCurve::percent(mv) - (int)oldPercent(mv);
+        TEST_ASSERT_TRUE(levelDiff >= -1 && levelDiff <= 1);
+    }
+    char message[80];
+    snprintf(message, sizeof(message), "largest difference %.3f %% at %u mV", worst, (unsigned)worstMv);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_TRUE(worst < 1.0);
+}
+
+void test_monotonic_and_clamped(void)
+{
+    TEST_ASSERT_EQUAL_UINT16(BatteryCurve::centiPercent(BatteryCurve::MIN_MV), BatteryCurve::centiPercent(0));
+    TEST_ASSERT_EQUAL_UINT16(10000, BatteryCurve::centiPercent(5000));
+    for (uint32_t mv = BatteryCurve::MIN_MV; mv < BatteryCurve::MAX_MV; ++mv)
+        TEST_ASSERT_TRUE(BatteryCurve::centiPercent(mv + 1) >= BatteryCurve::centiPercent(mv));
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_within_one_percent_of_the_pow_curve);
+    RUN_TEST(test_monotonic_and_clamped);
+    return UNITY_END();
+}
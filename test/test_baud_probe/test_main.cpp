@@ -0,0 +1,227 @@
+// Baudrate detection on receiver streams as a UART would decode them at each
+// candidate rate, and the probe against simulated 1 Hz receivers.
+#include <unity.h>
+#include <Arduino.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include "BaudProbe.h"
+#include "GnssTraffic.h"
+
+// What a UART at rxBaud makes of 8N1 bytes sent back to back at txBaud:
+// it waits for a falling edge, samples the middle of each bit at its own
+// rate, and keeps the byte even on a framing error, as the ESP32 does
+static std::vector<uint8_t> resample(const std::vector<uint8_t>& bytes, uint32_t txBaud, uint32_t rxBaud)
+{
+    if (txBaud == rxBaud)
+        return bytes;
+    const double txBit = 1.0 / txBaud;
+    const double rxBit = 1.0 / rxBaud;
+    const double end = bytes.size() * 10 * txBit;
+    auto level = [&](double t) {
+        if (t < 0 || t >= end)
+            return 1;
+        size_t bit = (size_t)(t / txBit);
+        size_t index = bit % 10;
+        if (index == 0)
+            return 0;
+        if (index == 9)
+            return 1;
+        return (bytes[bit / 10] >> (index - 1)) & 1;
+    };
+
+    std::vector<uint8_t> out;
+    for (double t = 0; t < end;)
+    {
+        if (level(t))
+        {
+            // The line only changes at the sender's bit boundaries
+            t = (std::floor(t / txBit) + 1.001) * txBit;
+            continue;
+        }
+        uint8_t value = 0;
+        for (int i = 0; i < 8; ++i)
+            value |= level(t + (1.5 + i) * rxBit) << i;
+        out.push_back(value);
+        t += 9.5 * rxBit; // Middle of the stop bit, then look for the next start
+    }
+    return out;
+}
+
+static std::vector<uint8_t> bytesOf(const std::string& text) { return std::vector<uint8_t>(text.begin(), text.end()); }
+
+// Receiver sending one epoch per second at its own rate, starting phaseMs in.
+// The port decodes it at whatever rate the probe last set.
+class SimulatedReceiver : public Stream {
+public:
+    SimulatedReceiver(std::vector<uint8_t> epoch, uint32_t baud, unsigned long phaseMs)
+        : _epoch(std::move(epoch)), _baud(baud), _phaseMs(phaseMs), _start(millis())
+    {
+        setBaud(baud);
+    }
+
+    void setBaud(uint32_t baud)
+    {
+        _decoded = resample(_epoch, _baud, baud);
+        _rxBaud = baud;
+        _delivered = (size_t)(progress() * _decoded.size());
+        _rx.clear();
+    }
+    uint32_t rxBaud() const { return _rxBaud; }
+
+    int available() override
+    {
+        pump();
+        return _rx.size();
+    }
+    int read() override
+    {
+        pump();
+        if (_rx.empty())
+            return -1;
+        int c = _rx.front();
+        _rx.pop_front();
+        return c;
+    }
+    int peek() override { return available() ? _rx.front() : -1; }
+    size_t write(uint8_t) override { return 1; }
+
+private:
+    std::vector<uint8_t> _epoch;
+    std::vector<uint8_t> _decoded;
+    uint32_t _baud;
+    uint32_t _rxBaud = 0;
+    unsigned long _phaseMs;
+    unsigned long _start;
+    long _epochIndex = -1;
+    size_t _delivered = 0;
+    std::deque<uint8_t> _rx;
+
+    // Share of the current epoch on the wire so far
+    double progress()
+    {
+        long now = (long)(millis() - _start) - (long)_phaseMs;
+        if (now < 0)
+            return 0;
+        if (now / 1000 != _epochIndex)
+        {
+            _epochIndex = now / 1000;
+            _delivered = 0;
+        }
+        double burstMs = _epoch.size() * 10 * 1000.0 / _baud;
+        return std::min(1.0, (now % 1000) / burstMs);
+    }
+
+    void pump()
+    {
+        size_t due = (size_t)(progress() * _decoded.size());
+        for (; _delivered < due; ++_delivered)
+            _rx.push_back(_decoded[_delivered]);
+    }
+};
+
+static void setReceiverBaud(void* ctx, uint32_t baud) { static_cast<SimulatedReceiver*>(ctx)->setBaud(baud); }
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_only_the_true_rate_frames(void)
+{
+    struct Recording {
+        const char* name;
+        std::vector<uint8_t> bytes;
+        uint32_t baud;
+    } streams[] = {
+        {"NMEA 9600", bytesOf(gnss::nmeaStream(1500, 1)), 9600},
+        {"NMEA 115200", bytesOf(gnss::nmeaStream(4000)), 115200},
+        {"NMEA 460800", bytesOf(gnss::nmeaStream(4000)), 460800},
+        {"RTCM 921600", gnss::rtcmEpoch(), 921600},
+    };
+    for (const Recording& stream : streams)
+    {
+        uint32_t bestScore = 0;
+        uint32_t best = 0;
+        for (uint32_t rate : BaudProbe::CANDIDATES)
+        {
+            BaudScorer scorer;
+            std::vector<uint8_t> heard = resample(stream.bytes, stream.baud, rate);
+            scorer.feed(heard.data(), heard.size());
+            char message[96];
+            snprintf(message, sizeof(message), "%s heard at %u", stream.name, (unsigned)rate);
+            if (rate == stream.baud)
+                TEST_ASSERT_TRUE_MESSAGE(scorer.frames() > 0, message);
+            else
+                TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, scorer.frames(), message);
+            if (scorer.score() > bestScore)
+            {
+                bestScore = scorer.score();
+                best = rate;
+            }
+        }
+        TEST_ASSERT_EQUAL_UINT32(stream.baud, best);
+    }
+}
+
+// A 1 Hz receiver at each candidate rate, first heard 300 ms into the probe
+// and looked for at the default rate: locked within the first epoch burst,
+// under a second after its first byte
+void test_probe_locks_within_the_first_epoch(void)
+{
+    std::vector<uint8_t> epoch = bytesOf(gnss::epoch(0, 2));
+    TEST_ASSERT_TRUE(epoch.size() >= 512);
+    for (uint32_t rate : BaudProbe::CANDIDATES)
+    {
+        SimulatedReceiver receiver(epoch, rate, 300);
+        BaudProbe probe;
+        uint32_t baud = probe.run(receiver, setReceiverBaud, &receiver, 460800);
+        char message[96];
+        snprintf(message, sizeof(message), "%u baud: first byte at %lu ms, locked at %lu ms", (unsigned)rate,
+                 probe.activityMs(), probe.elapsedMs());
+        TEST_MESSAGE(message);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(rate, baud, message);
+        TEST_ASSERT_EQUAL_UINT32(rate, receiver.rxBaud());
+        TEST_ASSERT_TRUE_MESSAGE(probe.activityMs() >= 290, message);
+        TEST_ASSERT_TRUE_MESSAGE(probe.elapsedMs() - probe.activityMs() < 1000, message);
+    }
+}
+
+// A receiver that only sends GGA hops one candidate or so per epoch, but
+// still finds its rate within the budget
+void test_probe_finds_a_sparse_receiver(void)
+{
+    SimulatedReceiver receiver(bytesOf(gnss::sentence("GNGGA,120000.00,5231.12345,N,01323.45670,E,4,12,0.6,35.1,M,39.8,M,1.0,0000")), 115200, 100);
+    BaudProbe probe;
+    uint32_t baud = probe.run(receiver, setReceiverBaud, &receiver, 9600);
+    char message[64];
+    snprintf(message, sizeof(message), "locked in %lu ms", probe.elapsedMs());
+    TEST_MESSAGE(message);
+    TEST_ASSERT_EQUAL_UINT32(115200, baud);
+    TEST_ASSERT_TRUE(probe.elapsedMs() < BaudProbe::BUDGET_MS);
+}
+
+void test_probe_locks_at_once_on_the_configured_rate(void)
+{
+    SimulatedReceiver receiver(bytesOf(gnss::epoch(0)), 460800, 0);
+    BaudProbe probe;
+    TEST_ASSERT_EQUAL_UINT32(460800, probe.run(receiver, setReceiverBaud, &receiver, 460800));
+    TEST_ASSERT_TRUE(probe.elapsedMs() < 100);
+}
+
+void test_probe_gives_up_on_a_silent_port(void)
+{
+    SimulatedReceiver receiver({}, 115200, 0);
+    BaudProbe probe;
+    TEST_ASSERT_EQUAL_UINT32(0, probe.run(receiver, setReceiverBaud, &receiver, 115200, 300));
+    TEST_ASSERT_EQUAL_UINT32(0, probe.bestScore());
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_only_the_true_rate_frames);
+    RUN_TEST(test_probe_locks_within_the_first_epoch);
+    RUN_TEST(test_probe_finds_a_sparse_receiver);
+    RUN_TEST(test_probe_locks_at_once_on_the_configured_rate);
+    RUN_TEST(test_probe_gives_up_on_a_silent_port);
+    return UNITY_END();
+}
@@ -0,0 +1,143 @@
+// BlePacketizer against a fake GATT link: notifications are filled to
+// MTU-3, paced to the per-interval budget, and a refused notification or a
+// lost subscription stops the send without losing or repeating bytes.
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "BlePacketizer.h"
+
+class FakeGatt : public GattTransport {
+public:
+    bool subscribed = true;
+    uint16_t linkMtu = BlePacketizer::MIN_MTU;
+    int refuseAfter = -1; // Refuses every notification once this many were taken
+    std::vector<std::string> packets;
+
+    bool connected() override { return subscribed; }
+    uint16_t mtu() override { return linkMtu; }
+    bool notify(const uint8_t* data, size_t len) override
+    {
+        if (!subscribed || (refuseAfter >= 0 && packets.size() >= (size_t)refuseAfter))
+            return false;
+        packets.emplace_back((const char*)data, len);
+        return true;
+    }
+
+    std::string received() const
+    {
+        std::string all;
+        for (const std::string& packet : packets)
+            all += packet;
+        return all;
+    }
+};
+
+static std::string pattern(size_t len)
+{
+    std::string data;
+    for (size_t i = 0; i < len; ++i)
+        data += (char)('A' + i % 26);
+    return data;
+}
+
+static size_t send(BlePacketizer& packetizer, const std::string& data, size_t from, uint32_t nowUs)
+{
+    return packetizer.send((const uint8_t*)data.data() + from, data.size() - from, nowUs);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_packets_fill_the_mtu(void)
+{
+    FakeGatt gatt;
+    gatt.linkMtu = 185;
+    BlePacketizer packetizer(gatt);
+    std::string data = pattern(400);
+
+    TEST_ASSERT_EQUAL_UINT32(400, send(packetizer, data, 0, 0));
+    TEST_ASSERT_EQUAL_UINT32(3, gatt.packets.size());
+    TEST_ASSERT_EQUAL_UINT32(182, gatt.packets[0].size());
+    TEST_ASSERT_EQUAL_UINT32(182, gatt.packets[1].size());
+    TEST_ASSERT_EQUAL_UINT32(36, gatt.packets[2].size());
+    TEST_ASSERT_TRUE(gatt.received() == data);
+
+    // A link below the ATT minimum still gets the minimum payload
+    gatt.linkMtu = 0;
+    TEST_ASSERT_EQUAL_UINT32(BlePacketizer::MIN_MTU - BlePacketizer::ATT_HEADER, packetizer.payloadSize());
+}
+
+void test_budget_paces_to_the_interval(void)
+{
+    FakeGatt gatt;
+    BlePacketizer packetizer(gatt);
+    packetizer.setConnectionInterval(15000);
+    packetizer.setPacketsPerInterval(2);
+    std::string data = pattern(200); // 10 packets of 20 bytes
+
+    size_t done = send(packetizer, data, 0, 1000);
+    TEST_ASSERT_EQUAL_UINT32(40, done);
+    TEST_ASSERT_EQUAL_UINT32(10000, packetizer.waitUs(6000));
+    TEST_ASSERT_EQUAL_UINT32(0, send(packetizer, data, done, 6000));
+
+    // Each interval takes the next two packets
+    uint32_t now = 1000;
+    while (done < data.size())
+    {
+        now += packetizer.waitUs(now);
+        size_t sent = send(packetizer, data, done, now);
+        TEST_ASSERT_EQUAL_UINT32(40, sent);
+        done += sent;
+    }
+    TEST_ASSERT_EQUAL_UINT32(1000 + 4 * 15000, now);
+    TEST_ASSERT_EQUAL_UINT32(10, packetizer.packets());
+    TEST_ASSERT_TRUE(gatt.received() == data);
+}
+
+void test_refusal_gives_up_the_interval(void)
+{
+    FakeGatt gatt;
+    BlePacketizer packetizer(gatt);
+    packetizer.setConnectionInterval(30000);
+    std::string data = pattern(100);
+    gatt.refuseAfter = 1;
+
+    TEST_ASSERT_EQUAL_UINT32(20, send(packetizer, data, 0, 0));
+    TEST_ASSERT_EQUAL_UINT32(1, packetizer.refused());
+    TEST_ASSERT_EQUAL_UINT32(30000, packetizer.waitUs(0));
+
+    // Once the stack takes packets again, the rest follows in order
+    gatt.refuseAfter = -1;
+    TEST_ASSERT_EQUAL_UINT32(80, send(packetizer, data, 20, 30000));
+    TEST_ASSERT_EQUAL_UINT32(1, packetizer.refused());
+    TEST_ASSERT_TRUE(gatt.received() == data);
+}
+
+void test_unsubscribed_client_gets_nothing(void)
+{
+    FakeGatt gatt;
+    BlePacketizer packetizer(gatt);
+    std::string data = pattern(100);
+    gatt.subscribed = false;
+
+    TEST_ASSERT_EQUAL_UINT32(0, send(packetizer, data, 0, 0));
+    TEST_ASSERT_EQUAL_UINT32(0, gatt.packets.size());
+    TEST_ASSERT_EQUAL_UINT32(0, packetizer.refused());
+
+    // A new subscriber starts with a fresh budget
+    gatt.subscribed = true;
+    packetizer.reset();
+    TEST_ASSERT_EQUAL_UINT32(0, packetizer.waitUs(0));
+    TEST_ASSERT_EQUAL_UINT32(80, send(packetizer, data, 0, 0));
+    TEST_ASSERT_EQUAL_UINT32(4, gatt.packets.size());
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_packets_fill_the_mtu);
+    RUN_TEST(test_budget_paces_to_the_interval);
+    RUN_TEST(test_refusal_gives_up_the_interval);
+    RUN_TEST(test_unsubscribed_client_gets_nothing);
+    return UNITY_END();
+}
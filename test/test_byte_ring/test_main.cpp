@@ -0,0 +1,183 @@
+// ByteRing semantics, plus a two-thread throughput run that checks every
+// byte arrives once and in order
+#include <unity.h>
+#include <Arduino.h>
+#include <thread>
+#include "ByteRing.h"
+#include "Bench.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_capacity_rounds_up_to_power_of_two(void)
+{
+    ByteRing ring;
+    TEST_ASSERT_EQUAL_size_t(0, ring.capacity());
+    TEST_ASSERT_TRUE(ring.begin(1000));
+    TEST_ASSERT_EQUAL_size_t(1024, ring.capacity());
+    TEST_ASSERT_EQUAL_size_t(1024, ring.freeSpace());
+    TEST_ASSERT_TRUE(ring.begin(4096));
+    TEST_ASSERT_EQUAL_size_t(4096, ring.capacity());
+}
+
+void test_write_read_across_the_wrap(void)
+{
+    ByteRing ring;
+    ring.begin(16);
+    uint8_t in[40], out[40];
+    for (size_t i = 0; i < sizeof(in); ++i)
+        in[i] = i;
+    // Step the offsets around the end of the storage a few times
+    for (size_t round = 0; round < 5; ++round)
+    {
+        TEST_ASSERT_EQUAL_size_t(11, ring.write(in + round, 11));
+        TEST_ASSERT_EQUAL_size_t(11, ring.available());
+        TEST_ASSERT_EQUAL_size_t(11, ring.read(out, sizeof(out)));
+        TEST_ASSERT_EQUAL_MEMORY(in + round, out, 11);
+    }
+    TEST_ASSERT_EQUAL_size_t(55, ring.totalWritten());
+    TEST_ASSERT_EQUAL_size_t(55, ring.totalRead());
+    TEST_ASSERT_EQUAL_UINT32(0, ring.overflowBytes());
+}
+
+void test_write_keeps_what_fits_and_counts_the_rest(void)
+{
+    ByteRing ring;
+    ring.begin(16);
+    uint8_t data[20] = {};
+    TEST_ASSERT_EQUAL_size_t(16, ring.write(data, sizeof(data)));
+    TEST_ASSERT_EQUAL_UINT32(4, ring.overflowBytes());
+    TEST_ASSERT_EQUAL_size_t(0, ring.write(data, 1));
+    TEST_ASSERT_EQUAL_UINT32(5, ring.overflowBytes());
+    TEST_ASSERT_EQUAL_size_t(16, ring.highWater());
+    ring.resetStats();
+    TEST_ASSERT_EQUAL_UINT32(0, ring.overflowBytes());
+    TEST_ASSERT_EQUAL_size_t(0, ring.highWater());
+}
+
+void test_write_all_is_all_or_nothing(void)
+{
+    ByteRing ring;
+    ring.begin(16);
+    uint8_t data[10] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    TEST_ASSERT_TRUE(ring.writeAll(data, 10));
+    TEST_ASSERT_FALSE(ring.writeAll(data, 10));
+    TEST_ASSERT_EQUAL_size_t(10, ring.available());
+    TEST_ASSERT_EQUAL_UINT32(10, ring.overflowBytes());
+    TEST_ASSERT_TRUE(ring.writeAll(data, 6));
+    TEST_ASSERT_EQUAL_size_t(0, ring.freeSpace());
+}
+
+void test_peek_and_skip(void)
+{
+    ByteRing ring;
+    ring.begin(8);
+    const uint8_t data[] = {'a', 'b', 'c', 'd', 'e'};
+    ring.write(data, sizeof(data));
+    uint8_t out[8];
+    TEST_ASSERT_EQUAL_size_t(3, ring.peek(out, 3));
+    TEST_ASSERT_EQUAL_MEMORY("abc", out, 3);
+    TEST_ASSERT_EQUAL_size_t(5, ring.available());
+    TEST_ASSERT_EQUAL_size_t(2, ring.skip(2));
+    TEST_ASSERT_EQUAL_size_t(3, ring.read(out, sizeof(out)));
+    TEST_ASSERT_EQUAL_MEMORY("cde", out, 3);
+    TEST_ASSERT_EQUAL_size_t(0, ring.skip(1));
+}
+
+void test_unallocated_ring_drops_everything(void)
+{
+    ByteRing ring;
+    uint8_t data[4] = {};
+    TEST_ASSERT_EQUAL_size_t(0, ring.write(data, sizeof(data)));
+    TEST_ASSERT_EQUAL_size_t(0, ring.freeSpace());
+    TEST_ASSERT_EQUAL_UINT32(4, ring.overflowBytes());
+}
+
+// Producer and consumer on their own threads, in the odd-sized chunks UART
+// and SPP callbacks deliver. The consumer checks the sequence.
+void test_spsc_throughput(void)
+{
+    static constexpr size_t TOTAL = 256u << 20;
+    ByteRing ring;
+    ring.begin(8192);
+
+    std::atomic<bool> corrupt{false};
+    uint64_t start = bench::nowNs();
+    std::thread producer([&] {
+        uint8_t chunk[512];
+        size_t sent = 0, size = 1;
+        while (sent < TOTAL)
+        {
+            size = size * 7 % 509 + 1;
+            size_t n = std::min(size, TOTAL - sent);
+            for (size_t i = 0; i < n; ++i)
+                chunk[i] = (uint8_t)((sent + i) * 13);
+            size_t done = 0;
+            while (done < n)
+            {
+                done += ring.write(chunk + done, n - done);
+                if (done < n) std::this_thread::yield();
+            }
+            sent += n;
+        }
+    });
+    uint8_t buffer[1024];
+    size_t received = 0;
+    while (received < TOTAL)
+    {
+        size_t n = ring.read(buffer, sizeof(buffer));
+        if (n == 0)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        for (size_t i = 0; i < n; ++i)
+            if (buffer[i] != (uint8_t)((received + i) * 13))
+                corrupt = true;
+        received += n;
+    }
+    producer.join();
+    uint64_t ns = bench::nowNs() - start;
+
+    char line[128];
+    snprintf(line, sizeof(line), "SPSC %u MB through an 8 KB ring: %.0f MB/s, high water %u bytes",
+             (unsigned)(TOTAL >> 20), bench::megabytesPerSecond(TOTAL, ns), (unsigned)ring.highWater());
+    TEST_MESSAGE(line);
+    TEST_ASSERT_FALSE(corrupt);
+    TEST_ASSERT_EQUAL_size_t(TOTAL, ring.totalRead());
+    TEST_ASSERT_EQUAL_size_t(0, ring.available());
+}
+
+// Cost of one receive-callback sized write and router-sized read
+void test_single_thread_chunk_cost(void)
+{
+    static constexpr size_t ROUNDS = 1000000;
+    ByteRing ring;
+    ring.begin(4096);
+    uint8_t chunk[120] = {}, out[256];
+    uint64_t start = bench::nowNs();
+    for (size_t i = 0; i < ROUNDS; ++i)
+    {
+        ring.write(chunk, sizeof(chunk));
+        ring.read(out, sizeof(out));
+    }
+    uint64_t ns = bench::nowNs() - start;
+    char line[128];
+    snprintf(line, sizeof(line), "120 byte write + read: %.1f ns per pair", (double)ns / ROUNDS);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL_size_t(ROUNDS * sizeof(chunk), ring.totalRead());
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_capacity_rounds_up_to_power_of_two);
+    RUN_TEST(test_write_read_across_the_wrap);
+    RUN_TEST(test_write_keeps_what_fits_and_counts_the_rest);
+    RUN_TEST(test_write_all_is_all_or_nothing);
+    RUN_TEST(test_peek_and_skip);
+    RUN_TEST(test_unallocated_ring_drops_everything);
+    RUN_TEST(test_spsc_throughput);
+    RUN_TEST(test_single_thread_chunk_cost);
+    return UNITY_END();
+}
@@ -0,0 +1,180 @@
+// Capture file blocks: records written by CaptureBlock read back through
+// CaptureReader, the on-flash layout tools/capture_replay.py decodes, CRC
+// checking, and where a capture resumes in a ring that has wrapped.
+#include <unity.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "CaptureBlock.h"
+#include "CRC32.h"
+
+struct Written {
+    uint64_t us;
+    uint8_t source;
+    std::string data;
+};
+
+static std::string payload(size_t len, char seed)
+{
+    std::string data;
+    for (size_t i = 0; i < len; ++i)
+        data += (char)(seed + i % 23);
+    return data;
+}
+
+static std::vector<Written> readAll(const uint8_t* block)
+{
+    std::vector<Written> records;
+    CaptureReader reader;
+    if (!reader.open(block))
+        return records;
+    CaptureRecord record;
+    while (reader.next(record))
+        records.push_back({record.us, record.source, std::string((const char*)record.data, record.len)});
+    TEST_ASSERT_EQUAL_UINT32(reader.records(), records.size());
+    return records;
+}
+
+static uint32_t le32(const uint8_t* p) { return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24; }
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_records_read_back(void)
+{
+    // Deltas on every varint length boundary, payloads around one
+    const uint64_t base = 5000000000ull;
+    const uint32_t deltas[] = {0, 127, 128, 16383, 16384, 2097151, 2097152, 0x7FFFFFFF};
+    const size_t lens[] = {1, 127, 128, 300, 0, 64, 2, 100};
+    std::vector<Written> written;
+    CaptureBlock block;
+    block.start(7, base);
+    uint64_t us = base;
+    for (size_t i = 0; i < 8; ++i)
+    {
+        us += deltas[i];
+        written.push_back({us, (uint8_t)(i % 4), payload(lens[i], 'A' + i)});
+        const Written& w = written.back();
+        TEST_ASSERT_TRUE(block.append(w.us, w.source, (const uint8_t*)w.data.data(), w.data.size()));
+    }
+
+    std::vector<Written> read = readAll(block.finish());
+    TEST_ASSERT_EQUAL_UINT32(written.size(), read.size());
+    for (size_t i = 0; i < read.size(); ++i)
+    {
+        TEST_ASSERT_EQUAL_UINT64(written[i].us, read[i].us);
+        TEST_ASSERT_EQUAL_UINT8(written[i].source, read[i].source);
+        TEST_ASSERT_TRUE(written[i].data == read[i].data);
+    }
+}
+
+// The layout capture_replay.py unpacks with "<IIQHHI", then varint deltaUs,
+// source, varint len, payload
+void test_layout_on_flash(void)
+{
+    CaptureBlock block;
+    block.start(0x01020304, 0x1122334455667788ull);
+    block.append(0x1122334455667788ull + 300, 2, (const uint8_t*)"$GN", 3);
+    const uint8_t* data = block.finish();
+
+    TEST_ASSERT_EQUAL_HEX32(CaptureBlock::MAGIC, le32(data));
+    TEST_ASSERT_EQUAL_MEMORY("CAP1", data, 4);
+    TEST_ASSERT_EQUAL_HEX32(0x01020304, le32(data + 4));
+    TEST_ASSERT_EQUAL_HEX32(0x55667788, le32(data + 8));
+    TEST_ASSERT_EQUAL_HEX32(0x11223344, le32(data + 12));
+    const uint8_t body[] = {0xAC, 0x02, 2, 3, '$', 'G', 'N'};
+    TEST_ASSERT_EQUAL_UINT32(sizeof(body), data[16] | data[17] << 8);
+    TEST_ASSERT_EQUAL_UINT32(1, data[18] | data[19] << 8);
+    TEST_ASSERT_EQUAL_HEX32(CRC32::calculate(body, sizeof(body)), le32(data + 20));
+    TEST_ASSERT_EQUAL_MEMORY(body, data + CaptureBlock::HEADER_LEN, sizeof(body));
+    // Nothing stale after the records
+    for (size_t i = CaptureBlock::HEADER_LEN + sizeof(body); i < CaptureBlock::SIZE; ++i)
+        TEST_ASSERT_EQUAL_UINT8(0, data[i]);
+}
+
+void test_full_block_refuses_and_stays_intact(void)
+{
+    CaptureBlock block;
+    block.start(1, 0);
+    std::string chunk = payload(480, 'a');
+    size_t appended = 0;
+    while (block.append(appended * 1000, 1, (const uint8_t*)chunk.data(), chunk.size()))
+        appended++;
+    TEST_ASSERT_EQUAL_UINT32(4, appended);
+    // What still fits goes in after a refusal
+    TEST_ASSERT_TRUE(block.append(5000, 3, (const uint8_t*)chunk.data(), 20));
+
+    std::vector<Written> read = readAll(block.finish());
+    TEST_ASSERT_EQUAL_UINT32(5, read.size());
+    TEST_ASSERT_EQUAL_UINT64(5000, read[4].us);
+    TEST_ASSERT_EQUAL_UINT32(20, read[4].data.size());
+
+    // A delta beyond 32 bits needs a new block
+    block.start(2, 0);
+    TEST_ASSERT_FALSE(block.append(1ull << 33, 0, (const uint8_t*)"x", 1));
+    TEST_ASSERT_TRUE(block.empty());
+}
+
+void test_damage_is_detected(void)
+{
+    CaptureBlock block;
+    block.start(3, 100);
+    block.append(200, 1, (const uint8_t*)"$GNGGA,1*00\r\n", 13);
+    uint8_t data[CaptureBlock::SIZE];
+    memcpy(data, block.finish(), sizeof(data));
+    CaptureReader reader;
+    TEST_ASSERT_TRUE(reader.open(data));
+    TEST_ASSERT_EQUAL_UINT32(3, reader.seq());
+
+    data[CaptureBlock::HEADER_LEN + 6] ^= 0x20;
+    TEST_ASSERT_FALSE(reader.open(data));
+    data[CaptureBlock::HEADER_LEN + 6] ^= 0x20;
+    data[0] = 0;
+    TEST_ASSERT_FALSE(reader.open(data));
+
+    // A preallocated, never written block
+    memset(data, 0, sizeof(data));
+    TEST_ASSERT_FALSE(reader.open(data));
+}
+
+static void addBlock(CaptureResume& resume, uint32_t seq)
+{
+    CaptureBlock block;
+    block.start(seq, 0);
+    block.append(1, 0, (const uint8_t*)"x", 1);
+    resume.add(block.finish());
+}
+
+void test_resume_after_the_newest_block(void)
+{
+    CaptureResume fresh;
+    uint8_t blank[CaptureBlock::HEADER_LEN] = {};
+    fresh.add(blank);
+    TEST_ASSERT_EQUAL_UINT32(0, fresh.nextSeq());
+
+    // A ring of eight that has wrapped: slot i holds seq 16 + i or 8 + i
+    CaptureResume ring;
+    const uint32_t slots[] = {16, 17, 18, 11, 12, 13, 14, 15};
+    for (uint32_t seq : slots)
+        addBlock(ring, seq);
+    TEST_ASSERT_EQUAL_UINT32(19, ring.nextSeq());
+
+    // Across the 32-bit wrap of seq itself
+    CaptureResume wrapped;
+    const uint32_t late[] = {0, 0xFFFFFFFD, 1, 0xFFFFFFFE, 0xFFFFFFFF};
+    for (uint32_t seq : late)
+        addBlock(wrapped, seq);
+    wrapped.add(blank);
+    TEST_ASSERT_EQUAL_UINT32(2, wrapped.nextSeq());
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_records_read_back);
+    RUN_TEST(test_layout_on_flash);
+    RUN_TEST(test_full_block_refuses_and_stays_intact);
+    RUN_TEST(test_damage_is_detected);
+    RUN_TEST(test_resume_after_the_newest_block);
+    return UNITY_END();
+}
@@ -0,0 +1,373 @@
+// Replays a traffic capture into the router on the host. Every record goes
+// to onSerialData, onSerial1Data, onSerialBTData or onBLEData by its source,
+// at the pace it was recorded or scaled, into the output stages, StreamTee
+// and MenuCLI wired as main.cpp wires them (and as test_soak does). The
+// output ports count what reaches them, so the run reports delivered bytes,
+// queue drops and the throughput of the whole forwarding path.
+//
+// CAPTURE_FILE=<file> replays a raw capture file, e.g. one saved with
+// tools/capture_replay.py --save; without it a synthetic capture of a 5 Hz
+// receiver and a correction client is built with CaptureBlock.
+// CAPTURE_SPEED scales the pace (default 1 for a file, 10 for the synthetic
+// capture); 0 sends as fast as possible.
+#include <unity.h>
+#include <Arduino.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "BridgeRouter.h"
+#include "CaptureBlock.h"
+#include "MenuCLI.h"
+#include "OutputForwarder.h"
+#include "PacketPool.h"
+#include "StreamTee.h"
+#include "Bench.h"
+#include "GnssTraffic.h"
+
+using BTDownlink = StreamTee<OutputForwarder>;
+using Router = BasicBridgeRouter<OutputForwarder, OutputForwarder, BTDownlink>;
+
+static constexpr size_t TX_QUEUE_SIZE = 8192;
+static constexpr uint32_t UART_BYTES_PER_SECOND = 46080; // 460800 baud, 10 bits per byte
+static constexpr uint32_t SPP_UPLINK_BYTES_PER_SECOND = 20000;
+static constexpr size_t UART_CHUNK = 120;
+static constexpr size_t SPP_CHUNK = 330;
+static constexpr unsigned PORTS = 4; // LatencyTrace ports: Serial, Serial1, SerialBT, BLE
+static const char* const PORT_NAMES[PORTS] = {"Serial", "Serial1", "SerialBT", "BLE"};
+
+// The far end of an output port; takes everything at once and counts it
+class Sink : public Stream {
+public:
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override
+    {
+        bytes += size;
+        return size;
+    }
+    using Print::write;
+    int availableForWrite() override { return 128; }
+
+    std::atomic<uint64_t> bytes{0};
+};
+
+// Ports, output stages, router and menu as main.cpp sets them up. Drain
+// tasks never exit, so each replay builds a fresh bridge and leaves it running.
+struct Bridge {
+    Sink serial, serial1, spp, ble;
+    OutputForwarder serialOut{serial, "Serial Out"};
+    OutputForwarder serial1Out{serial1, "Serial1 Out"};
+    OutputForwarder serialBTOut{spp, "SerialBT Out"};
+    OutputForwarder bleOut{ble, "BLE Out"};
+    BTDownlink btDownlink{serialBTOut, bleOut};
+    LinkCounters serialTx, serial1Tx, serialBTTx, bleTx;
+    PacketPool pool;
+    MenuCLI menu;
+    Router router{serialOut, serial1Out, btDownlink, menu};
+
+    Bridge()
+    {
+        serialOut.begin(TX_QUEUE_SIZE, 1);
+        serial1Out.begin(TX_QUEUE_SIZE, 1);
+        serialBTOut.begin(TX_QUEUE_SIZE, 0);
+        bleOut.begin(TX_QUEUE_SIZE, 0);
+        serialOut.setCounters(&serialTx);
+        serial1Out.setCounters(&serial1Tx);
+        serialBTOut.setCounters(&serialBTTx);
+        bleOut.setCounters(&bleTx);
+        serialBTOut.setCoalescing(512, 20);
+        bleOut.setCoalescing(512, 20);
+        serialBTOut.setBackpressure({OutputForwarder::KeepLatest, 75, 50});
+        bleOut.setBackpressure({OutputForwarder::KeepLatest, 75, 50});
+        serialOut.setDelimiter('\n');
+        serialBTOut.setDelimiter('\n');
+        bleOut.setDelimiter('\n');
+        pool.begin(48, 512);
+        router.setPacketPool(&pool);
+        router.setPriority(BridgeRouterBase::SerialBTInput, 1);
+        router.setUplinkMode(BridgeRouterBase::UplinkMode::Mux);
+        router.corrections().setReserve(TX_QUEUE_SIZE - 2048);
+        router.begin();
+
+        menu.attachOutput(&serialOut);
+        menu.attachOutput(&serialBTOut);
+        menu.attachOutput(&bleOut);
+        menu.setOnExit([this] { router.setState(BridgeRouterBase::State::Idle); });
+    }
+
+    void route(const CaptureRecord& record)
+    {
+        switch (record.source)
+        {
+        case 0: router.onSerialData(record.data, record.len); break;
+        case 1: router.onSerial1Data(record.data, record.len); break;
+        case 2: router.onSerialBTData(record.data, record.len); break;
+        case 3: router.onBLEData(record.data, record.len); break;
+        }
+    }
+
+    // Waits until every output stage has handed its queue to its port
+    void drain(unsigned long ms)
+    {
+        OutputForwarder* outs[] = {&serialOut, &serial1Out, &serialBTOut, &bleOut};
+        unsigned long start = millis();
+        for (int idle = 0; idle < 3 && millis() - start < ms;)
+        {
+            delay(10);
+            bool empty = true;
+            for (OutputForwarder* out : outs)
+                if (out->pending() > 0)
+                    empty = false;
+            idle = empty ? idle + 1 : 0;
+        }
+    }
+
+    uint32_t drops() const { return serialTx.drops + serial1Tx.drops + serialBTTx.drops + bleTx.drops; }
+};
+
+// The records of a capture file, oldest block first
+struct Capture {
+    std::vector<uint8_t> file;
+    std::vector<CaptureRecord> records;
+    uint64_t fed[PORTS] = {};
+    size_t blocks = 0;
+    size_t damaged = 0;
+
+    void decode()
+    {
+        CaptureResume resume;
+        size_t count = file.size() / CaptureBlock::SIZE;
+        for (size_t i = 0; i < count; ++i)
+            resume.add(&file[i * CaptureBlock::SIZE]);
+
+        // Seqs wrap, so blocks sort by their distance from the one to come
+        std::vector<std::pair<uint32_t, const uint8_t*>> valid;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const uint8_t* block = &file[i * CaptureBlock::SIZE];
+            CaptureReader reader;
+            if (reader.open(block))
+                valid.push_back({reader.seq() - resume.nextSeq(), block});
+            else if (std::any_of(block, block + 4, [](uint8_t b) { return b != 0; }))
+                damaged++;
+        }
+        std::sort(valid.begin(), valid.end());
+        blocks = valid.size();
+
+        for (const auto& entry : valid)
+        {
+            CaptureReader reader;
+            reader.open(entry.second);
+            CaptureRecord record;
+            while (reader.next(record))
+            {
+                records.push_back(record);
+                if (record.source < PORTS)
+                    fed[record.source] += record.len;
+            }
+        }
+    }
+
+    double seconds() const { return records.empty() ? 0 : (records.back().us - records.front().us) / 1e6; }
+};
+
+static bool loadFile(const char* path, Capture& capture)
+{
+    FILE* in = fopen(path, "rb");
+    if (!in)
+        return false;
+    uint8_t buffer[4096];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), in)) > 0)
+        capture.file.insert(capture.file.end(), buffer, buffer + got);
+    fclose(in);
+    capture.decode();
+    return true;
+}
+
+// Records as the capture task sees them: the receiver's epochs in UART
+// reads and the correction client's bursts in SPP reads, each paced by its
+// link. Blocks go into a ring that starts part way round, with blank slots.
+static void synthesize(unsigned seconds, unsigned rateHz, Capture& capture)
+{
+    struct Pending {
+        uint64_t us;
+        uint8_t source;
+        std::string data;
+    };
+    std::vector<Pending> pending;
+    const uint64_t startUs = 7000000;
+    for (unsigned epoch = 0; epoch < seconds * rateHz; ++epoch)
+    {
+        std::string text = gnss::epoch(epoch, 4);
+        uint64_t us = startUs + epoch * 1000000ull / rateHz;
+        for (size_t pos = 0; pos < text.size(); pos += UART_CHUNK)
+        {
+            size_t len = std::min(UART_CHUNK, text.size() - pos);
+            us += len * 1000000ull / UART_BYTES_PER_SECOND;
+            pending.push_back({us, 1, text.substr(pos, len)});
+        }
+    }
+    for (unsigned burst = 0; burst < seconds; ++burst)
+    {
+        std::vector<uint8_t> frames = gnss::rtcmEpoch((uint8_t)burst);
+        uint64_t us = startUs + burst * 1000000ull + 100000;
+        for (size_t pos = 0; pos < frames.size(); pos += SPP_CHUNK)
+        {
+            size_t len = std::min(SPP_CHUNK, frames.size() - pos);
+            us += len * 1000000ull / SPP_UPLINK_BYTES_PER_SECOND;
+            pending.push_back({us, 2, std::string((const char*)frames.data() + pos, len)});
+        }
+    }
+    std::stable_sort(pending.begin(), pending.end(), [](const Pending& a, const Pending& b) { return a.us < b.us; });
+
+    std::vector<std::vector<uint8_t>> blocks;
+    CaptureBlock block;
+    uint32_t seq = 0xFFFFFFFE; // The ring has been running for a while
+    block.start(seq++, pending.front().us);
+    for (const Pending& p : pending)
+    {
+        const uint8_t* data = (const uint8_t*)p.data.data();
+        if (block.append(p.us, p.source, data, p.data.size()))
+            continue;
+        const uint8_t* full = block.finish();
+        blocks.emplace_back(full, full + CaptureBlock::SIZE);
+        block.start(seq++, p.us);
+        TEST_ASSERT_TRUE(block.append(p.us, p.source, data, p.data.size()));
+    }
+    const uint8_t* last = block.finish();
+    blocks.emplace_back(last, last + CaptureBlock::SIZE);
+
+    size_t slots = blocks.size() + 2;
+    capture.file.assign(slots * CaptureBlock::SIZE, 0);
+    for (size_t i = 0; i < blocks.size(); ++i)
+        std::copy(blocks[i].begin(), blocks[i].end(), &capture.file[(i + 3) % slots * CaptureBlock::SIZE]);
+    capture.decode();
+}
+
+static double speed(double fallback)
+{
+    const char* env = getenv("CAPTURE_SPEED");
+    return env ? atof(env) : fallback;
+}
+
+// Feeds every record at its recorded time divided by pace, or back to back
+// for a pace of 0, and returns the seconds it took
+static double replay(Bridge& bridge, const Capture& capture, double pace)
+{
+    uint64_t start = bench::nowNs();
+    uint64_t firstUs = capture.records.empty() ? 0 : capture.records.front().us;
+    uint64_t polled = start;
+    for (const CaptureRecord& record : capture.records)
+    {
+        if (pace > 0)
+        {
+            uint64_t due = start + (uint64_t)((record.us - firstUs) * 1000 / pace);
+            uint64_t now = bench::nowNs();
+            if (due > now)
+                std::this_thread::sleep_for(std::chrono::nanoseconds(due - now));
+        }
+        bridge.route(record);
+        uint64_t now = bench::nowNs();
+        if (now - polled >= 1000000)
+        {
+            bridge.router.poll();
+            bridge.menu.poll();
+            polled = now;
+        }
+    }
+    bridge.router.poll();
+    double seconds = (bench::nowNs() - start) / 1e9;
+    bridge.drain(3000);
+    return seconds;
+}
+
+static void report(const Capture& capture, Bridge& bridge, double seconds, double pace)
+{
+    char line[200], paced[24] = "flat out";
+    if (pace > 0)
+        snprintf(paced, sizeof(paced), "at %.1fx", pace);
+    snprintf(line, sizeof(line), "%u blocks (%u damaged), %u records, %.1f s captured, replayed %s in %.2f s",
+             (unsigned)capture.blocks, (unsigned)capture.damaged, (unsigned)capture.records.size(), capture.seconds(),
+             paced, seconds);
+    TEST_MESSAGE(line);
+    for (unsigned port = 0; port < PORTS; ++port)
+    {
+        snprintf(line, sizeof(line), "  in  %-8s %8llu B", PORT_NAMES[port], (unsigned long long)capture.fed[port]);
+        TEST_MESSAGE(line);
+    }
+    const Sink* sinks[] = {&bridge.serial, &bridge.serial1, &bridge.spp, &bridge.ble};
+    const LinkCounters* counters[] = {&bridge.serialTx, &bridge.serial1Tx, &bridge.serialBTTx, &bridge.bleTx};
+    for (unsigned port = 0; port < PORTS; ++port)
+    {
+        snprintf(line, sizeof(line), "  out %-8s %8llu B %6u dropped", PORT_NAMES[port],
+                 (unsigned long long)sinks[port]->bytes.load(), (unsigned)counters[port]->drops.load());
+        TEST_MESSAGE(line);
+    }
+    uint64_t fed = capture.fed[0] + capture.fed[1] + capture.fed[2] + capture.fed[3];
+    snprintf(line, sizeof(line), "  %.2f MB/s into the router", bench::megabytesPerSecond(fed, seconds * 1e9));
+    TEST_MESSAGE(line);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Every byte of a capture taken from the links comes out where main.cpp
+// routes it: sentences to USB, SPP and BLE, corrections to the receiver
+// and mirrored to the USB console
+void test_synthetic_capture_is_delivered(void)
+{
+    Capture capture;
+    synthesize(10, 5, capture);
+    TEST_ASSERT_EQUAL_UINT32(0, capture.damaged);
+    TEST_ASSERT_GREATER_THAN(0, capture.fed[1]);
+    TEST_ASSERT_GREATER_THAN(0, capture.fed[2]);
+    // Records come back in the order they were captured, across the seq wrap
+    for (size_t i = 1; i < capture.records.size(); ++i)
+        TEST_ASSERT_TRUE(capture.records[i - 1].us <= capture.records[i].us);
+
+    Bridge* bridge = new Bridge();
+    double pace = speed(10);
+    double seconds = replay(*bridge, capture, pace);
+    report(capture, *bridge, seconds, pace);
+    if (pace == 0)
+        return; // Flat out, the SPP and BLE stages may shed sentences
+
+    TEST_ASSERT_EQUAL_UINT32(0, bridge->drops());
+    TEST_ASSERT_EQUAL_UINT64(capture.fed[1], bridge->spp.bytes.load());
+    TEST_ASSERT_EQUAL_UINT64(capture.fed[1], bridge->ble.bytes.load());
+    TEST_ASSERT_EQUAL_UINT64(capture.fed[2], bridge->serial1.bytes.load());
+    TEST_ASSERT_EQUAL_UINT64(capture.fed[1] + capture.fed[2], bridge->serial.bytes.load());
+}
+
+void test_capture_file(void)
+{
+    const char* path = getenv("CAPTURE_FILE");
+    if (!path)
+        TEST_IGNORE_MESSAGE("CAPTURE_FILE not set");
+    Capture capture;
+    TEST_ASSERT_TRUE_MESSAGE(loadFile(path, capture), path);
+    TEST_ASSERT_GREATER_THAN(0, capture.records.size());
+
+    Bridge* bridge = new Bridge();
+    double pace = speed(1);
+    double seconds = replay(*bridge, capture, pace);
+    report(capture, *bridge, seconds, pace);
+    if (pace == 0)
+        return;
+    // Corrections and USB are sized to keep up with any receiver
+    TEST_ASSERT_EQUAL_UINT32(0, bridge->serialTx.drops.load());
+    TEST_ASSERT_EQUAL_UINT32(0, bridge->serial1Tx.drops.load());
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_synthetic_capture_is_delivered);
+    RUN_TEST(test_capture_file);
+    return UNITY_END();
+}
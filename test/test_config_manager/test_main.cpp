@@ -0,0 +1,244 @@
+// ConfigManager persistence on the EEPROM shim: load and save, migration of
+// the headerless legacy layout, and how often flash is rewritten
+#include <unity.h>
+#include <Arduino.h>
+#include <EEPROM.h>
+#include "ConfigManager.h"
+
+struct TestConfig {
+    char bt_name[32] = "LC29HEA-BT";
+    uint32_t serial_baud = 460800;
+    uint32_t serial1_baud = 460800;
+    uint32_t serial1_rx = 7;
+    uint32_t serial1_tx = 8;
+    uint32_t bt_flush_ms = 20;
+    uint8_t uplink_mode = 0;
+    uint16_t rtcm_window = 2048;
+};
+
+struct LegacyConfig {
+    char bt_name[32];
+    uint32_t serial_baud;
+    uint32_t serial1_baud;
+    uint32_t serial1_rx;
+    uint32_t serial1_tx;
+};
+
+static void migrate(const uint8_t* data, TestConfig& cfg)
+{
+    LegacyConfig legacy;
+    memcpy(&legacy, data, sizeof(legacy));
+    memcpy(cfg.bt_name, legacy.bt_name, sizeof(cfg.bt_name));
+    cfg.serial_baud = legacy.serial_baud;
+    cfg.serial1_baud = legacy.serial1_baud;
+    cfg.serial1_rx = legacy.serial1_rx;
+    cfg.serial1_tx = legacy.serial1_tx;
+}
+
+// TestConfig as a release before uplink_mode and rtcm_window were appended
+struct OlderConfig {
+    char bt_name[32] = "LC29HEA-BT";
+    uint32_t serial_baud = 460800;
+    uint32_t serial1_baud = 460800;
+    uint32_t serial1_rx = 7;
+    uint32_t serial1_tx = 8;
+    uint32_t bt_flush_ms = 20;
+};
+
+// What the first firmware left in flash: the struct and its CRC32
+static void storeLegacy(const LegacyConfig& legacy, bool corrupt = false)
+{
+    std::vector<uint8_t>& flash = EEPROM.flash();
+    flash.assign(sizeof(legacy) + sizeof(uint32_t), 0);
+    memcpy(flash.data(), &legacy, sizeof(legacy));
+    uint32_t crc = CRC32::calculate(flash.data(), sizeof(legacy));
+    memcpy(flash.data() + sizeof(legacy), &crc, sizeof(crc));
+    if (corrupt) flash[3] ^= 1;
+}
+
+void setUp(void) { EEPROM.erase(); }
+void tearDown(void) {}
+
+void test_fresh_flash_gets_the_defaults(void)
+{
+    TestConfig config;
+    ConfigManager<TestConfig> manager(0);
+    TEST_ASSERT_FALSE(manager.begin(&config));
+    TEST_ASSERT_EQUAL_UINT32(1, EEPROM.commits());
+    // The blob is the struct plus header and CRC, not a fixed 4 KB region
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(TestConfig) + 12, EEPROM.flash().size());
+
+    EEPROM.reboot();
+    TestConfig reloaded;
+    ConfigManager<TestConfig> again(0);
+    TEST_ASSERT_TRUE(again.begin(&reloaded));
+}
+
+void test_saved_settings_survive_a_reboot(void)
+{
+    TestConfig config;
+    ConfigManager<TestConfig> manager(0);
+    manager.begin(&config);
+    strcpy(config.bt_name, "Rover");
+    config.serial1_baud = 115200;
+    manager.save();
+
+    EEPROM.reboot();
+    TestConfig reloaded;
+    ConfigManager<TestConfig> again(0);
+    TEST_ASSERT_TRUE(again.begin(&reloaded));
+    TEST_ASSERT_EQUAL_STRING("Rover", reloaded.bt_name);
+    TEST_ASSERT_EQUAL_UINT32(115200, reloaded.serial1_baud);
+}
+
+void test_damaged_copy_falls_back_to_defaults(void)
+{
+    TestConfig config;
+    ConfigManager<TestConfig> manager(0);
+    manager.begin(&config);
+    config.serial_baud = 9600;
+    manager.save();
+    EEPROM.flash()[12] ^= 0x40;
+
+    EEPROM.reboot();
+    TestConfig reloaded;
+    ConfigManager<TestConfig> again(0);
+    TEST_ASSERT_FALSE(again.begin(&reloaded));
+    TEST_ASSERT_EQUAL_UINT32(460800, reloaded.serial_baud);
+}
+
+void test_legacy_copy_is_migrated(void)
+{
+    LegacyConfig legacy = {"Base-7", 115200, 921600, 16, 17};
+    storeLegacy(legacy);
+
+    TestConfig config;
+    ConfigManager<TestConfig> manager(0);
+    manager.setLegacy(sizeof(LegacyConfig), migrate);
+    TEST_ASSERT_TRUE(manager.begin(&config));
+    TEST_ASSERT_EQUAL_STRING("Base-7", config.bt_name);
+    TEST_ASSERT_EQUAL_UINT32(115200, config.serial_baud);
+    TEST_ASSERT_EQUAL_UINT32(921600, config.serial1_baud);
+    TEST_ASSERT_EQUAL_UINT32(16, config.serial1_rx);
+    TEST_ASSERT_EQUAL_UINT32(17, config.serial1_tx);
+    TEST_ASSERT_EQUAL_UINT32(20, config.bt_flush_ms);
+    TEST_ASSERT_EQUAL_UINT16(2048, config.rtcm_window);
+
+    // Stored in the current layout straight away
+    EEPROM.reboot();
+    TestConfig reloaded;
+    ConfigManager<TestConfig> again(0);
+    TEST_ASSERT_TRUE(again.begin(&reloaded));
+    TEST_ASSERT_EQUAL_STRING("Base-7", reloaded.bt_name);
+    TEST_ASSERT_EQUAL_UINT32(921600, reloaded.serial1_baud);
+}
+
+void test_damaged_legacy_copy_is_ignored(void)
+{
+    LegacyConfig legacy = {"Base-7", 115200, 921600, 16, 17};
+    storeLegacy(legacy, true);
+
+    TestConfig config;
+    ConfigManager<TestConfig> manager(0);
+    manager.setLegacy(sizeof(LegacyConfig), migrate);
+    TEST_ASSERT_FALSE(manager.begin(&config));
+    TEST_ASSERT_EQUAL_STRING("LC29HEA-BT", config.bt_name);
+}
+
+void test_older_layout_keeps_its_settings(void)
+{
+    OlderConfig older;
+    ConfigManager<OlderConfig> oldManager(0);
+    oldManager.begin(&older);
+    strcpy(older.bt_name, "Rover");
+    older.serial1_baud = 921600;
+    older.bt_flush_ms = 5;
+    oldManager.save();
+
+    // The upgrade keeps every stored field and defaults the new ones
+    EEPROM.reboot();
+    TestConfig config;
+    ConfigManager<TestConfig> manager(0);
+    TEST_ASSERT_TRUE(manager.begin(&config));
+    TEST_ASSERT_EQUAL_STRING("Rover", config.bt_name);
+    TEST_ASSERT_EQUAL_UINT32(921600, config.serial1_baud);
+    TEST_ASSERT_EQUAL_UINT32(5, config.bt_flush_ms);
+    TEST_ASSERT_EQUAL_UINT8(0, config.uplink_mode);
+    TEST_ASSERT_EQUAL_UINT16(2048, config.rtcm_window);
+
+    // And is stored in the new layout
+    EEPROM.reboot();
+    TestConfig reloaded;
+    ConfigManager<TestConfig> again(0);
+    TEST_ASSERT_TRUE(again.begin(&reloaded));
+    TEST_ASSERT_EQUAL_UINT32(921600, reloaded.serial1_baud);
+    TEST_ASSERT_EQUAL_UINT32(sizeof(TestConfig) + 12, EEPROM.flash().size());
+}
+
+void test_damaged_older_layout_falls_back_to_defaults(void)
+{
+    OlderConfig older;
+    ConfigManager<OlderConfig> oldManager(0);
+    oldManager.begin(&older);
+    older.serial1_baud = 921600;
+    oldManager.save();
+    EEPROM.flash()[20] ^= 0x01;
+
+    EEPROM.reboot();
+    TestConfig config;
+    ConfigManager<TestConfig> manager(0);
+    TEST_ASSERT_FALSE(manager.begin(&config));
+    TEST_ASSERT_EQUAL_UINT32(460800, config.serial1_baud);
+}
+
+// A menu session of edits costs one commit once the delay has passed
+void test_deferred_saves_coalesce_into_one_commit(void)
+{
+    TestConfig config;
+    ConfigManager<TestConfig> manager(0);
+    manager.begin(&config);
+    manager.setCommitDelay(5000);
+    EEPROM.resetCounters();
+
+    for (uint32_t i = 0; i < 20; ++i)
+    {
+        config.bt_flush_ms = i;
+        manager.save();
+        manager.poll();
+    }
+    TEST_ASSERT_TRUE(manager.pending());
+    TEST_ASSERT_EQUAL_UINT32(0, EEPROM.commits());
+
+    shim::advanceMillis(5000);
+    manager.poll();
+    TEST_ASSERT_FALSE(manager.pending());
+    TEST_ASSERT_EQUAL_UINT32(1, EEPROM.commits());
+    TEST_ASSERT_EQUAL_UINT32(0, EEPROM.begins());
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(TestConfig) + 12, EEPROM.bytesWritten());
+}
+
+void test_unchanged_save_does_not_touch_flash(void)
+{
+    TestConfig config;
+    ConfigManager<TestConfig> manager(0);
+    manager.begin(&config);
+    EEPROM.resetCounters();
+    manager.save();
+    manager.save();
+    TEST_ASSERT_EQUAL_UINT32(0, EEPROM.commits());
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fresh_flash_gets_the_defaults);
+    RUN_TEST(test_saved_settings_survive_a_reboot);
+    RUN_TEST(test_damaged_copy_falls_back_to_defaults);
+    RUN_TEST(test_legacy_copy_is_migrated);
+    RUN_TEST(test_damaged_legacy_copy_is_ignored);
+    RUN_TEST(test_older_layout_keeps_its_settings);
+    RUN_TEST(test_damaged_older_layout_falls_back_to_defaults);
+    RUN_TEST(test_deferred_saves_coalesce_into_one_commit);
+    RUN_TEST(test_unchanged_save_does_not_touch_flash);
+    return UNITY_END();
+}
@@ -0,0 +1,105 @@
+// CRC32 check values, the table and ROM backends against a bitwise
+// reference at every alignment, and their speed. On the host the ROM
+// routine is the shim's bitwise version, which still checks the inversions
+// around the ROM call.
+#include <unity.h>
+#include <string.h>
+#include <vector>
+#include "CRC32.h"
+#include "Bench.h"
+
+static uint32_t reference(const uint8_t* data, size_t len)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    while (len--)
+    {
+        crc ^= *data++;
+        for (int bit = 0; bit < 8; ++bit)
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+    }
+    return ~crc;
+}
+
+static uint32_t crcOf(const char* text) { return CRC32::calculate((const uint8_t*)text, strlen(text)); }
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_check_values(void)
+{
+    TEST_ASSERT_EQUAL_HEX32(0x00000000, crcOf(""));
+    TEST_ASSERT_EQUAL_HEX32(0xE8B7BE43, crcOf("a"));
+    TEST_ASSERT_EQUAL_HEX32(0x352441C2, crcOf("abc"));
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, crcOf("123456789"));
+    TEST_ASSERT_EQUAL_HEX32(0x414FA339, crcOf("The quick brown fox jumps over the lazy dog"));
+    uint8_t zeros[32] = {}, ones[32];
+    memset(ones, 0xFF, sizeof(ones));
+    TEST_ASSERT_EQUAL_HEX32(0x190A55AD, CRC32::calculate(zeros, sizeof(zeros)));
+    TEST_ASSERT_EQUAL_HEX32(0xFF6CAB0B, CRC32::calculate(ones, sizeof(ones)));
+}
+
+// Every length up to a few steps, from every offset within an eight-byte
+// word, and split at every point for the incremental form
+void test_backends_agree_at_unaligned_lengths(void)
+{
+    std::vector<uint8_t> buffer(8 + 300);
+    for (size_t i = 0; i < buffer.size(); ++i)
+        buffer[i] = (uint8_t)(i * 151 + 7);
+    for (size_t offset = 0; offset < 8; ++offset)
+    {
+        for (size_t len = 0; len <= 300; ++len)
+        {
+            const uint8_t* data = buffer.data() + offset;
+            uint32_t expected = reference(data, len);
+            char where[48];
+            snprintf(where, sizeof(where), "offset %u length %u", (unsigned)offset, (unsigned)len);
+            TEST_ASSERT_EQUAL_HEX32_MESSAGE(expected, ~CRC32::updateTables(0xFFFFFFFF, data, len), where);
+            TEST_ASSERT_EQUAL_HEX32_MESSAGE(expected, ~CRC32::updateRom(0xFFFFFFFF, data, len), where);
+            TEST_ASSERT_EQUAL_HEX32_MESSAGE(expected, CRC32::calculate(data, len), where);
+            size_t split = len / 3;
+            uint32_t tables = CRC32::updateTables(CRC32::updateTables(0xFFFFFFFF, data, split), data + split, len - split);
+            uint32_t rom = CRC32::updateRom(CRC32::updateRom(0xFFFFFFFF, data, split), data + split, len - split);
+            TEST_ASSERT_EQUAL_HEX32_MESSAGE(expected, ~tables, where);
+            TEST_ASSERT_EQUAL_HEX32_MESSAGE(expected, ~rom, where);
+        }
+    }
+}
+
+static volatile uint32_t sink; // Keeps the timed loops from being optimised away
+
+static double measure(uint32_t (*update)(uint32_t, const uint8_t*, size_t), const std::vector<uint8_t>& data, int rounds)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    uint64_t start = bench::nowNs();
+    for (int i = 0; i < rounds; ++i)
+        crc = update(crc, data.data(), data.size());
+    uint64_t ns = bench::nowNs() - start;
+    sink = crc;
+    return bench::megabytesPerSecond((uint64_t)data.size() * rounds, ns);
+}
+
+static uint32_t bitwise(uint32_t crc, const uint8_t* data, size_t len) { return ~reference(data, len) ^ crc ^ crc; }
+
+void test_speed(void)
+{
+    // The size of the stored config, and a larger block
+    for (size_t size : {sizeof(uint32_t) * 64, (size_t)4096})
+    {
+        std::vector<uint8_t> data(size, 0x5A);
+        int rounds = (int)((64u << 20) / size);
+        char line[160];
+        snprintf(line, sizeof(line), "%u byte blocks: tables %.0f MB/s, rom %.0f MB/s, bitwise %.0f MB/s",
+                 (unsigned)size, measure(CRC32::updateTables, data, rounds), measure(CRC32::updateRom, data, rounds / 8),
+                 measure(bitwise, data, rounds / 8));
+        TEST_MESSAGE(line);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_check_values);
+    RUN_TEST(test_backends_agree_at_unaligned_lengths);
+    RUN_TEST(test_speed);
+    return UNITY_END();
+}
@@ -0,0 +1,264 @@
+// GnssCommandQueue driven the way the router task drives it, on a synthetic
+// clock: ready() whenever Serial1 may be written, sentSentence() after the
+// write, and every receiver sentence through onSentence(). Covers PAIR and
+// PQTM replies, the query reply that follows an acknowledgement, timeouts,
+// busy receivers and what clear() and a full queue keep.
+#include <unity.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "GnssCommand.h"
+#include "GnssTraffic.h"
+
+using Command = GnssCommandQueue::Command;
+using Status = GnssCommandQueue::Status;
+
+struct Receiver {
+    GnssCommandQueue queue;
+    uint32_t now = 0;
+    std::vector<std::string> notified; // "<name> <status>" per handler call
+
+    Receiver() { queue.setHandler(onCommand, this); }
+
+    bool push(const char* text) { return queue.push(text, strlen(text), now); }
+
+    // Writes the command that is due; fails if none is
+    std::string send()
+    {
+        const Command* command = queue.ready(now);
+        TEST_ASSERT_NOT_NULL(command);
+        std::string sentence(command->sentence, command->len);
+        queue.sentSentence(now);
+        return sentence;
+    }
+
+    bool reply(const char* body)
+    {
+        std::string sentence = gnss::sentence(body);
+        return queue.onSentence((const uint8_t*)sentence.data(), sentence.size(), now);
+    }
+
+    const Command& last() const { return queue.at(queue.size() - 1); }
+
+    static void onCommand(void* ctx, const Command& command)
+    {
+        static_cast<Receiver*>(ctx)->notified.push_back(std::string(command.name) + " " +
+                                                        GnssCommandQueue::statusName(command.status));
+    }
+};
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_pair_result_codes(void)
+{
+    Receiver rx;
+    TEST_ASSERT_TRUE(rx.push("PAIR050,1000"));
+    TEST_ASSERT_TRUE(rx.send() == gnss::sentence("PAIR050,1000"));
+    // Acknowledgements of other commands are not ours
+    TEST_ASSERT_FALSE(rx.reply("PAIR001,062,0"));
+    rx.now = 40;
+    TEST_ASSERT_TRUE(rx.reply("PAIR001,050,0"));
+    TEST_ASSERT_EQUAL(Status::Ok, rx.queue.at(0).status);
+    TEST_ASSERT_EQUAL_INT(0, rx.queue.at(0).code);
+    TEST_ASSERT_EQUAL_UINT32(40, rx.queue.at(0).doneAt);
+
+    // 1: still processing, the timeout starts over
+    rx.push("PAIR062,0,1");
+    rx.send();
+    rx.now = 900;
+    TEST_ASSERT_TRUE(rx.reply("PAIR001,062,1"));
+    TEST_ASSERT_EQUAL(Status::Sent, rx.last().status);
+    rx.now = 1500;
+    TEST_ASSERT_NULL(rx.queue.ready(rx.now));
+    TEST_ASSERT_EQUAL_UINT32(1, rx.last().tries);
+    TEST_ASSERT_TRUE(rx.reply("PAIR001,062,0"));
+    TEST_ASSERT_EQUAL(Status::Ok, rx.last().status);
+
+    // 5: busy, sent again after the back-off
+    rx.push("PAIR066,1,1,1,1,0,0");
+    rx.send();
+    TEST_ASSERT_TRUE(rx.reply("PAIR001,066,5"));
+    TEST_ASSERT_EQUAL(Status::Queued, rx.last().status);
+    TEST_ASSERT_NULL(rx.queue.ready(rx.now));
+    rx.now += 100;
+    rx.send();
+    TEST_ASSERT_EQUAL_UINT32(2, rx.last().tries);
+
+    // Anything else fails the command with its code
+    TEST_ASSERT_TRUE(rx.reply("PAIR001,066,3"));
+    TEST_ASSERT_EQUAL(Status::Failed, rx.last().status);
+    TEST_ASSERT_EQUAL_INT(3, rx.last().code);
+    TEST_ASSERT_EQUAL_UINT32(1, rx.queue.failed());
+    TEST_ASSERT_FALSE(rx.queue.busy());
+    TEST_ASSERT_EQUAL_UINT32(3, rx.notified.size());
+    TEST_ASSERT_TRUE(rx.notified[2] == "PAIR066 failed");
+}
+
+void test_pqtm_ok_and_error(void)
+{
+    Receiver rx;
+    rx.push("$PQTMSAVEPAR*5A\r\n");
+    TEST_ASSERT_TRUE(rx.send() == gnss::sentence("PQTMSAVEPAR"));
+    // Replies to other commands and receiver output pass through
+    TEST_ASSERT_FALSE(rx.reply("PQTMCFGMSGRATE,OK"));
+    TEST_ASSERT_FALSE(rx.reply("GNGGA,000000.00,,,,,0,00,99.99,,,,,,"));
+    TEST_ASSERT_TRUE(rx.reply("PQTMSAVEPAR,OK"));
+    TEST_ASSERT_EQUAL(Status::Ok, rx.last().status);
+    TEST_ASSERT_EQUAL_INT(-1, rx.last().code);
+    TEST_ASSERT_EQUAL_STRING("$PQTMSAVEPAR,OK", rx.last().reply);
+
+    rx.push("PQTMCFGMSGRATE,W,GGA,1");
+    rx.send();
+    TEST_ASSERT_TRUE(rx.reply("PQTMCFGMSGRATE,ERROR,3"));
+    TEST_ASSERT_EQUAL(Status::Failed, rx.last().status);
+    TEST_ASSERT_EQUAL_INT(3, rx.last().code);
+    TEST_ASSERT_EQUAL_STRING("$PQTMCFGMSGRATE,ERROR,3", rx.last().reply);
+    TEST_ASSERT_EQUAL_UINT32(1, rx.queue.failed());
+}
+
+// A PAIR query is acknowledged first and answered by its own sentence after
+void test_query_reply_follows_the_ack(void)
+{
+    Receiver rx;
+    rx.push("PAIR051");
+    rx.push("PAIR050,500");
+    rx.send();
+    TEST_ASSERT_TRUE(rx.reply("PAIR001,051,0"));
+    TEST_ASSERT_EQUAL(Status::Ok, rx.queue.at(0).status);
+    TEST_ASSERT_EQUAL_STRING("", rx.queue.at(0).reply);
+
+    // The next command may already be on its way when the answer comes
+    rx.send();
+    TEST_ASSERT_TRUE(rx.reply("PAIR051,1000"));
+    TEST_ASSERT_EQUAL_STRING("$PAIR051,1000", rx.queue.at(0).reply);
+    TEST_ASSERT_EQUAL(Status::Sent, rx.queue.at(1).status);
+    TEST_ASSERT_EQUAL_UINT32(2, rx.notified.size());
+    TEST_ASSERT_TRUE(rx.notified[0] == "PAIR051 ok");
+    TEST_ASSERT_TRUE(rx.notified[1] == "PAIR051 ok");
+
+    // Only once
+    TEST_ASSERT_FALSE(rx.reply("PAIR051,1000"));
+    TEST_ASSERT_TRUE(rx.reply("PAIR001,050,0"));
+    TEST_ASSERT_EQUAL_STRING("", rx.queue.at(1).reply);
+}
+
+void test_timeout_resends_up_to_the_retry_limit(void)
+{
+    Receiver rx;
+    rx.now = 0xFFFFFC00; // Across the millis() wrap
+    rx.queue.setTimeout(1000);
+    rx.queue.setRetries(2);
+    rx.push("PQTMCFGRCVRMODE,W,1");
+    rx.push("PQTMSAVEPAR");
+    rx.send();
+
+    rx.now += 999;
+    TEST_ASSERT_NULL(rx.queue.ready(rx.now));
+    rx.now += 1;
+    rx.send();
+    rx.now += 1000;
+    rx.send();
+    TEST_ASSERT_EQUAL_UINT32(3, rx.queue.at(0).tries);
+    TEST_ASSERT_EQUAL(Status::Sent, rx.queue.at(0).status);
+
+    // Out of tries: it times out and the next command is due at once
+    rx.now += 1000;
+    TEST_ASSERT_TRUE(rx.send() == gnss::sentence("PQTMSAVEPAR"));
+    TEST_ASSERT_EQUAL(Status::Timeout, rx.queue.at(0).status);
+    TEST_ASSERT_EQUAL_UINT32(rx.now, rx.queue.at(0).doneAt);
+    TEST_ASSERT_EQUAL_UINT32(4, rx.queue.sent());
+    TEST_ASSERT_EQUAL_UINT32(2, rx.queue.retried());
+    TEST_ASSERT_EQUAL_UINT32(1, rx.queue.failed());
+    // A late reply no longer counts
+    TEST_ASSERT_FALSE(rx.reply("PQTMCFGRCVRMODE,OK"));
+}
+
+void test_busy_receiver_backs_off(void)
+{
+    Receiver rx;
+    rx.now = 1000;
+    rx.queue.setRetries(1);
+    rx.push("PAIR432,1");
+    rx.send();
+    TEST_ASSERT_TRUE(rx.reply("PAIR001,432,5"));
+    TEST_ASSERT_TRUE(rx.queue.busy());
+    rx.now += 99;
+    TEST_ASSERT_NULL(rx.queue.ready(rx.now));
+    rx.now += 1;
+    rx.send();
+
+    // Still busy after the last try: it fails with the busy code
+    TEST_ASSERT_TRUE(rx.reply("PAIR001,432,5"));
+    TEST_ASSERT_EQUAL(Status::Failed, rx.last().status);
+    TEST_ASSERT_EQUAL_INT(5, rx.last().code);
+    TEST_ASSERT_EQUAL_UINT32(2, rx.last().tries);
+    TEST_ASSERT_EQUAL_UINT32(1, rx.queue.retried());
+}
+
+void test_clear_keeps_the_command_in_flight(void)
+{
+    Receiver rx;
+    rx.push("PAIR050,1000");
+    rx.push("PAIR062,0,1");
+    rx.push("PAIR062,1,1");
+    rx.send();
+    rx.queue.clear();
+    TEST_ASSERT_EQUAL_UINT32(1, rx.queue.pending());
+
+    TEST_ASSERT_TRUE(rx.reply("PAIR001,050,0"));
+    TEST_ASSERT_FALSE(rx.queue.busy());
+    TEST_ASSERT_NULL(rx.queue.ready(rx.now));
+    TEST_ASSERT_EQUAL_UINT32(1, rx.queue.size());
+
+    // Nothing sent yet: all of it goes
+    rx.push("PAIR062,2,1");
+    rx.push("PAIR062,3,1");
+    rx.queue.clear();
+    TEST_ASSERT_EQUAL_UINT32(0, rx.queue.pending());
+    TEST_ASSERT_EQUAL_UINT32(1, rx.queue.size());
+}
+
+void test_full_queue_forgets_finished_commands(void)
+{
+    Receiver rx;
+    char text[32];
+    for (size_t i = 0; i < 2; ++i)
+    {
+        snprintf(text, sizeof(text), "PAIR062,%u,1", (unsigned)i);
+        rx.push(text);
+        rx.send();
+        rx.reply("PAIR001,062,0");
+    }
+    for (size_t i = 2; i < GnssCommandQueue::MAX_COMMANDS; ++i)
+    {
+        snprintf(text, sizeof(text), "PAIR062,%u,1", (unsigned)i);
+        TEST_ASSERT_TRUE(rx.push(text));
+    }
+    TEST_ASSERT_EQUAL_UINT32(GnssCommandQueue::MAX_COMMANDS, rx.queue.size());
+
+    // Each push past the end takes the oldest finished command's slot
+    TEST_ASSERT_TRUE(rx.push("PAIR062,32,1"));
+    TEST_ASSERT_TRUE(rx.queue.at(0).sentence == gnss::sentence("PAIR062,1,1"));
+    TEST_ASSERT_TRUE(rx.push("PAIR062,33,1"));
+    TEST_ASSERT_TRUE(rx.queue.at(0).sentence == gnss::sentence("PAIR062,2,1"));
+    TEST_ASSERT_EQUAL_UINT32(GnssCommandQueue::MAX_COMMANDS, rx.queue.size());
+    TEST_ASSERT_EQUAL_UINT32(GnssCommandQueue::MAX_COMMANDS, rx.queue.pending());
+
+    // Pending commands are never dropped
+    TEST_ASSERT_FALSE(rx.push("PAIR062,34,1"));
+    TEST_ASSERT_TRUE(rx.last().sentence == gnss::sentence("PAIR062,33,1"));
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_pair_result_codes);
+    RUN_TEST(test_pqtm_ok_and_error);
+    RUN_TEST(test_query_reply_follows_the_ack);
+    RUN_TEST(test_timeout_resends_up_to_the_retry_limit);
+    RUN_TEST(test_busy_receiver_backs_off);
+    RUN_TEST(test_clear_keeps_the_command_in_flight);
+    RUN_TEST(test_full_queue_forgets_finished_commands);
+    return UNITY_END();
+}
@@ -0,0 +1,229 @@
+// Heap use and dispatch time of MenuCLI's static command table against the
+// registerCommand() map it replaces, for the same set of commands. The host
+// String keeps short text inline like the ESP32 one, so allocation counts
+// are comparable in kind, not byte for byte.
+#include <unity.h>
+#include <Arduino.h>
+#include <atomic>
+#include <new>
+#include <string>
+#include "MenuCLI.h"
+#include "Bench.h"
+
+static std::atomic<size_t> allocations{0};
+static std::atomic<size_t> allocatedBytes{0};
+
+void* operator new(size_t size)
+{
+    allocations++;
+    allocatedBytes += size;
+    void* p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// Output sink that takes everything and keeps nothing
+class NullStream : public Stream {
+public:
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    size_t write(uint8_t) override { return 1; }
+    size_t write(const uint8_t*, size_t size) override { return size; }
+    int availableForWrite() override { return 4096; }
+    using Print::write;
+};
+
+// Output sink that keeps what it is given
+class CaptureStream : public NullStream {
+public:
+    std::string text;
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override
+    {
+        text.append((const char*)buffer, size);
+        return size;
+    }
+    using Print::write;
+};
+
+static volatile long checksum;
+
+static void tableHandler(MenuCLI::Args args, Stream& out)
+{
+    checksum += args.len + args.nextWord().toInt();
+}
+
+// The command names main.cpp registers, sorted
+static constexpr MenuCLI::Command commands[] = {
+    {"autobaud", "Auto-baud on boot [on|off|run]", tableHandler},
+    {"ble stats", "BLE link statistics", tableHandler},
+    {"bt backpressure", "Set BT backpressure policy", tableHandler},
+    {"bt coalesce", "Set BT coalescing", tableHandler},
+    {"bt name", "Set Bluetooth name", tableHandler},
+    {"capture", "Traffic capture [start|stop|dump]", tableHandler},
+    {"config", "Show config", tableHandler},
+    {"filter", "Per-output sentence filter", tableHandler},
+    {"gnss", "Queue receiver commands", tableHandler},
+    {"latency", "Latency report", tableHandler},
+    {"nmea stats", "NMEA framer statistics", tableHandler},
+    {"pool", "Packet pool statistics", tableHandler},
+    {"power", "CPU clock policy", tableHandler},
+    {"restart", "Restart the device", tableHandler},
+    {"rtcm", "RTCM statistics", tableHandler},
+    {"serial backpressure", "Set Serial backpressure policy", tableHandler},
+    {"serial baud", "Set Serial baud", tableHandler},
+    {"serial1 baud", "Set Serial1 baud", tableHandler},
+    {"serial1 pins", "Set Serial1 pins", tableHandler},
+    {"stats", "Bridge statistics", tableHandler},
+    {"stats reset", "Reset statistics", tableHandler},
+    {"uplink", "Uplink mode and priorities", tableHandler},
+};
+static constexpr size_t COMMAND_COUNT = sizeof(commands) / sizeof(commands[0]);
+static_assert(MenuCLI::isSorted(commands, COMMAND_COUNT), "commands must be sorted");
+
+static const char* lines[] = {
+    "stats\n",
+    "bt coalesce 512 20\n",
+    "serial1 baud 921600\n",
+    "filter bt GSV 5\n",
+    "gnss PAIR062,0,1\n",
+    "uplink mux\n",
+    "stats reset\n",
+    "serial backpressure oldest 80 40\n",
+};
+static constexpr size_t LINE_COUNT = sizeof(lines) / sizeof(lines[0]);
+
+struct Result {
+    size_t setupAllocations;
+    size_t setupBytes;
+    double allocationsPerLine;
+    double nsPerLine;
+};
+
+static Result run(bool table)
+{
+    static constexpr size_t ROUNDS = 20000;
+    NullStream sink;
+    Result result = {};
+
+    MenuCLI menu;
+    menu.attachOutput(&sink);
+    menu.setEcho(false);
+    size_t a0 = allocations, b0 = allocatedBytes;
+    if (table)
+        menu.setCommandTable(commands);
+    else
+        for (const MenuCLI::Command& command : commands)
+        {
+            MenuCLI::TableHandler handler = command.handler;
+            menu.registerCommand(command.name, command.help, [handler](const String& args, Stream& out) {
+                handler(MenuCLI::Args{args.c_str(), args.length()}, out);
+            });
+        }
+    result.setupAllocations = allocations - a0;
+    result.setupBytes = allocatedBytes - b0;
+
+    // Warm up, then count
+    for (const char* line : lines)
+        menu.write((const uint8_t*)line, strlen(line));
+    size_t before = allocations;
+    uint64_t start = bench::nowNs();
+    for (size_t round = 0; round < ROUNDS; ++round)
+    {
+        const char* line = lines[round % LINE_COUNT];
+        menu.write((const uint8_t*)line, strlen(line));
+    }
+    uint64_t ns = bench::nowNs() - start;
+    result.allocationsPerLine = (double)(allocations - before) / ROUNDS;
+    result.nsPerLine = (double)ns / ROUNDS;
+    return result;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_table_dispatch_finds_longest_match(void)
+{
+    static const char* seen;
+    static const MenuCLI::Command table[] = {
+        {"stats", "", [](MenuCLI::Args, Stream&) { seen = "stats"; }},
+        {"stats reset", "", [](MenuCLI::Args, Stream&) { seen = "stats reset"; }},
+    };
+    NullStream sink;
+    MenuCLI menu;
+    menu.attachOutput(&sink);
+    menu.setCommandTable(table);
+    menu.write((const uint8_t*)"stats reset\n", 12);
+    TEST_ASSERT_EQUAL_STRING("stats reset", seen);
+    menu.write((const uint8_t*)"stats   \n", 9);
+    TEST_ASSERT_EQUAL_STRING("stats", seen);
+    seen = nullptr;
+    menu.write((const uint8_t*)"statsreset\n", 11);
+    TEST_ASSERT_NULL(seen);
+}
+
+void test_long_batch_and_overflow(void)
+{
+    static size_t argsLen;
+    static int calls;
+    static const MenuCLI::Command table[] = {
+        {"gnss", "", [](MenuCLI::Args args, Stream&) { argsLen = args.len; calls++; }},
+    };
+    CaptureStream sink;
+    MenuCLI menu;
+    menu.attachOutput(&sink);
+    menu.setEcho(false);
+    menu.setCommandTable(table);
+
+    // A pasted batch well past the old 128 characters arrives whole
+    std::string batch;
+    while (batch.size() < 300)
+        batch += "PAIR062,0,1;PAIR062,2,0;PQTMCFGSAT,R,1;";
+    std::string line = "gnss " + batch + "\n";
+    menu.write((const uint8_t*)line.data(), line.size());
+    TEST_ASSERT_EQUAL(1, calls);
+    TEST_ASSERT_EQUAL_size_t(batch.size(), argsLen);
+
+    // One character too many: nothing runs, the error says why
+    line = "gnss " + std::string(MenuCLI::LINE_BUFFER_SIZE - 5, 'X') + "\n";
+    menu.write((const uint8_t*)line.data(), line.size());
+    menu.flush();
+    TEST_ASSERT_EQUAL(1, calls);
+    TEST_ASSERT_TRUE(sink.text.find("ERROR: Line longer than 511 characters") != std::string::npos);
+
+    // The next line is back to normal
+    menu.write((const uint8_t*)"gnss\n", 5);
+    TEST_ASSERT_EQUAL(2, calls);
+    TEST_ASSERT_EQUAL_size_t(0, argsLen);
+}
+
+void test_heap_and_dispatch_time(void)
+{
+    Result map = run(false);
+    Result table = run(true);
+    char line[200];
+    snprintf(line, sizeof(line), "registerCommand map: %u allocations (%u bytes) to register, %.2f per line, %.0f ns per line",
+             (unsigned)map.setupAllocations, (unsigned)map.setupBytes, map.allocationsPerLine, map.nsPerLine);
+    TEST_MESSAGE(line);
+    snprintf(line, sizeof(line), "static table:        %u allocations (%u bytes) to register, %.2f per line, %.0f ns per line",
+             (unsigned)table.setupAllocations, (unsigned)table.setupBytes, table.allocationsPerLine, table.nsPerLine);
+    TEST_MESSAGE(line);
+
+    // The point of the table: nothing allocated per command or per line
+    TEST_ASSERT_EQUAL_size_t(0, table.setupAllocations);
+    TEST_ASSERT_EQUAL_UINT32(0, (uint32_t)(table.allocationsPerLine * 1000));
+    TEST_ASSERT_GREATER_THAN(table.setupAllocations, map.setupAllocations);
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_table_dispatch_finds_longest_match);
+    RUN_TEST(test_long_batch_and_overflow);
+    RUN_TEST(test_heap_and_dispatch_time);
+    return UNITY_END();
+}
@@ -0,0 +1,133 @@
+// NmeaFramer behaviour on split, corrupt and oversized input, and its parse
+// speed in MB/s
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "NmeaFramer.h"
+#include "Bench.h"
+#include "GnssTraffic.h"
+
+static std::vector<std::string> sentences;
+
+static void collect(void* ctx, const uint8_t* sentence, size_t len)
+{
+    sentences.emplace_back((const char*)sentence, len);
+}
+
+static void count(void* ctx, const uint8_t* sentence, size_t len)
+{
+    (*static_cast<size_t*>(ctx)) += len;
+}
+
+void setUp(void) { sentences.clear(); }
+void tearDown(void) {}
+
+void test_sentence_split_at_every_byte(void)
+{
+    std::string gga = gnss::sentence("GNGGA,123519.00,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,");
+    NmeaFramer framer;
+    for (char c : gga)
+        framer.feed((const uint8_t*)&c, 1, collect, nullptr);
+    TEST_ASSERT_EQUAL_size_t(1, sentences.size());
+    TEST_ASSERT_EQUAL_STRING(gga.c_str(), sentences[0].c_str());
+    TEST_ASSERT_EQUAL_UINT32(1, framer.sentences());
+    TEST_ASSERT_EQUAL_UINT32(0, framer.corrupt());
+}
+
+void test_bad_checksum_is_counted_and_dropped(void)
+{
+    std::string good = gnss::sentence("GNVTG,0.0,T,,M,0.01,N,0.02,K,R");
+    std::string bad = good;
+    bad[3] ^= 1;
+    std::string input = bad + good;
+    NmeaFramer framer;
+    framer.feed((const uint8_t*)input.data(), input.size(), collect, nullptr);
+    TEST_ASSERT_EQUAL_size_t(1, sentences.size());
+    TEST_ASSERT_EQUAL_STRING(good.c_str(), sentences[0].c_str());
+    TEST_ASSERT_EQUAL_UINT32(1, framer.corrupt());
+}
+
+void test_dollar_restarts_a_broken_sentence(void)
+{
+    std::string good = gnss::sentence("GNGLL,4807.038,N,01131.000,E,123519.00,A,A");
+    std::string input = "$GNGSA,A,3,04,05" + good;
+    NmeaFramer framer;
+    framer.feed((const uint8_t*)input.data(), input.size(), collect, nullptr);
+    TEST_ASSERT_EQUAL_size_t(1, sentences.size());
+    TEST_ASSERT_EQUAL_STRING(good.c_str(), sentences[0].c_str());
+    TEST_ASSERT_EQUAL_UINT32(1, framer.corrupt());
+}
+
+void test_junk_between_sentences_is_skipped(void)
+{
+    std::string good = gnss::sentence("PAIR001,062,0");
+    std::string input = "\xD3" "garbage" + good + "\r\n";
+    NmeaFramer framer;
+    framer.feed((const uint8_t*)input.data(), input.size(), collect, nullptr);
+    TEST_ASSERT_EQUAL_size_t(1, sentences.size());
+    TEST_ASSERT_EQUAL_UINT32(10, framer.junkBytes());
+}
+
+void test_oversized_sentence_is_discarded(void)
+{
+    std::string body = "PQTMLONG," + std::string(NmeaFramer::MAX_SENTENCE, 'A');
+    std::string input = gnss::sentence(body) + gnss::sentence("GNRMC,,V,,,,,,,,,,N,V");
+    NmeaFramer framer;
+    framer.feed((const uint8_t*)input.data(), input.size(), collect, nullptr);
+    TEST_ASSERT_EQUAL_size_t(1, sentences.size());
+    TEST_ASSERT_EQUAL_UINT32(1, framer.corrupt());
+}
+
+void test_lowercase_checksum_digits(void)
+{
+    std::string good = gnss::sentence("GPTXT,01,01,02,ANTSTATUS=OK");
+    for (char& c : good)
+        c = (c >= 'A' && c <= 'F' && &c > &good[good.size() - 5]) ? c + 32 : c;
+    NmeaFramer framer;
+    framer.feed((const uint8_t*)good.data(), good.size(), collect, nullptr);
+    TEST_ASSERT_EQUAL_size_t(1, sentences.size());
+}
+
+static void benchmark(const char* name, const std::string& input, size_t chunk)
+{
+    NmeaFramer framer;
+    size_t forwarded = 0;
+    const int rounds = 20;
+    uint64_t start = bench::nowNs();
+    for (int round = 0; round < rounds; ++round)
+        for (size_t pos = 0; pos < input.size(); pos += chunk)
+            framer.feed((const uint8_t*)input.data() + pos, std::min(chunk, input.size() - pos), count, &forwarded);
+    uint64_t ns = bench::nowNs() - start;
+    char line[160];
+    snprintf(line, sizeof(line), "%s, %u byte chunks: %.1f MB/s, %u sentences, %u corrupt", name, (unsigned)chunk,
+             bench::megabytesPerSecond(input.size() * rounds, ns), (unsigned)framer.sentences(),
+             (unsigned)framer.corrupt());
+    TEST_MESSAGE(line);
+    TEST_ASSERT_GREATER_THAN(0, forwarded);
+}
+
+void test_parse_speed(void)
+{
+    std::string clean = gnss::nmeaStream(4 << 20);
+    for (size_t chunk : {1, 120, 4096})
+        benchmark("clean stream", clean, chunk);
+
+    // One flipped byte every 500 bytes
+    std::string noisy = clean;
+    for (size_t i = 250; i < noisy.size(); i += 500)
+        noisy[i] ^= 0x20;
+    benchmark("noisy stream", noisy, 120);
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_sentence_split_at_every_byte);
+    RUN_TEST(test_bad_checksum_is_counted_and_dropped);
+    RUN_TEST(test_dollar_restarts_a_broken_sentence);
+    RUN_TEST(test_junk_between_sentences_is_skipped);
+    RUN_TEST(test_oversized_sentence_is_discarded);
+    RUN_TEST(test_lowercase_checksum_digits);
+    RUN_TEST(test_parse_speed);
+    return UNITY_END();
+}
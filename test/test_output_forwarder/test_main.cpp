@@ -0,0 +1,181 @@
+// Backpressure policies of OutputForwarder, congested on purpose by a target
+// port that holds the drain task inside write() until the test opens it.
+#include <unity.h>
+#include <Arduino.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include "OutputForwarder.h"
+#include "GnssTraffic.h"
+
+class GatedPort : public Stream {
+public:
+    std::atomic<bool> open{false};
+    std::atomic<uint32_t> writes{0};
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override
+    {
+        writes++;
+        while (!open)
+            delay(1);
+        std::lock_guard<std::mutex> lock(_mutex);
+        _out.append((const char*)buffer, size);
+        return size;
+    }
+    int availableForWrite() override { return 4096; }
+    using Print::write;
+
+    std::string out()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _out;
+    }
+
+private:
+    std::mutex _mutex;
+    std::string _out;
+};
+
+static constexpr size_t QUEUE_SIZE = 1024;
+
+// Forwarder whose task is stuck in a write of "hold\n" and whose queue is
+// above the high watermark, so the next write meets the policy
+struct Congested {
+    GatedPort port;
+    OutputForwarder out{port, "Test Out"};
+    std::string filler;
+
+    explicit Congested(uint8_t policy)
+    {
+        out.begin(QUEUE_SIZE, 0);
+        out.setDelimiter('\n');
+        out.setBackpressure({policy, 50, 25});
+        out.write((const uint8_t*)"hold\n", 5);
+        while (port.writes == 0)
+            delay(1);
+        for (int i = 0; filler.size() < QUEUE_SIZE * 6 / 10; ++i)
+            filler += "filler line " + std::to_string(i) + "\n";
+        out.write((const uint8_t*)filler.data(), filler.size());
+    }
+
+    void write(const std::string& text) { out.write((const uint8_t*)text.data(), text.size()); }
+
+    // Opens the port and waits until everything, held sentences too, is out
+    std::string drain()
+    {
+        port.open = true;
+        for (int quiet = 0; quiet < 20;)
+        {
+            uint32_t writes = port.writes;
+            delay(5);
+            quiet = out.pending() == 0 && port.writes == writes ? quiet + 1 : 0;
+        }
+        return port.out();
+    }
+};
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_keep_latest_holds_newest_sentence_per_type_and_part(void)
+{
+    Congested* c = new Congested(OutputForwarder::KeepLatest);
+    TEST_ASSERT_EQUAL(0, c->out.availableForWrite());
+    std::string oldGga = gnss::sentence("GPGGA,120000.00,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,");
+    std::string newGga = gnss::sentence("GPGGA,120001.00,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,");
+    std::string gsv1 = gnss::sentence("GPGSV,2,1,08,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45");
+    std::string gsv2 = gnss::sentence("GPGSV,2,2,08,15,40,083,46,17,17,308,41,19,07,344,39,24,22,228,45");
+    std::string glgsv = gnss::sentence("GLGSV,1,1,02,65,40,083,46,66,17,308,41");
+    c->write(oldGga + gsv1);
+    c->write(gsv2 + glgsv + newGga);
+    std::string out = c->drain();
+
+    TEST_ASSERT_EQUAL(std::string::npos, out.find(oldGga));
+    size_t filler = out.find(c->filler);
+    size_t first = out.find(gsv1);
+    TEST_ASSERT_NOT_EQUAL(std::string::npos, filler);
+    TEST_ASSERT_NOT_EQUAL(std::string::npos, first);
+    TEST_ASSERT_TRUE(first > filler);
+    // Held sentences go out in arrival order, once nothing else is queued
+    TEST_ASSERT_EQUAL(first + gsv1.size(), out.find(gsv2));
+    TEST_ASSERT_EQUAL(first + gsv1.size() + gsv2.size(), out.find(glgsv));
+    TEST_ASSERT_EQUAL(first + gsv1.size() + gsv2.size() + glgsv.size(), out.find(newGga));
+    TEST_ASSERT_EQUAL_UINT32(1, c->out.droppedFrames());
+}
+
+void test_keep_latest_passes_other_traffic_through(void)
+{
+    Congested* c = new Congested(OutputForwarder::KeepLatest);
+    std::string gga = gnss::sentence("GPGGA,120000.00,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,");
+    std::string reply = "Serial1 baud: 460800\r\n";
+    std::vector<uint8_t> frame = gnss::rtcmFrame(1005, 19, 0, false, '\n');
+    std::string rtcm(frame.begin(), frame.end());
+    c->write(reply + gga + rtcm + "partial $GP");
+    std::string out = c->drain();
+
+    size_t filler = out.find(c->filler);
+    size_t replyAt = out.find(reply);
+    size_t rtcmAt = out.find(rtcm + "partial $GP");
+    TEST_ASSERT_NOT_EQUAL(std::string::npos, replyAt);
+    TEST_ASSERT_NOT_EQUAL(std::string::npos, rtcmAt);
+    TEST_ASSERT_TRUE(replyAt > filler);
+    TEST_ASSERT_TRUE(out.find(gga) > rtcmAt);
+    TEST_ASSERT_EQUAL_UINT32(0, c->out.droppedFrames());
+}
+
+void test_block_stalls_the_writer_once(void)
+{
+    Congested* c = new Congested(OutputForwarder::Block);
+    TEST_ASSERT_EQUAL(0, c->out.availableForWrite());
+    unsigned long start = millis();
+    TEST_ASSERT_EQUAL(0, c->out.write((const uint8_t*)"late\n", 5));
+    unsigned long waited = millis() - start;
+    TEST_ASSERT_TRUE(waited >= OutputForwarder::BLOCK_TIMEOUT_MS);
+    TEST_ASSERT_TRUE(waited < OutputForwarder::BLOCK_TIMEOUT_MS + 50);
+
+    // Further writes drop at once until the queue has drained
+    start = millis();
+    TEST_ASSERT_EQUAL(0, c->out.write((const uint8_t*)"later\n", 6));
+    TEST_ASSERT_TRUE(millis() - start < 5);
+
+    c->drain();
+    TEST_ASSERT_TRUE(c->out.availableForWrite() > 0);
+    TEST_ASSERT_EQUAL(6, c->out.write((const uint8_t*)"again\n", 6));
+}
+
+void test_packets_keep_stream_order(void)
+{
+    PacketPool pool;
+    pool.begin(4, 512, false);
+    Congested* c = new Congested(OutputForwarder::DropNewest);
+    c->port.open = true;
+    c->drain();
+
+    // Packets are written from the pool buffer, between the bytes around them
+    std::vector<uint8_t> bytes = gnss::rtcmFrame(1074, 300);
+    std::string frame(bytes.begin(), bytes.end());
+    Packet* packet = pool.acquire();
+    memcpy(packet->data, frame.data(), frame.size());
+    packet->len = frame.size();
+    c->write("before\n");
+    TEST_ASSERT_EQUAL_UINT32(frame.size(), c->out.writePacket(packet));
+    c->write("after\n");
+    packet->release();
+    std::string out = c->drain();
+    TEST_ASSERT_TRUE(out.compare(out.size() - frame.size() - 13, std::string::npos, "before\n" + frame + "after\n") == 0);
+    TEST_ASSERT_EQUAL_UINT32(4, pool.available());
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_keep_latest_holds_newest_sentence_per_type_and_part);
+    RUN_TEST(test_keep_latest_passes_other_traffic_through);
+    RUN_TEST(test_block_stalls_the_writer_once);
+    RUN_TEST(test_packets_keep_stream_order);
+    return UNITY_END();
+}
@@ -0,0 +1,121 @@
+// PacketPool under contention: tasks acquire, share and release packets at
+// once, and every packet must have one owner at a time and end up back in
+// the pool exactly once.
+#include <unity.h>
+#include <atomic>
+#include <string.h>
+#include <thread>
+#include <vector>
+#include "PacketPool.h"
+
+static constexpr size_t POOL_SIZE = 16;
+static constexpr size_t PACKET_SIZE = 64;
+static constexpr int THREADS = 4;
+static constexpr int ROUNDS = 20000;
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_exhausted_pool_is_counted(void)
+{
+    PacketPool pool;
+    TEST_ASSERT_TRUE(pool.begin(2, PACKET_SIZE, false));
+    Packet* a = pool.acquire();
+    Packet* b = pool.acquire();
+    TEST_ASSERT_NOT_NULL(a);
+    TEST_ASSERT_NOT_NULL(b);
+    TEST_ASSERT_NULL(pool.acquire());
+    TEST_ASSERT_EQUAL_UINT32(1, pool.exhausted());
+    TEST_ASSERT_EQUAL_UINT32(0, pool.lowWater());
+
+    // A shared packet comes back once the last holder lets go
+    a->retain();
+    a->release();
+    TEST_ASSERT_EQUAL_UINT32(0, pool.available());
+    a->release();
+    b->release();
+    TEST_ASSERT_EQUAL_UINT32(2, pool.available());
+}
+
+void test_concurrent_acquire_and_release(void)
+{
+    PacketPool pool;
+    TEST_ASSERT_TRUE(pool.begin(POOL_SIZE, PACKET_SIZE, false));
+    std::atomic<int> owner[POOL_SIZE];
+    for (std::atomic<int>& o : owner)
+        o = -1;
+    std::atomic<uint32_t> collisions{0}, corrupted{0}, acquired{0};
+
+    // The last byte of each packet names it; the threads never write there
+    Packet* all[POOL_SIZE];
+    for (size_t i = 0; i < POOL_SIZE; ++i)
+    {
+        all[i] = pool.acquire();
+        all[i]->data[PACKET_SIZE - 1] = i;
+    }
+    for (Packet* packet : all)
+        packet->release();
+
+    // Each thread stamps the packets it holds and checks nobody else does
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t)
+    {
+        threads.emplace_back([&, t] {
+            Packet* held[3] = {};
+            for (int round = 0; round < ROUNDS; ++round)
+            {
+                Packet*& slot = held[round % 3];
+                if (slot)
+                {
+                    for (size_t i = 0; i < slot->len; ++i)
+                        if (slot->data[i] != (uint8_t)t) corrupted++;
+                    owner[slot->data[PACKET_SIZE - 1]].store(-1);
+                    slot->release();
+                    slot = nullptr;
+                    continue;
+                }
+                slot = pool.acquire();
+                if (!slot) continue;
+                acquired++;
+                int expected = -1;
+                size_t index = slot->data[PACKET_SIZE - 1];
+                if (!owner[index].compare_exchange_strong(expected, t)) collisions++;
+                memset(slot->data, t, PACKET_SIZE - 1);
+                slot->len = PACKET_SIZE - 1;
+            }
+            for (Packet* packet : held)
+                if (packet)
+                {
+                    owner[packet->data[PACKET_SIZE - 1]].store(-1);
+                    packet->release();
+                }
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    TEST_ASSERT_EQUAL_UINT32(0, collisions.load());
+    TEST_ASSERT_EQUAL_UINT32(0, corrupted.load());
+    TEST_ASSERT_TRUE(acquired > (uint32_t)ROUNDS);
+    TEST_ASSERT_EQUAL_UINT32(POOL_SIZE, pool.available());
+
+    // Every packet is on the free list once: draining it yields each one
+    std::vector<bool> seen(POOL_SIZE);
+    for (size_t i = 0; i < POOL_SIZE; ++i)
+    {
+        Packet* packet = pool.acquire();
+        TEST_ASSERT_NOT_NULL(packet);
+        size_t index = packet->data[PACKET_SIZE - 1];
+        TEST_ASSERT_FALSE(seen[index]);
+        seen[index] = true;
+    }
+    TEST_ASSERT_NULL(pool.acquire());
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_exhausted_pool_is_counted);
+    RUN_TEST(test_concurrent_acquire_and_release);
+    return UNITY_END();
+}
@@ -0,0 +1,164 @@
+// PowerGovernor replayed over GNSS traffic timelines the way the router task
+// drives it: update() on every chunk and whenever nextCheckMs() runs out.
+// Checks that learned epochs find the clock already up, that gaps run at
+// the low clock, and that dense, missing and absent traffic are handled.
+#include <unity.h>
+#include <vector>
+#include "PowerGovernor.h"
+
+struct Chunk {
+    uint32_t ms;
+    size_t bytes;
+};
+
+// Epoch bursts of burstBytes arriving as 64 byte UART chunks, one per
+// millisecond, with the start jittered by up to jitterMs either way
+static std::vector<Chunk> epochs(uint32_t periodMs, int count, size_t burstBytes, uint32_t jitterMs = 0, uint32_t startMs = 100)
+{
+    std::vector<Chunk> timeline;
+    for (int epoch = 0; epoch < count; ++epoch)
+    {
+        uint32_t ms = startMs + epoch * periodMs;
+        if (jitterMs)
+            ms = ms - jitterMs + (epoch * 7) % (2 * jitterMs + 1);
+        for (size_t sent = 0; sent < burstBytes; sent += 64)
+            timeline.push_back({ms++, burstBytes - sent < 64 ? burstBytes - sent : 64});
+    }
+    return timeline;
+}
+
+struct Replay {
+    PowerGovernor governor;
+    uint32_t now = 0;
+    uint32_t wake = 0; // 0: nothing scheduled
+    int slowStarts = 0; // Bursts that met the low clock, counted from countFrom
+    int bursts = 0;
+    uint32_t countFrom = 0;
+
+    void advance(uint32_t ms)
+    {
+        while (wake && wake <= ms)
+        {
+            now = wake;
+            check();
+        }
+        now = ms;
+    }
+
+    void check()
+    {
+        governor.update(now);
+        uint32_t next = governor.nextCheckMs(now);
+        wake = next ? now + next + 1 : 0;
+    }
+
+    void play(const std::vector<Chunk>& timeline, uint32_t endMs)
+    {
+        uint32_t last = 0;
+        for (const Chunk& chunk : timeline)
+        {
+            advance(chunk.ms);
+            bool burstStart = bursts == 0 || chunk.ms - last >= PowerGovernor::BURST_GAP_MS;
+            if (burstStart)
+            {
+                bursts++;
+                if (chunk.ms >= countFrom && governor.mode() != PowerGovernor::Burst) slowStarts++;
+            }
+            last = chunk.ms;
+            governor.onTraffic(now, chunk.bytes);
+            check();
+        }
+        advance(endMs);
+        governor.update(now);
+    }
+};
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_learned_epochs_find_the_clock_up(void)
+{
+    Replay replay;
+    replay.countFrom = 100 + 3 * 1000; // A few epochs to learn the period
+    replay.play(epochs(1000, 30, 1200, 1), 30100);
+
+    TEST_ASSERT_EQUAL_UINT32(30, replay.bursts);
+    TEST_ASSERT_EQUAL(0, replay.slowStarts);
+    TEST_ASSERT_UINT32_WITHIN(2, 1000, replay.governor.burstPeriodMs());
+    TEST_ASSERT_UINT32_WITHIN(2, 18, replay.governor.burstLengthMs());
+    // 19 ms of traffic, a gap to notice its end and the guard per second
+    TEST_ASSERT_TRUE(replay.governor.dutyPercent(PowerGovernor::Between) >= 95);
+}
+
+void test_five_hertz_keeps_most_of_the_gap(void)
+{
+    Replay replay;
+    replay.countFrom = 100 + 3 * 200;
+    replay.play(epochs(200, 100, 600, 2), 20100);
+
+    TEST_ASSERT_EQUAL(0, replay.slowStarts);
+    TEST_ASSERT_UINT32_WITHIN(3, 200, replay.governor.burstPeriodMs());
+    TEST_ASSERT_TRUE(replay.governor.dutyPercent(PowerGovernor::Between) >= 80);
+}
+
+void test_dense_stream_keeps_the_full_clock(void)
+{
+    // 20 Hz of 1 kB epochs is above DENSE_RATE; gaps of ~35 ms are not worth it
+    Replay replay;
+    replay.countFrom = UINT32_MAX;
+    replay.play(epochs(50, 200, 1000), 10100);
+    TEST_ASSERT_TRUE(replay.governor.byteRate() > PowerGovernor::DENSE_RATE);
+
+    replay.governor.resetStats();
+    replay.countFrom = replay.now;
+    replay.play(epochs(50, 100, 1000, 0, replay.now + 50), replay.now + 5050);
+    TEST_ASSERT_EQUAL(0, replay.slowStarts);
+    TEST_ASSERT_EQUAL(100, replay.governor.dutyPercent(PowerGovernor::Burst));
+}
+
+void test_missing_epoch_and_silence(void)
+{
+    // Five epochs, a skipped one, then four more and silence for good
+    Replay replay;
+    replay.countFrom = UINT32_MAX;
+    replay.play(epochs(1000, 5, 1200), 5099);
+
+    // Up for the missed epoch, back down a period and a gap after the last one
+    TEST_ASSERT_EQUAL(PowerGovernor::Burst, replay.governor.mode());
+    replay.play({}, 4118 + 1000 + PowerGovernor::BURST_GAP_MS);
+    TEST_ASSERT_EQUAL(PowerGovernor::Between, replay.governor.mode());
+
+    // The first epoch after the gap meets the low clock, but the gap does
+    // not throw off the period, so the ones after it are expected again
+    replay.countFrom = 7000;
+    replay.play(epochs(1000, 4, 1200, 0, 6100), 9200);
+    TEST_ASSERT_EQUAL(0, replay.slowStarts);
+    TEST_ASSERT_EQUAL_UINT32(1000, replay.governor.burstPeriodMs());
+    TEST_ASSERT_EQUAL(PowerGovernor::Between, replay.governor.mode());
+
+    replay.play({}, 9118 + PowerGovernor::IDLE_MS + 1);
+    TEST_ASSERT_EQUAL(PowerGovernor::Idle, replay.governor.mode());
+    TEST_ASSERT_EQUAL_UINT32(PowerGovernor::LOW_MHZ, replay.governor.mhz());
+    // Nothing left to wake up for
+    TEST_ASSERT_EQUAL_UINT32(0, replay.wake);
+}
+
+void test_off_policy_never_lowers_the_clock(void)
+{
+    Replay replay;
+    replay.governor.setPolicy(PowerGovernor::Off);
+    replay.play(epochs(1000, 5, 1200), 10000);
+    TEST_ASSERT_EQUAL(100, replay.governor.dutyPercent(PowerGovernor::Burst));
+    TEST_ASSERT_EQUAL_UINT32(PowerGovernor::FULL_MHZ, replay.governor.mhz());
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_learned_epochs_find_the_clock_up);
+    RUN_TEST(test_five_hertz_keeps_most_of_the_gap);
+    RUN_TEST(test_dense_stream_keeps_the_full_clock);
+    RUN_TEST(test_missing_epoch_and_silence);
+    RUN_TEST(test_off_policy_never_lowers_the_clock);
+    return UNITY_END();
+}
@@ -0,0 +1,306 @@
+// Pushes synthetic 460800 baud receiver output and correction bursts through
+// BasicBridgeRouter and the real output stages, and reports routed bytes per
+// second, per-call latency percentiles and dropped bytes. The last test
+// compares the templated router with the same router over plain Stream
+// ports, which dispatches every write virtually as the old router did.
+#include <unity.h>
+#include <Arduino.h>
+#include <BluetoothSerial.h>
+#include "BridgeRouter.h"
+#include "BridgeStats.h"
+#include "OutputForwarder.h"
+#include "PacketPool.h"
+#include "Bench.h"
+#include "GnssTraffic.h"
+
+using Router = BasicBridgeRouter<OutputForwarder, OutputForwarder, OutputForwarder>;
+
+static constexpr uint32_t SERIAL1_BAUD = 460800;
+static constexpr size_t TX_QUEUE_SIZE = 8192;
+static constexpr size_t UART_CHUNK = 120;  // Serial1 reads come in FIFO-sized pieces
+static constexpr size_t SPP_CHUNK = 330;   // Typical SPP packet from a phone NTRIP client
+
+// The ports, output stages and router as main.cpp sets them up. Drain tasks
+// never exit, so each test builds a fresh bridge and leaves it running.
+struct Bridge {
+    HardwareSerial serial;
+    HardwareSerial serial1;
+    BluetoothSerial serialBT;
+    OutputForwarder serialOut{serial, "Serial Out"};
+    OutputForwarder serial1Out{serial1, "Serial1 Out"};
+    OutputForwarder serialBTOut{serialBT, "SerialBT Out"};
+    LinkCounters serialTx, serial1Tx, serialBTTx;
+    PacketPool pool;
+    MenuCLI menu;
+    Router router{serialOut, serial1Out, serialBTOut, menu};
+
+    Bridge()
+    {
+        serialOut.begin(TX_QUEUE_SIZE, 1);
+        serial1Out.begin(TX_QUEUE_SIZE, 1);
+        serialBTOut.begin(TX_QUEUE_SIZE, 0);
+        serialOut.setCounters(&serialTx);
+        serial1Out.setCounters(&serial1Tx);
+        serialBTOut.setCounters(&serialBTTx);
+        serialBTOut.setCoalescing(512, 20);
+        serialOut.setDelimiter('\n');
+        serialBTOut.setDelimiter('\n');
+        pool.begin(48, 512);
+        router.setPacketPool(&pool);
+        router.begin();
+    }
+
+    uint32_t dropped() const { return serialTx.drops + serial1Tx.drops + serialBTTx.drops; }
+
+    // Waits until every output stage has handed its queue to the port
+    void drain()
+    {
+        OutputForwarder* outs[] = {&serialOut, &serial1Out, &serialBTOut};
+        for (int idle = 0; idle < 3;)
+        {
+            delay(5);
+            bool empty = true;
+            for (OutputForwarder* out : outs)
+                if (out->pending() > 0)
+                    empty = false;
+            idle = empty ? idle + 1 : 0;
+        }
+    }
+};
+
+static void report(const char* name, uint64_t bytes, uint64_t routeNs, uint64_t wallNs, bench::Latency& latency,
+                   uint32_t dropped)
+{
+    char line[256];
+    snprintf(line, sizeof(line), "%s: %llu bytes, routing %.1f MB/s (wall %.2f MB/s), %s, dropped %u bytes", name,
+             (unsigned long long)bytes, bench::megabytesPerSecond(bytes, routeNs),
+             bench::megabytesPerSecond(bytes, wallNs), latency.summary(), (unsigned)dropped);
+    TEST_MESSAGE(line);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// One second of receiver output at line rate with a correction burst, paced
+// in real time as the UART delivers it. Nothing may be lost.
+void test_line_rate_without_drops(void)
+{
+    Bridge* bridge = new Bridge();
+    const size_t perSecond = SERIAL1_BAUD / 10;
+    std::string nmea = gnss::nmeaStream(perSecond);
+    std::vector<uint8_t> rtcm = gnss::rtcmEpoch();
+
+    bench::Latency latency;
+    uint64_t routeNs = 0;
+    uint64_t start = bench::nowNs();
+    size_t rtcmSent = 0;
+    for (size_t pos = 0; pos < nmea.size(); pos += UART_CHUNK)
+    {
+        // Bytes arrive at 10 bits per byte
+        uint64_t due = start + (uint64_t)pos * 1000000000ull / perSecond;
+        while (bench::nowNs() < due)
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        size_t len = std::min(UART_CHUNK, nmea.size() - pos);
+        uint64_t t0 = bench::nowNs();
+        bridge->router.onSerial1Data((const uint8_t*)nmea.data() + pos, len);
+        uint64_t t1 = bench::nowNs();
+        latency.add(t1 - t0);
+        routeNs += t1 - t0;
+
+        // Corrections arrive once per second, a little after the epoch starts
+        if (rtcmSent < rtcm.size() && pos >= nmea.size() / 10)
+        {
+            size_t n = std::min(SPP_CHUNK, rtcm.size() - rtcmSent);
+            uint64_t t2 = bench::nowNs();
+            bridge->router.onSerialBTData(rtcm.data() + rtcmSent, n);
+            routeNs += bench::nowNs() - t2;
+            rtcmSent += n;
+        }
+    }
+    uint64_t wallNs = bench::nowNs() - start;
+    bridge->drain();
+
+    report("line rate", nmea.size() + rtcm.size(), routeNs, wallNs, latency, bridge->dropped());
+    TEST_ASSERT_EQUAL_UINT32(0, bridge->dropped());
+    TEST_ASSERT_EQUAL_UINT32(0, bridge->router.nmea().corrupt());
+    // Every sentence reaches both consoles; corrections reach Serial1 and are mirrored to Serial
+    TEST_ASSERT_EQUAL_size_t(nmea.size(), bridge->serialBT.tx().size());
+    TEST_ASSERT_EQUAL_size_t(nmea.size() + rtcm.size(), bridge->serial.tx().size());
+    std::string serial1 = bridge->serial1.tx();
+    TEST_ASSERT_EQUAL_size_t(rtcm.size(), serial1.size());
+    TEST_ASSERT_EQUAL_MEMORY(rtcm.data(), serial1.data(), rtcm.size());
+}
+
+// As fast as the router goes: the upper bound on routed bytes per second
+void test_downlink_throughput(void)
+{
+    Bridge* bridge = new Bridge();
+    std::string nmea = gnss::nmeaStream(4 << 20);
+    std::vector<uint8_t> rtcm = gnss::rtcmEpoch();
+
+    bench::Latency latency;
+    latency.reserve(nmea.size() / UART_CHUNK + 1);
+    uint64_t routeNs = 0;
+    size_t routed = 0;
+    uint64_t start = bench::nowNs();
+    for (size_t pos = 0; pos < nmea.size(); pos += UART_CHUNK)
+    {
+        size_t len = std::min(UART_CHUNK, nmea.size() - pos);
+        uint64_t t0 = bench::nowNs();
+        bridge->router.onSerial1Data((const uint8_t*)nmea.data() + pos, len);
+        uint64_t t1 = bench::nowNs();
+        latency.add(t1 - t0);
+        routeNs += t1 - t0;
+        routed += len;
+        // A correction epoch for every second of receiver output
+        if (pos % (SERIAL1_BAUD / 10) < UART_CHUNK)
+        {
+            for (size_t sent = 0; sent < rtcm.size(); sent += SPP_CHUNK)
+                bridge->router.onSerialBTData(rtcm.data() + sent, std::min(SPP_CHUNK, rtcm.size() - sent));
+            routed += rtcm.size();
+        }
+    }
+    uint64_t wallNs = bench::nowNs() - start;
+    bridge->drain();
+
+    report("max rate", routed, routeNs, wallNs, latency, bridge->dropped());
+    TEST_ASSERT_EQUAL_UINT32(0, bridge->router.nmea().corrupt());
+    TEST_ASSERT_GREATER_THAN(0, bridge->router.nmea().sentences());
+    // At the very least the router must keep up with the line rate
+    TEST_ASSERT_GREATER_THAN(SERIAL1_BAUD / 10 * 1e-6, bench::megabytesPerSecond(routed, routeNs));
+}
+
+// Both uplinks share Serial1 in mux mode while the downlink is at full rate
+void test_mux_uplink_bursts(void)
+{
+    Bridge* bridge = new Bridge();
+    bridge->router.setUplinkMode(BridgeRouterBase::UplinkMode::Mux);
+    bridge->router.setPriority(BridgeRouterBase::SerialBTInput, 1);
+    std::string nmea = gnss::nmeaStream(SERIAL1_BAUD / 10);
+    std::vector<uint8_t> rtcm = gnss::rtcmEpoch();
+    std::string command = gnss::sentence("PAIR062,0,1");
+
+    bench::Latency latency;
+    uint64_t routeNs = 0;
+    size_t routed = 0;
+    uint64_t start = bench::nowNs();
+    size_t commands = 0;
+    for (size_t pos = 0; pos < nmea.size(); pos += UART_CHUNK)
+    {
+        size_t len = std::min(UART_CHUNK, nmea.size() - pos);
+        uint64_t t0 = bench::nowNs();
+        bridge->router.onSerial1Data((const uint8_t*)nmea.data() + pos, len);
+        if (pos % 4096 < UART_CHUNK)
+        {
+            for (size_t sent = 0; sent < rtcm.size(); sent += SPP_CHUNK)
+                bridge->router.onSerialBTData(rtcm.data() + sent, std::min(SPP_CHUNK, rtcm.size() - sent));
+            bridge->router.onSerialData((const uint8_t*)command.data(), command.size());
+            routed += rtcm.size() + command.size();
+            commands++;
+        }
+        bridge->router.poll();
+        uint64_t t1 = bench::nowNs();
+        latency.add(t1 - t0);
+        routeNs += t1 - t0;
+        routed += len;
+    }
+    uint64_t wallNs = bench::nowNs() - start;
+    for (int i = 0; i < 100 && bridge->router.hasPendingUplink(); ++i)
+    {
+        bridge->drain();
+        bridge->router.poll();
+    }
+    bridge->drain();
+
+    uint32_t muxDrops = bridge->router.muxDrops(BridgeRouterBase::SerialInput) +
+                        bridge->router.muxDrops(BridgeRouterBase::SerialBTInput);
+    report("mux", routed, routeNs, wallNs, latency, bridge->dropped() + muxDrops);
+    // The downlink runs unpaced here and may drop; every uplink frame must arrive
+    TEST_ASSERT_EQUAL_UINT32(0, bridge->serial1Tx.drops + muxDrops);
+    TEST_ASSERT_FALSE(bridge->router.hasPendingUplink());
+    TEST_ASSERT_EQUAL_UINT32(commands, bridge->router.muxFrames(BridgeRouterBase::SerialInput));
+}
+
+// Sink that only counts. It is final, so the templated router binds its
+// writes statically; through Stream& the same calls stay virtual.
+class NullPort final : public Stream {
+public:
+    uint64_t bytes = 0;
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override
+    {
+        bytes += size;
+        return size;
+    }
+    using Print::write;
+    int availableForWrite() override { return 1 << 20; }
+};
+
+// Routing time for the downlink stream plus an SPP correction epoch per
+// second of it, through router
+template <class R>
+static uint64_t routeTraffic(R& router, const std::string& nmea, const std::vector<uint8_t>& rtcm)
+{
+    uint64_t start = bench::nowNs();
+    for (size_t pos = 0; pos < nmea.size(); pos += UART_CHUNK)
+    {
+        router.onSerial1Data((const uint8_t*)nmea.data() + pos, std::min(UART_CHUNK, nmea.size() - pos));
+        if (pos % (SERIAL1_BAUD / 10) < UART_CHUNK)
+            for (size_t sent = 0; sent < rtcm.size(); sent += SPP_CHUNK)
+                router.onSerialBTData(rtcm.data() + sent, std::min(SPP_CHUNK, rtcm.size() - sent));
+    }
+    return bench::nowNs() - start;
+}
+
+void test_static_against_virtual_dispatch(void)
+{
+    using StaticRouter = BasicBridgeRouter<NullPort, NullPort, NullPort>;
+    using VirtualRouter = BasicBridgeRouter<Stream, Stream, Stream>;
+    static constexpr int ROUNDS = 5;
+    std::string nmea = gnss::nmeaStream(2 << 20);
+    std::vector<uint8_t> rtcm = gnss::rtcmEpoch();
+
+    NullPort staticPorts[3], virtualPorts[3];
+    MenuCLI menu;
+    PacketPool pool;
+    pool.begin(48, 512);
+    StaticRouter* staticRouter = new StaticRouter(staticPorts[0], staticPorts[1], staticPorts[2], menu);
+    VirtualRouter* virtualRouter = new VirtualRouter(virtualPorts[0], virtualPorts[1], virtualPorts[2], menu);
+    staticRouter->setPacketPool(&pool);
+    virtualRouter->setPacketPool(&pool);
+
+    // Best of several alternating rounds, so both see the same machine
+    uint64_t staticNs = UINT64_MAX, virtualNs = UINT64_MAX;
+    for (int round = 0; round < ROUNDS; ++round)
+    {
+        staticNs = std::min(staticNs, routeTraffic(*staticRouter, nmea, rtcm));
+        virtualNs = std::min(virtualNs, routeTraffic(*virtualRouter, nmea, rtcm));
+    }
+
+    uint64_t bytes = nmea.size() + rtcm.size() * (nmea.size() / (SERIAL1_BAUD / 10) + 1);
+    char line[200];
+    snprintf(line, sizeof(line), "static %.1f MB/s, virtual %.1f MB/s, %.2fx", bench::megabytesPerSecond(bytes, staticNs),
+             bench::megabytesPerSecond(bytes, virtualNs), (double)virtualNs / staticNs);
+    TEST_MESSAGE(line);
+
+    // Same routes taken, byte for byte
+    for (int i = 0; i < 3; ++i)
+        TEST_ASSERT_EQUAL_UINT64(virtualPorts[i].bytes, staticPorts[i].bytes);
+    TEST_ASSERT_GREATER_THAN(0, staticPorts[1].bytes);
+    // Timing on a shared host is noisy; only a clear loss would be a regression
+    TEST_ASSERT_LESS_THAN(virtualNs * 5 / 4, staticNs);
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_line_rate_without_drops);
+    RUN_TEST(test_downlink_throughput);
+    RUN_TEST(test_mux_uplink_bursts);
+    RUN_TEST(test_static_against_virtual_dispatch);
+    return UNITY_END();
+}
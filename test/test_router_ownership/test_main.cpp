@@ -0,0 +1,226 @@
+// Serial1 ownership under contention: both uplinks feed the router at once
+// while a short owner timeout keeps handing Serial1 back and forth, the menu
+// is opened and closed, and the timer service releases quiet owners. Every
+// chunk must end up in exactly one place: on Serial1, answered with the
+// owner error, or in the menu.
+#include <unity.h>
+#include <Arduino.h>
+#include <atomic>
+#include <thread>
+#include "BridgeRouter.h"
+#include "GnssTraffic.h"
+
+// Chunks are told apart by their first byte
+enum Source
+{
+    FromSerial,
+    FromSerialBT,
+    SOURCE_COUNT
+};
+
+static Source sourceOf(const uint8_t* buffer) { return buffer[0] == 0xD3 ? FromSerialBT : FromSerial; }
+
+// Port that may be written from both uplinks at once and only counts
+class CountingPort {
+public:
+    std::atomic<uint32_t> chunks[SOURCE_COUNT] = {};
+    std::atomic<uint32_t> lines{0};
+
+    size_t write(const uint8_t* buffer, size_t len)
+    {
+        if (len > 0)
+            chunks[sourceOf(buffer)]++;
+        return len;
+    }
+    int availableForWrite() { return 1 << 20; }
+    void flush() {}
+    size_t println(const char*)
+    {
+        lines++;
+        return 0;
+    }
+};
+
+class CountingMenu {
+public:
+    std::atomic<uint32_t> begins{0};
+    std::atomic<uint32_t> chunks[SOURCE_COUNT] = {};
+
+    void begin() { begins++; }
+    size_t write(const uint8_t* buffer, size_t len)
+    {
+        if (len > 0)
+            chunks[sourceOf(buffer)]++;
+        return len;
+    }
+};
+
+using Router = BasicBridgeRouter<CountingPort, CountingPort, CountingPort, CountingMenu>;
+using State = BridgeRouterBase::State;
+
+static constexpr unsigned long OWNER_TIMEOUT_MS = 3;
+
+struct Bridge {
+    CountingPort serialOut, serial1Out, serialBTOut;
+    CountingMenu menu;
+    Router router{serialOut, serial1Out, serialBTOut, menu};
+
+    Bridge()
+    {
+        router.setOwnerTimeout(OWNER_TIMEOUT_MS);
+        router.corrections().setEnabled(false); // Frames go straight to Serial1
+        router.begin();
+    }
+
+    bool waitForIdle(unsigned long ms)
+    {
+        for (unsigned long waited = 0; waited < ms; ++waited)
+        {
+            if (router.state() == State::Idle)
+                return true;
+            delay(1);
+        }
+        return router.state() == State::Idle;
+    }
+};
+
+// Sends count chunks; pauses now and then so the owner timeout can expire
+template <class Send>
+static void produce(uint32_t seed, size_t count, Send send)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        send(i);
+        seed = seed * 1103515245 + 12345;
+        unsigned pause = (seed >> 16) % 64;
+        if (pause < 3)
+            delay(OWNER_TIMEOUT_MS + pause * 2);
+        else if (pause < 24)
+            std::this_thread::sleep_for(std::chrono::microseconds(pause * 10));
+    }
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_quiet_owner_is_released(void)
+{
+    Bridge* bridge = new Bridge();
+    const uint8_t data[] = "SSSS";
+    bridge->router.onSerialData(data, 4);
+    TEST_ASSERT_EQUAL(State::SerialForward, bridge->router.state());
+    TEST_ASSERT_TRUE(bridge->waitForIdle(100));
+
+    std::vector<uint8_t> frame = gnss::rtcmFrame(1005, 19);
+    bridge->router.onSerialBTData(frame.data(), frame.size());
+    TEST_ASSERT_EQUAL(State::SerialBTForward, bridge->router.state());
+    TEST_ASSERT_EQUAL_UINT32(1, bridge->serial1Out.chunks[FromSerialBT]);
+    TEST_ASSERT_TRUE(bridge->waitForIdle(100));
+}
+
+// SPP and BLE share the wireless side of Serial1 but not their framing
+void test_ble_and_spp_are_framed_apart(void)
+{
+    Bridge* bridge = new Bridge();
+    Router& router = bridge->router;
+    std::vector<uint8_t> spp = gnss::rtcmFrame(1077, 120);
+    std::vector<uint8_t> ble = gnss::rtcmFrame(1087, 90);
+    size_t half = spp.size() / 2;
+
+    router.onSerialBTData(spp.data(), half);
+    router.onBLEData(ble.data(), ble.size());
+    router.onSerialBTData(spp.data() + half, spp.size() - half);
+    TEST_ASSERT_EQUAL(State::SerialBTForward, router.state());
+    TEST_ASSERT_EQUAL_UINT32(2, bridge->serial1Out.chunks[FromSerialBT]);
+    TEST_ASSERT_EQUAL_UINT32(0, router.rtcm().crcErrors());
+    TEST_ASSERT_EQUAL_UINT32(0, router.bleRtcm().crcErrors());
+    TEST_ASSERT_EQUAL_UINT32(1, router.rtcm().frames());
+    TEST_ASSERT_EQUAL_UINT32(1, router.bleRtcm().frames());
+    TEST_ASSERT_TRUE(bridge->waitForIdle(100));
+
+    // Half a magic word on each does not open the menu
+    router.onSerialBTData((const uint8_t*)"me", 2);
+    router.onBLEData((const uint8_t*)"nu", 2);
+    TEST_ASSERT_EQUAL(State::SerialBTForward, router.state());
+    TEST_ASSERT_EQUAL_UINT32(0, bridge->menu.begins);
+    TEST_ASSERT_TRUE(bridge->waitForIdle(100));
+}
+
+void test_no_lost_transitions_under_contention(void)
+{
+    static constexpr size_t CHUNKS = 20000;
+    static constexpr size_t MENU_EVERY = 97;
+    Bridge* bridge = new Bridge();
+    Router& router = bridge->router;
+    std::vector<uint8_t> frame = gnss::rtcmFrame(1077, 120);
+    std::atomic<bool> running{true};
+
+    // Leaves the menu as soon as it opens, like an immediate "exit"
+    std::thread closer([&] {
+        while (running)
+        {
+            if (router.state() == State::Menu)
+                router.setState(State::Idle);
+            std::this_thread::yield();
+        }
+    });
+    std::thread serial([&] {
+        const uint8_t data[] = "SSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSS";
+        produce(1, CHUNKS, [&](size_t i) {
+            if (i % MENU_EVERY == 0)
+                router.onSerialData((const uint8_t*)"menu", 4);
+            else
+                router.onSerialData(data, sizeof(data) - 1);
+        });
+    });
+    std::thread serialBT([&] {
+        produce(2, CHUNKS, [&](size_t) { router.onSerialBTData(frame.data(), frame.size()); });
+    });
+    serial.join();
+    serialBT.join();
+    running = false;
+    closer.join();
+    TEST_ASSERT_TRUE(bridge->waitForIdle(100));
+
+    // Only Serial sends the magic word; each open also prints a banner on it
+    uint32_t opens = bridge->menu.begins;
+    uint32_t serialRefused = bridge->serialOut.lines - opens;
+    uint32_t serialBTRefused = bridge->serialBTOut.lines;
+    // A magic word that wins Idle opens the menu; otherwise it is data too
+    uint32_t serialChunks =
+        bridge->serial1Out.chunks[FromSerial] + serialRefused + bridge->menu.chunks[FromSerial] + opens;
+    uint32_t serialBTChunks =
+        bridge->serial1Out.chunks[FromSerialBT] + serialBTRefused + bridge->menu.chunks[FromSerialBT];
+    // Owner and other both mirror the chunk to the peer console
+    uint32_t serialMirrored = bridge->serial1Out.chunks[FromSerial] + serialRefused;
+    uint32_t serialBTMirrored = bridge->serial1Out.chunks[FromSerialBT] + serialBTRefused;
+
+    char line[200];
+    snprintf(line, sizeof(line),
+             "Serial: %u owned, %u refused, %u to menu; SerialBT: %u owned, %u refused, %u to menu; %u menu opens",
+             (unsigned)bridge->serial1Out.chunks[FromSerial], (unsigned)serialRefused,
+             (unsigned)bridge->menu.chunks[FromSerial], (unsigned)bridge->serial1Out.chunks[FromSerialBT],
+             (unsigned)serialBTRefused, (unsigned)bridge->menu.chunks[FromSerialBT], (unsigned)opens);
+    TEST_MESSAGE(line);
+
+    TEST_ASSERT_EQUAL_UINT32(CHUNKS, serialChunks);
+    TEST_ASSERT_EQUAL_UINT32(CHUNKS, serialBTChunks);
+    TEST_ASSERT_EQUAL_UINT32(serialMirrored, bridge->serialBTOut.chunks[FromSerial]);
+    TEST_ASSERT_EQUAL_UINT32(serialBTMirrored, bridge->serialOut.chunks[FromSerialBT]);
+
+    // The run has to have exercised every transition to mean anything
+    TEST_ASSERT_GREATER_THAN(0, bridge->serial1Out.chunks[FromSerial]);
+    TEST_ASSERT_GREATER_THAN(0, bridge->serial1Out.chunks[FromSerialBT]);
+    TEST_ASSERT_GREATER_THAN(0, serialRefused);
+    TEST_ASSERT_GREATER_THAN(0, serialBTRefused);
+    TEST_ASSERT_GREATER_THAN(0, opens);
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_quiet_owner_is_released);
+    RUN_TEST(test_ble_and_spp_are_framed_apart);
+    RUN_TEST(test_no_lost_transitions_under_contention);
+    return UNITY_END();
+}
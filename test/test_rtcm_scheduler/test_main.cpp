@@ -0,0 +1,246 @@
+// RtcmScheduler fed with synthetic correction frames: epochs keyed on the
+// epoch time of each constellation, station and bias copies replaced per
+// station, the send order, what a full buffer evicts and the counters kept
+// per message type.
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "RtcmScheduler.h"
+#include "GnssTraffic.h"
+
+using gnss::rtcmFrame;
+
+struct Sent {
+    uint16_t type;
+    uint8_t fill;
+};
+
+static bool push(RtcmScheduler& scheduler, const std::vector<uint8_t>& frame)
+{
+    return scheduler.push(frame.data(), frame.size());
+}
+
+// Payload byte 8 is fill + 8 * 31 (rtcmFrame), which tells copies apart
+static std::vector<Sent> drain(RtcmScheduler& scheduler)
+{
+    std::vector<Sent> sent;
+    size_t len;
+    while (const uint8_t* frame = scheduler.front(len))
+    {
+        sent.push_back({Rtcm3Framer::messageType(frame), (uint8_t)(frame[Rtcm3Framer::HEADER_LEN + 8] - 8 * 31)});
+        scheduler.pop();
+    }
+    return sent;
+}
+
+static std::string types(const std::vector<Sent>& sent)
+{
+    std::string text;
+    for (const Sent& s : sent)
+        text += (text.empty() ? "" : " ") + std::to_string(s.type);
+    return text;
+}
+
+// Types only get counters once something happens to one of their frames
+static const RtcmScheduler::TypeStats* stats(const RtcmScheduler& scheduler, uint16_t type)
+{
+    static const RtcmScheduler::TypeStats none = {};
+    for (size_t i = 0; i < scheduler.typeCount(); ++i)
+        if (scheduler.typeAt(i).type == type)
+            return &scheduler.typeAt(i);
+    return &none;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_newer_epoch_supersedes_its_constellation(void)
+{
+    RtcmScheduler scheduler;
+    push(scheduler, rtcmFrame(1077, 120, 0, true, 1, 1000));
+    push(scheduler, rtcmFrame(1087, 120, 0, false, 2, 1000));
+    // GPS moves on; GLONASS keeps its older epoch
+    push(scheduler, rtcmFrame(1077, 120, 0, true, 3, 2000));
+    TEST_ASSERT_EQUAL_UINT32(2, scheduler.frames());
+    TEST_ASSERT_EQUAL_UINT32(1, stats(scheduler, 1077)->superseded);
+    TEST_ASSERT_EQUAL_UINT32(0, stats(scheduler, 1087)->superseded);
+
+    // More of the same GPS epoch joins it
+    push(scheduler, rtcmFrame(1074, 60, 0, false, 4, 2000));
+    TEST_ASSERT_EQUAL_UINT32(3, scheduler.frames());
+    std::vector<Sent> sent = drain(scheduler);
+    std::string order = types(sent);
+    TEST_ASSERT_EQUAL_STRING("1077 1074 1087", order.c_str());
+    TEST_ASSERT_EQUAL_UINT8(3, sent[0].fill);
+}
+
+// Casters that clear the multiple message bit on every frame, or set it on
+// every frame, still group by the epoch time
+void test_epochs_follow_the_time_not_the_mmb(void)
+{
+    RtcmScheduler scheduler;
+    push(scheduler, rtcmFrame(1074, 100, 0, false, 1, 5000));
+    push(scheduler, rtcmFrame(1077, 100, 0, false, 2, 5000));
+    push(scheduler, rtcmFrame(1084, 100, 0, true, 3, 5000));
+    push(scheduler, rtcmFrame(1087, 100, 0, true, 4, 5000));
+    TEST_ASSERT_EQUAL_UINT32(4, scheduler.frames());
+    TEST_ASSERT_EQUAL_UINT32(0, stats(scheduler, 1074)->superseded);
+
+    // GLONASS MSM carries the day of week above the time of day that
+    // legacy GLONASS observations have; the same epoch either way
+    push(scheduler, rtcmFrame(1012, 100, 0, true, 5, 5000));
+    TEST_ASSERT_EQUAL_UINT32(5, scheduler.frames());
+    push(scheduler, rtcmFrame(1087, 100, 0, true, 6, (3u << 27) | 6000));
+    TEST_ASSERT_EQUAL_UINT32(3, scheduler.frames());
+    TEST_ASSERT_EQUAL_UINT32(1, stats(scheduler, 1084)->superseded);
+    TEST_ASSERT_EQUAL_UINT32(1, stats(scheduler, 1012)->superseded);
+    push(scheduler, rtcmFrame(1012, 100, 0, false, 7, 6000));
+    TEST_ASSERT_EQUAL_UINT32(4, scheduler.frames());
+}
+
+void test_station_and_bias_replace_their_station(void)
+{
+    RtcmScheduler scheduler;
+    push(scheduler, rtcmFrame(1005, 19, 1, false, 1));
+    push(scheduler, rtcmFrame(1005, 19, 2, false, 2));
+    push(scheduler, rtcmFrame(1230, 12, 1, false, 3));
+    push(scheduler, rtcmFrame(1033, 40, 1, false, 4));
+    TEST_ASSERT_EQUAL_UINT32(4, scheduler.frames());
+
+    push(scheduler, rtcmFrame(1005, 19, 1, false, 5));
+    push(scheduler, rtcmFrame(1230, 12, 1, false, 6));
+    push(scheduler, rtcmFrame(1230, 12, 2, false, 7));
+    TEST_ASSERT_EQUAL_UINT32(5, scheduler.frames());
+    TEST_ASSERT_EQUAL_UINT32(1, stats(scheduler, 1005)->duplicates);
+    TEST_ASSERT_EQUAL_UINT32(1, stats(scheduler, 1230)->duplicates);
+    TEST_ASSERT_EQUAL_UINT32(0, stats(scheduler, 1033)->duplicates);
+
+    // Other messages are never deduplicated
+    push(scheduler, rtcmFrame(1019, 61, 1, false, 8));
+    push(scheduler, rtcmFrame(1019, 61, 1, false, 9));
+    std::vector<Sent> sent = drain(scheduler);
+    std::string order = types(sent);
+    TEST_ASSERT_EQUAL_STRING("1005 1033 1005 1230 1230 1019 1019", order.c_str());
+    TEST_ASSERT_EQUAL_UINT8(2, sent[0].fill);
+    TEST_ASSERT_EQUAL_UINT8(5, sent[2].fill);
+    TEST_ASSERT_EQUAL_UINT8(6, sent[3].fill);
+}
+
+// Newest epoch group, station and bias, other, then older epochs
+void test_send_order(void)
+{
+    RtcmScheduler scheduler;
+    push(scheduler, rtcmFrame(1087, 100, 0, true, 1, 1000));
+    push(scheduler, rtcmFrame(1097, 100, 0, true, 2, 1000));
+    push(scheduler, rtcmFrame(1019, 61));
+    push(scheduler, rtcmFrame(1077, 100, 0, true, 3, 1000));
+    push(scheduler, rtcmFrame(1230, 12));
+    // The second GPS epoch starts a new group; Galileo joins it
+    push(scheduler, rtcmFrame(1077, 100, 0, true, 4, 2000));
+    push(scheduler, rtcmFrame(1005, 19));
+    push(scheduler, rtcmFrame(1097, 100, 0, false, 5, 2000));
+
+    std::vector<Sent> sent = drain(scheduler);
+    std::string order = types(sent);
+    TEST_ASSERT_EQUAL_STRING("1077 1097 1230 1005 1019 1087", order.c_str());
+    TEST_ASSERT_EQUAL_UINT8(4, sent[0].fill);
+    TEST_ASSERT_EQUAL_UINT8(5, sent[1].fill);
+    TEST_ASSERT_TRUE(scheduler.empty());
+}
+
+// A full buffer drops from the end of the send order, the frame being
+// pushed included
+void test_overflow_evicts_the_least_urgent(void)
+{
+    RtcmScheduler scheduler;
+    push(scheduler, rtcmFrame(1087, 100, 0, false, 1, 1000));
+    push(scheduler, rtcmFrame(1077, 100, 0, false, 2, 1000));
+    push(scheduler, rtcmFrame(1077, 100, 0, false, 3, 2000));
+    for (uint8_t i = 0; scheduler.frames() < RtcmScheduler::MAX_FRAMES - 1; ++i)
+        TEST_ASSERT_TRUE(push(scheduler, rtcmFrame(1019, 61, 0, false, 10 + i)));
+    TEST_ASSERT_TRUE(push(scheduler, rtcmFrame(1005, 19)));
+    TEST_ASSERT_EQUAL_UINT32(RtcmScheduler::MAX_FRAMES, scheduler.frames());
+
+    // The older GLONASS epoch goes first, then the latest ephemeris
+    TEST_ASSERT_TRUE(push(scheduler, rtcmFrame(1074, 60, 0, false, 4, 2000)));
+    TEST_ASSERT_EQUAL_UINT32(1, stats(scheduler, 1087)->overflows);
+    TEST_ASSERT_TRUE(push(scheduler, rtcmFrame(1230, 12)));
+    TEST_ASSERT_EQUAL_UINT32(1, stats(scheduler, 1019)->overflows);
+    // Nothing queued is less urgent than another ephemeris
+    TEST_ASSERT_FALSE(push(scheduler, rtcmFrame(1019, 61, 0, false, 99)));
+    TEST_ASSERT_EQUAL_UINT32(2, stats(scheduler, 1019)->overflows);
+    TEST_ASSERT_EQUAL_UINT32(RtcmScheduler::MAX_FRAMES, scheduler.frames());
+
+    std::vector<Sent> sent = drain(scheduler);
+    TEST_ASSERT_EQUAL_UINT32(RtcmScheduler::MAX_FRAMES, sent.size());
+    TEST_ASSERT_EQUAL_UINT16(1077, sent[0].type);
+    TEST_ASSERT_EQUAL_UINT16(1074, sent[1].type);
+    TEST_ASSERT_EQUAL_UINT16(1019, sent.back().type);
+    for (const Sent& s : sent)
+        TEST_ASSERT_TRUE(s.type != 1087 && s.fill != 99);
+
+    // Byte space runs out the same way
+    RtcmScheduler bytes;
+    push(bytes, rtcmFrame(1097, 1000, 0, false, 1, 1000));
+    push(bytes, rtcmFrame(1077, 1000, 0, false, 2, 1000));
+    push(bytes, rtcmFrame(1077, 1000, 0, false, 3, 2000));
+    // Older observations refuse another of their own once full...
+    while (push(bytes, rtcmFrame(1097, 1000, 0, false, 4, 1000)))
+        ;
+    TEST_ASSERT_TRUE(bytes.bytes() + 1006 > RtcmScheduler::BUFFER_SIZE);
+    TEST_ASSERT_EQUAL_UINT32(1, stats(bytes, 1097)->overflows);
+    size_t queued = bytes.frames();
+    // ...but make way for the newest epoch
+    TEST_ASSERT_TRUE(push(bytes, rtcmFrame(1077, 1000, 0, false, 5, 2000)));
+    TEST_ASSERT_EQUAL_UINT32(2, stats(bytes, 1097)->overflows);
+    TEST_ASSERT_EQUAL_UINT32(queued, bytes.frames());
+}
+
+void test_counters_per_type(void)
+{
+    RtcmScheduler scheduler;
+    for (uint8_t second = 0; second < 3; ++second)
+    {
+        std::vector<uint8_t> epoch = gnss::rtcmEpoch(second);
+        for (size_t pos = 0; pos < epoch.size();)
+        {
+            size_t len = Rtcm3Framer::HEADER_LEN + (((epoch[pos + 1] & 0x03) << 8) | epoch[pos + 2]) +
+                         Rtcm3Framer::CRC_LEN;
+            TEST_ASSERT_TRUE(scheduler.push(epoch.data() + pos, len));
+            pos += len;
+        }
+    }
+    drain(scheduler);
+
+    // In order of first appearance
+    const uint16_t order[] = {1077, 1087, 1097, 1127, 1005, 1230};
+    TEST_ASSERT_EQUAL_UINT32(6, scheduler.typeCount());
+    for (size_t i = 0; i < 6; ++i)
+    {
+        const RtcmScheduler::TypeStats& t = scheduler.typeAt(i);
+        TEST_ASSERT_EQUAL_UINT16(order[i], t.type);
+        TEST_ASSERT_EQUAL_UINT32(1, t.sent);
+        TEST_ASSERT_EQUAL_UINT32(i < 4 ? 2 : 0, t.superseded);
+        TEST_ASSERT_EQUAL_UINT32(i < 4 ? 0 : 2, t.duplicates);
+        TEST_ASSERT_EQUAL_UINT32(0, t.overflows);
+    }
+
+    push(scheduler, rtcmFrame(1077, 100));
+    scheduler.clear();
+    TEST_ASSERT_EQUAL_UINT32(1, scheduler.cleared());
+    scheduler.resetStats();
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.typeCount());
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.cleared());
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_newer_epoch_supersedes_its_constellation);
+    RUN_TEST(test_epochs_follow_the_time_not_the_mmb);
+    RUN_TEST(test_station_and_bias_replace_their_station);
+    RUN_TEST(test_send_order);
+    RUN_TEST(test_overflow_evicts_the_least_urgent);
+    RUN_TEST(test_counters_per_type);
+    return UNITY_END();
+}
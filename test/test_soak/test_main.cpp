@@ -0,0 +1,509 @@
+// Soak and load sweep on the host. A generator plays the receiver on Serial1
+// and the correction client on SPP, and drives the router, the output stages
+// and MenuCLI wired as main.cpp wires them. Every output port is a simulated
+// link with its own speed and stall pattern, so back pressure reaches the
+// output stages as it would from a UART or an SPP channel.
+//
+// Each step synthesizes NMEA epochs at one rate for four constellations,
+// sends an MSM7 burst with 1005 and 1230 once per second, and opens the menu
+// for one command. Sentences and frames are matched by content at the far
+// end of each link, which gives drops, delivered bytes per second and
+// latency percentiles per direction.
+//
+// The table is printed with the test output. SOAK_RESULTS=<file> stores it,
+// SOAK_BASELINE=<file> fails the run if a row drops noticeably more or its
+// p99 latency grew by more than SOAK_TOLERANCE (default 0.5) over a table
+// stored by an earlier commit. CI passes baseline.txt next to this file,
+// the worst of several runs (tools/soak_baseline.py). SOAK_STEP_MS sets the
+// length of each step.
+#include <unity.h>
+#include <Arduino.h>
+#include <BluetoothSerial.h>
+#include <stdlib.h>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "BridgeRouter.h"
+#include "MenuCLI.h"
+#include "OutputForwarder.h"
+#include "PacketPool.h"
+#include "StreamTee.h"
+#include "Bench.h"
+#include "GnssTraffic.h"
+
+using BTDownlink = StreamTee<OutputForwarder>;
+using Router = BasicBridgeRouter<OutputForwarder, OutputForwarder, BTDownlink>;
+
+static constexpr size_t TX_QUEUE_SIZE = 8192;
+static constexpr uint32_t UART_BYTES_PER_SECOND = 46080; // 460800 baud, 10 bits per byte
+static constexpr uint32_t SPP_UPLINK_BYTES_PER_SECOND = 20000;
+static constexpr size_t UART_CHUNK = 120;
+static constexpr size_t SPP_CHUNK = 330;
+static constexpr unsigned CONSTELLATIONS = 4;
+static const unsigned RATES_HZ[] = {1, 5, 10, 20};
+
+struct Link {
+    uint32_t bytesPerSecond;
+    uint32_t stallEveryMs; // 0: never stalls
+    uint32_t stallForMs;
+};
+
+struct Scenario {
+    const char* name;
+    Link serial, spp, ble;
+};
+
+static const Scenario STEADY = {"steady", {UART_BYTES_PER_SECOND, 0, 0}, {30000, 0, 0}, {8000, 0, 0}};
+// The phone stops reading SPP for a while every two seconds
+static const Scenario STALLED = {"stalled", {UART_BYTES_PER_SECOND, 0, 0}, {30000, 2000, 400}, {8000, 0, 0}};
+
+// Matches what arrives to what was sent, oldest copy first
+class Tracker {
+public:
+    void send(const char* data, size_t len, uint64_t ns)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pending[std::string(data, len)].push_back(ns);
+        _sent++;
+        _sentBytes += len;
+    }
+    void receive(const char* data, size_t len, uint64_t ns)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _pending.find(std::string(data, len));
+        if (it == _pending.end() || it->second.empty())
+            return; // Menu output, or not ours
+        _latency.add(ns - it->second.front());
+        it->second.pop_front();
+        _received++;
+        _receivedBytes += len;
+    }
+
+    uint32_t sent() const { return _sent; }
+    uint32_t received() const { return _received; }
+    uint64_t receivedBytes() const { return _receivedBytes; }
+    bench::Latency& latency() { return _latency; }
+
+private:
+    std::mutex _mutex;
+    std::unordered_map<std::string, std::deque<uint64_t>> _pending;
+    bench::Latency _latency;
+    uint32_t _sent = 0;
+    uint32_t _received = 0;
+    uint64_t _sentBytes = 0;
+    uint64_t _receivedBytes = 0;
+};
+
+static void sleepUntil(uint64_t ns)
+{
+    uint64_t now = bench::nowNs();
+    if (ns > now)
+        std::this_thread::sleep_for(std::chrono::nanoseconds(ns - now));
+}
+
+// Far end of one link. A write takes as long as the link needs to carry it
+// and waits out a stall first, like a UART whose FIFO stops draining. What
+// arrives is split into sentences (or RTCM frames) for the tracker.
+class SimLink : public Stream {
+public:
+    SimLink(Tracker& tracker, bool frames) : _tracker(tracker), _frames(frames) {}
+
+    void configure(const Link& link)
+    {
+        _link = link;
+        _origin = bench::nowNs();
+        _freeAt = _origin;
+    }
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override
+    {
+        uint64_t start = std::max(bench::nowNs(), _freeAt);
+        if (_link.stallEveryMs)
+        {
+            uint64_t phase = (start - _origin) % (_link.stallEveryMs * 1000000ull);
+            uint64_t stall = _link.stallForMs * 1000000ull;
+            if (phase < stall)
+                start += stall - phase;
+        }
+        _freeAt = start + size * 1000000000ull / _link.bytesPerSecond;
+        sleepUntil(_freeAt);
+        if (_frames)
+            _framer.feed(buffer, size, onFrame, this);
+        else
+            splitLines(buffer, size);
+        return size;
+    }
+    using Print::write;
+    int availableForWrite() override { return 128; }
+
+    // Lines starting with watch are counted, e.g. a menu reply
+    const char* watch = nullptr;
+    std::atomic<uint32_t> watched{0};
+
+private:
+    Tracker& _tracker;
+    bool _frames;
+    Link _link = {UART_BYTES_PER_SECOND, 0, 0};
+    uint64_t _origin = 0;
+    uint64_t _freeAt = 0;
+    std::string _line;
+    Rtcm3Framer _framer;
+
+    void splitLines(const uint8_t* buffer, size_t size)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            _line += (char)buffer[i];
+            if (buffer[i] != '\n')
+                continue;
+            if (watch && _line.compare(0, strlen(watch), watch) == 0)
+                watched++;
+            // Menu prompts and mirrored corrections have no line end of their
+            // own, so a sentence may follow them on the same line
+            size_t start = _line.rfind('$');
+            if (start != std::string::npos)
+                _tracker.receive(_line.data() + start, _line.size() - start, bench::nowNs());
+            _line.clear();
+        }
+    }
+
+    static void onFrame(void* ctx, const uint8_t* frame, size_t len, uint16_t type)
+    {
+        static_cast<SimLink*>(ctx)->_tracker.receive((const char*)frame, len, bench::nowNs());
+    }
+};
+
+static const MenuCLI::Command MENU_COMMANDS[] = {
+    {"soak", "Answers the soak generator", [](MenuCLI::Args args, Stream& out) { out.println("soak: ok"); }},
+};
+
+// Ports, output stages, router and menu as main.cpp sets them up, with mux
+// uplinks so the menu can open while corrections flow. Drain tasks never
+// exit, so each step builds a fresh bridge and leaves it running.
+struct Bridge {
+    Tracker serialDown, sppDown, bleDown, uplink;
+    SimLink serial{serialDown, false};
+    SimLink spp{sppDown, false};
+    SimLink ble{bleDown, false};
+    SimLink serial1{uplink, true};
+    OutputForwarder serialOut{serial, "Serial Out"};
+    OutputForwarder serial1Out{serial1, "Serial1 Out"};
+    OutputForwarder serialBTOut{spp, "SerialBT Out"};
+    OutputForwarder bleOut{ble, "BLE Out"};
+    BTDownlink btDownlink{serialBTOut, bleOut};
+    LinkCounters serialTx, serial1Tx, serialBTTx, bleTx;
+    PacketPool pool;
+    MenuCLI menu;
+    Router router{serialOut, serial1Out, btDownlink, menu};
+
+    explicit Bridge(const Scenario& scenario)
+    {
+        serial.configure(scenario.serial);
+        spp.configure(scenario.spp);
+        ble.configure(scenario.ble);
+        serial1.configure({UART_BYTES_PER_SECOND, 0, 0});
+        serial.watch = "soak: ok";
+
+        serialOut.begin(TX_QUEUE_SIZE, 1);
+        serial1Out.begin(TX_QUEUE_SIZE, 1);
+        serialBTOut.begin(TX_QUEUE_SIZE, 0);
+        bleOut.begin(TX_QUEUE_SIZE, 0);
+        serialOut.setCounters(&serialTx);
+        serial1Out.setCounters(&serial1Tx);
+        serialBTOut.setCounters(&serialBTTx);
+        bleOut.setCounters(&bleTx);
+        serialBTOut.setCoalescing(512, 20);
+        bleOut.setCoalescing(512, 20);
+        serialBTOut.setBackpressure({OutputForwarder::KeepLatest, 75, 50});
+        bleOut.setBackpressure({OutputForwarder::KeepLatest, 75, 50});
+        serialOut.setDelimiter('\n');
+        serialBTOut.setDelimiter('\n');
+        bleOut.setDelimiter('\n');
+        pool.begin(48, 512);
+        router.setPacketPool(&pool);
+        router.setPriority(BridgeRouterBase::SerialBTInput, 1);
+        router.setUplinkMode(BridgeRouterBase::UplinkMode::Mux);
+        router.corrections().setReserve(TX_QUEUE_SIZE - 2048);
+        router.begin();
+
+        menu.setCommandTable(MENU_COMMANDS);
+        menu.attachOutput(&serialOut);
+        menu.attachOutput(&serialBTOut);
+        menu.attachOutput(&bleOut);
+        menu.setOnExit([this] { router.setState(BridgeRouterBase::State::Idle); });
+    }
+
+    // Waits until every output stage has handed its queue to its link
+    void drain(unsigned long ms)
+    {
+        OutputForwarder* outs[] = {&serialOut, &serial1Out, &serialBTOut, &bleOut};
+        unsigned long start = millis();
+        for (int idle = 0; idle < 3 && millis() - start < ms;)
+        {
+            delay(10);
+            bool empty = true;
+            for (OutputForwarder* out : outs)
+                if (out->pending() > 0)
+                    empty = false;
+            idle = empty ? idle + 1 : 0;
+        }
+    }
+};
+
+// Bytes on their way into the router, handed over at the pace of the
+// input link. Units are registered as sent when the source emits them, so
+// latency includes the input link as it did on the bench.
+class Feed {
+public:
+    Feed(Tracker* trackers[], size_t count) : _trackers(trackers), _count(count) {}
+
+    void push(const char* data, size_t len, uint64_t ns)
+    {
+        for (size_t i = 0; i < _count; ++i)
+            _trackers[i]->send(data, len, ns);
+        _data.append(data, len);
+    }
+    // Hands over up to max bytes in chunks of at most chunk
+    template <class Route>
+    size_t pump(size_t max, size_t chunk, Route route)
+    {
+        size_t done = 0;
+        while (done < max && done < _data.size())
+        {
+            size_t len = std::min(std::min(chunk, max - done), _data.size() - done);
+            route((const uint8_t*)_data.data() + done, len);
+            done += len;
+        }
+        _data.erase(0, done);
+        return done;
+    }
+
+private:
+    Tracker** _trackers;
+    size_t _count;
+    std::string _data;
+};
+
+struct Row {
+    unsigned rateHz;
+    const char* scenario;
+    const char* direction;
+    uint32_t sent;
+    uint32_t received;
+    double dropPercent;
+    uint32_t deliveredBps;
+    double p50Ms, p99Ms, maxMs;
+};
+
+static std::vector<Row> rows;
+
+static unsigned long stepMs()
+{
+    const char* env = getenv("SOAK_STEP_MS");
+    return env ? strtoul(env, nullptr, 10) : 2500;
+}
+
+static Row row(unsigned rateHz, const Scenario& scenario, const char* direction, Tracker& tracker, double seconds)
+{
+    bench::Latency& latency = tracker.latency();
+    Row r = {rateHz, scenario.name, direction, tracker.sent(), tracker.received(), 0, (uint32_t)(tracker.receivedBytes() / seconds),
+             latency.percentile(50) / 1e6, latency.percentile(99) / 1e6, latency.percentile(100) / 1e6};
+    if (tracker.sent())
+        r.dropPercent = 100.0 * (tracker.sent() - tracker.received()) / tracker.sent();
+    return r;
+}
+
+static void printRow(const Row& r)
+{
+    char line[160];
+    snprintf(line, sizeof(line), "%4u Hz %-7s %-7s %6u sent %6.2f%% dropped %6u B/s  p50 %7.2f  p99 %7.2f  max %7.2f ms",
+             r.rateHz, r.scenario, r.direction, (unsigned)r.sent, r.dropPercent, (unsigned)r.deliveredBps, r.p50Ms,
+             r.p99Ms, r.maxMs);
+    TEST_MESSAGE(line);
+}
+
+// One step: rateHz receiver epochs, a correction burst every second and one
+// menu session, then the links drain and every direction gets a row
+static void runStep(unsigned rateHz, const Scenario& scenario, uint32_t& menuReplies)
+{
+    Bridge* bridge = new Bridge(scenario);
+    Router& router = bridge->router;
+    Tracker* downlinks[] = {&bridge->serialDown, &bridge->sppDown, &bridge->bleDown};
+    Tracker* uplinks[] = {&bridge->uplink};
+    Feed nmea(downlinks, 3), rtcm(uplinks, 1);
+    unsigned long duration = stepMs();
+    uint64_t start = bench::nowNs();
+    uint64_t uartFed = 0, sppFed = 0;
+    unsigned epoch = 0, burst = 0;
+    bool menuSent = false;
+
+    for (uint64_t now = start; now - start < duration * 1000000ull; now = bench::nowNs())
+    {
+        uint64_t elapsedUs = (now - start) / 1000;
+        while (epoch * 1000000ull / rateHz <= elapsedUs)
+        {
+            std::string text = gnss::epoch(epoch++, CONSTELLATIONS);
+            for (size_t pos = 0; pos < text.size();)
+            {
+                size_t end = text.find('\n', pos) + 1;
+                nmea.push(text.data() + pos, end - pos, now);
+                pos = end;
+            }
+        }
+        // Corrections a little after each second starts
+        while (burst * 1000000ull + 100000 <= elapsedUs)
+        {
+            std::vector<uint8_t> frames = gnss::rtcmEpoch((uint8_t)burst++);
+            for (size_t pos = 0; pos < frames.size();)
+            {
+                size_t len = Rtcm3Framer::HEADER_LEN + (((frames[pos + 1] & 0x03) << 8) | frames[pos + 2]) +
+                             Rtcm3Framer::CRC_LEN;
+                rtcm.push((const char*)frames.data() + pos, len, now);
+                pos += len;
+            }
+        }
+        if (!menuSent && elapsedUs >= duration * 500)
+        {
+            for (const char* line : {"menu\n", "soak\n", "exit\n"})
+                router.onSerialData((const uint8_t*)line, strlen(line));
+            menuSent = true;
+        }
+
+        uint64_t uartDue = elapsedUs * UART_BYTES_PER_SECOND / 1000000;
+        uartFed += nmea.pump(uartDue - std::min(uartDue, uartFed), UART_CHUNK,
+                             [&](const uint8_t* data, size_t len) { router.onSerial1Data(data, len); });
+        uint64_t sppDue = elapsedUs * SPP_UPLINK_BYTES_PER_SECOND / 1000000;
+        sppFed += rtcm.pump(sppDue - std::min(sppDue, sppFed), SPP_CHUNK,
+                            [&](const uint8_t* data, size_t len) { router.onSerialBTData(data, len); });
+        router.poll();
+        bridge->menu.poll();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    double seconds = duration / 1000.0;
+    bridge->drain(3000);
+    menuReplies += bridge->serial.watched;
+    TEST_ASSERT_EQUAL(BridgeRouterBase::State::Idle, router.state());
+
+    rows.push_back(row(rateHz, scenario, "serial", bridge->serialDown, seconds));
+    rows.push_back(row(rateHz, scenario, "spp", bridge->sppDown, seconds));
+    rows.push_back(row(rateHz, scenario, "ble", bridge->bleDown, seconds));
+    rows.push_back(row(rateHz, scenario, "uplink", bridge->uplink, seconds));
+    for (size_t i = rows.size() - 4; i < rows.size(); ++i)
+        printRow(rows[i]);
+}
+
+static const Row* findRow(const char* scenario, unsigned rateHz, const char* direction)
+{
+    for (const Row& r : rows)
+        if (r.rateHz == rateHz && strcmp(r.scenario, scenario) == 0 && strcmp(r.direction, direction) == 0)
+            return &r;
+    return nullptr;
+}
+
+static void assertNoDrops(const Row* r)
+{
+    TEST_ASSERT_NOT_NULL(r);
+    TEST_ASSERT_GREATER_THAN(0, r->sent);
+    TEST_ASSERT_EQUAL_UINT32(r->sent, r->received);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_steady_links(void)
+{
+    uint32_t menuReplies = 0;
+    for (unsigned rate : RATES_HZ)
+        runStep(rate, STEADY, menuReplies);
+    TEST_ASSERT_EQUAL_UINT32(sizeof(RATES_HZ) / sizeof(RATES_HZ[0]), menuReplies);
+
+    // Below every link's capacity nothing may be lost
+    for (const char* direction : {"serial", "spp", "ble", "uplink"})
+        assertNoDrops(findRow("steady", 1, direction));
+    // USB and Serial1 keep up at every rate; corrections are never dropped
+    for (unsigned rate : RATES_HZ)
+    {
+        assertNoDrops(findRow("steady", rate, "serial"));
+        assertNoDrops(findRow("steady", rate, "uplink"));
+    }
+}
+
+void test_stalled_client(void)
+{
+    uint32_t menuReplies = 0;
+    for (unsigned rate : RATES_HZ)
+        runStep(rate, STALLED, menuReplies);
+    TEST_ASSERT_EQUAL_UINT32(sizeof(RATES_HZ) / sizeof(RATES_HZ[0]), menuReplies);
+
+    // A stalled phone only costs its own link
+    for (unsigned rate : RATES_HZ)
+    {
+        assertNoDrops(findRow("stalled", rate, "serial"));
+        assertNoDrops(findRow("stalled", rate, "uplink"));
+    }
+}
+
+// Stores the table and compares it with one stored by an earlier commit
+void test_against_baseline(void)
+{
+    if (const char* path = getenv("SOAK_RESULTS"))
+    {
+        FILE* out = fopen(path, "w");
+        TEST_ASSERT_NOT_NULL(out);
+        fprintf(out, "# rate_hz scenario direction sent drop_percent delivered_bps p50_ms p99_ms max_ms\n");
+        for (const Row& r : rows)
+            fprintf(out, "%u %s %s %u %.2f %u %.3f %.3f %.3f\n", r.rateHz, r.scenario, r.direction,
+                    (unsigned)r.sent, r.dropPercent, (unsigned)r.deliveredBps, r.p50Ms, r.p99Ms, r.maxMs);
+        fclose(out);
+    }
+
+    const char* path = getenv("SOAK_BASELINE");
+    if (!path)
+        TEST_IGNORE_MESSAGE("SOAK_BASELINE not set");
+    const char* tolerance = getenv("SOAK_TOLERANCE");
+    double allowed = tolerance ? atof(tolerance) : 0.5;
+    FILE* in = fopen(path, "r");
+    TEST_ASSERT_NOT_NULL(in);
+    char text[200];
+    int regressions = 0;
+    while (fgets(text, sizeof(text), in))
+    {
+        unsigned rate, sent, bps;
+        char scenario[16], direction[16];
+        double drop, p50, p99, max;
+        if (text[0] == '#' || sscanf(text, "%u %15s %15s %u %lf %u %lf %lf %lf", &rate, scenario, direction, &sent,
+                                     &drop, &bps, &p50, &p99, &max) != 9)
+            continue;
+        const Row* now = findRow(scenario, rate, direction);
+        if (!now)
+            continue;
+        // Host timing is noisy, so latency gets a millisecond on top of the
+        // ratio, and links shedding load on purpose a tenth more drops
+        bool worse = now->dropPercent > drop * 1.1 + 1.0 || now->p99Ms > p99 * (1 + allowed) + 1.0;
+        if (worse)
+        {
+            char line[200];
+            snprintf(line, sizeof(line), "Regression %u Hz %s %s: drop %.2f%% -> %.2f%%, p99 %.2f -> %.2f ms", rate,
+                     scenario, direction, drop, now->dropPercent, p99, now->p99Ms);
+            TEST_MESSAGE(line);
+            regressions++;
+        }
+    }
+    fclose(in);
+    TEST_ASSERT_EQUAL_INT(0, regressions);
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_steady_links);
+    RUN_TEST(test_stalled_client);
+    RUN_TEST(test_against_baseline);
+    return UNITY_END();
+}
@@ -0,0 +1,216 @@
+#!/usr/bin/env python3
+"""Decode and replay a traffic capture recorded with `capture start`.
+
+Usage:
+    capture_replay.py capture.log                    # summary of a saved terminal log
+    capture_replay.py capture.bin --events           # list every record of a raw capture file
+    capture_replay.py --port /dev/ttyUSB0 --save capture.bin
+                                                     # fetch the capture from a bridge in the menu
+    capture_replay.py capture.bin --to Serial1=/dev/ttyUSB1 --to SerialBT=/dev/rfcomm0 --speed 4
+                                                     # replay into the bridge at four times the original pace
+
+A capture is a ring of 2048-byte blocks, each decodable on its own:
+    header  magic "CAP1", seq u32, baseUs u64, used u16, records u16, crc32 u32 (little-endian)
+    record  varint deltaUs, source u8, varint len, payload
+`capture dump <n>` prints block n as "CAPTURE 1 <n> <blocks>", "B <hex>" lines, "CAPTURE END".
+
+Replaying writes each record's payload to the device mapped to its source,
+so the bridge routes it again: Serial records go into the bridge's USB port,
+Serial1 records into an adapter wired to the receiver side, SerialBT and BLE
+records into a Bluetooth serial port. --speed 0 sends as fast as possible and
+reports the throughput, which makes a capture usable as a benchmark.
+Without hardware, test/test_capture_replay feeds a capture file into the
+router on the host: CAPTURE_FILE=capture.bin CAPTURE_SPEED=0 pio test -e native -f test_capture_replay
+"""
+
+import argparse
+import struct
+import sys
+import time
+import zlib
+
+PORTS = ["Serial", "Serial1", "SerialBT", "BLE"]
+BLOCK_SIZE = 2048
+HEADER = struct.Struct("<IIQHHI")
+MAGIC = 0x31504143
+
+
+def name(index):
+    return PORTS[index] if index < len(PORTS) else "?%d" % index
+
+
+def varint(data, pos):
+    value, shift = 0, 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        if byte < 0x80:
+            return value, pos
+        shift += 7
+
+
+def decode_block(block):
+    """Returns (seq, records) or None for an empty or damaged block."""
+    if len(block) < HEADER.size:
+        return None
+    magic, seq, base, used, count, crc = HEADER.unpack_from(block)
+    body = block[HEADER.size:HEADER.size + used]
+    if magic != MAGIC or len(body) != used or zlib.crc32(body) != crc:
+        return None
+    records, pos, us = [], 0, base
+    for _ in range(count):
+        delta, pos = varint(body, pos)
+        source = body[pos]
+        length, pos = varint(body, pos + 1)
+        us += delta
+        records.append((us, source, bytes(body[pos:pos + length])))
+        pos += length
+    return seq, records
+
+
+def parse_dump(lines):
+    """Collects the blocks of one or more `capture dump` outputs."""
+    blocks, current = {}, None
+    for line in lines:
+        line = line.strip()
+        if line.startswith("CAPTURE END"):
+            if current is not None:
+                blocks[current[0]] = bytes.fromhex(current[1])
+            current = None
+        elif line.startswith("CAPTURE "):
+            current = (int(line.split()[2]), "")
+        elif current is not None and line.startswith("B "):
+            current = (current[0], current[1] + line[2:])
+    return [blocks[i] for i in sorted(blocks)]
+
+
+def load(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:4] == struct.pack("<I", MAGIC) or data[:4] == bytes(4):
+        return [data[i:i + BLOCK_SIZE] for i in range(0, len(data), BLOCK_SIZE)]
+    return parse_dump(data.decode("ascii", "replace").splitlines())
+
+
+def fetch(port, baud, timeout):
+    import serial  # pyserial
+
+    with serial.Serial(port, baud, timeout=timeout) as link:
+        link.reset_input_buffer()
+        blocks, index, total = [], 0, None
+        while total is None or index < total:
+            link.write(b"capture dump %d\n" % index)
+            lines = []
+            while True:
+                line = link.readline().decode("ascii", "replace")
+                if not line:
+                    raise TimeoutError("no CAPTURE END for block %d" % index)
+                lines.append(line)
+                if line.startswith("CAPTURE "):
+                    total = int(line.split()[3])
+                if line.startswith("CAPTURE END"):
+                    break
+            block = parse_dump(lines)
+            if not block or len(block[0]) != BLOCK_SIZE:
+                continue  # Lost on the way, ask again
+            blocks.append(block[0])
+            index += 1
+        return blocks
+
+
+def records_of(blocks):
+    decoded = [d for d in map(decode_block, blocks) if d]
+    damaged = sum(1 for b in blocks if any(b[:4])) - len(decoded)
+    decoded.sort(key=lambda d: d[0])
+    records = [r for _, block in decoded for r in block]
+    return records, len(decoded), damaged
+
+
+def report(records, blocks, damaged, show_events):
+    print("Blocks: %d valid, %d damaged" % (blocks, damaged))
+    if not records:
+        return
+    base = records[0][0]
+    span = (records[-1][0] - base) / 1e6
+    print("Records: %d over %.3f s" % (len(records), span))
+    print("Source      chunks      bytes   bytes/s")
+    totals = {}
+    for _, source, payload in records:
+        chunks, size = totals.get(source, (0, 0))
+        totals[source] = (chunks + 1, size + len(payload))
+    for source, (chunks, size) in sorted(totals.items()):
+        print("%-9s %8d %10d %9.0f" % (name(source), chunks, size, size / span if span > 0 else 0))
+    if show_events:
+        print()
+        for us, source, payload in records:
+            print("%12.6f  %-8s %5d  %s" % ((us - base) / 1e6, name(source), len(payload),
+                                             payload[:32].hex()))
+
+
+def replay(records, targets, baud, speed):
+    import serial  # pyserial
+
+    links = {PORTS.index(src): serial.Serial(dev, baud) for src, dev in targets}
+    try:
+        start = time.monotonic()
+        base = records[0][0] if records else 0
+        sent = 0
+        for us, source, payload in records:
+            link = links.get(source)
+            if link is None:
+                continue
+            if speed > 0:
+                delay = (us - base) / 1e6 / speed - (time.monotonic() - start)
+                if delay > 0:
+                    time.sleep(delay)
+            link.write(payload)
+            sent += len(payload)
+        for link in links.values():
+            link.flush()
+        elapsed = time.monotonic() - start
+        print("Replayed %d bytes in %.3f s (%.0f bytes/s)" % (sent, elapsed, sent / elapsed if elapsed else 0))
+    finally:
+        for link in links.values():
+            link.close()
+
+
+def target(text):
+    source, _, device = text.partition("=")
+    if source not in PORTS or not device:
+        raise argparse.ArgumentTypeError("expected SOURCE=DEVICE with SOURCE one of " + ", ".join(PORTS))
+    return source, device
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", nargs="?", help="raw capture file or captured dump log")
+    parser.add_argument("--port", help="serial port of a bridge that is already in the menu")
+    parser.add_argument("--baud", type=int, default=460800)
+    parser.add_argument("--timeout", type=float, default=3.0)
+    parser.add_argument("--save", help="write the raw capture file here")
+    parser.add_argument("--events", action="store_true", help="also list every record")
+    parser.add_argument("--to", type=target, action="append", default=[], metavar="SOURCE=DEVICE",
+                        help="replay records of SOURCE into DEVICE; may be repeated")
+    parser.add_argument("--speed", type=float, default=1.0, help="pace factor, 0 for as fast as possible")
+    args = parser.parse_args()
+
+    if args.port:
+        blocks = fetch(args.port, args.baud, args.timeout)
+    elif args.input:
+        blocks = load(args.input)
+    else:
+        parser.error("need an input file or --port")
+
+    if args.save:
+        with open(args.save, "wb") as f:
+            f.write(b"".join(blocks))
+
+    records, valid, damaged = records_of(blocks)
+    report(records, valid, damaged, args.events)
+    if args.to:
+        replay(records, args.to, args.baud, args.speed)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,48 @@
+#!/usr/bin/env python3
+"""Merge soak tables into a baseline that holds the worst of each row.
+
+Usage:
+    soak_baseline.py soak1.txt soak2.txt ... > test/test_soak/baseline.txt
+
+Each table is what test_soak stores with SOAK_RESULTS=<file>. A single run's
+p99 on a busy host is one scheduling hiccup away from doubling, so the
+checked-in baseline is the envelope of several runs: the highest drop rate
+and latencies and the lowest delivered rate seen for each row.
+"""
+
+import sys
+
+HEADER = "# rate_hz scenario direction sent drop_percent delivered_bps p50_ms p99_ms max_ms"
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    rows, order = {}, []
+    for path in sys.argv[1:]:
+        with open(path) as f:
+            for line in f:
+                fields = line.split()
+                if line.startswith("#") or len(fields) != 9:
+                    continue
+                key = tuple(fields[:3])
+                sent = int(fields[3])
+                drop, bps = float(fields[4]), int(fields[5])
+                latency = [float(v) for v in fields[6:]]
+                if key not in rows:
+                    order.append(key)
+                    rows[key] = [sent, drop, bps] + latency
+                    continue
+                row = rows[key]
+                row[0] = max(row[0], sent)
+                row[1] = max(row[1], drop)
+                row[2] = min(row[2], bps)
+                row[3:] = [max(a, b) for a, b in zip(row[3:], latency)]
+    print(HEADER)
+    for key in order:
+        sent, drop, bps, p50, p99, worst = rows[key]
+        print("%s %s %s %u %.2f %u %.3f %.3f %.3f" % (key + (sent, drop, bps, p50, p99, worst)))
+
+
+if __name__ == "__main__":
+    main()
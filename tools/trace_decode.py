@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+"""Decode a `trace dump` captured from the bridge menu into a latency report.
+
+Usage:
+    trace_decode.py capture.log          # decode a saved terminal log
+    trace_decode.py -                    # read from stdin
+    trace_decode.py --port /dev/ttyUSB0  # request a dump over a serial port (needs pyserial)
+
+The dump is framed as:
+    TRACE 1 <records>
+    R <hex>   trace records, 8 bytes each: us u32le, point u8, port u8, len u16le
+    H <hex>   one path histogram: src u8, dst u8, count u32, max u32, then
+              (bucket u8, count u32) pairs, all as big-endian hex numbers
+    TRACE END
+"""
+
+import argparse
+import struct
+import sys
+
+PORTS = ["Serial", "Serial1", "SerialBT", "BLE"]
+POINTS = ["receive", "enqueue", "output"]
+
+
+def upper_bound(bucket):
+    # Mirrors LatencyTrace::Histogram::upperBound
+    if bucket < 8:
+        return bucket
+    e = bucket // 4 + 1
+    return ((4 + bucket % 4) << (e - 2)) + (1 << (e - 2)) - 1
+
+
+def percentile(buckets, count, top, pct):
+    target = (count * pct + 99) // 100
+    seen = 0
+    for bucket in sorted(buckets):
+        seen += buckets[bucket]
+        if seen >= target:
+            return min(upper_bound(bucket), top)
+    return top
+
+
+def parse(lines):
+    """Returns (records, histograms) of the last complete dump in lines."""
+    result = None
+    records, histograms, inside = [], [], False
+    for line in lines:
+        line = line.strip()
+        if line.startswith("TRACE END"):
+            if inside:
+                result = (records, histograms)
+            inside = False
+        elif line.startswith("TRACE "):
+            records, histograms, inside = [], [], True
+        elif inside and line.startswith("R "):
+            data = bytes.fromhex(line[2:])
+            if len(data) % 8:
+                raise ValueError("truncated record line: " + line)
+            for off in range(0, len(data), 8):
+                us, point, port, length = struct.unpack_from("<IBBH", data, off)
+                records.append((us, point, port, length))
+        elif inside and line.startswith("H "):
+            text = line[2:]
+            src, dst = int(text[0:2], 16), int(text[2:4], 16)
+            count, top = int(text[4:12], 16), int(text[12:20], 16)
+            buckets = {}
+            for off in range(20, len(text), 10):
+                buckets[int(text[off:off + 2], 16)] = int(text[off + 2:off + 10], 16)
+            histograms.append((src, dst, count, top, buckets))
+    if result is None:
+        raise ValueError("no complete TRACE dump found")
+    return result
+
+
+def name(table, index):
+    return table[index] if index < len(table) else "?%d" % index
+
+
+def report(records, histograms, show_events):
+    print("Path                   count     p50 us     p99 us     max us")
+    for src, dst, count, top, buckets in histograms:
+        print("%-8s -> %-8s %9d %10d %10d %10d" % (
+            name(PORTS, src), name(PORTS, dst), count,
+            percentile(buckets, count, top, 50), percentile(buckets, count, top, 99), top))
+
+    if not records:
+        return
+    # Unsigned 32-bit microseconds; unwrap relative to the first record
+    base = records[0][0]
+    span = ((records[-1][0] - base) & 0xFFFFFFFF) / 1e6
+    print()
+    print("Trace ring: %d records over %.3f s" % (len(records), span))
+    print("Point     Port        events      bytes   bytes/s")
+    totals = {}
+    for _, point, port, length in records:
+        events, size = totals.get((point, port), (0, 0))
+        totals[(point, port)] = (events + 1, size + length)
+    for (point, port), (events, size) in sorted(totals.items()):
+        rate = size / span if span > 0 else 0
+        print("%-9s %-9s %8d %10d %9.0f" % (name(POINTS, point), name(PORTS, port), events, size, rate))
+
+    if show_events:
+        print()
+        for us, point, port, length in records:
+            print("%12.6f  %-8s %-8s %5d" % (((us - base) & 0xFFFFFFFF) / 1e6,
+                                             name(POINTS, point), name(PORTS, port), length))
+
+
+def capture(port, baud, timeout):
+    import serial  # pyserial
+
+    with serial.Serial(port, baud, timeout=timeout) as link:
+        link.reset_input_buffer()
+        link.write(b"trace dump\n")
+        lines = []
+        while True:
+            line = link.readline().decode("ascii", "replace")
+            if not line:
+                raise TimeoutError("no TRACE END received")
+            lines.append(line)
+            if line.startswith("TRACE END"):
+                return lines
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", nargs="?", help="captured log file, or - for stdin")
+    parser.add_argument("--port", help="serial port of a bridge that is already in the menu")
+    parser.add_argument("--baud", type=int, default=460800)
+    parser.add_argument("--timeout", type=float, default=3.0)
+    parser.add_argument("--events", action="store_true", help="also list every trace record")
+    args = parser.parse_args()
+
+    if args.port:
+        lines = capture(args.port, args.baud, args.timeout)
+    elif args.input and args.input != "-":
+        with open(args.input, encoding="ascii", errors="replace") as f:
+            lines = f.readlines()
+    else:
+        lines = sys.stdin.readlines()
+
+    records, histograms = parse(lines)
+    report(records, histograms, args.events)
+
+
+if __name__ == "__main__":
+    main()